@@ -66,6 +66,14 @@ namespace _goptical
       void get_default_image();
       void trace();
 
+      /** Get number of threads from tracer parameters */
+      unsigned int get_thread_count() const;
+
+      /** Get number of threads used to process given number of
+          items, from tracer parameters. Small jobs are not worth
+          starting threads. */
+      unsigned int get_thread_count(size_t items) const;
+
       sys::system &     _system;
       trace::tracer     _tracer;
       bool              _processed_trace;
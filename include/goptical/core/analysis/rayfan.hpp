@@ -26,6 +26,9 @@
 #ifndef GOPTICAL_ANALYSIS_RAYFAN_HH_
 #define GOPTICAL_ANALYSIS_RAYFAN_HH_
 
+#include <map>
+#include <vector>
+
 #include "goptical/core/common.hpp"
 
 #include "goptical/core/io/renderer_axes.hpp"
@@ -40,6 +43,8 @@ namespace _goptical
   namespace analysis
   {
 
+    class RayFanSink;
+
     /**
        @short RayFan diagram analysis
        @header <goptical/core/analysis/RayFan
@@ -48,6 +53,14 @@ namespace _goptical
 
        This class is designed to compute various ray fan plots.
 
+       Rays striking the entrance and target surfaces are recorded
+       by a @ref trace::Sink while tracing. Target surface rays are
+       matched with entrance rays using the index of the source ray
+       they derive from, and their optical path length is
+       accumulated by the tracer, so ray history is not
+       required. Rays are then grouped by wavelen and the chief ray
+       of each wavelen is located once per ray trace.
+
        @xsee {tuto_fan1, tuto_fan2}
     */
     class RayFan
@@ -120,23 +133,59 @@ namespace _goptical
       void invalidate();
 
     private:
+      friend class RayFanSink;
+
+      /** Source ray striking the entrance surface */
+      struct entrance_s
+      {
+        unsigned int _source_index;
+        math::Vector3 _point;           // entrance surface local
+        math::Vector3 _direction;       // incident ray direction
+      };
+
+      /** Indexed ray striking the target surface */
+      struct ray_s
+      {
+        light::Ray _ray;
+        double  _len;
+        math::Vector3 _point;           // target surface local
+        math::Vector3 _exit;            // direction of ray generated by target
+        bool    _has_exit;
+        unsigned int _entrance;         // entrance ray index
+        double  _opl;                   // optical path length in waves
+      };
+
+      /** Indexed rays range and chief ray of a wavelen */
+      struct wavelen_s
+      {
+        unsigned int _first;
+        unsigned int _last;
+        unsigned int _chief;
+      };
+
       void process_trace();
+      void process_index(RayFanSink &sink);
 
-      typedef double (RayFan::*get_value_t)(const trace::Ray &r, const trace::Ray &chief) const;
+      typedef double (RayFan::*get_value_t)(const ray_s &r, const ray_s &chief) const;
 
-      const trace::Ray & find_chief_ray(const trace::rays_queue_t &intercepts, double wavelen);
+      const ray_s & find_chief_ray(double wavelen) const;
 
-      double get_entrance_height(const trace::Ray &r, const trace::Ray &chief) const;
-      double get_entrance_angle(const trace::Ray &r, const trace::Ray &chief) const;
-      double get_transverse_distance(const trace::Ray &r, const trace::Ray &chief) const;
-      double get_longitudinal_distance(const trace::Ray &r, const trace::Ray &chief) const;
-      double get_optical_path_len(const trace::Ray &r, const trace::Ray &chief) const;
-      double get_image_angle(const trace::Ray &r, const trace::Ray &chief) const;
-      double get_exit_angle(const trace::Ray &r, const trace::Ray &chief) const;
+      double get_entrance_height(const ray_s &r, const ray_s &chief) const;
+      double get_entrance_angle(const ray_s &r, const ray_s &chief) const;
+      double get_transverse_distance(const ray_s &r, const ray_s &chief) const;
+      double get_longitudinal_distance(const ray_s &r, const ray_s &chief) const;
+      double get_optical_path_len(const ray_s &r, const ray_s &chief) const;
+      double get_image_angle(const ray_s &r, const ray_s &chief) const;
+      double get_exit_angle(const ray_s &r, const ray_s &chief) const;
 
       trace::tracer     _tracer;
       bool              _processed_trace;
 
+      std::vector<entrance_s> _entrance_rays;
+      std::vector<ray_s> _rays;         // sorted by wavelen
+      std::map<double, wavelen_s> _wavelens;
+      double            _entrance_radius;
+
       const sys::Surface *_entrance;
       const sys::Surface *_exit;
 
@@ -26,6 +26,9 @@
 #ifndef GOPTICAL_ANALYSIS_SPOT_HH_
 #define GOPTICAL_ANALYSIS_SPOT_HH_
 
+#include <map>
+#include <vector>
+
 #include "goptical/core/common.hpp"
 
 #include "goptical/core/io/renderer_axes.hpp"
@@ -49,6 +52,12 @@ namespace _goptical
        This class is designed to plot spot diagram and perform
        related analysis.
 
+       Intercepts distances from spot centroid are sorted along with
+       cumulated intensity when the analysis is processed, so that
+       encircled and ensquared intensity queries do not scan all
+       intercepts. Spot statistics are computed on the tracer
+       threads.
+
        @xsee {tuto_spot1, tuto_spot2}
     */
     class Spot : public PointImage
@@ -76,6 +85,14 @@ namespace _goptical
       /** Get amount of light intensity which falls in given radius from spot center */
       double get_encircled_intensity(double radius);
 
+      /** Get amount of light intensity of given wavelength which
+          falls in given radius from spot center */
+      double get_encircled_intensity(double radius, double wavelen);
+
+      /** Get amount of light intensity which falls in a square
+          centered on spot center with given half side length */
+      double get_ensquared_intensity(double half_side);
+
       /** Get encircled energy plot */
       ref<data::Plot> get_encircled_intensity_plot(int zones = 100);
 
@@ -95,10 +112,23 @@ namespace _goptical
       inline io::RendererAxes & get_diagram_axes();
 
     private:
+      /** Sorted distances with cumulated intensity */
+      struct radial_s
+      {
+        std::vector<double> _radius;
+        std::vector<double> _intensity;
+      };
+
       void process_trace();
       void process_analysis();
 
+      /** Get cumulated intensity up to given distance */
+      static double get_radial_intensity(const radial_s &r, double radius);
+
       math::Vector3 _centroid;
+      radial_s  _radial;        // distance to centroid
+      radial_s  _square;        // largest coordinate distance to centroid
+      std::map<double, radial_s> _radial_wavelen;
 
       bool      _processed_analysis;
       double    _max_radius;
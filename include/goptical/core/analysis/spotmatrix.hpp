@@ -0,0 +1,155 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_ANALYSIS_SPOTMATRIX_HH_
+#define GOPTICAL_ANALYSIS_SPOTMATRIX_HH_
+
+#include <map>
+#include <vector>
+
+#include "goptical/core/common.hpp"
+
+#include "goptical/core/math/vector.hpp"
+#include "goptical/core/light/spectral_line.hpp"
+#include "goptical/core/sys/source_point.hpp"
+
+#include "goptical/core/analysis/pointimage.hpp"
+
+namespace _goptical
+{
+
+  namespace analysis
+  {
+
+    /**
+       @short Field and wavelength spot diagrams analysis
+       @header <goptical/core/analysis/SpotMatrix
+       @module {Core}
+       @main
+
+       This class computes spot statistics for a set of fields and
+       spectral lines, as found in spot diagram matrix reports.
+
+       A point source is created for each field. Field sources are
+       not part of the system, each field is traced by its own
+       tracer where the field source replaces sources of the system,
+       see @ref trace::tracer::set_source. The system is left
+       unchanged and all tracers share the same compiled system.
+       Fields are traced in parallel, tracer threads are shared
+       between fields.
+
+       Statistics of matrix cells are computed on the tracer threads.
+
+       Cells with no ray intercepts on the image have all their
+       statistics set to zero.
+    */
+    class SpotMatrix : public PointImage
+    {
+    public:
+      SpotMatrix(sys::system &system);
+
+      inline void invalidate();
+
+      /** Add a field point source. Field sources are at infinity
+          by default, a direction vector must be provided in this
+          case, a position vector otherwise.
+          @return index of the field */
+      unsigned int add_field(const math::Vector3 &pos_dir,
+                             sys::SourceInfinityMode mode = sys::SourceAtInfinity);
+
+      /** Add a spectral line traced for all fields.
+          @return index of the spectral line */
+      unsigned int add_spectral_line(const light::SpectralLine &l);
+
+      /** Remove all fields and spectral lines */
+      void clear();
+
+      /** Get number of fields */
+      inline unsigned int get_field_count() const;
+
+      /** Get number of spectral lines */
+      inline unsigned int get_spectral_line_count() const;
+
+      /** Get point source used for a field */
+      inline const sys::SourcePoint & get_field_source(unsigned int field) const;
+
+      /** Get number of rays striking the image for a field and spectral line */
+      inline unsigned int get_ray_count(unsigned int field, unsigned int line);
+
+      /** Get spot centroid for a field and spectral line */
+      inline const math::Vector3 & get_centroid(unsigned int field, unsigned int line);
+
+      /** Get spot root mean square radius for a field and spectral line */
+      inline double get_rms_radius(unsigned int field, unsigned int line);
+
+      /** Get spot maximum radius for a field and spectral line */
+      inline double get_max_radius(unsigned int field, unsigned int line);
+
+      /** Get amount of light intensity in the whole spot for a field
+          and spectral line */
+      inline double get_total_intensity(unsigned int field, unsigned int line);
+
+      /** Get amount of light intensity which falls in given radius
+          from spot centroid for a field and spectral line */
+      double get_encircled_intensity(unsigned int field, unsigned int line,
+                                     double radius);
+
+    private:
+      /** Spot statistics of a field and spectral line */
+      struct cell_s
+      {
+        math::Vector3 _centroid;
+        double  _rms_radius;
+        double  _max_radius;
+        double  _intensity;
+        unsigned int _ray_count;
+        std::vector<double> _radius;    // sorted distances to centroid
+        std::vector<double> _encircled; // cumulated intensity
+      };
+
+      /** Ray intercept data kept between traces */
+      struct intercept_s
+      {
+        math::Vector3 _point;
+        double  _intensity;
+        unsigned int _cell;
+      };
+
+      void trace_fields();
+      void process_analysis();
+
+      inline const cell_s & get_cell(unsigned int field, unsigned int line);
+
+      bool      _processed_analysis;
+      std::vector<ref<sys::SourcePoint> > _fields;
+      std::vector<light::SpectralLine> _lines;
+      std::vector<intercept_s> _rays;
+      std::vector<cell_s> _cells;       // indexed by field, then line
+    };
+
+  }
+}
+
+#endif
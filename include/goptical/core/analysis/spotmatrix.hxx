@@ -0,0 +1,101 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_ANALYSIS_SPOTMATRIX_HXX_
+#define GOPTICAL_ANALYSIS_SPOTMATRIX_HXX_
+
+#include "goptical/core/error.hpp"
+#include "goptical/core/math/vector.hxx"
+#include "goptical/core/light/spectral_line.hxx"
+#include "goptical/core/sys/source_point.hxx"
+
+#include "goptical/core/analysis/pointimage.hxx"
+
+namespace _goptical
+{
+
+  namespace analysis
+  {
+
+    void SpotMatrix::invalidate()
+    {
+      _processed_trace = false;
+      _processed_analysis = false;
+    }
+
+    unsigned int SpotMatrix::get_field_count() const
+    {
+      return _fields.size();
+    }
+
+    unsigned int SpotMatrix::get_spectral_line_count() const
+    {
+      return _lines.size();
+    }
+
+    const sys::SourcePoint & SpotMatrix::get_field_source(unsigned int field) const
+    {
+      return *_fields.at(field);
+    }
+
+    const SpotMatrix::cell_s & SpotMatrix::get_cell(unsigned int field, unsigned int line)
+    {
+      if (field >= _fields.size() || line >= _lines.size())
+        throw Error("spot matrix cell out of range");
+
+      process_analysis();
+
+      return _cells[field * _lines.size() + line];
+    }
+
+    unsigned int SpotMatrix::get_ray_count(unsigned int field, unsigned int line)
+    {
+      return get_cell(field, line)._ray_count;
+    }
+
+    const math::Vector3 & SpotMatrix::get_centroid(unsigned int field, unsigned int line)
+    {
+      return get_cell(field, line)._centroid;
+    }
+
+    double SpotMatrix::get_rms_radius(unsigned int field, unsigned int line)
+    {
+      return get_cell(field, line)._rms_radius;
+    }
+
+    double SpotMatrix::get_max_radius(unsigned int field, unsigned int line)
+    {
+      return get_cell(field, line)._max_radius;
+    }
+
+    double SpotMatrix::get_total_intensity(unsigned int field, unsigned int line)
+    {
+      return get_cell(field, line)._intensity;
+    }
+
+  }
+}
+
+#endif
@@ -0,0 +1,134 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_ANALYSIS_THROUGHFOCUS_HH_
+#define GOPTICAL_ANALYSIS_THROUGHFOCUS_HH_
+
+#include <vector>
+
+#include "goptical/core/common.hpp"
+
+#include "goptical/core/math/vector.hpp"
+#include "goptical/core/data/plot.hpp"
+
+#include "goptical/core/analysis/pointimage.hpp"
+
+namespace _goptical
+{
+
+  namespace analysis
+  {
+
+    /**
+       @short Through focus spot analysis
+       @header <goptical/core/analysis/ThroughFocus
+       @module {Core}
+       @main
+
+       This class computes spot size on planes parallel to the
+       image plane, shifted along the image z axis, without tracing
+       again for each plane.
+
+       Rays are traced once. Rays striking the image are straight
+       lines beyond the last optical surface, so their intercept
+       points and slopes are expressed in image coordinates and
+       propagated analytically to each defocused plane. Spot
+       centroid and rms radius are linear and quadratic functions
+       of defocus; they are computed from rays moments in a single
+       pass. Encircled intensity is computed for all planes on the
+       tracer threads.
+
+       Rays are not clipped by the image shape on shifted planes.
+    */
+    class ThroughFocus : public PointImage
+    {
+    public:
+      ThroughFocus(sys::system &system);
+
+      inline void invalidate();
+
+      /** Set defocus of first and last planes relative to image
+          and number of planes. Default is 101 planes from -0.5 to
+          0.5. */
+      void set_defocus_range(double first, double last, unsigned int count);
+
+      /** Get number of defocused planes */
+      inline unsigned int get_plane_count() const;
+
+      /** Get defocus of a plane relative to image */
+      inline double get_defocus(unsigned int plane) const;
+
+      /** Get spot centroid on a plane, in image coordinates */
+      math::Vector2 get_centroid(unsigned int plane);
+
+      /** Get spot root mean square radius on a plane */
+      double get_rms_radius(unsigned int plane);
+
+      /** Get defocus of the plane with smallest spot rms radius. The
+          result is not restricted to the defocus range. */
+      double get_best_defocus();
+
+      /** Get amount of light intensity which falls in given radius
+          from spot centroid on each plane */
+      std::vector<double> get_encircled_intensity(double radius);
+
+      /** Get spot rms radius versus defocus plot */
+      ref<data::Plot> get_rms_radius_plot();
+
+      /** Get encircled intensity in given radius versus defocus plot */
+      ref<data::Plot> get_encircled_intensity_plot(double radius);
+
+    private:
+      void process_rays();
+
+      /** Get rays position on a plane */
+      inline math::Vector2 get_position(unsigned int ray, double defocus) const;
+
+      /** Create a plot with one value per plane */
+      ref<data::Plot> new_plot(const std::vector<double> &values) const;
+
+      bool      _processed_rays;
+      double    _first;
+      double    _last;
+      unsigned int _count;
+
+      // rays lines in image coordinates, position at z = 0 and slopes
+      std::vector<math::Vector2> _origins;
+      std::vector<math::Vector2> _slopes;
+      std::vector<double> _intensity;
+
+      // rays moments
+      math::Vector2 _mean_origin;
+      math::Vector2 _mean_slope;
+      double    _var_origin;    // variance of origins
+      double    _covar;         // covariance of origins and slopes
+      double    _var_slope;     // variance of slopes
+    };
+
+  }
+}
+
+#endif
+
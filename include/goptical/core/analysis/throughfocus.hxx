@@ -0,0 +1,67 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_ANALYSIS_THROUGHFOCUS_HXX_
+#define GOPTICAL_ANALYSIS_THROUGHFOCUS_HXX_
+
+#include "goptical/core/math/vector.hxx"
+#include "goptical/core/data/plot.hxx"
+
+#include "goptical/core/analysis/pointimage.hxx"
+
+namespace _goptical
+{
+
+  namespace analysis
+  {
+
+    void ThroughFocus::invalidate()
+    {
+      _processed_trace = false;
+      _processed_rays = false;
+    }
+
+    unsigned int ThroughFocus::get_plane_count() const
+    {
+      return _count;
+    }
+
+    double ThroughFocus::get_defocus(unsigned int plane) const
+    {
+      return _count > 1
+        ? _first + (_last - _first) * plane / (_count - 1)
+        : _first;
+    }
+
+    math::Vector2 ThroughFocus::get_position(unsigned int ray, double defocus) const
+    {
+      return _origins[ray] + _slopes[ray] * defocus;
+    }
+
+  }
+}
+
+#endif
+
@@ -191,7 +191,13 @@ namespace goptical {
         /** Hexapolar pattern, suitable for circular shapes */
         HexaPolarDist,
         /** Random distribution */
-        RandomDist
+        RandomDist,
+        /** Scrambled Sobol low discrepancy sequence, reproducible for a given seed */
+        SobolDist,
+        /** Randomly shifted Halton low discrepancy sequence in bases 2 and 3 */
+        HaltonDist,
+        /** Stratified distribution with one random point in each grid cell */
+        JitteredDist
       };
 
     /** Specifies light intensity calculation mode to use by light propagation algorithms. */
@@ -492,15 +498,26 @@ namespace _goptical {
   namespace trace {
     using namespace goptical::trace;
 
+    class CompiledSystem;
+    class Detector;
     class Distribution;
+    class IndexTable;
+    class Irradiance;
     class tracer;
     class Params;
     class Ray;
+    class RayBatch;
     class Result;
     class Element;
     class Sequence;
+    class Sink;
 
-    typedef std::deque<Ray *> rays_queue_t;
+    /** Rays list type used by ray tracer and trace results. This
+        was a @tt std::deque in previous releases, it is now a @tt
+        std::vector so that lists storage can be kept between traces
+        (see @ref Result::set_retain_capacity). Code relying on @tt
+        push_front or @tt pop_front must be updated. */
+    typedef std::vector<Ray *> rays_queue_t;
 
   }
 
@@ -613,6 +630,7 @@ namespace _goptical {
     class Conic;
     class Foucault;
     class Array;
+    class Tabulated;
   }
 
   /** @module {Core}
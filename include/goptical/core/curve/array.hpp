@@ -61,6 +61,12 @@ namespace _goptical {
       double sagitta(const math::Vector2 & xy) const;
       /** @override */
       void derivative(const math::Vector2 & xy, math::Vector2 & dxdy) const;
+      /** @override */
+      double sagitta_gradient(const math::Vector2 & xy, math::Vector2 & dxdy) const;
+      /** @override */
+      bool is_tabulation_useful() const;
+      /** @override Version changes with the base curve too */
+      unsigned int get_version() const;
 
     private:
 
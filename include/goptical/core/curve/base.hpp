@@ -61,12 +61,75 @@ namespace _goptical {
       /** Get curve x and y derivative (gradient) at specified point */
       virtual void derivative(const math::Vector2 & xy, math::Vector2 & dxdy) const;
 
+      /** Get curve sagitta and x and y derivative (gradient) at
+          specified point. Default implementation calls @ref sagitta
+          and @ref derivative, curves should reimplement it when both
+          can be computed together. */
+      virtual double sagitta_gradient(const math::Vector2 & xy, math::Vector2 & dxdy) const;
+
       /** Get intersection point between curve and 3d ray. Return
-          false if no intersection occurred */
+          false if no intersection occurred. Default implementation
+          uses a safeguarded Newton method, see @ref intersect_newton. */
       virtual bool intersect(math::Vector3 &point, const math::VectorPair3 &ray) const;
 
       /** Get normal to curve surface at specified point */
       virtual void normal(math::Vector3 &normal, const math::Vector3 &point) const;
+
+      /** Get intersection points between curve and all active rays
+          of a batch. Rays which do not intersect the curve are
+          disabled. Default implementation uses @ref intersect_newton
+          for each ray and adds solver iterations to the batch
+          iterations count. Curves which reimplement @ref intersect
+          must reimplement this function too, see @ref
+          intersect_batch_each. */
+      virtual void intersect_batch(trace::RayBatch &batch) const;
+
+      /** Get normals to curve surface at intersection points of all
+          active rays of a batch. Default implementation calls @ref
+          normal for each ray. */
+      virtual void normal_batch(trace::RayBatch &batch) const;
+
+      /** Return true if the curve is expensive to evaluate and may
+          be replaced by a tabulated @ref Grid curve during ray
+          tracing, see @ref trace::Params::set_sag_table_tolerance.
+          Default implementation returns true. Curves with cheap
+          evaluation or with discontinuities must return false. */
+      virtual bool is_tabulation_useful() const;
+
+      /** Get exact range of sagitta values over the disk of given
+          radius centered on curve origin. Return false if the curve
+          is not able to provide exact bounds. Default implementation
+          returns false. */
+      virtual bool get_sagitta_range(double radius, math::range_t &range) const;
+
+      /** Get curve version. The version changes each time the curve
+          is modified, data computed from the curve must be updated
+          when it changes. */
+      virtual unsigned int get_version() const;
+
+      /** Change curve version. This is done by all curve modifiers
+          and must be called when curve data has been changed
+          through a reference, see @ref Grid::get_data. */
+      inline void update_version();
+
+    protected:
+      inline Base();
+
+      /** Find intersection point between curve and 3d ray with
+          Newton iterations on the ray parameter, starting from the
+          z=0 plane intersection. Each iteration uses a single @ref
+          sagitta_gradient call. Steps which increase the sagitta
+          error are halved. Number of iterations is added to @tt
+          iterations. */
+      bool intersect_newton(math::Vector3 &point, const math::VectorPair3 &ray,
+                            unsigned int &iterations) const;
+
+      /** Get intersection points between curve and all active rays
+          of a batch by calling @ref intersect for each ray */
+      void intersect_batch_each(trace::RayBatch &batch) const;
+
+    private:
+      unsigned int _version;
     };
 
   }
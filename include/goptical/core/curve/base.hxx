@@ -30,10 +30,20 @@ namespace _goptical {
 
   namespace curve {
 
+    Base::Base()
+      : _version(0)
+    {
+    }
+
     Base::~Base()
     {
     }
 
+    void Base::update_version()
+    {
+      _version++;
+    }
+
   }
 }
 
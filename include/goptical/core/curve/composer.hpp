@@ -81,6 +81,7 @@ namespace _goptical {
 
         double _z_scale;
         double _z_offset;
+        unsigned int _version;
       };
 
       Composer();
@@ -92,6 +93,11 @@ namespace _goptical {
 
       double sagitta(const math::Vector2 & xy) const;
       void derivative(const math::Vector2 & xy, math::Vector2 & dxdy) const;
+      double sagitta_gradient(const math::Vector2 & xy, math::Vector2 & dxdy) const;
+
+      /** @override Version changes with base curves and their
+          attributes too */
+      unsigned int get_version() const;
 
     private:
       std::list <Attributes> _list;
@@ -51,6 +51,9 @@ namespace _goptical {
 
        @ref Sphere and @ref Parabola offer optimized implementations
        for common special cases.
+
+       Batch intersection and normal functions use vector
+       instructions when supported by the processor.
      */
     class Conic : public ConicBase
     {
@@ -75,6 +78,8 @@ namespace _goptical {
 
       bool intersect(math::Vector3 &point, const math::VectorPair3 &ray) const;
       double sagitta(double r) const;
+      void intersect_batch(trace::RayBatch &batch) const;
+      void normal_batch(trace::RayBatch &batch) const;
       double derivative(double r) const;
 
     };
@@ -35,11 +35,13 @@ namespace _goptical {
     void Conic::set_eccentricity(double e)
     {
       _sh = - math::square(e) + 1.0;
+      update_version();
     }
 
     void Conic::set_schwarzschild(double sc)
     {
       _sh = sc + 1.0;
+      update_version();
     }
 
   }
@@ -72,6 +72,11 @@ namespace _goptical {
       virtual double sagitta(double r) const = 0;
       virtual double derivative(double r) const = 0;
 
+      bool is_tabulation_useful() const;
+      bool get_sagitta_range(double radius, math::range_t &range) const;
+
+      inline void update_version();
+
     protected:
       inline ConicBase(double roc, double sc);
 
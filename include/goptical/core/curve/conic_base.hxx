@@ -38,6 +38,11 @@ namespace _goptical {
     {
     }
 
+    void ConicBase::update_version()
+    {
+      Rotational::update_version();
+    }
+
     double ConicBase::get_eccentricity() const
     {
       return sqrt(- _sh + 1.0);
@@ -49,6 +49,9 @@ namespace _goptical {
     protected:
       inline curveRoc(double roc);
 
+      /** Change curve version, see @ref Base::update_version */
+      virtual void update_version() = 0;
+
       double _roc;
     };
 
@@ -38,6 +38,7 @@ namespace _goptical {
     void curveRoc::set_roc(double roc)
     {
       _roc = roc;
+      update_version();
     }
 
     double curveRoc::get_roc() const
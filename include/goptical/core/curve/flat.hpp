@@ -51,7 +51,10 @@ namespace _goptical {
       Flat();
 
       bool intersect(math::Vector3 &point, const math::VectorPair3 &ray) const;
+      void intersect_batch(trace::RayBatch &batch) const;
       void normal(math::Vector3 &normal, const math::Vector3 &point) const;
+      bool is_tabulation_useful() const;
+      bool get_sagitta_range(double radius, math::range_t &range) const;
 
       double sagitta(double r) const;
       double derivative(double r) const;
@@ -139,6 +139,8 @@ namespace _goptical {
       /** Set surface integration (ODE) algorithm step size, default is 1mm */
       inline void set_ode_stepsize(double step);
 
+      inline void update_version();
+
       double sagitta(double r) const;
       double derivative(double r) const;
 
@@ -34,6 +34,11 @@ namespace _goptical {
 
   namespace curve {
 
+    void Foucault::update_version()
+    {
+      Rotational::update_version();
+    }
+
     void Foucault::set_moving_source(double offset)
     {
       _updated = false;
@@ -54,6 +59,7 @@ namespace _goptical {
     {
       _updated = false;
       _radius = radius;
+      update_version();
     }
 
     double Foucault::get_radius() const
@@ -65,6 +71,7 @@ namespace _goptical {
     {
       _updated = false;
       _ode_step = step;
+      update_version();
     }
 
     unsigned int Foucault::get_zones_count() const
@@ -75,6 +82,7 @@ namespace _goptical {
     void Foucault::set_knife_offset(unsigned int zone_number, double  knife_offset)
     {
       _reading.get_y_value(zone_number) = knife_offset;
+      update_version();
     }
 
     const std::pair<double, double> Foucault::get_reading(unsigned int index) const
@@ -62,7 +62,8 @@ namespace _goptical {
       /** Get embedded sagitta/gradient data container */
       inline const data::Grid &get_data() const;
 
-      /** Get embedded sagitta/gradient data container */
+      /** Get embedded sagitta/gradient data container. @ref
+          update_version must be called when data is modified. */
       inline data::Grid &get_data();
 
       /** Set grid values to best fit an other curve. Gradient data
@@ -72,6 +73,8 @@ namespace _goptical {
 
       double sagitta(const math::Vector2 & xy) const;
       void derivative(const math::Vector2 & xy, math::Vector2 & dxdy) const;
+      double sagitta_gradient(const math::Vector2 & xy, math::Vector2 & dxdy) const;
+      bool is_tabulation_useful() const;
 
     protected:
       data::Grid _data;
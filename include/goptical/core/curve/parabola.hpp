@@ -49,6 +49,7 @@ namespace _goptical {
       Parabola(double roc);
 
       bool intersect(math::Vector3 &point, const math::VectorPair3 &ray) const;
+      void intersect_batch(trace::RayBatch &batch) const;
 
       double sagitta(double r) const;
       double derivative(double r) const;
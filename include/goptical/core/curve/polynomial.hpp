@@ -89,6 +89,8 @@ namespace _goptical {
 
       double sagitta(double r) const;
       double derivative(double r) const;
+      double sagitta_gradient(double r, double &dzdr) const;
+      bool is_tabulation_useful() const;
 
     private:
       unsigned int _first_term, _last_term;
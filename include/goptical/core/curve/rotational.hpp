@@ -62,8 +62,17 @@ namespace _goptical {
       */
       virtual double derivative(double r) const;
 
+      /** Get curve sagitta and derivative at specified distance from
+          origin. Default implementation calls @ref sagitta and @ref
+          derivative.
+          @param r distance from curve origin (0, 0)
+          @param dzdr derivative at r
+      */
+      virtual double sagitta_gradient(double r, double &dzdr) const;
+
       inline double sagitta(const math::Vector2 & xy) const;
       void derivative(const math::Vector2 & xy, math::Vector2 & dxdy) const;
+      double sagitta_gradient(const math::Vector2 & xy, math::Vector2 & dxdy) const;
 
       // FIXME sample points
       /** Get number of available sample points. Samples points may be
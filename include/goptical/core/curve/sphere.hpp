@@ -41,6 +41,9 @@ namespace _goptical {
        @main
 
        This class provides an efficient spherical curve implementation.
+
+       Batch intersection and normal functions use vector
+       instructions when supported by the processor.
      */
     class Sphere : public ConicBase
     {
@@ -50,6 +53,8 @@ namespace _goptical {
 
       bool intersect(math::Vector3 &point, const math::VectorPair3 &ray) const;
       void normal(math::Vector3 &normal, const math::Vector3 &point) const;
+      void intersect_batch(trace::RayBatch &batch) const;
+      void normal_batch(trace::RayBatch &batch) const;
 
       double sagitta(double r) const;
       double derivative(double r) const;
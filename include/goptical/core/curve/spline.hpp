@@ -59,7 +59,8 @@ namespace _goptical {
       /** Get sagitta/derivative data container */
       inline const data::DiscreteSet & get_data() const;
 
-      /** get sagitta/derivative data container */
+      /** get sagitta/derivative data container. @ref update_version
+          must be called when data is modified. */
       inline data::DiscreteSet & get_data();
 
       /** Clear all points and fit to an other rotationally symmetric curve.
@@ -71,6 +72,8 @@ namespace _goptical {
 
       inline double sagitta(double r) const;
       inline double derivative(double r) const;
+      inline double sagitta_gradient(double r, double &dzdr) const;
+      bool is_tabulation_useful() const;
 
     protected:
       data::DiscreteSet _data;
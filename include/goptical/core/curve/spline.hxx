@@ -53,6 +53,13 @@ namespace _goptical {
       return _data.interpolate(r, 1);
     }
 
+    double Spline::sagitta_gradient(double r, double &dzdr) const
+    {
+      dzdr = _data.interpolate(r, 1);
+
+      return _data.interpolate(r);
+    }
+
   }
 }
 
@@ -0,0 +1,110 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_CURVE_TABULATED_HH_
+#define GOPTICAL_CURVE_TABULATED_HH_
+
+#include <vector>
+
+#include "goptical/core/common.hpp"
+
+#include "base.hpp"
+#include "grid.hpp"
+
+namespace _goptical {
+
+  namespace curve {
+
+    /**
+       @short Tabulated approximation of an other curve
+       @header <goptical/core/curve/Tabulated
+       @module {Core}
+       @main
+
+       This class samples sagitta and gradient of an other curve in
+       a @ref Grid curve with data::BicubicDeriv interpolation. It
+       is used by @ref sys::Surface to replace expensive curves
+       during ray tracing, see @ref trace::Params::set_sag_table_tolerance.
+
+       Grid resolution is doubled until the interpolation error,
+       measured at cells centers and edges middle points, is below
+       the requested tolerance. Cells which do not meet the
+       tolerance, where the curve is not smooth enough, and points
+       outside the sampled circle use the original curve.
+    */
+    class Tabulated : public Base
+    {
+    public:
+      /** Sample curve over the circle of given radius. Rows of the
+          grid are split between threads when @tt threads is greater
+          than 1, the curve must then support concurrent
+          evaluation. Grid size is limited to @tt max_n sample
+          points per side. An exception is thrown if the tolerance
+          is not met on most of the circle area. */
+      Tabulated(const const_ref<Base> &curve, double radius, double tolerance,
+                unsigned int threads = 1, unsigned int max_n = 513);
+
+      ~Tabulated();
+
+      /** Get original curve */
+      inline const Base & get_curve() const;
+
+      /** Get grid curve used for interpolation */
+      inline const Grid & get_grid() const;
+
+      /** Get sagitta tolerance */
+      inline double get_tolerance() const;
+
+      /** Get number of grid cells which use the original curve */
+      inline unsigned int get_exact_cell_count() const;
+
+      double sagitta(const math::Vector2 & xy) const;
+      void derivative(const math::Vector2 & xy, math::Vector2 & dxdy) const;
+      double sagitta_gradient(const math::Vector2 & xy, math::Vector2 & dxdy) const;
+      bool is_tabulation_useful() const;
+
+    private:
+      /** Sample curve and measure interpolation error of each cell */
+      void sample(std::vector<double> &err, unsigned int threads);
+
+      /** Test if the original curve must be used at given point */
+      inline bool use_curve(const math::Vector2 & xy) const;
+
+      const_ref<Base>           _curve;
+      ref<Grid>                 _grid;
+      double                    _radius;
+      double                    _tolerance;
+      unsigned int              _n;             // grid cells per side
+      double                    _step;          // grid cell size
+      std::vector<bool>         _exact;         // cells using original curve
+      unsigned int              _exact_count;
+    };
+
+  }
+
+}
+
+#endif
+
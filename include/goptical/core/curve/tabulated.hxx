@@ -0,0 +1,73 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_CURVE_TABULATED_HXX_
+#define GOPTICAL_CURVE_TABULATED_HXX_
+
+#include <cmath>
+
+#include "base.hxx"
+#include "grid.hxx"
+
+namespace _goptical {
+
+  namespace curve {
+
+    const Base & Tabulated::get_curve() const
+    {
+      return *_curve;
+    }
+
+    const Grid & Tabulated::get_grid() const
+    {
+      return *_grid;
+    }
+
+    double Tabulated::get_tolerance() const
+    {
+      return _tolerance;
+    }
+
+    unsigned int Tabulated::get_exact_cell_count() const
+    {
+      return _exact_count;
+    }
+
+    bool Tabulated::use_curve(const math::Vector2 & xy) const
+    {
+      double x = floor((xy.x() + _radius) / _step);
+      double y = floor((xy.y() + _radius) / _step);
+
+      if (!(x >= 0 && x < _n && y >= 0 && y < _n))
+        return true;
+
+      return _exact[(unsigned int)x + (unsigned int)y * _n];
+    }
+
+  }
+}
+
+#endif
+
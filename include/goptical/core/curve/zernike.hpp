@@ -26,6 +26,8 @@
 #ifndef GOPTICAL_CURVE_ZERNIKE_HH_
 #define GOPTICAL_CURVE_ZERNIKE_HH_
 
+#include <vector>
+
 #include "goptical/core/common.hpp"
 
 #include "goptical/core/trace/distribution.hpp"
@@ -46,10 +48,18 @@ namespace _goptical {
        individually.
 
        Fitting can be used to get best fit Zernike polynomials
-       coefficients of an other curve.
+       coefficients of an other curve, of measured sample points or
+       of a sagitta data grid.
+
+       Terms up to any radial order are available with Fringe, Noll
+       and ANSI (OSA) indexing, see @ref Ordering. Default term set
+       contains the 36 Fringe terms described in ISO standard
+       10110-5.
 
-       This implementation uses Zernike polynomials set as described
-       in ISO standard 10110-5.
+       Radial polynomials are computed with the Kintner recurrence
+       on the squared radius and azimuthal terms with powers of
+       @tt {x + iy}. All enabled terms are evaluated together, for
+       blocks of points when tracing rays batches.
 
        Based on Zernikes pages by James C Wyant and Michael Koch.
        @url http://www.optics.arizona.edu/jcwyant/Zernikes/ZernikePolynomials.htm
@@ -60,17 +70,36 @@ namespace _goptical {
       static const trace::Distribution default_dist;
 
     public:
-      /** Number of implemented zernike polynomials */
+      /** Zernike terms indexing and normalization conventions */
+      enum Ordering
+        {
+          /** Fringe (University of Arizona) ordering with terms
+              sorted by @tt {(n + |m|) / 2} groups, then by
+              decreasing @tt {|m|}. Terms are not normalized, first
+              term index is 0. Groups are extended with the same
+              rule above the 37 standard terms. */
+          Fringe,
+          /** Noll ordering with normalized terms, cosine terms
+              have even index. First term index is 1. */
+          Noll,
+          /** ANSI Z80.28 and OSA ordering with normalized terms,
+              index is @tt {(n * (n + 2) + m) / 2}. First term index
+              is 0. */
+          Ansi,
+        };
+
+      /** Number of terms in default Fringe terms set */
       static const unsigned int term_count = 36;
 
-      /** Create a Zernike curve defined over the given circle radius. 
+      /** Create a Zernike curve defined over the given circle
+          radius with the 36 Fringe terms up to radial order 10.
           @param radius Zernike circle radius
           @param unit_scale Sagitta scale factor used to change units globally
       */
       Zernike(double radius, double unit_scale = 1.0);
 
       /** Create a Zernike curve defined over the given circle radius
-          and initialize coefficients from table.
+          with the 36 Fringe terms and initialize coefficients from table.
           @param radius Zernike circle radius
           @param coefs Table of Zernike coefficients starting with z0 (piston)
           @param coefs_count Number of coefficients available in the table
@@ -78,11 +107,39 @@ namespace _goptical {
       */
       Zernike(double radius, double coefs[], unsigned int coefs_count, double unit_scale = 1.0);
 
+      /** Create a Zernike curve defined over the given circle radius
+          with all terms up to the given radial order. With Fringe
+          ordering, all groups which only contain terms up to this
+          order are used.
+          @param radius Zernike circle radius
+          @param ordering Terms indexing convention
+          @param max_order Maximum radial order
+          @param unit_scale Sagitta scale factor used to change units globally
+      */
+      Zernike(double radius, Ordering ordering, unsigned int max_order,
+              double unit_scale = 1.0);
+
       /** Set Zernike circle radius */
       inline void set_radius(double radius);
       /** Get Zernike circle radius */
       inline double get_radius() const;
 
+      /** Get terms indexing convention */
+      inline Ordering get_ordering() const;
+      /** Get number of terms */
+      inline unsigned int get_term_count() const;
+      /** Get index of first term, 1 with Noll ordering, 0 otherwise */
+      inline unsigned int get_first_term() const;
+      /** Get maximum radial order of terms */
+      inline unsigned int get_max_order() const;
+
+      /** Get radial order and azimuthal frequency of term n.
+          Azimuthal frequency is negative for sine terms. */
+      void get_term_order(unsigned int n, unsigned int &radial, int &azimuthal) const;
+      /** Get index of term with given radial order and azimuthal
+          frequency. Azimuthal frequency is negative for sine terms. */
+      unsigned int get_term_index(unsigned int radial, int azimuthal) const;
+
       /** Set coefficient associated with zernike term n and enable
           term according to current threshold. See
           set_coefficients_threshold() */
@@ -112,26 +169,109 @@ namespace _goptical {
           curve. RMS difference is returned. The specified
           distribution is used to choose sampling points on
           curve. Terms state is adjusted according to current
-          threshold */
-      double fit(const Base &c, const trace::Distribution & d = default_dist);
+          threshold. The curve is sampled on @tt threads threads,
+          it must then support concurrent evaluation. */
+      double fit(const Base &c, const trace::Distribution & d = default_dist,
+                 unsigned int threads = 1);
+
+      /** Compute all zernike coefficients to best fit sagitta values
+          measured at arbitrary points. Points outside the zernike
+          circle and points with non finite sagitta are
+          ignored. RMS residual is returned and terms state is
+          adjusted according to current threshold.
+
+          Least squares normal equations are assembled by blocks of
+          sample points on @tt threads threads and solved by
+          Cholesky factorization. Terms values at sample points and
+          the factorized matrix are kept, next fits on the same
+          sample points only project the new sagitta values. */
+      double fit(unsigned int count, const double x[], const double y[],
+                 const double z[], unsigned int threads = 1);
+
+      /** Compute all zernike coefficients to best fit sagitta values
+          stored in a 2d data grid. @see fit */
+      double fit(const data::Grid &g, unsigned int threads = 1);
+
+      /** Release terms values and factorized matrix kept by last fit */
+      void clear_fit_cache();
 
       double sagitta(const math::Vector2 & xy) const;
       void derivative(const math::Vector2 & xy, math::Vector2 & dxdy) const;
+      double sagitta_gradient(const math::Vector2 & xy, math::Vector2 & dxdy) const;
+
+      /** Get sagitta and gradient at multiple points. Enabled terms
+          are evaluated together for blocks of points. */
+      void sagitta_gradient_batch(unsigned int count, const double x[], const double y[],
+                                  double z[], double dzdx[], double dzdy[]) const;
 
-      /** Evaluate zernike polynomial n */
+      /** Newton iterations are performed for all rays of the batch
+          in lockstep, see @ref sagitta_gradient_batch */
+      void intersect_batch(trace::RayBatch &batch) const;
+      /** @override */
+      void normal_batch(trace::RayBatch &batch) const;
+
+      /** Evaluate all terms at a point of the unit circle. Values
+          are stored in term index order, starting with the first
+          term. */
+      void zernike_polys(const math::Vector2 & xy, double values[]) const;
+
+      /** Evaluate Fringe zernike polynomial n */
       static double zernike_poly(unsigned int n, const math::Vector2 & xy);
-      /** Evaluate x and y derivatives of zernike polynomial n */
+      /** Evaluate x and y derivatives of Fringe zernike polynomial n */
       static void zernike_poly_d(unsigned int n, const math::Vector2 & xy, math::Vector2 & dxdy);
+
     private:
+      /** Radial order and signed azimuthal frequency of a term */
+      struct term_s
+      {
+        unsigned int _n;
+        int _m;
+      };
 
+      void init_terms(unsigned int max_order);
       void update_threshold_state();
+      /** Update per azimuthal frequency coefficients tables from
+          enabled terms */
+      void update_tables();
 
+      /** Evaluate sagitta and gradient for at most @ref block_size
+          points of the unit circle */
+      void eval_block(unsigned int count, const double x[], const double y[],
+                      double z[], double dzdx[], double dzdy[]) const;
+
+      /** Compute terms values at sample points and factorize
+          least squares normal matrix */
+      void fit_prepare(unsigned int threads);
+
+      static const unsigned int block_size = 64;
+
+      /** Least squares fit data kept for next fit on same points */
+      struct fit_cache_s
+      {
+        std::vector<double> _x, _y;       // unit circle sample points
+        std::vector<unsigned int> _index; // sample points used
+        std::vector<double> _basis;       // terms values, a row per point used
+        std::vector<double> _chol;        // normal matrix Cholesky factor
+      };
+
+      Ordering _ordering;
+      unsigned int _max_order;
       double _scale;
       double _threshold;
       double _radius;
-      double _coeff[term_count];
-      unsigned int _enabled_count;
-      unsigned char _enabled_list[term_count];
+      std::vector<struct term_s> _terms;
+      std::vector<double> _coeff;
+      std::vector<bool> _enabled;
+
+      // radial polynomials of azimuthal frequency m are stored
+      // from _offset[m], indexed by k = (n - m) / 2
+      std::vector<unsigned int> _offset;
+      std::vector<int> _kmax;           // last radial term used, -1 if none
+      std::vector<double> _rec[3];      // radial recurrence coefficients
+      std::vector<double> _ccos;        // cosine terms coefficients
+      std::vector<double> _csin;        // sine terms coefficients
+      std::vector<int> _icos, _isin;    // term index or -1
+      struct fit_cache_s _fit;
     };
 
   }
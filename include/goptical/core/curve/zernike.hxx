@@ -37,6 +37,7 @@ namespace _goptical {
     void Zernike::set_radius(double radius)
     {
       _radius = radius;
+      update_version();
     }
 
     double Zernike::get_radius() const
@@ -44,16 +45,39 @@ namespace _goptical {
       return _radius;
     }
 
+    Zernike::Ordering Zernike::get_ordering() const
+    {
+      return _ordering;
+    }
+
+    unsigned int Zernike::get_term_count() const
+    {
+      return _terms.size();
+    }
+
+    unsigned int Zernike::get_first_term() const
+    {
+      return _ordering == Noll ? 1 : 0;
+    }
+
+    unsigned int Zernike::get_max_order() const
+    {
+      return _max_order;
+    }
+
     void Zernike::set_coefficient(unsigned int n, double c)
     {
-      assert(n < term_count);
+      n -= get_first_term();
+      assert(n < _coeff.size());
       _coeff[n] = c;
-      set_term_state(n, fabs(c) >= _threshold);
+      _enabled[n] = fabs(c) >= _threshold;
+      update_tables();
     }
 
     double Zernike::get_coefficient(unsigned int n) const
     {
-      assert(n < term_count);
+      n -= get_first_term();
+      assert(n < _coeff.size());
       return _coeff[n];
     }
 
@@ -66,6 +90,7 @@ namespace _goptical {
     void Zernike::set_coefficients_scale(double s)
     {
       _scale = s;
+      update_version();
     }
 
   }
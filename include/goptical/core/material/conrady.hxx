@@ -36,6 +36,7 @@ namespace _goptical {
       _a = A;
       _b = B;
       _c = C;
+      index_cache_flush();
     }
 
   }
@@ -129,8 +129,16 @@ namespace _goptical {
       /** @override */
       double get_refractive_index(double wavelen) const;
 
+    protected:
+
+      /** Discard cached refractive index values, must be called
+          when refractive index model coefficients are changed. */
+      inline void index_cache_flush();
+
     private:
 
+      static unsigned long index_cache_new_serial();
+
       /** Get temperature coeffiecient of refractive index using
           absloute reference refractive index */
       double get_schott_temp(double wavelen, double ref_index) const;
@@ -158,8 +166,8 @@ namespace _goptical {
       /** medium used during refractive index measurement */
       const_ref<Base> _measurement_medium;
 
-      mutable double _last_wavelen;
-      mutable double _last_get_refractive_index;
+      /** refractive index cache key, changed on model update */
+      unsigned long _index_cache_serial;
     };
 
   }
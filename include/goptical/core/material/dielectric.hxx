@@ -45,6 +45,11 @@ namespace _goptical {
       return _transmittance;
     }
 
+    void Dielectric::index_cache_flush()
+    {
+      _index_cache_serial = index_cache_new_serial();
+    }
+
     void Dielectric::set_temperature_schott(double d0, double d1, double d2,
                                                 double e0, double e1, double wl_tk)
     {
@@ -55,23 +60,27 @@ namespace _goptical {
       _temp_e0 = e0;
       _temp_e1 = e1;
       _temp_wl_tk = wl_tk;
+      index_cache_flush();
     }
 
     void Dielectric::set_temperature_dndt(double dndt)
     {
       _temp_model = ThermalDnDt;
       _temp_d0 = dndt;
+      index_cache_flush();
     }
 
     void Dielectric::disable_temperature_coeff()
     {
       _temp_model = ThermalNone;
+      index_cache_flush();
     }
 
     void Dielectric::set_measurement_medium(const const_ref<Base> &medium)
     {
       assert(medium.ptr() != this);
       _measurement_medium = medium;
+      index_cache_flush();
     }
 
     void Dielectric::set_wavelen_range(double low, double high)
@@ -37,17 +37,20 @@ namespace _goptical {
 
     data::DiscreteSet & DispersionTable::get_refractive_index_dataset()
     {
+      index_cache_flush();
       return _refractive_index;
     }
 
     void DispersionTable::set_refractive_index(double wavelen, double index)
     {
       _refractive_index.add_data(wavelen, index);
+      index_cache_flush();
     }
 
     void DispersionTable::clear_refractive_index_table()
     {
       _refractive_index.clear();
+      index_cache_flush();
     }
 
   }
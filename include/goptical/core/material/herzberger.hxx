@@ -40,6 +40,7 @@ namespace _goptical {
       _d = D;
       _e = E;
       _f = F;
+      index_cache_flush();
     }
 
   }
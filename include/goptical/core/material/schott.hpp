@@ -75,9 +75,6 @@ namespace _goptical {
 
       std::vector<double> _coeff;
       int _first;
-      mutable double _last_wavelen;
-      mutable double _last_wavelen_val;
-      
     };
 
   }
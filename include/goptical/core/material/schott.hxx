@@ -40,6 +40,7 @@ namespace _goptical {
       assert(term >= 0 && term < (int)_coeff.size());
 
       _coeff[term] = K;
+      index_cache_flush();
     }
 
   }
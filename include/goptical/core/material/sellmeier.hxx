@@ -36,6 +36,7 @@ namespace _goptical {
     void Sellmeier::set_contant_term(double A)
     {
       _constant = A;
+      index_cache_flush();
     }
 
     void Sellmeier::set_term(unsigned int term, double K, double L)
@@ -46,6 +47,7 @@ namespace _goptical {
 
       _coeff[term] = K;
       _coeff[term + 1] = L;
+      index_cache_flush();
     }
 
   }
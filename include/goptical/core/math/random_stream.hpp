@@ -0,0 +1,85 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_MATH_RANDOMSTREAM_HH_
+#define GOPTICAL_MATH_RANDOMSTREAM_HH_
+
+#include <stdint.h>
+
+#include "goptical/core/common.hpp"
+
+namespace _goptical {
+
+  namespace math {
+
+    /**
+       @short Counter based random numbers stream
+       @header <goptical/core/math/RandomStream
+       @module {Core}
+
+       This class provides reproducible pseudo random numbers
+       without global state. Each value is computed by hashing its
+       position in the stream along with a key derived from the seed
+       and stream number, so any value can be obtained directly
+       from its position.
+
+       Streams created with the same seed and different stream
+       numbers are independent. Worker threads use their own stream
+       and produce the same values regardless of scheduling.
+     */
+    class RandomStream
+    {
+    public:
+      /** Create stream of random numbers for given seed and stream number */
+      inline RandomStream(uint64_t seed = 0, uint64_t stream = 0);
+
+      /** Get 64 bits random value at given position in stream */
+      inline uint64_t get_bits(uint64_t position) const;
+
+      /** Get uniform random value in [0, 1) range at given position in stream */
+      inline double get_uniform(uint64_t position) const;
+
+      /** Get next uniform random value in [0, 1) range and advance position */
+      inline double uniform();
+
+      /** Set position of next value returned by @ref uniform */
+      inline void set_position(uint64_t position);
+
+      /** Get position of next value returned by @ref uniform */
+      inline uint64_t get_position() const;
+
+      /** Get 64 bits hash of a value, used to derive keys and values */
+      static inline uint64_t mix(uint64_t x);
+
+    private:
+      uint64_t  _key;
+      uint64_t  _position;
+    };
+
+  }
+}
+
+#endif
+
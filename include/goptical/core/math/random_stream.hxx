@@ -0,0 +1,78 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_MATH_RANDOMSTREAM_HXX_
+#define GOPTICAL_MATH_RANDOMSTREAM_HXX_
+
+namespace _goptical {
+
+  namespace math {
+
+    RandomStream::RandomStream(uint64_t seed, uint64_t stream)
+      : _key(mix(mix(seed) + stream * 0xd1b54a32d192ed03ULL)),
+        _position(0)
+    {
+    }
+
+    uint64_t RandomStream::mix(uint64_t x)
+    {
+      // splitmix64 finalizer
+      x += 0x9e3779b97f4a7c15ULL;
+      x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+      return x ^ (x >> 31);
+    }
+
+    uint64_t RandomStream::get_bits(uint64_t position) const
+    {
+      return mix(_key ^ mix(position));
+    }
+
+    double RandomStream::get_uniform(uint64_t position) const
+    {
+      // 53 bits mantissa
+      return (get_bits(position) >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    double RandomStream::uniform()
+    {
+      return get_uniform(_position++);
+    }
+
+    void RandomStream::set_position(uint64_t position)
+    {
+      _position = position;
+    }
+
+    uint64_t RandomStream::get_position() const
+    {
+      return _position;
+    }
+
+  }
+}
+
+#endif
+
@@ -56,6 +56,11 @@ namespace _goptical {
       /** Check if the (x,y) 2d point is inside 2d shape area */
       virtual bool inside(const math::Vector2 &point) const = 0;
 
+      /** Disable all active rays of a batch which have their
+          intersection point (x,y) outside 2d shape area. Default
+          implementation calls @ref inside for each ray. */
+      virtual void inside_batch(trace::RayBatch &batch) const;
+
       /** Get points distributed on shape area with given pattern */
       virtual void get_pattern(const math::Vector2::put_delegate_t &f,
                                const trace::Distribution &d,
@@ -89,6 +94,17 @@ namespace _goptical {
       /** Get shape teselation triangles */
       virtual void get_triangles(const math::Triangle<2>::put_delegate_t &f,
                                  double resolution) const = 0;
+
+      /** Get shape version. The version changes each time the shape
+          is modified, data computed from the shape must be updated
+          when it changes. */
+      virtual unsigned int get_version() const;
+
+      /** Change shape version. This is done by all shape modifiers. */
+      inline void update_version();
+
+    private:
+      unsigned int _version;
     };
 
   }
@@ -31,9 +31,15 @@ namespace _goptical {
   namespace shape {
 
     Base::Base()
+      : _version(0)
     {
     }
 
+    void Base::update_version()
+    {
+      _version++;
+    }
+
   }
 }
 
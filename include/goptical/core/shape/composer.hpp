@@ -126,16 +126,22 @@ namespace _goptical {
 
       private:
         bool inside(const math::Vector2 &point) const;
+        unsigned int get_version() const;
 
         const_ref<Base>         _shape;
         bool                    _exclude;
         std::list <Attributes>  _list;
         math::Transform<2>      _transform;
         math::Transform<2>      _inv_transform;
+        unsigned int            _version;
       };
 
       Composer();
 
+      /** @override Version changes with composed shapes and their
+          attributes too */
+      unsigned int get_version() const;
+
     private:
 
       void update();
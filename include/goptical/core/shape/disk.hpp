@@ -62,6 +62,8 @@ namespace _goptical {
       math::VectorPair2 get_bounding_box() const;
       /** @override */
       bool inside(const math::Vector2 &point) const;
+      /** @override */
+      void inside_batch(trace::RayBatch &batch) const;
 
       inline double get_external_xradius() const;
       inline double get_internal_xradius() const;
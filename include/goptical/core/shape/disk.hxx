@@ -40,6 +40,7 @@ namespace _goptical {
     void DiskBase::set_radius(double r)
     {
       _radius = r;
+      update_version();
     }
 
     double DiskBase::get_radius(void) const
@@ -65,6 +65,8 @@ namespace _goptical {
       math::VectorPair2 get_bounding_box() const;
       /** @override */
       bool inside(const math::Vector2 &point) const;
+      /** @override */
+      void inside_batch(trace::RayBatch &batch) const;
 
     protected:
 
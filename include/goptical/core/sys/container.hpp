@@ -27,6 +27,7 @@
 
 #include <iostream>
 #include <list>
+#include <vector>
 
 #include "goptical/core/common.hpp"
 
@@ -60,6 +61,10 @@ namespace _goptical {
       void add_front(const ref<Element> &e);
       void add(const ref<Element> &e);
 
+      /** Add multiple elements at once, in list order. Storage for
+          system elements data is reserved before insertion. */
+      void add(const std::vector<ref<Element> > &list);
+
       /** Remove an element */
       void remove(Element &e);
 
@@ -111,6 +116,8 @@ namespace _goptical {
       virtual void added(Element &e) = 0;
       /** called when elements are inserted or removed */
       virtual void removed(Element &e) = 0;
+      /** called before multiple elements are inserted */
+      virtual void reserve(unsigned int count);
 
     private:
 
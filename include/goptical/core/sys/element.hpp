@@ -27,6 +27,7 @@
 #define GOPTICAL_ELEMENT_HH_
 
 #include <iostream>
+#include <list>
 
 #include "goptical/core/common.hpp"
 
@@ -118,21 +119,27 @@ namespace _goptical {
       /** Get transform from this element to parent element coordinate system */
       inline const math::Transform<3> & get_transform() const;
 
-      /** Get transform from this element to given element coordinate system */
-      const math::Transform<3> & get_transform_to(const Element &e) const;
+      /** Get transform from this element to given element coordinate
+          system. Transform is composed from global transforms on each
+          call. One of the elements may not be part of a system, see
+          @ref system::get_transform. */
+      math::Transform<3> get_transform_to(const Element &e) const;
 
-      /** Get transform from given element to this element coordinate system */
-      const math::Transform<3> & get_transform_from(const Element &e) const;
+      /** Get transform from given element to this element coordinate
+          system. Transform is composed from global transforms on each
+          call. One of the elements may not be part of a system, see
+          @ref system::get_transform. */
+      math::Transform<3> get_transform_from(const Element &e) const;
 
       /** Get transform from this element to given element coordinate
           system. Transform to global coordinates is returned if
           paramter is 0. */
-      const math::Transform<3> & get_transform_to(const Element *e) const;
+      math::Transform<3> get_transform_to(const Element *e) const;
 
       /** Get transform from given element to this element coordinate
           system. Transform from global coordinates is returned if
           paramter is 0. */
-      const math::Transform<3> & get_transform_from(const Element *e) const;
+      math::Transform<3> get_transform_from(const Element *e) const;
 
       /** Get transform from this element local to global coordinates */
       const math::Transform<3> & get_global_transform() const;
@@ -222,6 +229,8 @@ protected:
 private:
       system *_system;
       Container *_container;
+      // position in container elements list
+      std::list<ref<Element> >::iterator _container_pos;
 
       bool      _enabled;
       // must be incremented each time a change is made to element properties
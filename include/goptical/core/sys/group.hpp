@@ -66,6 +66,7 @@ namespace _goptical {
     private:
       void added(Element &e);
       void removed(Element &e);
+      void reserve(unsigned int count);
 
       void system_register(system &s);
       void system_unregister();
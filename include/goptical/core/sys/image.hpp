@@ -28,6 +28,7 @@
 
 #include "goptical/core/common.hpp"
 
+#include "goptical/core/math/vector_pair.hpp"
 #include "goptical/core/sys/surface.hpp"
 #include "goptical/core/curve/flat.hpp"
 #include "goptical/core/shape/infinite.hpp"
@@ -41,6 +42,11 @@ namespace _goptical {
        @header <goptical/core/sys/Image
        @module {Core}
        @main
+
+       In detector mode, intensity of rays reaching the image is
+       binned in a pixels array while tracing, see @ref
+       set_detector. Memory used does not depend on the number of
+       traced rays.
      */
     class Image : public Surface
     {
@@ -54,6 +60,27 @@ namespace _goptical {
       /** Create a new flat square image plane at given position with given half width */
       Image(const math::VectorPair3 &position, double radius);
 
+      /** Enable detector mode. Rays reaching the image are binned
+          in a pixels array covering the current image shape
+          bounding box, with a separate array for each wavelength
+          when @tt per_wavelen is set. Rays do not need to be saved
+          in the trace result, data is available from @ref
+          trace::Result::get_detector. */
+      void set_detector(unsigned int width, unsigned int height,
+                        bool per_wavelen = false);
+
+      /** Disable detector mode */
+      void clear_detector();
+
+      /** Test if detector mode is enabled */
+      inline bool has_detector() const;
+
+      /** Create an empty detector with current detector settings */
+      ref<trace::Detector> new_detector() const;
+
+      /** Test if a detector has been created with current detector settings */
+      bool match_detector(const trace::Detector &d) const;
+
     private:
       void trace_ray_simple(trace::Result &result, trace::Ray &incident,
                             const math::VectorPair3 &local, const math::VectorPair3 &intersect) const;
@@ -61,6 +88,10 @@ namespace _goptical {
                                const math::VectorPair3 &local, const math::VectorPair3 &intersect) const;
       void trace_ray_polarized(trace::Result &result, trace::Ray &incident,
                                const math::VectorPair3 &local, const math::VectorPair3 &intersect) const;
+
+      unsigned int      _detector_width;
+      unsigned int      _detector_height;
+      bool              _detector_per_wavelen;
     };
 
   }
@@ -32,6 +32,11 @@ namespace _goptical {
   
   namespace sys {
 
+    bool Image::has_detector() const
+    {
+      return _detector_width != 0;
+    }
+
   }
 }
 
@@ -53,6 +53,10 @@ namespace _goptical {
        replaced by system environement @ref material::Proxy
        {proxy} material when the optical surface becomes part of a
        @ref system.
+
+       In sequential simple ray trace mode, all incoming rays are
+       processed as a single @ref trace::RayBatch using the @ref
+       refract_batch function.
     */
 
     class OpticalSurface : public Surface
@@ -96,8 +100,23 @@ namespace _goptical {
       /** Get surface natural color from material properties. */
       io::Rgb get_color(const io::Renderer &r) const;
 
+    protected:
+
+      /** Compute rays refracted and reflected according to fresnel
+          law for all active rays of a batch with intersection points
+          and normals. New rays are appended to the @tt generated
+          batch with parent index set to incident ray index. Refractive
+          indexes are looked up in @tt table when available. */
+      virtual void refract_batch(const trace::IndexTable &table,
+                                 const trace::RayBatch &batch,
+                                 trace::RayBatch &generated) const;
+
     private:
 
+      /** @override */
+      void process_rays_simple(trace::Result &result,
+                               trace::rays_queue_t *input) const;
+
       void trace_ray_simple(trace::Result &result, trace::Ray &incident,
                             const math::VectorPair3 &local, const math::VectorPair3 &intersect) const;
 
@@ -69,6 +69,12 @@ namespace _goptical {
       GOPTICAL_ACCESSORS(bool, intercept_reemit,
                          "intercept and reemit enabled. @see Stop");
 
+      /** @override Stop bounding box extends to external radius */
+      math::VectorPair3 get_bounding_box() const;
+
+      /** @override Stop bounding box extends to external radius */
+      bool get_exact_bounding_box(math::VectorPair3 &box) const;
+
     private:
 
       /** @override */
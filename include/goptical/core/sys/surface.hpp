@@ -27,12 +27,18 @@
 #define GOPTICAL_SURFACE_HH_
 
 #include <iostream>
+#include <list>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
 
 #include "goptical/core/common.hpp"
 
 #include "goptical/core/sys/element.hpp"
 #include "goptical/core/shape/base.hpp"
 #include "goptical/core/curve/base.hpp"
+#include "goptical/core/trace/distribution.hpp"
 
 namespace _goptical {
 
@@ -83,11 +89,41 @@ namespace _goptical {
                              math::VectorPair3 &pt,
                              const math::VectorPair3 &ray) const;
 
+      /** Get intersection points and normals to surface of all
+          active rays in a batch of surface local rays. Rays which
+          do not intersect the surface are disabled. */
+      virtual void intersect_batch(const trace::Params &params,
+                                   trace::RayBatch &batch) const;
+
+      /** Update tabulated curve which replaces the surface curve
+          during ray tracing, see @ref curve::Tabulated. A table
+          covering the shape radius is built if the curve reports
+          tabulation as useful. It is only rebuilt when the surface
+          version or the tolerance changed. No table is used when
+          @tt tolerance is 0 or can not be met. Tables built for
+          different tolerances are kept, this function can be called
+          while other tracers of the system are running. */
+      void update_curve_table(double tolerance, unsigned int threads = 1) const;
+
+      /** Get curve used to find rays intersection with the given
+          tracer parameters. This is the tabulated curve if
+          available and up to date, the surface curve otherwise. */
+      const curve::Base & get_trace_curve(const trace::Params &params) const;
+
       /** Get distribution pattern points projected on the surface */
       void get_pattern(const math::Vector3::put_delegate_t &f,
                        const trace::Distribution &d,
                        bool unobstructed = false) const;
 
+      /** Get distribution pattern points projected on the surface
+          in a buffer shared with the surface. The last few requested
+          patterns are kept until the surface curve or shape changes,
+          so that sources tracing the same system many times do not
+          generate the pattern again. This function may be called
+          from different threads. */
+      std::shared_ptr<const std::vector<math::Vector3> >
+      get_pattern(const trace::Distribution &d, bool unobstructed = false) const;
+
       /** trace a single ray through the surface */
       template <trace::IntensityMode m>
       void trace_ray(trace::Result &result, trace::Ray &incident,
@@ -104,8 +140,22 @@ namespace _goptical {
 
       math::VectorPair3 get_bounding_box() const;
 
+      /** Get a bounding box which encloses all possible ray
+          intersection points in local coordinates. Return false if
+          the curve is not able to provide exact sagitta bounds. Unlike
+          @ref get_bounding_box, which samples the curve for rendering
+          purpose, this box is conservative. */
+      virtual bool get_exact_bounding_box(math::VectorPair3 &box) const;
+
     protected:
 
+      /** Load incident rays in a batch of surface local rays and
+          declare rays which intersect the surface as intercepted.
+          Only intersecting rays are left active. Ray parent indexes
+          are positions in the input queue. */
+      void intersect_rays(trace::Result &result, const trace::rays_queue_t &input,
+                          trace::RayBatch &batch) const;
+
       /** This function must be reimplemented by subclasses to handle
           incoming rays and generate new ones when in simple ray trace mode. */
       virtual void trace_ray_simple(trace::Result &result, trace::Ray &incident,
@@ -149,6 +199,39 @@ namespace _goptical {
       double                    _discard_intensity;
       const_ref<curve::Base>   _curve;
       const_ref<shape::Base>   _shape;
+
+      /** Tabulated curve built for a given tolerance */
+      struct table_s
+      {
+        const_ref<curve::Base>  _curve;         // invalid if not tabulated
+        double                  _tolerance;
+        unsigned int            _version;       // surface version when built
+        unsigned int            _curve_version; // curve version when built
+        unsigned int            _shape_version; // shape version when built
+        const struct table_s    *_next;
+      };
+
+      static void free_tables(const struct table_s *t);
+
+      mutable std::mutex        _table_lock;    // serialize tables build
+      mutable std::atomic<const struct table_s *> _tables; // most recent first
+
+      /** Pattern points buffer */
+      struct pattern_s
+      {
+        trace::Distribution     _dist;
+        bool                    _unobstructed;
+        const_ref<curve::Base>  _curve;         // curve used to build the pattern
+        const_ref<shape::Base>  _shape;         // shape used to build the pattern
+        unsigned int            _curve_version;
+        unsigned int            _shape_version;
+        std::shared_ptr<const std::vector<math::Vector3> > _points;
+      };
+
+      static const unsigned int pattern_cache_size = 4;
+
+      mutable std::mutex        _patterns_lock;
+      mutable std::list<struct pattern_s> _patterns; // most recent first
     };
 
   }
@@ -39,6 +39,7 @@ namespace _goptical {
     void Surface::set_curve(const const_ref<curve::Base> &c)
     {
       _curve = c;
+      update_version();
     }
 
     const curve::Base & Surface::get_curve() const
@@ -49,6 +50,7 @@ namespace _goptical {
     void Surface::set_shape(const const_ref<shape::Base> &s)
     {
       _shape = s;
+      update_version();
     }
 
     const shape::Base & Surface::get_shape() const
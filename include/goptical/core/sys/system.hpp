@@ -25,10 +25,14 @@
 #ifndef GOPTICAL_SYSTEM_HH_
 #define GOPTICAL_SYSTEM_HH_
 
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <mutex>
 
 #include "goptical/core/common.hpp"
 
+#include "goptical/core/math/vector_pair.hpp"
 #include "goptical/core/sys/element.hpp"
 #include "goptical/core/sys/container.hpp"
 #include "goptical/core/trace/params.hpp"
@@ -48,11 +52,25 @@ namespace _goptical {
        @ref Element {element} may be part of a system. This class handle 3d
        transformation between elements local coordinates.
 
+       Elements are registered in a table indexed by element
+       identifier. Identifiers of removed elements are kept in a free
+       list and reused, adding or removing an element takes constant
+       amortized time.
+
+       Local to global and global to local transforms of all
+       elements are stored in a flat table indexed by element
+       identifier. Transforms of moved elements are updated on next
+       access under a lock, the table can be read by several threads
+       as long as the system is not modified at the same time.
+       Transforms between two elements are composed on each call.
+
        @xsee {tuto_system}
     */
     class system : public ref_base<system>, public Container
     {
       friend class Element;
+      friend class Group;
+      friend class trace::CompiledSystem;
 
     public:
       /** Create a new empty system. */
@@ -80,8 +98,10 @@ namespace _goptical {
       /** Get default tracer parameters */
       inline trace::Params & get_tracer_params();
 
-      /** Get transform between two elements local coordinates */
-      inline const math::Transform<3> & get_transform(const Element &from, const Element &to) const;
+      /** Get transform between two elements local coordinates. An
+          element which is not part of a system is positioned
+          relative to global coordinates. */
+      inline math::Transform<3> get_transform(const Element &from, const Element &to) const;
 
       /** Get transform from element local to global coordinates */
       inline const math::Transform<3> & get_global_transform(const Element &from) const;
@@ -102,11 +122,20 @@ namespace _goptical {
       /** Increase current system version */
       inline void update_version();
 
-      /** Find surface which colides with the given ray and update intersection point */
+      /** Find surface which colides with the given ray and update
+          intersection point. Surfaces are selected using a bounding
+          volume hierarchy of the system snapshot. Tracers use their
+          own snapshot instead, see @ref get_compiled. */
       Surface * colide_next(const trace::Params &params,
                             math::VectorPair3 &intersect,
                             const trace::Ray &ray) const;
 
+      /** Get system snapshot used for ray tracing. A new snapshot
+          is built if the system changed since last call, previous
+          snapshots stay valid while in use. This function can be
+          called from different threads. */
+      std::shared_ptr<const trace::CompiledSystem> get_compiled() const;
+
       /** set environment material */
       void set_environment(const const_ref<material::Base> &env);
 
@@ -121,32 +150,38 @@ namespace _goptical {
 
     private:
 
+      /** Element transforms table entry */
+      struct transform_s
+      {
+        math::Transform<3> _l2g;  // local to global transform
+        math::Transform<3> _g2l;  // global to local transform
+        bool _dirty;
+      };
+
       /** called be container class when a new element is added */
       void added(Element &e);
       /** called be container class when a new element is removed */
       void removed(Element &e);
+      /** called be container class before multiple elements are added */
+      void reserve(unsigned int count);
 
-      /** get an new element identifier */
+      /** get an new element identifier, released identifiers are reused */
       unsigned int index_get(Element &element);
       /** free the identifier associated with the given element */
       void index_put(const Element &element);
 
-      /** Get a reference to cache entry for transform between 2 elements (ids) */
-      inline math::Transform<3> * & transform_cache_entry(unsigned int from, unsigned int to) const;
+      /** Get transforms table entry of an element, up to date */
+      inline const struct transform_s & transform_cache_entry(const Element &e) const;
 
-      /** Compute and get 3d transform between element local and global coordinates */
-      const math::Transform<3> & transform_l2g_cache_update(const Element &e) const;
-      /** Compute and get 3d transform between element local and global coordinates */
-      const math::Transform<3> & transform_g2l_cache_update(const Element &e) const;
-      /** Compute and get 3d transform between two elements local coordinates */
-      const math::Transform<3> & transform_cache_update(const Element &from, const Element &to) const;
+      /** Compute transforms of all flushed elements */
+      void transform_cache_update() const;
 
-      /** Flush all cached transforms associated with a given element */
+      /** Mark transforms of a given element as outdated */
       void transform_cache_flush(const Element &element);
-      /** Flush all cached transforms */
+      /** Mark transforms of all elements as outdated */
       void transform_cache_flush();
 
-      /** Resize transform cache size */
+      /** Resize transforms table */
       void transform_cache_resize(unsigned int newsize);
 
       unsigned int              _version;
@@ -157,8 +192,14 @@ namespace _goptical {
       trace::Params             _tracer_params;
       unsigned int              _e_count;
       std::vector<Element *>    _index_map;
-      // FIXME use transform pool instead of new/delete
-      std::vector<math::Transform<3> *> _transform_cache;
+      std::vector<unsigned int> _index_free;    // released identifiers
+      mutable std::vector<struct transform_s> _transform_cache; // indexed by element id
+      mutable std::vector<unsigned int> _transform_dirty;       // ids of outdated entries
+      mutable std::atomic<bool> _transform_outdated;
+      mutable std::mutex        _transform_lock;
+
+      mutable std::mutex        _compiled_lock;
+      mutable std::shared_ptr<const trace::CompiledSystem> _compiled;
     };
 
   }
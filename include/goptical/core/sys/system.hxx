@@ -85,39 +85,36 @@ namespace _goptical {
       return _tracer_params;
     }
 
-    math::Transform<3> * & system::transform_cache_entry(unsigned int from, unsigned int to) const
+    const system::transform_s & system::transform_cache_entry(const Element &e) const
     {
-      return const_cast<math::Transform<3> * &>(_transform_cache[from * _e_count + to]);
+      if (_transform_outdated.load(std::memory_order_acquire))
+        transform_cache_update();
+
+      assert(e.id() < _e_count);
+      return _transform_cache[e.id()];
     }
 
-    const math::Transform<3> & system::get_transform(const Element &from, const Element &to) const
+    math::Transform<3> system::get_transform(const Element &from, const Element &to) const
     {
-      math::Transform<3> * &e = transform_cache_entry(from.id(), to.id());
+      math::Transform<3> t(from.id() ? transform_cache_entry(from)._l2g
+                           : from.get_transform());
 
-      if (!e)
-        transform_cache_update(from, to);
+      if (to.id())
+        t.compose(transform_cache_entry(to)._g2l);
+      else
+        t.compose(to.get_transform().inverse());
 
-      return *e;
+      return t;
     }
 
     const math::Transform<3> & system::get_global_transform(const Element &from) const
     {
-      math::Transform<3> * &e = transform_cache_entry(from.id(), 0);
-
-      if (!e)
-        transform_l2g_cache_update(from);
-
-      return *e;
+      return transform_cache_entry(from)._l2g;
     }
 
     const math::Transform<3> & system::get_local_transform(const Element &to) const
     {
-      math::Transform<3> * &e = transform_cache_entry(0, to.id());
-
-      if (!e)
-        transform_g2l_cache_update(to);
-
-      return *e;
+      return transform_cache_entry(to)._g2l;
     }
 
     void system::update_version()
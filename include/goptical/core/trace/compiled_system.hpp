@@ -0,0 +1,177 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_TRACE_COMPILEDSYSTEM_HH_
+#define GOPTICAL_TRACE_COMPILEDSYSTEM_HH_
+
+#include <vector>
+
+#include "goptical/core/common.hpp"
+
+#include "goptical/core/math/vector_pair.hpp"
+#include "goptical/core/math/transform.hpp"
+#include "goptical/core/sys/element.hpp"
+
+namespace _goptical {
+
+  namespace trace {
+
+    /**
+       @short Ray tracing snapshot of an optical system
+       @header <goptical/core/trace/CompiledSystem
+       @module {Core}
+
+       This class holds system data used by tracers so that no
+       element type lookup or transform cache access is needed for
+       each ray. It contains a flat table of registered elements
+       with their types, enabled sources, transforms between ray
+       creators and surfaces local coordinates, surfaces materials
+       with proxies resolved and a bounding volume hierarchy used to
+       find surfaces hit by rays in non sequential mode.
+
+       A snapshot is built for a given system version and is never
+       modified afterwards. The system publishes a new snapshot when
+       it changes, tracers keep the snapshot they started with until
+       the end of their trace, see @ref sys::system::get_compiled.
+     */
+    class CompiledSystem
+    {
+    public:
+
+      /** Element types */
+      enum ElementType
+        {
+          /** Element is neither a source nor a surface */
+          ElementOther,
+          /** Element is a @ref sys::Source */
+          ElementSource,
+          /** Element is a @ref sys::Surface */
+          ElementSurface,
+          /** Element is a @ref sys::OpticalSurface */
+          ElementOpticalSurface,
+        };
+
+      /** Build a snapshot of given system */
+      CompiledSystem(const sys::system &system);
+
+      /** Test if the system, or a surface curve or shape, changed
+          since the snapshot was built */
+      bool is_outdated() const;
+
+      /** Get system version of snapshot */
+      inline unsigned int get_version() const;
+
+      /** Get snapshot system */
+      inline const sys::system & get_system() const;
+
+      /** Get type of a system element */
+      inline ElementType get_type(const sys::Element &e) const;
+
+      /** Get enabled sources in system container order */
+      inline const std::vector<const sys::Source *> & get_sources() const;
+
+      /** Get enabled surfaces in element identifier order */
+      inline const std::vector<const sys::Surface *> & get_surfaces() const;
+
+      /** Get material on one side of an optical surface with
+          material proxies resolved */
+      inline const material::Base & get_material(const sys::Element &e, unsigned int side) const;
+
+      /** Get transform between a ray creator element and a surface
+          local coordinates */
+      inline math::Transform<3> get_transform(const sys::Element &from,
+                                                      const sys::Element &to) const;
+
+      /** Find surface which colides with the given ray and update
+          intersection point. Equidistant intersections are resolved
+          in element identifier order. */
+      sys::Surface * colide_next(const Params &params,
+                                 math::VectorPair3 &intersect,
+                                 const Ray &ray) const;
+
+    private:
+
+      /** Build snapshot data */
+      void build();
+
+      /** Get sum of surfaces curves and shapes versions */
+      unsigned int get_surfaces_version() const;
+
+      /** Build bounding volume hierarchy node for a range of surfaces */
+      unsigned int tree_build(unsigned int first, unsigned int last);
+
+      /** Test surface intersection and keep closest one */
+      inline void colide_test(const Params &params, unsigned int surface,
+                              const sys::Element &origin, const math::VectorPair3 &ray,
+                              math::VectorPair3 &intersect, double &min_dist,
+                              int &hit) const;
+
+      static const unsigned int none = (unsigned int)-1;
+
+      /** Registered element data, indexed by element identifier */
+      struct element_s
+      {
+        const sys::Element *_element;
+        ElementType _type;
+        unsigned int _creator;          // row in transforms table
+        unsigned int _surface;          // column in transforms table
+        const material::Base *_material[2];
+        math::Transform<3> _global;     // local to global transform
+      };
+
+      /** Bounding volume hierarchy node */
+      struct node_s
+      {
+        math::VectorPair3 _box;
+        unsigned int _first;    // first leaf surface or second child node index
+        unsigned int _count;    // leaf surfaces count, 0 for inner nodes
+      };
+
+      /** Bounding volume hierarchy surface */
+      struct tree_surface_s
+      {
+        unsigned int _surface;  // index in surfaces table
+        math::VectorPair3 _box; // global bounding box
+      };
+
+      const sys::system         *_system;
+      unsigned int              _version;
+      unsigned int              _surfaces_version;
+
+      std::vector<struct element_s> _elements;
+      std::vector<const sys::Source *> _sources;
+      std::vector<const sys::Surface *> _surfaces;
+      std::vector<math::Transform<3> > _transforms;
+
+      std::vector<struct node_s> _nodes;
+      std::vector<struct tree_surface_s> _tree_surfaces;
+      unsigned int              _unbounded;     // surfaces tested for all rays
+    };
+
+  }
+}
+
+#endif
+
@@ -0,0 +1,88 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_TRACE_COMPILEDSYSTEM_HXX_
+#define GOPTICAL_TRACE_COMPILEDSYSTEM_HXX_
+
+#include <cassert>
+
+#include "goptical/core/math/transform.hxx"
+#include "goptical/core/sys/element.hxx"
+
+namespace _goptical {
+
+  namespace trace {
+
+    unsigned int CompiledSystem::get_version() const
+    {
+      return _version;
+    }
+
+    const sys::system & CompiledSystem::get_system() const
+    {
+      return *_system;
+    }
+
+    CompiledSystem::ElementType CompiledSystem::get_type(const sys::Element &e) const
+    {
+      assert(e.id() < _elements.size() && _elements[e.id()]._element == &e);
+      return _elements[e.id()]._type;
+    }
+
+    const std::vector<const sys::Source *> & CompiledSystem::get_sources() const
+    {
+      return _sources;
+    }
+
+    const std::vector<const sys::Surface *> & CompiledSystem::get_surfaces() const
+    {
+      return _surfaces;
+    }
+
+    const material::Base & CompiledSystem::get_material(const sys::Element &e, unsigned int side) const
+    {
+      assert(_elements[e.id()]._type == ElementOpticalSurface);
+      return *_elements[e.id()]._material[side];
+    }
+
+    math::Transform<3> CompiledSystem::get_transform(const sys::Element &from,
+                                                  const sys::Element &to) const
+    {
+      const struct element_s &f = _elements[from.id()];
+      const struct element_s &t = _elements[to.id()];
+
+      // large systems do not have a transforms table, creators
+      // which are not part of the system are not in the table
+      if (f._creator == none || t._surface == none)
+        return from.get_transform_to(to);
+
+      return _transforms[f._creator * _surfaces.size() + t._surface];
+    }
+
+  }
+}
+
+#endif
+
@@ -0,0 +1,107 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_TRACE_DETECTOR_HH_
+#define GOPTICAL_TRACE_DETECTOR_HH_
+
+#include <map>
+#include <set>
+
+#include "goptical/core/common.hpp"
+
+#include "goptical/core/math/vector_pair.hpp"
+#include "goptical/core/trace/irradiance.hpp"
+#include "goptical/core/trace/sink.hpp"
+
+namespace _goptical {
+
+  namespace trace {
+
+    /**
+       @short Pixel detector collecting rays while tracing
+       @header <goptical/core/trace/Detector
+       @module {Core}
+
+       This class bins intercepted rays intensity in an @ref
+       Irradiance map as rays arrive. A separate map can be kept
+       for each wavelength in addition to the map of all
+       wavelengths.
+
+       Memory used does not depend on the number of traced rays.
+       Detectors are created by images in detector mode, see @ref
+       sys::Image::set_detector, and can also be registered as a
+       @ref Sink for any surface.
+    */
+    class Detector : public Sink
+    {
+    public:
+      /** Create a detector covering given window of the surface
+          plane with given pixels resolution */
+      Detector(const math::VectorPair2 &window,
+               unsigned int width, unsigned int height,
+               bool per_wavelen = false);
+
+      ~Detector();
+
+      /** Test if a separate map is kept for each wavelength */
+      inline bool is_per_wavelen() const;
+
+      /** Get map of all wavelengths */
+      inline const Irradiance & get_irradiance() const;
+
+      /** Get map of a single wavelength */
+      const Irradiance & get_irradiance(double wavelen) const;
+
+      /** Get set of wavelengths with a separate map */
+      std::set<double> get_wavelen_set() const;
+
+      /** Get number of rays which reached the detector, including
+          rays outside of the maps window */
+      inline unsigned long get_ray_count() const;
+
+      /** Set all pixels to zero and remove wavelengths maps */
+      void clear();
+
+      /** @override */
+      void intercept(const sys::Surface &s, const Ray &ray);
+      /** @override */
+      ref<Sink> new_worker() const;
+      /** @override */
+      void merge_worker(Sink &worker);
+
+    private:
+      typedef std::map<double, ref<Irradiance> > wavelens_t;
+
+      ref<Irradiance>   _total;
+      wavelens_t        _wavelens;
+      bool              _per_wavelen;
+      unsigned long     _count;
+    };
+
+  }
+}
+
+#endif
+
@@ -25,8 +25,12 @@
 #ifndef GOPTICAL_TRACE_DISTRIBUTION_HH_
 #define GOPTICAL_TRACE_DISTRIBUTION_HH_
 
+#include <stdint.h>
+
 #include "goptical/core/common.hpp"
 
+#include "goptical/core/math/vector.hpp"
+
 namespace _goptical
 {
 
@@ -46,6 +50,13 @@ namespace _goptical
        Ray density is expressed as average number of rays along
        surface radius.
 
+       Random, Sobol, Halton and jittered patterns are generated from
+       a seed and a stream number. The same seed and stream always
+       give the same points; different streams give independent
+       sample sets, one can be used per worker thread. Low
+       discrepancy patterns reach a given spot accuracy with fewer
+       rays than the random pattern.
+
        @image dist_patterns.png {Different patterns rendered on a disk with default density}
      */
 
@@ -86,10 +97,45 @@ namespace _goptical
           not. */
       inline void set_uniform_pattern();
 
+      /** Set seed of random and low discrepancy patterns, default is 0 */
+      inline void set_seed(uint64_t seed);
+
+      /** Get current seed */
+      inline uint64_t get_seed() const;
+
+      /** Set random stream number, default is 0. Distributions
+          with same seed and different streams produce independent
+          points. */
+      inline void set_stream(unsigned int stream);
+
+      /** Get current random stream number */
+      inline unsigned int get_stream() const;
+
+      /** Test if pattern is built from sampled points, see @ref get_unit_samples */
+      inline bool is_sampled_pattern() const;
+
+      /** Get about @tt count points in the [0, 1) square for the
+          sampled patterns. Jittered pattern rounds the count up to
+          fill a complete grid. */
+      void get_unit_samples(unsigned int count,
+                            const math::Vector2::put_delegate_t &f) const;
+
+      /** Get about @tt count points uniformly distributed over the
+          unit radius disk, excluding the central hole with given
+          radius. Sampled points are mapped with equal area so that
+          their stratification is preserved. */
+      void get_disk_samples(unsigned int count, double hole_radius,
+                            const math::Vector2::put_delegate_t &f) const;
+
+      /** Test if distributions have same pattern, density, scaling and seed */
+      inline bool operator==(const Distribution &d) const;
+
     private:
       Pattern           _pattern;
       unsigned int      _radial_density;
       double            _scaling;
+      uint64_t          _seed;
+      unsigned int      _stream;
     };
   }
 }
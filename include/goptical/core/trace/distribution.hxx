@@ -39,7 +39,9 @@ namespace _goptical
                                double scaling)
     : _pattern(pattern),
       _radial_density(radial_density),
-      _scaling(scaling)
+      _scaling(scaling),
+      _seed(0),
+      _stream(0)
     {
       if (radial_density < 1)
         throw Error("ray distribution radial density must be greater than 1");
@@ -75,6 +77,40 @@ namespace _goptical
       _scaling = margin;
     }
 
+    void Distribution::set_seed(uint64_t seed)
+    {
+      _seed = seed;
+    }
+
+    uint64_t Distribution::get_seed() const
+    {
+      return _seed;
+    }
+
+    void Distribution::set_stream(unsigned int stream)
+    {
+      _stream = stream;
+    }
+
+    unsigned int Distribution::get_stream() const
+    {
+      return _stream;
+    }
+
+    bool Distribution::is_sampled_pattern() const
+    {
+      switch (_pattern)
+        {
+        case RandomDist:
+        case SobolDist:
+        case HaltonDist:
+        case JitteredDist:
+          return true;
+        default:
+          return false;
+        }
+    }
+
     void Distribution::set_uniform_pattern()
     {
       switch (_pattern)
@@ -88,6 +124,15 @@ namespace _goptical
         }
     }
 
+    bool Distribution::operator==(const Distribution &d) const
+    {
+      return _pattern == d._pattern &&
+        _radial_density == d._radial_density &&
+        _scaling == d._scaling &&
+        _seed == d._seed &&
+        _stream == d._stream;
+    }
+
   }
 }
 
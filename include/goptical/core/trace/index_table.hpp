@@ -0,0 +1,135 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_TRACE_INDEXTABLE_HH_
+#define GOPTICAL_TRACE_INDEXTABLE_HH_
+
+#include <set>
+#include <vector>
+
+#include "goptical/core/common.hpp"
+
+#include "goptical/core/sys/element.hpp"
+
+namespace _goptical {
+
+  namespace trace {
+
+    /**
+       @short Materials optical properties for traced wavelengths
+       @header <goptical/core/trace/IndexTable
+       @module {Core}
+
+       This class holds refractive indexes, internal transmittances
+       and normal incidence reflectances and transmittances of all
+       materials used by optical surfaces of a system, for each
+       wavelength of rays being traced. It is built by the @ref
+       tracer once sources have generated rays, so that optical
+       surfaces only perform table lookups when refracting rays.
+
+       Materials and wavelengths are identified by integer
+       slots. Proxy materials share the slot of the material they
+       refer to. Internal transmittance is stored for a 1 mm
+       thickness and must be raised to the thickness power.
+
+       Values which could not be computed are stored as NaN, the
+       corresponding material function must then be called
+       instead. This keeps errors reported in the same way.
+     */
+    class IndexTable
+    {
+    public:
+      /** Slot value used for materials and wavelengths not in table */
+      static const unsigned int none = (unsigned int)-1;
+
+      /** Create an empty table */
+      IndexTable();
+
+      /** Mark table content as outdated. Material properties are
+          computed again on next @ref update. */
+      inline void invalidate();
+
+      /** Compute table for materials of the given system and the
+          given wavelengths, unless the table is valid for the same
+          wavelengths already. Transmittances and reflectances are
+          only computed when @tt intensity is set. */
+      void update(const sys::system &system, const std::set<double> &wavelens,
+                  bool intensity);
+
+      /** Compute table for materials of the given system snapshot,
+          see above. */
+      void update(const CompiledSystem &compiled, const std::set<double> &wavelens,
+                  bool intensity);
+
+      /** Get wavelength slot */
+      inline unsigned int get_wavelen_slot(double wavelen) const;
+      /** Get material slot, proxy materials are accepted */
+      inline unsigned int get_material_slot(const material::Base *m) const;
+      /** Get slot of material on one side of an optical surface */
+      inline unsigned int get_material_slot(const sys::Element &e, unsigned int side) const;
+
+      /** Get refractive index */
+      inline double get_refractive_index(unsigned int material, unsigned int wavelen) const;
+      /** Get internal transmittance for a 1 mm thickness */
+      inline double get_internal_transmittance(unsigned int material, unsigned int wavelen) const;
+      /** Get normal incidence reflectance of light going from
+          material @tt from to material @tt to */
+      inline double get_normal_reflectance(unsigned int from, unsigned int to,
+                                           unsigned int wavelen) const;
+      /** Get normal incidence transmittance of light going from
+          material @tt from to material @tt to */
+      inline double get_normal_transmittance(unsigned int from, unsigned int to,
+                                             unsigned int wavelen) const;
+
+    private:
+      /** Material slots of an optical surface */
+      struct element_s
+      {
+        unsigned int _slot[2];
+      };
+
+      /** Material pointer slot */
+      struct key_s
+      {
+        const material::Base *_material;
+        unsigned int _slot;
+      };
+
+      bool                      _valid;
+      std::vector<double>       _wavelens;
+      std::vector<const material::Base *> _materials; // proxies resolved
+      std::vector<struct key_s> _keys;
+      std::vector<struct element_s> _elements;        // indexed by element id
+      std::vector<double>       _index;                 // [material][wavelen]
+      std::vector<double>       _transmittance;         // [material][wavelen]
+      std::vector<double>       _normal_reflectance;    // [from][to][wavelen]
+      std::vector<double>       _normal_transmittance;  // [from][to][wavelen]
+    };
+
+  }
+}
+
+#endif
+
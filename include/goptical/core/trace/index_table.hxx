@@ -0,0 +1,92 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_TRACE_INDEXTABLE_HXX_
+#define GOPTICAL_TRACE_INDEXTABLE_HXX_
+
+#include "goptical/core/sys/element.hxx"
+
+namespace _goptical {
+
+  namespace trace {
+
+    void IndexTable::invalidate()
+    {
+      _valid = false;
+    }
+
+    unsigned int IndexTable::get_wavelen_slot(double wavelen) const
+    {
+      for (unsigned int i = 0; i < _wavelens.size(); i++)
+        if (_wavelens[i] == wavelen)
+          return i;
+
+      return none;
+    }
+
+    unsigned int IndexTable::get_material_slot(const material::Base *m) const
+    {
+      for (auto &k : _keys)
+        if (k._material == m)
+          return k._slot;
+
+      return none;
+    }
+
+    unsigned int IndexTable::get_material_slot(const sys::Element &e, unsigned int side) const
+    {
+      if (e.id() >= _elements.size())
+        return none;
+
+      return _elements[e.id()]._slot[side];
+    }
+
+    double IndexTable::get_refractive_index(unsigned int material, unsigned int wavelen) const
+    {
+      return _index[material * _wavelens.size() + wavelen];
+    }
+
+    double IndexTable::get_internal_transmittance(unsigned int material, unsigned int wavelen) const
+    {
+      return _transmittance[material * _wavelens.size() + wavelen];
+    }
+
+    double IndexTable::get_normal_reflectance(unsigned int from, unsigned int to,
+                                              unsigned int wavelen) const
+    {
+      return _normal_reflectance[(from * _materials.size() + to) * _wavelens.size() + wavelen];
+    }
+
+    double IndexTable::get_normal_transmittance(unsigned int from, unsigned int to,
+                                                unsigned int wavelen) const
+    {
+      return _normal_transmittance[(from * _materials.size() + to) * _wavelens.size() + wavelen];
+    }
+
+  }
+}
+
+#endif
+
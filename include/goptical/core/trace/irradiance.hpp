@@ -0,0 +1,146 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_TRACE_IRRADIANCE_HH_
+#define GOPTICAL_TRACE_IRRADIANCE_HH_
+
+#include <vector>
+
+#include "goptical/core/common.hpp"
+
+#include "goptical/core/math/vector.hpp"
+#include "goptical/core/math/vector_pair.hpp"
+#include "goptical/core/trace/sink.hpp"
+
+namespace _goptical {
+
+  namespace trace {
+
+    /**
+       @short Irradiance map of rays intercepted by a surface
+       @header <goptical/core/trace/Irradiance
+       @module {Core}
+       @main
+
+       This class accumulates intercepted rays intensity in a pixel
+       array covering a rectangular window of the surface plane, in
+       surface local coordinates. Pixels are stored in a single row
+       major buffer. Rays falling outside the window are dropped.
+
+       Each ray intensity is either added to the pixel it falls in
+       or, when bilinear splatting is enabled, shared between the 4
+       nearest pixels centers. Splatting reduces aliasing when few
+       rays are traced.
+
+       The map can collect rays saved in a @ref Result object with
+       the @ref add_intercepts function, which uses a partial map
+       for each thread. It can also be registered as a @ref Sink
+       to collect rays while tracing without storing them. Pixel
+       values may differ in rounding with the number of threads.
+    */
+    class Irradiance : public Sink
+    {
+    public:
+      /** Create an irradiance map covering given window of the
+          surface plane with given pixels resolution */
+      Irradiance(const math::VectorPair2 &window,
+                 unsigned int width, unsigned int height);
+
+      ~Irradiance();
+
+      /** Set window covered by the map. This clears the map. */
+      void set_window(const math::VectorPair2 &window);
+
+      /** Get window covered by the map */
+      inline const math::VectorPair2 & get_window() const;
+
+      /** Set map pixels resolution. This clears the map. */
+      void set_resolution(unsigned int width, unsigned int height);
+
+      /** Get map width in pixels */
+      inline unsigned int get_width() const;
+
+      /** Get map height in pixels */
+      inline unsigned int get_height() const;
+
+      GOPTICAL_ACCESSORS(bool, bilinear,
+        "bilinear splatting of rays intensity between adjacent pixels, default is false");
+
+      /** Set all pixels to zero */
+      void clear();
+
+      /** Add intensity at given point of the surface plane */
+      inline void add(const math::Vector2 &point, double intensity);
+
+      /** Add intercept intensity of all rays saved in the result
+          object for given surface. Intercepts are split between
+          threads, 0 uses all hardware threads. */
+      void add_intercepts(const Result &result, const sys::Surface &s,
+                          unsigned int threads = 1);
+
+      /** Get intensity accumulated in a pixel */
+      inline double get_value(unsigned int x, unsigned int y) const;
+
+      /** Get irradiance of a pixel, accumulated intensity divided
+          by pixel area */
+      inline double get_irradiance(unsigned int x, unsigned int y) const;
+
+      /** Get pixel area in surface plane */
+      inline double get_pixel_area() const;
+
+      /** Get pixels buffer, row @tt y starts at index @tt {y * width} */
+      inline const std::vector<double> & get_data() const;
+
+      /** Get sum of all pixels */
+      double get_total_intensity() const;
+
+      /** @override */
+      void intercept(const sys::Surface &s, const Ray &ray);
+      /** @override */
+      ref<Sink> new_worker() const;
+      /** @override */
+      void merge_worker(Sink &worker);
+
+    private:
+      /** Add intensity to a pixels buffer */
+      inline void add(double *data, const math::Vector2 &point, double intensity) const;
+
+      /** Share intensity between 4 pixels, position is given in
+          pixel units relative to first pixel center */
+      void add_bilinear(double *data, double x, double y, double intensity) const;
+
+      math::VectorPair2 _window;
+      math::Vector2     _scale;         // pixels per unit
+      unsigned int      _width;
+      unsigned int      _height;
+      bool              _bilinear;
+      std::vector<double> _data;
+    };
+
+  }
+}
+
+#endif
+
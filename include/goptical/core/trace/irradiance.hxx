@@ -0,0 +1,100 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_TRACE_IRRADIANCE_HXX_
+#define GOPTICAL_TRACE_IRRADIANCE_HXX_
+
+#include <algorithm>
+
+#include "goptical/core/math/vector.hxx"
+#include "goptical/core/math/vector_pair.hxx"
+#include "goptical/core/trace/sink.hxx"
+
+namespace _goptical {
+
+  namespace trace {
+
+    const math::VectorPair2 & Irradiance::get_window() const
+    {
+      return _window;
+    }
+
+    unsigned int Irradiance::get_width() const
+    {
+      return _width;
+    }
+
+    unsigned int Irradiance::get_height() const
+    {
+      return _height;
+    }
+
+    void Irradiance::add(double *data, const math::Vector2 &point, double intensity) const
+    {
+      double x = (point.x() - _window[0].x()) * _scale.x();
+      double y = (point.y() - _window[0].y()) * _scale.y();
+
+      // rays outside the window are dropped, window edges are
+      // included and rays on upper edges go to the last pixel
+      if (!(x >= 0.0 && x <= _width && y >= 0.0 && y <= _height))
+        return;
+
+      if (_bilinear)
+        add_bilinear(data, x - 0.5, y - 0.5, intensity);
+      else
+        data[std::min<size_t>(y, _height - 1) * _width +
+             std::min<size_t>(x, _width - 1)] += intensity;
+    }
+
+    void Irradiance::add(const math::Vector2 &point, double intensity)
+    {
+      add(&_data[0], point, intensity);
+    }
+
+    double Irradiance::get_value(unsigned int x, unsigned int y) const
+    {
+      return _data[(size_t)y * _width + x];
+    }
+
+    double Irradiance::get_pixel_area() const
+    {
+      return 1.0 / (_scale.x() * _scale.y());
+    }
+
+    double Irradiance::get_irradiance(unsigned int x, unsigned int y) const
+    {
+      return get_value(x, y) * _scale.x() * _scale.y();
+    }
+
+    const std::vector<double> & Irradiance::get_data() const
+    {
+      return _data;
+    }
+
+  }
+}
+
+#endif
+
@@ -75,6 +75,21 @@ namespace _goptical {
       GOPTICAL_ACCESSORS(PropagationMode, propagation_mode,
         "physical light propagation mode. @experimental @hidden");
 
+      GOPTICAL_ACCESSORS(unsigned int, thread_count,
+        "number of threads used for raytracing, 0 uses all hardware threads, default is 1");
+
+      GOPTICAL_ACCESSORS(bool, ray_history,
+        "keep all rays and ray tree links, default is true. Rays not saved in result lists are recycled when disabled");
+
+      GOPTICAL_ACCESSORS(bool, optical_path,
+        "accumulate optical path length of rays while tracing, see trace::Ray::get_optical_len, default is false");
+
+      GOPTICAL_ACCESSORS(bool, incremental,
+        "sequential raytracing restarts from the first changed element using rays cached by the previous trace, default is false");
+
+      GOPTICAL_ACCESSORS(double, sag_table_tolerance,
+        "maximum sagitta error of tabulated curves used in place of expensive surface curves when tracing, 0 disables tabulation, default is 0. @see sys::Surface::update_curve_table");
+
       /** Set sequential ray tracing mode */
       inline void set_sequential_mode(const const_ref<Sequence> &seq);
 
@@ -84,6 +99,9 @@ namespace _goptical {
       /** Test if in sequential ray tracing mode */
       inline bool is_sequential() const;
 
+      /** Get sequence used in sequential ray tracing mode */
+      inline const const_ref<Sequence> & get_sequence() const;
+
       /** Set distribution pattern for a given surface */
       inline void set_distribution(const sys::Surface &s, const Distribution &dist);
 
@@ -105,6 +123,11 @@ namespace _goptical {
       PropagationMode           _propagation_mode;
       bool                      _unobstructed;
       double                    _lost_ray_length;
+      unsigned int              _thread_count;
+      bool                      _ray_history;
+      bool                      _optical_path;
+      bool                      _incremental;
+      double                    _sag_table_tolerance;
     };
   }
 }
@@ -42,7 +42,12 @@ namespace _goptical {
         _sequential_mode(false),
         _propagation_mode(RayPropagation),
         _unobstructed(false),
-        _lost_ray_length(1000)
+        _lost_ray_length(1000),
+        _thread_count(1),
+        _ray_history(true),
+        _optical_path(false),
+        _incremental(false),
+        _sag_table_tolerance(0)
     {
     }
 
@@ -62,6 +67,11 @@ namespace _goptical {
       return _sequential_mode;
     }
 
+    const const_ref<Sequence> & Params::get_sequence() const
+    {
+      return _sequence;
+    }
+
     void Params::set_distribution(const sys::Surface &s, const Distribution &dist)
     {
       _s_distribution[&s] = dist;
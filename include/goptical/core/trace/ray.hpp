@@ -45,6 +45,8 @@ namespace _goptical {
      */
     class Ray : public light::Ray
     {
+      friend class Result;
+
     public:
 
       /** Create a propagated light ray */
@@ -61,6 +63,10 @@ namespace _goptical {
 
       GOPTICAL_ACCESSORS(double, len, "light ray length.");
 
+      GOPTICAL_ACCESSORS(unsigned int, source_index, "index of the source generated ray this ray derives from, source rays are numbered in trace order.");
+
+      GOPTICAL_ACCESSORS(double, optical_len, "optical path length from source to ray origin, only computed when enabled in tracer parameters.");
+
       /** Define a new child generated ray */
       inline void add_generated(trace::Ray *r);
 
@@ -98,6 +104,8 @@ namespace _goptical {
       math::Vector3             _point;         // ray intersection point (intersect surface local)
       double                    _intercept_intensity;   // intersection point intensity
       double                    _len;           // ray length
+      unsigned int              _source_index;  // root source ray index
+      double                    _optical_len;   // optical path length to origin
       const sys::Element        *_creator;      // element which generated this ray
       const material::Base  *_material;     // material
       sys::Element              *_i_element;    // intersect element
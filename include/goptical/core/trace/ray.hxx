@@ -45,6 +45,8 @@ namespace _goptical {
     Ray::Ray()
       : light::Ray(),
         _len(std::numeric_limits<double>::max()),
+        _source_index(0),
+        _optical_len(0),
         _creator(0),
         _parent(0),
         _child(0),
@@ -55,6 +57,8 @@ namespace _goptical {
     Ray::Ray(const light::Ray &r)
       : light::Ray(r),
         _len(std::numeric_limits<double>::max()),
+        _source_index(0),
+        _optical_len(0),
         _creator(0),
         _parent(0),
         _child(0),
@@ -65,6 +69,7 @@ namespace _goptical {
     void Ray::add_generated(Ray *r)
     {
       assert(!r->_parent);
+      r->_source_index = _source_index;
       r->_parent = this;
       r->_next = _child;
       _child = r;
@@ -0,0 +1,156 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_TRACE_RAYBATCH_HH_
+#define GOPTICAL_TRACE_RAYBATCH_HH_
+
+#include <vector>
+
+#include "goptical/core/common.hpp"
+
+#include "goptical/core/math/vector.hpp"
+#include "goptical/core/math/vector_pair.hpp"
+
+namespace _goptical {
+
+  namespace trace {
+
+    /**
+       @short Structure of arrays light rays container
+       @header <goptical/core/trace/RayBatch
+       @module {Core}
+
+       This class stores a set of rays with each ray property in a
+       separate contiguous array. It is used to process many rays
+       with a single call to batch functions like @ref
+       curve::Base::intersect_batch or @ref shape::Base::inside_batch.
+
+       Each ray has an origin, a direction, a wavelength, an
+       intensity, a material index and a parent index. Materials are
+       stored once in a batch material table. The parent index is
+       used by the caller to associate the ray with the object it
+       was loaded from.
+
+       An intersection point and a surface normal are also attached
+       to each ray. Rays can be disabled during processing, batch
+       functions only process active rays.
+
+       Allocated storage is kept when the batch is cleared.
+     */
+    class RayBatch
+    {
+    public:
+      /** Create an empty rays batch */
+      RayBatch();
+
+      /** Remove all rays and materials, keep allocated storage */
+      void clear();
+
+      /** Reserve storage for a given rays count */
+      void reserve(size_t count);
+
+      /** Get number of rays in batch */
+      inline size_t size() const;
+
+      /** Append a new active ray, return its index */
+      inline unsigned int add(const math::VectorPair3 &ray, double wavelen,
+                              double intensity, const material::Base *material,
+                              unsigned int parent);
+
+      /** Get ray origin and direction */
+      inline math::VectorPair3 get_ray(unsigned int index) const;
+      /** Set ray origin and direction */
+      inline void set_ray(unsigned int index, const math::VectorPair3 &ray);
+
+      /** Get ray intersection point and surface normal */
+      inline math::VectorPair3 get_intersect(unsigned int index) const;
+      /** Get ray intersection point */
+      inline math::Vector3 get_point(unsigned int index) const;
+      /** Set ray intersection point */
+      inline void set_point(unsigned int index, const math::Vector3 &point);
+      /** Get surface normal at ray intersection point */
+      inline math::Vector3 get_normal(unsigned int index) const;
+      /** Set surface normal at ray intersection point */
+      inline void set_normal(unsigned int index, const math::Vector3 &normal);
+
+      /** Get ray wavelength */
+      inline double get_wavelen(unsigned int index) const;
+      /** Get ray intensity */
+      inline double get_intensity(unsigned int index) const;
+      /** Get material ray is propagated in */
+      inline const material::Base * get_material(unsigned int index) const;
+      /** Get ray parent index */
+      inline unsigned int get_parent(unsigned int index) const;
+
+      /** Test if ray is still processed */
+      inline bool is_active(unsigned int index) const;
+      /** Enable or disable further processing of a ray */
+      inline void set_active(unsigned int index, bool active);
+
+      /** Add iterations performed by an intersection solver */
+      inline void add_iterations(unsigned long count);
+      /** Get iterations performed by intersection solvers since
+          batch was cleared */
+      inline unsigned long get_iterations() const;
+
+      /** Get ray origin array for a given axis */
+      inline const double * get_origin_array(unsigned int axis) const;
+      /** Get ray direction array for a given axis */
+      inline const double * get_direction_array(unsigned int axis) const;
+      /** Get intersection point array for a given axis */
+      inline double * get_point_array(unsigned int axis);
+      /** Get intersection point array for a given axis */
+      inline const double * get_point_array(unsigned int axis) const;
+      /** Get intersection normal array for a given axis */
+      inline double * get_normal_array(unsigned int axis);
+      /** Get intersection normal array for a given axis */
+      inline const double * get_normal_array(unsigned int axis) const;
+      /** Get rays active state array */
+      inline unsigned char * get_active_array();
+      /** Get rays active state array */
+      inline const unsigned char * get_active_array() const;
+
+    private:
+      unsigned int get_material_index(const material::Base *material);
+
+      std::vector<double>       _origin[3];
+      std::vector<double>       _direction[3];
+      std::vector<double>       _point[3];
+      std::vector<double>       _normal[3];
+      std::vector<double>       _wavelen;
+      std::vector<double>       _intensity;
+      std::vector<unsigned int> _material;      // index in materials table
+      std::vector<unsigned int> _parent;
+      std::vector<unsigned char> _active;
+      std::vector<const material::Base *> _materials;
+      unsigned int              _last_material;
+      unsigned long             _iterations;
+    };
+
+  }
+}
+
+#endif
+
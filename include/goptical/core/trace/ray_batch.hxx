@@ -0,0 +1,198 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_TRACE_RAYBATCH_HXX_
+#define GOPTICAL_TRACE_RAYBATCH_HXX_
+
+#include <cassert>
+
+#include "goptical/core/math/vector.hxx"
+#include "goptical/core/math/vector_pair.hxx"
+
+namespace _goptical {
+
+  namespace trace {
+
+    size_t RayBatch::size() const
+    {
+      return _active.size();
+    }
+
+    unsigned int RayBatch::add(const math::VectorPair3 &ray, double wavelen,
+                               double intensity, const material::Base *material,
+                               unsigned int parent)
+    {
+      unsigned int index = _active.size();
+
+      for (unsigned int j = 0; j < 3; j++)
+        {
+          _origin[j].push_back(ray.origin()[j]);
+          _direction[j].push_back(ray.direction()[j]);
+          _point[j].push_back(0.);
+          _normal[j].push_back(0.);
+        }
+
+      _wavelen.push_back(wavelen);
+      _intensity.push_back(intensity);
+      _material.push_back(get_material_index(material));
+      _parent.push_back(parent);
+      _active.push_back(1);
+
+      return index;
+    }
+
+    math::VectorPair3 RayBatch::get_ray(unsigned int index) const
+    {
+      return math::VectorPair3(math::Vector3(_origin[0][index], _origin[1][index], _origin[2][index]),
+                               math::Vector3(_direction[0][index], _direction[1][index], _direction[2][index]));
+    }
+
+    void RayBatch::set_ray(unsigned int index, const math::VectorPair3 &ray)
+    {
+      for (unsigned int j = 0; j < 3; j++)
+        {
+          _origin[j][index] = ray.origin()[j];
+          _direction[j][index] = ray.direction()[j];
+        }
+    }
+
+    math::VectorPair3 RayBatch::get_intersect(unsigned int index) const
+    {
+      return math::VectorPair3(get_point(index), get_normal(index));
+    }
+
+    math::Vector3 RayBatch::get_point(unsigned int index) const
+    {
+      return math::Vector3(_point[0][index], _point[1][index], _point[2][index]);
+    }
+
+    void RayBatch::set_point(unsigned int index, const math::Vector3 &point)
+    {
+      for (unsigned int j = 0; j < 3; j++)
+        _point[j][index] = point[j];
+    }
+
+    math::Vector3 RayBatch::get_normal(unsigned int index) const
+    {
+      return math::Vector3(_normal[0][index], _normal[1][index], _normal[2][index]);
+    }
+
+    void RayBatch::set_normal(unsigned int index, const math::Vector3 &normal)
+    {
+      for (unsigned int j = 0; j < 3; j++)
+        _normal[j][index] = normal[j];
+    }
+
+    double RayBatch::get_wavelen(unsigned int index) const
+    {
+      return _wavelen[index];
+    }
+
+    double RayBatch::get_intensity(unsigned int index) const
+    {
+      return _intensity[index];
+    }
+
+    const material::Base * RayBatch::get_material(unsigned int index) const
+    {
+      return _materials[_material[index]];
+    }
+
+    unsigned int RayBatch::get_parent(unsigned int index) const
+    {
+      return _parent[index];
+    }
+
+    bool RayBatch::is_active(unsigned int index) const
+    {
+      return _active[index];
+    }
+
+    void RayBatch::set_active(unsigned int index, bool active)
+    {
+      _active[index] = active;
+    }
+
+    void RayBatch::add_iterations(unsigned long count)
+    {
+      _iterations += count;
+    }
+
+    unsigned long RayBatch::get_iterations() const
+    {
+      return _iterations;
+    }
+
+    const double * RayBatch::get_origin_array(unsigned int axis) const
+    {
+      assert(axis < 3);
+      return _origin[axis].data();
+    }
+
+    const double * RayBatch::get_direction_array(unsigned int axis) const
+    {
+      assert(axis < 3);
+      return _direction[axis].data();
+    }
+
+    double * RayBatch::get_point_array(unsigned int axis)
+    {
+      assert(axis < 3);
+      return _point[axis].data();
+    }
+
+    const double * RayBatch::get_point_array(unsigned int axis) const
+    {
+      assert(axis < 3);
+      return _point[axis].data();
+    }
+
+    double * RayBatch::get_normal_array(unsigned int axis)
+    {
+      assert(axis < 3);
+      return _normal[axis].data();
+    }
+
+    const double * RayBatch::get_normal_array(unsigned int axis) const
+    {
+      assert(axis < 3);
+      return _normal[axis].data();
+    }
+
+    unsigned char * RayBatch::get_active_array()
+    {
+      return _active.data();
+    }
+
+    const unsigned char * RayBatch::get_active_array() const
+    {
+      return _active.data();
+    }
+
+  }
+}
+
+#endif
+
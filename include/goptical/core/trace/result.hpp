@@ -29,12 +29,17 @@
 #include <set>
 #include <deque>
 #include <memory>
+#include <vector>
 
 #include "goptical/core/common.hpp"
 
 #include "goptical/core/sys/element.hpp"
 #include "goptical/core/sys/surface.hpp"
 #include "goptical/core/trace/ray.hpp"
+#include "goptical/core/trace/ray_batch.hpp"
+#include "goptical/core/trace/detector.hpp"
+#include "goptical/core/trace/index_table.hpp"
+#include "goptical/core/trace/sink.hpp"
 
 namespace _goptical {
 
@@ -55,6 +60,12 @@ namespace _goptical {
 
        All @ref Ray object are allocated by this class. It is able
        to remember which element intercepted and generated each ray.
+
+       Rays storage and rays lists can be kept allocated between
+       traces by setting the retain capacity state. This avoids
+       memory allocations when the same system is traced many
+       times, the @ref get_alloc_count function can be used to check
+       the steady state is reached.
     */
     class Result
     {
@@ -83,6 +94,9 @@ namespace _goptical {
       /** Get centroid of all ray intercepted on a surface */
       math::Vector3 get_intercepted_centroid(const sys::Surface &s) const;
 
+      /** Get intensity of rays striking a surface on a 1024x1024
+          grid covering the surface bounding box, indexed as [x][y].
+          Rays outside the bounding box are dropped. @see Irradiance */
       std::vector<std::vector<double> > pixelate(const sys::Surface &s) const;
 
       /** Clear all result data */
@@ -101,6 +115,26 @@ namespace _goptical {
       /** Set all save states to false */
       void clear_save_states();
 
+      /** Set sink object used to process rays striking this surface
+          when tracing rays. An invalid ref removes the sink. */
+      void set_intercepted_sink(const sys::Surface &s, const ref<Sink> &sink);
+
+      /** Get data collected while tracing by an image in detector
+          mode, see @ref sys::Image::set_detector */
+      const Detector & get_detector(const sys::Image &image) const;
+
+      GOPTICAL_ACCESSORS(bool, retain_capacity,
+        "rays storage and rays lists retention when result is cleared, default is false");
+
+      /** Get number of memory allocations performed for rays storage
+          and rays lists since result creation */
+      inline unsigned int get_alloc_count() const;
+
+      /** Get a temporary rays batch owned by this result. Used by
+          elements to process rays without allocating storage on
+          each trace. Index must be less than 2. */
+      inline RayBatch & get_ray_batch(unsigned int index);
+
       /** Get maximum intensity for a single ray FIXME */
       double get_max_ray_intensity() const;
 
@@ -115,18 +149,37 @@ namespace _goptical {
 
       /** Declare a new ray interception */
       inline void add_intercepted(const sys::Surface &s, Ray &ray);
+      /** Pass intercepted ray to surface sink once its intercept
+          point and intensity have been set */
+      inline void sink_intercepted(const sys::Surface &s, const Ray &ray);
+      /** Bin a ray striking an image in detector mode */
+      void add_detected(const sys::Image &image, const Ray &ray);
       /** Declare a new ray generation */
       inline void add_generated(const sys::Element &s, Ray &ray);
 
+      /** Add iterations performed by curve intersection solver of a surface */
+      inline void add_intersect_iterations(const sys::Surface &s, unsigned long count);
+      /** Get number of iterations performed by curve intersection
+          solver of a surface during sequential ray tracing. Curves
+          with closed form intersection do not report iterations. */
+      inline unsigned long get_intersect_iterations(const sys::Surface &s) const;
+
       /** Declare ray wavelen used for tracing */
       inline void add_ray_wavelen(double wavelen);
 
       /** Get ray wavelen in use set */
       inline const std::set<double> & get_ray_wavelen_set() const;
 
+      /** Get system related to this result */
+      inline const sys::system & get_system() const;
+
       /** Get reference to tracer parameters used */
       inline const Params & get_params() const;
 
+      /** Get materials properties table built by the tracer for
+          wavelengths of traced rays */
+      inline const IndexTable & get_index_table() const;
+
       /** Draw all tangential rays using specified renderer. Only rays
           which end up hitting the image plane are drawn when @tt
           hit_image is set. */
@@ -144,6 +197,23 @@ namespace _goptical {
 
       void prepare();
 
+      /** Create a result object used to store rays traced by a
+          tracer worker thread. Rays storage is owned by this result. */
+      Result & new_worker();
+      /** Append rays lists and counters of a worker result */
+      void merge_worker(Result &worker);
+
+      /** Drop ray tree links of a processed ray and make its storage
+          available for new rays when @tt reuse is set. Used when
+          tracing without ray history. */
+      void release_ray(Ray &ray, bool reuse);
+      /** Get storage of a released ray */
+      inline Ray * reuse_ray();
+      /** Append a ray to a rays list, counting storage reallocation */
+      inline void push_ray(rays_queue_t &queue, Ray &ray);
+      /** Allocate or empty a rays list when enabled, release it otherwise */
+      void prepare_queue(std::shared_ptr<rays_queue_t> &queue, bool enabled);
+
       struct element_result_s
       {
         std::shared_ptr<rays_queue_t> 
@@ -152,19 +222,33 @@ namespace _goptical {
             _generated; // list of rays for each generator surfaces
         bool _save_intercepted_list;
         bool _save_generated_list;
+        ref<Sink> _sink; // intercepted rays sink
+        ref<Detector> _detector; // image detector data
+        unsigned long _iterations; // intersection solver iterations
       };
 
+      /** Get element data, index 0 is used for elements which are
+          not part of the system */
       inline struct element_result_s & get_element_result(const sys::Element &e);
       inline const struct element_result_s & get_element_result(const sys::Element &e) const;
 
       vector_pool<Ray, 1024> _rays; // rays allocation pool
+      std::vector<Ray *>        _free_rays; // released rays storage
       std::vector<struct element_result_s> _elements;
       std::set<double>          _wavelengths;
+      unsigned int              _source_rays;   // rays generated by sources
       rays_queue_t              *_generated_queue;
       trace::Result::sources_t  _sources;
       unsigned int              _bounce_limit_count;
       const sys::system         *_system;
       const trace::Params       *_params;
+      const IndexTable          *_index_table;
+      std::vector<std::shared_ptr<Result> > _workers; // worker threads rays storage
+      unsigned int              _workers_used;
+      bool                      _retain_capacity;
+      unsigned int              _alloc_count;
+      rays_queue_t              _tmp_queues[3]; // tracer temporary rays lists
+      RayBatch                  _batches[2];
       //  tracer::Mode          _mode;
     };
   }
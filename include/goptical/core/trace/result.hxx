@@ -27,11 +27,16 @@
 #define GOPTICAL_TRACE_RESULT_HXX_
 
 #include <cassert>
+#include <new>
 
 #include "goptical/core/error.hpp"
 #include "goptical/core/sys/element.hxx"
 #include "goptical/core/sys/surface.hxx"
 #include "goptical/core/trace/ray.hxx"
+#include "goptical/core/trace/ray_batch.hxx"
+#include "goptical/core/trace/detector.hxx"
+#include "goptical/core/trace/index_table.hxx"
+#include "goptical/core/trace/sink.hxx"
 
 namespace _goptical {
 
@@ -39,12 +44,12 @@ namespace _goptical {
 
     Result::element_result_s & Result::get_element_result(const sys::Element &e)
     {
-      return _elements[e.id() - 1];
+      return _elements[e.id()];
     }
 
     const Result::element_result_s & Result::get_element_result(const sys::Element &e) const
     {
-      return _elements[e.id() - 1];
+      return _elements[e.id()];
     }
 
     const trace::rays_queue_t & Result::get_intercepted(const sys::Surface &s) const
@@ -72,12 +77,38 @@ namespace _goptical {
       return _sources;
     }
 
+    void Result::push_ray(rays_queue_t &queue, Ray &ray)
+    {
+      if (queue.size() == queue.capacity())
+        _alloc_count++;
+
+      queue.push_back(&ray);
+    }
+
     void Result::add_intercepted(const sys::Surface &s, Ray &ray)
     {
       element_result_s &er = get_element_result(s);
 
       if (er._intercepted)
-        er._intercepted->push_back(&ray);
+        push_ray(*er._intercepted, ray);
+    }
+
+    void Result::add_intersect_iterations(const sys::Surface &s, unsigned long count)
+    {
+      get_element_result(s)._iterations += count;
+    }
+
+    unsigned long Result::get_intersect_iterations(const sys::Surface &s) const
+    {
+      return get_element_result(s)._iterations;
+    }
+
+    void Result::sink_intercepted(const sys::Surface &s, const Ray &ray)
+    {
+      element_result_s &er = get_element_result(s);
+
+      if (er._sink.valid())
+        er._sink->intercept(s, ray);
     }
 
     void Result::add_generated(const sys::Element &s, Ray &ray)
@@ -85,7 +116,7 @@ namespace _goptical {
       element_result_s &er = get_element_result(s);
 
       if (er._generated)
-        er._generated->push_back(&ray);
+        push_ray(*er._generated, ray);
     }
 
     void Result::add_ray_wavelen(double wavelen)
@@ -98,32 +129,72 @@ namespace _goptical {
       return _wavelengths;
     }
 
+    trace::Ray * Result::reuse_ray()
+    {
+      trace::Ray        *r = _free_rays.back();
+
+      _free_rays.pop_back();
+      r->~Ray();
+
+      return r;
+    }
+
     trace::Ray & Result::new_ray()
     {
-      trace::Ray        &r = _rays.create();
+      if (_free_rays.empty() && _rays.size() == _rays.capacity())
+        _alloc_count++;
+
+      trace::Ray        &r = _free_rays.empty()
+        ? _rays.create() : *new (reuse_ray()) Ray();
 
       if (_generated_queue)
-        _generated_queue->push_back(&r);
+        push_ray(*_generated_queue, r);
 
       return r;
     }
 
     trace::Ray & Result::new_ray(const light::Ray &ray)
     {
-      trace::Ray        &r = _rays.create(ray);
+      if (_free_rays.empty() && _rays.size() == _rays.capacity())
+        _alloc_count++;
+
+      trace::Ray        &r = _free_rays.empty()
+        ? _rays.create(ray) : *new (reuse_ray()) Ray(ray);
 
       if (_generated_queue)
-        _generated_queue->push_back(&r);
+        push_ray(*_generated_queue, r);
 
       return r;
     }
 
+    unsigned int Result::get_alloc_count() const
+    {
+      return _alloc_count;
+    }
+
+    RayBatch & Result::get_ray_batch(unsigned int index)
+    {
+      assert(index < 2);
+      return _batches[index];
+    }
+
+    const sys::system & Result::get_system() const
+    {
+      assert(_system != 0);
+      return *_system;
+    }
+
     const Params & Result::get_params() const
     {
       assert(_params != 0);
       return *_params;
     }
 
+    const IndexTable & Result::get_index_table() const
+    {
+      return *_index_table;
+    }
+
   }
 }
 
@@ -82,6 +82,9 @@ namespace _goptical {
       /** Get a reference to an element in sequence */
       inline const sys::Element &get_element(unsigned int index) const;
 
+      /** Get number of elements in sequence */
+      inline unsigned int get_element_count() const;
+
     private:
       void add(const sys::Container &c);
 
@@ -51,6 +51,11 @@ namespace _goptical {
       return *_list.at(index);
     }
 
+    unsigned int Sequence::get_element_count() const
+    {
+      return _list.size();
+    }
+
     void Sequence::clear()
     {
       _list.clear();
@@ -0,0 +1,78 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#ifndef GOPTICAL_TRACE_SINK_HH_
+#define GOPTICAL_TRACE_SINK_HH_
+
+#include "goptical/core/common.hpp"
+
+namespace _goptical {
+
+  namespace trace {
+
+    /**
+       @short Ray interception callback interface
+       @header <goptical/core/trace/Sink
+       @module {Core}
+
+       This class can be inherited to process rays intercepted by a
+       surface while the light is propagated, without storing rays in
+       the @ref Result object. Sinks are registered for a surface with
+       the @ref Result::set_intercepted_sink function.
+
+       The @ref intercept function is called once for each
+       intercepted ray, in the order rays would be stored in the
+       intercepted rays list of the surface.
+
+       When the tracer uses multiple threads, a separate sink is
+       obtained from @ref new_worker for each thread. Worker sinks
+       are merged back in rays order once tracing is over so that
+       no locking is needed and the final sink state does not
+       depend on the number of threads.
+    */
+    class Sink : public ref_base<Sink>
+    {
+    public:
+      virtual ~Sink();
+
+      /** Process a ray intercepted by a surface. Ray intercept
+          point and intercept intensity are valid at this point.
+          Intercept point is given in surface local coordinates. */
+      virtual void intercept(const sys::Surface &s, const Ray &ray) = 0;
+
+      /** Create an empty sink of the same kind used to collect
+          intercepted rays on a tracer worker thread. */
+      virtual ref<Sink> new_worker() const = 0;
+
+      /** Append data collected by a sink previously created by @ref
+          new_worker. */
+      virtual void merge_worker(Sink &worker) = 0;
+    };
+
+  }
+}
+
+#endif
+
@@ -26,11 +26,19 @@
 #ifndef GOPTICAL_TRACER_HH_
 #define GOPTICAL_TRACER_HH_
 
+#include <functional>
+#include <memory>
+
+#include <set>
+
 #include "goptical/core/common.hpp"
 
+#include "goptical/core/light/ray.hpp"
+
 #include "goptical/core/trace/result.hpp"
 #include "goptical/core/trace/params.hpp"
 #include "goptical/core/sys/system.hpp"
+#include "goptical/core/sys/source.hpp"
 
 namespace _goptical {
 
@@ -47,6 +55,17 @@ namespace _goptical {
        Propagation result is stored in a @ref Result object.
        Propagation parameters are stored in a @ref Params object.
 
+       When the incremental parameter is set, sequential ray tracing
+       keeps a copy of rays entering each sequence element. The next
+       trace restarts from the first element which has changed, or
+       which has rays saved in the result, based on elements
+       versions. Curves, shapes and materials modified in place must
+       be followed by a call to @ref sys::Element::update_version.
+
+       Materials properties are computed once per trace for
+       wavelengths of rays generated by sources, see @ref
+       IndexTable.
+
        @xsee {tuto_seqtrace}
      */
     class tracer
@@ -80,18 +99,118 @@ namespace _goptical {
       /** Get attached system */
       inline const sys::system & get_system() const;
 
-      /** Launch ray tracing operation */
+      /** Trace rays of given source instead of system sources. The
+          source must not be part of a system, it is positioned
+          relative to system global coordinates. In sequential mode,
+          sources of the sequence are skipped and the source rays
+          enter the first sequence element which is not a source. */
+      inline void set_source(const const_ref<sys::Source> &source);
+
+      /** Trace rays of system sources again */
+      inline void clear_source();
+
+      /** Launch ray tracing operation. The system snapshot returned
+          by @ref sys::system::get_compiled is fetched once and used
+          for all rays of the trace. */
       void trace();
 
+      /** Get number of incremental traces which did not start from
+          the first sequence element */
+      inline unsigned int get_cache_hit_count() const;
+      /** Get number of incremental traces which started from the
+          first sequence element */
+      inline unsigned int get_cache_miss_count() const;
+      /** Get total number of sequence elements skipped by
+          incremental traces */
+      inline unsigned long get_cache_skipped_count() const;
+      /** Get sequence position last trace started from */
+      inline unsigned int get_restart_position() const;
+
     private:
 
+      /** Ray entering a sequence element, cached for incremental trace */
+      struct seq_ray_s
+      {
+        light::Ray                _ray;
+        const sys::Element        *_creator;
+        const material::Base      *_material;
+        unsigned int              _source_index;
+        double                    _optical_len;
+      };
+
+      typedef std::vector<struct seq_ray_s> seq_rays_t;
+
+      /** Sequential trace data kept for incremental trace */
+      struct seq_cache_s
+      {
+        const Sequence            *_sequence;
+        unsigned int              _params_version;
+        const material::Base      *_environment; // system environment when cached
+        std::vector<const sys::Element *> _elements;
+        std::vector<unsigned int> _versions;    // element versions when cached
+        std::vector<seq_rays_t>   _inputs;      // rays entering each element
+        std::vector<std::set<double> > _wavelengths; // wavelengths after each source
+        std::vector<unsigned int> _source_rays; // source rays count after each source
+      };
+
+      /** Get sequence position incremental trace can restart from */
+      unsigned int seq_restart(const Result &result) const;
+
+      /** Copy rays entering a sequence element to the cache */
+      static void seq_capture(seq_rays_t &cache, const rays_queue_t &rays);
+
+      /** Number rays generated by a source in trace order */
+      static void number_source_rays(Result &result, const rays_queue_t &rays);
+
+      /** Set optical path length of rays generated from an
+          intercepted ray */
+      static void propagate_optical_len(const Result &result, Ray &ray);
+
       template <IntensityMode m> void trace_template();
       template <IntensityMode m> void trace_seq_template();
 
+      /** Trace a range of source rays through the system in non
+          sequential mode. Rays generated during propagation are
+          allocated from the given result object. */
+      template <IntensityMode m>
+      void trace_rays_template(Result &result, const rays_queue_t &rays,
+                               size_t first, size_t last) const;
+
+      /** Trace a range of source rays through a range of sequence
+          elements in sequential mode. */
+      template <IntensityMode m>
+      void trace_seq_rays_template(Result &result, const rays_queue_t &rays,
+                                   size_t first, size_t last,
+                                   unsigned int begin, unsigned int end,
+                                   std::vector<seq_rays_t> *inputs) const;
+
+      /** Run work on worker threads, each with its own worker
+          result. Worker results are merged in index order. */
+      void run_workers(Result &result, unsigned int count,
+                       const std::function<void (Result &worker, unsigned int index)> &work) const;
+
+      /** Get number of threads to use from parameters */
+      unsigned int get_thread_count() const;
+
+      /** Update lazily computed elements data so that the system is
+          only read by worker threads. Values which can not be
+          computed are skipped, errors are reported by the worker
+          which actually needs them. */
+      void prepare_parallel_trace(const Result &result, const rays_queue_t &rays) const;
+
       const_ref<sys::system>    _system;
+      const_ref<sys::Source>    _source;
       Params                    _params;
       Result                    _result;
       Result                    *_result_ptr;
+      std::shared_ptr<const CompiledSystem> _compiled;
+      IndexTable                _index_table;
+      unsigned int              _params_version;
+      seq_cache_s               _seq_cache;
+      unsigned int              _cache_hits;
+      unsigned int              _cache_misses;
+      unsigned long             _cache_skipped;
+      unsigned int              _restart;
     };
   }
 }
@@ -26,6 +26,7 @@
 #ifndef GOPTICAL_TRACER_HXX_
 #define GOPTICAL_TRACER_HXX_
 
+#include "goptical/core/light/ray.hxx"
 #include "goptical/core/trace/result.hpp"
 
 namespace _goptical {
@@ -52,6 +53,22 @@ namespace _goptical {
       return *_system;
     }
 
+    void tracer::set_source(const const_ref<sys::Source> &source)
+    {
+      _source = source;
+    }
+
+    void tracer::clear_source()
+    {
+      _source.invalidate();
+    }
+
+    void tracer::set_params(const Params &params)
+    {
+      _params_version++;
+      _params = params;
+    }
+
     const Params & tracer::get_params() const
     {
       return _params;
@@ -59,9 +76,31 @@ namespace _goptical {
 
     Params & tracer::get_params()
     {
+      // parameters may change, cached incremental trace data is stale
+      _params_version++;
       return _params;
     }
 
+    unsigned int tracer::get_cache_hit_count() const
+    {
+      return _cache_hits;
+    }
+
+    unsigned int tracer::get_cache_miss_count() const
+    {
+      return _cache_misses;
+    }
+
+    unsigned long tracer::get_cache_skipped_count() const
+    {
+      return _cache_skipped;
+    }
+
+    unsigned int tracer::get_restart_position() const
+    {
+      return _restart;
+    }
+
   }
 }
 
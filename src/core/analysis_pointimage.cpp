@@ -22,6 +22,9 @@
 
 */
 
+#include <algorithm>
+#include <thread>
+
 #include <goptical/core/trace/Result>
 #include <goptical/core/trace/Distribution>
 #include <goptical/core/trace/Ray>
@@ -58,6 +61,21 @@ namespace _goptical
         throw Error("no image found for analysis");
     }
 
+    unsigned int PointImage::get_thread_count() const
+    {
+      unsigned int threads = _tracer.get_params().get_thread_count();
+
+      if (!threads)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+      return threads;
+    }
+
+    unsigned int PointImage::get_thread_count(size_t items) const
+    {
+      return std::max<size_t>(1, std::min<size_t>(get_thread_count(), items / 4096));
+    }
+
     void PointImage::trace()
     {
       if (_processed_trace)
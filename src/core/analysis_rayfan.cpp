@@ -22,6 +22,9 @@
 
 */
 
+#include <algorithm>
+#include <cmath>
+
 #include <goptical/core/sys/System>
 #include <goptical/core/sys/Surface>
 #include <goptical/core/sys/Image>
@@ -40,6 +43,7 @@
 #include <goptical/core/trace/Result>
 #include <goptical/core/trace/Params>
 #include <goptical/core/trace/Ray>
+#include <goptical/core/trace/Sink>
 
 #include <goptical/core/light/SpectralLine>
 
@@ -49,6 +53,70 @@ namespace _goptical
   namespace analysis
   {
 
+    static const unsigned int none = (unsigned int)-1;
+
+    /* Records rays striking the entrance and target surfaces while
+       tracing, ray tree links are not needed afterward. The same
+       sink is registered for both surfaces. */
+    class RayFanSink : public trace::Sink
+    {
+    public:
+      RayFanSink(const sys::Surface &entrance, const sys::Surface &exit)
+        : _entrance(entrance),
+          _exit(exit)
+      {
+      }
+
+      void intercept(const sys::Surface &s, const trace::Ray &ray)
+      {
+        if (&s == &_entrance)
+          {
+            RayFan::entrance_s e = { ray.get_source_index(), ray.get_intercept_point(),
+                                     ray.direction() };
+
+            _entrance_rays.push_back(e);
+          }
+
+        if (&s == &_exit)
+          {
+            double wl = ray.get_wavelen();
+            const trace::Ray *child = ray.get_first_child();
+            RayFan::ray_s r;
+
+            r._ray = ray;
+            r._len = ray.get_len();
+            r._point = ray.get_intercept_point();
+            r._exit = child ? child->direction() : math::vector3_0;
+            r._has_exit = child != 0;
+            r._entrance = ray.get_source_index();
+            r._opl = (ray.get_optical_len() + ray.get_len()
+                      * ray.get_material()->get_refractive_index(wl))
+              / (wl * 1e-6); // opl in wave unit
+
+            _exit_rays.push_back(r);
+          }
+      }
+
+      ref<trace::Sink> new_worker() const
+      {
+        return GOPTICAL_REFNEW(RayFanSink, _entrance, _exit);
+      }
+
+      void merge_worker(trace::Sink &worker)
+      {
+        RayFanSink &w = static_cast<RayFanSink &>(worker);
+
+        _entrance_rays.insert(_entrance_rays.end(), w._entrance_rays.begin(),
+                              w._entrance_rays.end());
+        _exit_rays.insert(_exit_rays.end(), w._exit_rays.begin(), w._exit_rays.end());
+      }
+
+      const sys::Surface &_entrance;
+      const sys::Surface &_exit;
+      std::vector<RayFan::entrance_s> _entrance_rays;
+      std::vector<RayFan::ray_s> _exit_rays;
+    };
+
     RayFan::RayFan(const sys::system &system, enum rayfan_plane_e plane)
       : _tracer(system),
         _processed_trace(false),
@@ -91,17 +159,85 @@ namespace _goptical
           if (!_exit)
             throw Error("no suitable exit surface found for analysis");
 
+          ref<RayFanSink> sink = GOPTICAL_REFNEW(RayFanSink, *_entrance, *_exit);
+
           result.clear_save_states();
-          result.set_intercepted_save_state(*_exit, true);
+          result.set_intercepted_sink(*_entrance, sink);
+          result.set_intercepted_sink(*_exit, sink);
 
           _tracer.get_params().set_distribution(*_entrance, _dist);
           _tracer.get_params().set_unobstructed(true);
+          _tracer.get_params().set_optical_path(true);
           _tracer.trace();
 
+          result.set_intercepted_sink(*_entrance, ref<trace::Sink>());
+          result.set_intercepted_sink(*_exit, ref<trace::Sink>());
+
+          process_index(*sink);
+
           _processed_trace = true;
         }
     }
 
+    void RayFan::process_index(RayFanSink &sink)
+    {
+      _entrance_radius = _entrance->get_shape()
+        .get_outter_radius(math::Vector2(1-_dist_plane, _dist_plane));
+
+      // entrance surface data of each source ray
+
+      unsigned int sources = 0;
+
+      for (auto &e : sink._entrance_rays)
+        sources = std::max(sources, e._source_index + 1);
+
+      std::vector<unsigned int> entrance(sources, none);
+
+      _entrance_rays.swap(sink._entrance_rays);
+
+      for (unsigned int i = 0; i < _entrance_rays.size(); i++)
+        if (entrance[_entrance_rays[i]._source_index] == none)
+          entrance[_entrance_rays[i]._source_index] = i;
+
+      // count rays for each wavelen
+
+      _wavelens.clear();
+
+      for (auto &i : sink._exit_rays)
+        _wavelens[i._ray.get_wavelen()]._last++;
+
+      unsigned int count = 0;
+
+      for (auto &i : _wavelens)
+        {
+          wavelen_s &w = i.second;
+          unsigned int n = w._last;
+
+          w._first = w._last = count;
+          w._chief = none;
+          count += n;
+        }
+
+      // group rays by wavelen, keeping intercepts order
+
+      _rays.resize(count);
+
+      for (auto &i : sink._exit_rays)
+        {
+          wavelen_s &w = _wavelens[i._ray.get_wavelen()];
+          ray_s &r = _rays[w._last];
+
+          r = i;
+          r._entrance = r._entrance < sources ? entrance[r._entrance] : none;
+
+          if (w._chief == none && r._entrance != none &&
+              fabs(get_entrance_height(r, r)) < 1e-8)
+            w._chief = w._last;
+
+          w._last++;
+        }
+    }
+
     void RayFan::invalidate()
     {
       _processed_trace = false;
@@ -111,90 +247,67 @@ namespace _goptical
     ////////////////////////////////////////////////////////////////////////
     // Aberrations evaluation functions
 
-    double RayFan::get_entrance_height(const trace::Ray &r, const trace::Ray &chief) const
+    double RayFan::get_entrance_height(const ray_s &r, const ray_s &chief) const
     {
-      const trace::Ray *ray = &r;
-
-      // walk up to entrance pupil generated ray
-      while (ray && ray->get_creator() != _entrance)
-        ray = ray->get_parent();
-
-      if (!ray)
+      if (r._entrance == none)
         throw Error();
 
-      return ray->origin()[_dist_plane] / _entrance->get_shape()
-        .get_outter_radius(math::Vector2(1-_dist_plane, _dist_plane));
+      return _entrance_rays[r._entrance]._point[_dist_plane] / _entrance_radius;
     }
 
-    double RayFan::get_entrance_angle(const trace::Ray &r, const trace::Ray &chief) const
+    double RayFan::get_entrance_angle(const ray_s &r, const ray_s &chief) const
     {
-      const trace::Ray *ray = &r;
-
-      // walk up to entrance pupil generated ray
-      while (ray && ray->get_creator() != _entrance)
-        ray = ray->get_parent();
+      if (r._entrance == none)
+        throw Error();
 
-      // find parent ray once again
-      if (ray && (ray = ray->get_parent()))
-        return math::rad2degree(atan(ray->direction()[_dist_plane] / ray->direction().z()));
+      const math::Vector3 &d = _entrance_rays[r._entrance]._direction;
 
-      throw Error();
+      return math::rad2degree(atan(d[_dist_plane] / d.z()));
     }
 
-    double RayFan::get_transverse_distance(const trace::Ray &r, const trace::Ray &chief) const
+    double RayFan::get_transverse_distance(const ray_s &r, const ray_s &chief) const
     {
-      return r.get_intercept_point()[_ab_plane] - chief.get_intercept_point()[_ab_plane];
+      return r._point[_ab_plane] - chief._point[_ab_plane];
     }
 
-    double RayFan::get_longitudinal_distance(const trace::Ray &r, const trace::Ray &chief) const
+    double RayFan::get_longitudinal_distance(const ray_s &r, const ray_s &chief) const
     {
       if (&r == &chief)
         throw Error();
 
-      return chief.ln_ln_clst_pt_scale(r) - chief.get_len();
+      return chief._ray.ln_ln_clst_pt_scale(r._ray) - chief._len;
     }
 
-    double RayFan::get_exit_angle(const trace::Ray &r, const trace::Ray &chief) const
+    double RayFan::get_exit_angle(const ray_s &r, const ray_s &chief) const
     {
-      const trace::Ray *ray = r.get_first_child();
-
-      if (!ray)
+      if (!r._has_exit)
         throw Error();
 
-      return math::rad2degree(atan(ray->direction()[_ab_plane] / ray->direction().z()));
+      return math::rad2degree(atan(r._exit[_ab_plane] / r._exit.z()));
     }
 
-    double RayFan::get_image_angle(const trace::Ray &r, const trace::Ray &chief) const
+    double RayFan::get_image_angle(const ray_s &r, const ray_s &chief) const
     {
-      return math::rad2degree(atan(r.direction()[_ab_plane] / r.direction().z()));
+      return math::rad2degree(atan(r._ray.direction()[_ab_plane] / r._ray.direction().z()));
     }
 
-    double RayFan::get_optical_path_len(const trace::Ray &r, const trace::Ray &chief) const
+    double RayFan::get_optical_path_len(const ray_s &r, const ray_s &chief) const
     {
-      const double wl = r.get_wavelen();
-      double dist = 0.0;
-
-      for (const trace::Ray *ray = &r; ray; ray = ray->get_parent())
-        dist += ray->get_len() * ray->get_material()->get_refractive_index(wl);
-
-      return dist / (wl * 1e-6); // opl in wave unit
+      return r._opl;
     }
 
 
     ////////////////////////////////////////////////////////////////////////
     // Aberrations plot generation
 
-    const trace::Ray & RayFan::find_chief_ray(const trace::rays_queue_t &intercepts, double wavelen)
+    const RayFan::ray_s & RayFan::find_chief_ray(double wavelen) const
     {
-      for(auto& i : intercepts)
-        {
-          trace::Ray & ray = *i;
+      std::map<double, wavelen_s>::const_iterator i = _wavelens.find(wavelen);
 
-          if (ray.get_wavelen() == wavelen && fabs(get_entrance_height(ray, /* dummy */ ray)) < 1e-8)
-            return ray;
-        }
+      if (i == _wavelens.end() || i->second._chief == none)
+        throw Error("unable to find chief ray intercept");
 
-      throw Error("unable to find chief ray intercept");
+      return _rays[i->second._chief];
     }
 
     ref<data::Plot> RayFan::get_plot(enum rayfan_plot_type_e x,
@@ -279,9 +392,8 @@ namespace _goptical
       process_trace();
 
       trace::Result &result = _tracer.get_trace_result();
-      const trace::rays_queue_t &intercepts = result.get_intercepted(*_exit);
 
-      if (intercepts.empty() || result.get_ray_wavelen_set().empty())
+      if (_rays.empty() || result.get_ray_wavelen_set().empty())
         throw Error("no raytracing data available for analysis");
 
       bool first = true;
@@ -291,7 +403,8 @@ namespace _goptical
 
       for(auto& w : result.get_ray_wavelen_set())
         {
-          const trace::Ray & chief_ray = find_chief_ray(intercepts, w);
+          const ray_s & chief_ray = find_chief_ray(w);
+          const wavelen_s &wr = _wavelens.find(w)->second;
 
           // get chief ray reference values
 
@@ -316,13 +429,9 @@ namespace _goptical
           ref<data::DiscreteSet> s = GOPTICAL_REFNEW(data::DiscreteSet);
           s->set_interpolation(data::Cubic);
 
-          for(auto& i : intercepts)
+          for (unsigned int i = wr._first; i < wr._last; i++)
             {
-              trace::Ray & ray = *i;
-
-              if (ray.get_wavelen() != w)
-                continue;
-
+              const ray_s & ray = _rays[i];
               double x_val, y_val;
 
               try {
@@ -23,6 +23,8 @@
 */
 
 
+#include <algorithm>
+
 #include <goptical/core/analysis/Spot>
 #include <goptical/core/sys/Image>
 
@@ -40,6 +42,8 @@
 
 #include <goptical/core/light/SpectralLine>
 
+#include "thread_ranges_.hxx"
+
 namespace _goptical
 {
 
@@ -63,7 +67,28 @@ namespace _goptical
 
       trace();
 
-      _centroid = _tracer.get_trace_result().get_intercepted_centroid(*_image);
+      const trace::rays_queue_t &intercepts = *_intercepts;
+
+      if (intercepts.empty())
+        throw Error("no ray intercepts found on the surface");
+
+      std::vector<math::Vector3> sums(get_thread_count(intercepts.size()), math::vector3_0);
+
+      run_ranges(intercepts.size(), sums.size(),
+                 [&](unsigned int t, unsigned int first, unsigned int last)
+        {
+          math::Vector3 &sum = sums[t];
+
+          for (unsigned int i = first; i < last; i++)
+            sum += intercepts[i]->get_intercept_point();
+        });
+
+      _centroid = math::vector3_0;
+
+      for (auto &sum : sums)
+        _centroid += sum;
+
+      _centroid /= intercepts.size();
     }
 
     void Spot::process_analysis()
@@ -73,41 +98,126 @@ namespace _goptical
 
       process_trace();
 
-      double    mean = 0;       // rms radius
-      double    max = 0;        // max radius
-      double    intensity = 0;  // total intensity
+      const trace::rays_queue_t &intercepts = *_intercepts;
+      const unsigned int count = intercepts.size();
+
+      struct stats_s
+      {
+        double  _mean;          // rms radius
+        double  _max;           // max radius
+        double  _intensity;     // total intensity
+      };
 
-      for(auto& i : *_intercepts)
+      std::vector<stats_s> stats(get_thread_count(intercepts.size()), stats_s());
+      std::vector<double> dist(count);
+      std::vector<double> square(count);
+
+      // distances and statistics in a single pass
+
+      run_ranges(count, stats.size(),
+                 [&](unsigned int t, unsigned int first, unsigned int last)
         {
-          double        dist = (i->get_intercept_point() - _centroid).len();
+          stats_s &s = stats[t];
+
+          for (unsigned int i = first; i < last; i++)
+            {
+              const trace::Ray &ray = *intercepts[i];
+              math::Vector3 d = ray.get_intercept_point() - _centroid;
+              double l = d.len();
+
+              dist[i] = l;
+              square[i] = std::max(fabs(d.x()), fabs(d.y()));
 
-          if (max < dist)
-            max = dist;
+              if (s._max < l)
+                s._max = l;
 
-          mean += math::square(dist);
-          intensity += i->get_intensity();
+              s._mean += math::square(l);
+              s._intensity += ray.get_intensity();
+            }
+        });
+
+      stats_s total = stats_s();
+
+      for (auto &s : stats)
+        {
+          total._max = std::max(total._max, s._max);
+          total._mean += s._mean;
+          total._intensity += s._intensity;
         }
 
-      _useful_radius = _max_radius = max;
-      _rms_radius = sqrt(mean / _intercepts->size());
-      _tot_intensity = intensity;
+      _useful_radius = _max_radius = total._max;
+      _rms_radius = sqrt(total._mean / count);
+      _tot_intensity = total._intensity;
+
+      // sort distances and cumulate intensity
+
+      std::vector<unsigned int> order(count);
+
+      auto cumulate = [&](radial_s &r, unsigned int i, double d)
+        {
+          double sum = r._intensity.empty() ? 0.0 : r._intensity.back();
+
+          r._radius.push_back(d);
+          r._intensity.push_back(sum + intercepts[i]->get_intensity());
+        };
+
+      auto sort = [&](const std::vector<double> &d, radial_s &r)
+        {
+          for (unsigned int i = 0; i < count; i++)
+            order[i] = i;
+
+          std::stable_sort(order.begin(), order.end(),
+                           [&](unsigned int a, unsigned int b) { return d[a] < d[b]; });
+
+          r._radius.clear();
+          r._intensity.clear();
+          r._radius.reserve(count);
+          r._intensity.reserve(count);
+
+          for (unsigned int i : order)
+            cumulate(r, i, d[i]);
+        };
+
+      sort(square, _square);
+      sort(dist, _radial);
+
+      _radial_wavelen.clear();
+
+      for (unsigned int i : order)
+        cumulate(_radial_wavelen[intercepts[i]->get_wavelen()], i, dist[i]);
 
       _processed_analysis = true;
     }
 
+    double Spot::get_radial_intensity(const radial_s &r, double radius)
+    {
+      size_t n = std::upper_bound(r._radius.begin(), r._radius.end(), radius)
+        - r._radius.begin();
+
+      return n ? r._intensity[n - 1] : 0.0;
+    }
+
     double Spot::get_encircled_intensity(double radius)
     {
-      process_trace();
+      process_analysis();
 
-      double    intensity = 0;
+      return get_radial_intensity(_radial, radius);
+    }
 
-      for(auto& i : *_intercepts)
-        {
-          if ((i->get_intercept_point() - _centroid).len() <= radius)
-            intensity += i->get_intensity();
-        }
+    double Spot::get_encircled_intensity(double radius, double wavelen)
+    {
+      process_analysis();
+
+      std::map<double, radial_s>::const_iterator i = _radial_wavelen.find(wavelen);
+
+      return i == _radial_wavelen.end() ? 0.0 : get_radial_intensity(i->second, radius);
+    }
+
+    double Spot::get_ensquared_intensity(double half_side)
+    {
+      process_analysis();
 
-      return intensity;
+      return get_radial_intensity(_square, half_side);
     }
 
     ref<data::Plot> Spot::get_encircled_intensity_plot(int zones)
@@ -120,51 +230,26 @@ namespace _goptical
       if (intercepts.empty())
         throw Error("no ray intercept found for encircled intensity plot");
 
-      typedef std::map<double, ref<data::SampleSet> > data_sets_t;
-      data_sets_t data_sets;
+      ref<data::Plot> plot = GOPTICAL_REFNEW(data::Plot);
 
       // create plot data for each wavelen
 
-      for(auto& w : result.get_ray_wavelen_set())
+      for (auto& w : result.get_ray_wavelen_set())
         {
           ref<data::SampleSet> s = GOPTICAL_REFNEW(data::SampleSet);
+          const radial_s &r = _radial_wavelen[w];
 
           s->set_interpolation(data::Linear);
           s->set_metrics(0.0, _useful_radius / (double)zones);
           s->resize(zones + 1);
 
-          data_sets.insert(data_sets_t::value_type(w, s));
-        }
-
-      // compute encircled intensity for each radius range
-
-      for(auto& i : *_intercepts)
-        {
-          double dist = (i->get_intercept_point() - _centroid).len();
-
-          if (dist > _useful_radius)
-            continue;
-
-          int n = (unsigned int)((zones - 1) * (dist / _useful_radius));
-
-          assert(n >= 0 && n < zones);
-
-          data_sets[i->get_wavelen()]->get_y_value(n + 1) += i->get_intensity();
-        }
-
-      // integrate
-
-      ref<data::Plot> plot = GOPTICAL_REFNEW(data::Plot);
-
-      for (auto& d : data_sets)
-        {
-          for (int i = 1; i < zones; i++)
-            d.second->get_y_value(i + 1) += d.second->get_y_value(i);
+          for (int i = 0; i <= zones; i++)
+            s->get_y_value(i) = get_radial_intensity(r, s->get_x_value(i));
 
-          data::Plotdata p(d.second);
+          data::Plotdata p(s);
 
           //      p.set_label("Encircled ray intensity"); FIXME set wavelen
-          p.set_color(light::SpectralLine::get_wavelen_color(d.first));
+          p.set_color(light::SpectralLine::get_wavelen_color(w));
           p.set_style(data::LinePlot);
 
           plot->add_plot_data(p);
@@ -0,0 +1,282 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#include <algorithm>
+#include <map>
+#include <numeric>
+
+#include <goptical/core/analysis/SpotMatrix>
+#include <goptical/core/sys/Image>
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/SourcePoint>
+
+#include <goptical/core/trace/Tracer>
+#include <goptical/core/trace/Ray>
+#include <goptical/core/trace/Result>
+#include <goptical/core/trace/Params>
+
+#include <goptical/core/light/SpectralLine>
+
+#include "thread_ranges_.hxx"
+
+namespace _goptical
+{
+
+  namespace analysis
+  {
+
+    static const unsigned int none = (unsigned int)-1;
+
+    SpotMatrix::SpotMatrix(sys::system &system)
+      : PointImage(system),
+        _processed_analysis(false)
+    {
+    }
+
+    unsigned int SpotMatrix::add_field(const math::Vector3 &pos_dir,
+                                       sys::SourceInfinityMode mode)
+    {
+      _fields.push_back(GOPTICAL_REFNEW(sys::SourcePoint, mode, pos_dir));
+      invalidate();
+
+      return _fields.size() - 1;
+    }
+
+    unsigned int SpotMatrix::add_spectral_line(const light::SpectralLine &l)
+    {
+      for (auto &i : _lines)
+        if (i.get_wavelen() == l.get_wavelen())
+          throw Error("spectral line wavelen already used in spot matrix analysis");
+
+      _lines.push_back(l);
+      invalidate();
+
+      return _lines.size() - 1;
+    }
+
+    void SpotMatrix::clear()
+    {
+      _fields.clear();
+      _lines.clear();
+      _cells.clear();
+      invalidate();
+    }
+
+    void SpotMatrix::trace_fields()
+    {
+      if (_processed_trace)
+        return;
+
+      if (_fields.empty())
+        throw Error("no field defined for spot matrix analysis");
+
+      if (_lines.empty())
+        throw Error("no spectral line defined for spot matrix analysis");
+
+      get_default_image();
+
+      for (auto &f : _fields)
+        {
+          f->clear_spectrum();
+
+          for (auto &l : _lines)
+            f->add_spectral_line(l);
+        }
+
+      const unsigned int fields = _fields.size();
+      const unsigned int lines = _lines.size();
+      const unsigned int threads = get_thread_count();
+      const unsigned int field_threads = std::min(threads, fields);
+
+      std::map<double, unsigned int> wavelens;
+
+      for (unsigned int i = 0; i < lines; i++)
+        wavelens[_lines[i].get_wavelen()] = i;
+
+      // remaining threads are shared by tracers of fields
+      trace::Params params(_tracer.get_params());
+      params.set_thread_count(std::max(1u, threads / field_threads));
+
+      std::vector<std::vector<intercept_s> > rays(fields);
+
+      auto trace_field = [&](unsigned int field)
+        {
+          trace::tracer tracer(_system);
+
+          tracer.set_params(params);
+          tracer.set_source(_fields[field]);
+
+          trace::Result &result = tracer.get_trace_result();
+
+          result.set_intercepted_save_state(*_image, true);
+          tracer.trace();
+
+          const trace::rays_queue_t &intercepts = result.get_intercepted(*_image);
+          std::vector<intercept_s> &field_rays = rays[field];
+
+          field_rays.resize(intercepts.size());
+
+          for (unsigned int i = 0; i < intercepts.size(); i++)
+            {
+              const trace::Ray *r = intercepts[i];
+              intercept_s &ray = field_rays[i];
+
+              std::map<double, unsigned int>::const_iterator w
+                = wavelens.find(r->get_wavelen());
+
+              ray._point = r->get_intercept_point();
+              ray._intensity = r->get_intensity();
+              ray._cell = w == wavelens.end() ? none : field * lines + w->second;
+            }
+        };
+
+      // the first trace evaluates lazily computed system data which
+      // is then only read by tracers of other fields
+      trace_field(0);
+
+      run_ranges(fields - 1, field_threads,
+                 [&](unsigned int, unsigned int first, unsigned int last)
+        {
+          for (unsigned int i = first; i < last; i++)
+            trace_field(i + 1);
+        });
+
+      _rays.clear();
+
+      for (auto &r : rays)
+        _rays.insert(_rays.end(), r.begin(), r.end());
+
+      _processed_trace = true;
+    }
+
+    void SpotMatrix::process_analysis()
+    {
+      if (_processed_analysis)
+        return;
+
+      trace_fields();
+
+      const unsigned int count = _rays.size();
+      const unsigned int lines = _lines.size();
+
+      // group intercepts by cell, keeping intercepts order
+
+      _cells.assign(_fields.size() * lines, cell_s());
+
+      std::vector<unsigned int> offset(_cells.size() + 1, 0);
+
+      for (auto &r : _rays)
+        if (r._cell != none)
+          offset[r._cell + 1]++;
+
+      std::partial_sum(offset.begin(), offset.end(), offset.begin());
+
+      std::vector<unsigned int> order(offset.back());
+      std::vector<unsigned int> pos(offset.begin(), offset.end() - 1);
+
+      for (unsigned int i = 0; i < count; i++)
+        if (_rays[i]._cell != none)
+          order[pos[_rays[i]._cell]++] = i;
+
+      // cells statistics and sorted distances
+
+      run_ranges(_cells.size(), get_thread_count(count),
+                 [&](unsigned int, unsigned int first, unsigned int last)
+        {
+          std::vector<double> dist;
+          std::vector<unsigned int> sorted;
+
+          for (unsigned int c = first; c < last; c++)
+            {
+              cell_s &s = _cells[c];
+              const unsigned int *rays = order.data() + offset[c];
+              const unsigned int n = offset[c + 1] - offset[c];
+
+              s._centroid = math::vector3_0;
+              s._ray_count = n;
+
+              if (!n)
+                continue;
+
+              for (unsigned int i = 0; i < n; i++)
+                s._centroid += _rays[rays[i]]._point;
+
+              s._centroid /= n;
+
+              double mean = 0;
+
+              dist.resize(n);
+              sorted.resize(n);
+
+              for (unsigned int i = 0; i < n; i++)
+                {
+                  const intercept_s &ray = _rays[rays[i]];
+                  double l = (ray._point - s._centroid).len();
+
+                  dist[i] = l;
+                  sorted[i] = i;
+
+                  if (s._max_radius < l)
+                    s._max_radius = l;
+
+                  mean += l * l;
+                  s._intensity += ray._intensity;
+                }
+
+              s._rms_radius = sqrt(mean / n);
+
+              std::stable_sort(sorted.begin(), sorted.end(),
+                               [&](unsigned int a, unsigned int b) { return dist[a] < dist[b]; });
+
+              double sum = 0;
+
+              s._radius.reserve(n);
+              s._encircled.reserve(n);
+
+              for (unsigned int i : sorted)
+                {
+                  sum += _rays[rays[i]]._intensity;
+                  s._radius.push_back(dist[i]);
+                  s._encircled.push_back(sum);
+                }
+            }
+        });
+
+      _processed_analysis = true;
+    }
+
+    double SpotMatrix::get_encircled_intensity(unsigned int field, unsigned int line,
+                                               double radius)
+    {
+      const cell_s &s = get_cell(field, line);
+
+      size_t n = std::upper_bound(s._radius.begin(), s._radius.end(), radius)
+        - s._radius.begin();
+
+      return n ? s._encircled[n - 1] : 0.0;
+    }
+
+  }
+}
@@ -0,0 +1,285 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include <goptical/core/analysis/ThroughFocus>
+#include <goptical/core/sys/Image>
+
+#include <goptical/core/trace/Tracer>
+#include <goptical/core/trace/Ray>
+#include <goptical/core/trace/Result>
+
+#include <goptical/core/math/Transform>
+
+#include <goptical/core/io/RendererAxes>
+
+#include <goptical/core/data/PlotData>
+#include <goptical/core/data/Plot>
+#include <goptical/core/data/SampleSet>
+
+#include "thread_ranges_.hxx"
+
+namespace _goptical
+{
+
+  namespace analysis
+  {
+
+    ThroughFocus::ThroughFocus(sys::system &system)
+      : PointImage(system),
+        _processed_rays(false),
+        _first(-0.5),
+        _last(0.5),
+        _count(101)
+    {
+    }
+
+    void ThroughFocus::set_defocus_range(double first, double last, unsigned int count)
+    {
+      if (count < 1)
+        throw Error("through focus analysis needs at least one plane");
+
+      _first = first;
+      _last = last;
+      _count = count;
+    }
+
+    void ThroughFocus::process_rays()
+    {
+      if (_processed_rays)
+        return;
+
+      trace();
+
+      const trace::rays_queue_t &intercepts = *_intercepts;
+
+      _origins.clear();
+      _slopes.clear();
+      _intensity.clear();
+      _origins.reserve(intercepts.size());
+      _slopes.reserve(intercepts.size());
+      _intensity.reserve(intercepts.size());
+
+      // express rays lines in image coordinates
+
+      const sys::Element *creator = 0;
+      math::Transform<3> t;
+
+      for (auto &r : intercepts)
+        {
+          if (r->get_creator() != creator)
+            {
+              creator = r->get_creator();
+              t = _image->get_transform_from(creator);
+            }
+
+          math::Vector3 d = t.transform_linear(r->get_direction());
+
+          // skip rays almost parallel to the image plane
+          if (fabs(d.z()) < 1e-10)
+            continue;
+
+          const math::Vector3 &p = r->get_intercept_point();
+          math::Vector2 s(d.x() / d.z(), d.y() / d.z());
+
+          _origins.push_back(math::Vector2(p.x(), p.y()) - s * p.z());
+          _slopes.push_back(s);
+          _intensity.push_back(r->get_intensity());
+        }
+
+      const unsigned int count = _origins.size();
+
+      if (!count)
+        throw Error("no ray intercepts found on the surface");
+
+      // rays moments, spot size is a quadratic function of defocus
+
+      struct moments_s
+      {
+        math::Vector2 _origin;
+        math::Vector2 _slope;
+        double  _var_origin;
+        double  _covar;
+        double  _var_slope;
+      };
+
+      const moments_s zero = { math::vector2_0, math::vector2_0, 0, 0, 0 };
+      std::vector<moments_s> m(get_thread_count(count), zero);
+
+      run_ranges(count, m.size(),
+                 [&](unsigned int i, unsigned int first, unsigned int last)
+        {
+          for (unsigned int j = first; j < last; j++)
+            {
+              m[i]._origin += _origins[j];
+              m[i]._slope += _slopes[j];
+            }
+        });
+
+      _mean_origin = _mean_slope = math::vector2_0;
+
+      for (auto &i : m)
+        {
+          _mean_origin += i._origin;
+          _mean_slope += i._slope;
+        }
+
+      _mean_origin /= count;
+      _mean_slope /= count;
+
+      run_ranges(count, m.size(),
+                 [&](unsigned int i, unsigned int first, unsigned int last)
+        {
+          for (unsigned int j = first; j < last; j++)
+            {
+              math::Vector2 o = _origins[j] - _mean_origin;
+              math::Vector2 s = _slopes[j] - _mean_slope;
+
+              m[i]._var_origin += o * o;
+              m[i]._covar += o * s;
+              m[i]._var_slope += s * s;
+            }
+        });
+
+      _var_origin = _covar = _var_slope = 0;
+
+      for (auto &i : m)
+        {
+          _var_origin += i._var_origin;
+          _covar += i._covar;
+          _var_slope += i._var_slope;
+        }
+
+      _var_origin /= count;
+      _covar /= count;
+      _var_slope /= count;
+
+      _processed_rays = true;
+    }
+
+    math::Vector2 ThroughFocus::get_centroid(unsigned int plane)
+    {
+      process_rays();
+
+      return _mean_origin + _mean_slope * get_defocus(plane);
+    }
+
+    double ThroughFocus::get_rms_radius(unsigned int plane)
+    {
+      process_rays();
+
+      double z = get_defocus(plane);
+
+      return sqrt(std::max(0.0, _var_origin + 2.0 * z * _covar + z * z * _var_slope));
+    }
+
+    double ThroughFocus::get_best_defocus()
+    {
+      process_rays();
+
+      return _var_slope > 0 ? -_covar / _var_slope : 0.0;
+    }
+
+    std::vector<double> ThroughFocus::get_encircled_intensity(double radius)
+    {
+      process_rays();
+
+      std::vector<double> res(_count);
+      const unsigned int count = _origins.size();
+
+      run_ranges(_count, get_thread_count((size_t)_count * count),
+                 [&](unsigned int, unsigned int first, unsigned int last)
+        {
+          for (unsigned int plane = first; plane < last; plane++)
+            {
+              double z = get_defocus(plane);
+              math::Vector2 c = _mean_origin + _mean_slope * z;
+              double intensity = 0;
+
+              for (unsigned int j = 0; j < count; j++)
+                if ((get_position(j, z) - c).len() <= radius)
+                  intensity += _intensity[j];
+
+              res[plane] = intensity;
+            }
+        });
+
+      return res;
+    }
+
+    ref<data::Plot> ThroughFocus::new_plot(const std::vector<double> &values) const
+    {
+      ref<data::SampleSet> s = GOPTICAL_REFNEW(data::SampleSet);
+
+      s->set_interpolation(data::Linear);
+      s->set_metrics(_first, _count > 1 ? (_last - _first) / (_count - 1) : 1.0);
+      s->resize(_count);
+
+      for (unsigned int i = 0; i < _count; i++)
+        s->get_y_value(i) = values[i];
+
+      ref<data::Plot> plot = GOPTICAL_REFNEW(data::Plot);
+
+      data::Plotdata p(s);
+      p.set_style(data::LinePlot);
+      plot->add_plot_data(p);
+
+      plot->get_axes().set_label("Defocus", io::RendererAxes::X);
+      plot->get_axes().set_unit("m", true, true, -3, io::RendererAxes::X);
+
+      return plot;
+    }
+
+    ref<data::Plot> ThroughFocus::get_rms_radius_plot()
+    {
+      std::vector<double> values(_count);
+
+      for (unsigned int i = 0; i < _count; i++)
+        values[i] = get_rms_radius(i);
+
+      ref<data::Plot> plot = new_plot(values);
+
+      plot->set_title("Through focus spot rms radius");
+      plot->get_axes().set_label("Spot rms radius", io::RendererAxes::Y);
+      plot->get_axes().set_unit("m", true, true, -3, io::RendererAxes::Y);
+
+      return plot;
+    }
+
+    ref<data::Plot> ThroughFocus::get_encircled_intensity_plot(double radius)
+    {
+      ref<data::Plot> plot = new_plot(get_encircled_intensity(radius));
+
+      plot->set_title("Through focus encircled rays intensity");
+      plot->get_axes().set_label("Encircled intensity", io::RendererAxes::Y);
+      plot->get_axes().set_unit("", false, false, 0, io::RendererAxes::Y);
+
+      return plot;
+    }
+
+  }
+}
+
@@ -108,6 +108,21 @@ namespace _goptical {
       _curve->derivative((this->*_transform)(xy), dxdy);
     }
 
+    double Array::sagitta_gradient(const math::Vector2 & xy, math::Vector2 & dxdy) const
+    {
+      return _curve->sagitta_gradient((this->*_transform)(xy), dxdy);
+    }
+
+    bool Array::is_tabulation_useful() const
+    {
+      return false;
+    }
+
+    unsigned int Array::get_version() const
+    {
+      return Base::get_version() + _curve->get_version();
+    }
+
   }
 
 }
@@ -25,6 +25,10 @@
 #include <goptical/core/curve/Base>
 #include <goptical/core/math/Vector>
 #include <goptical/core/math/VectorPair>
+#include <goptical/core/trace/RayBatch>
+
+#include <cmath>
+#include <limits>
 
 #include <gsl/gsl_deriv.h>
 
@@ -34,54 +38,83 @@ namespace _goptical {
 
     // Default curve/ray intersection iterative method
 
-    bool Base::intersect(math::Vector3 &point, const math::VectorPair3 &ray) const
+    bool Base::intersect_newton(math::Vector3 &point, const math::VectorPair3 &ray,
+                                unsigned int &iterations) const
     {
-      math::VectorPair3 p;
+      const math::Vector3 &o = ray.origin();
+      const math::Vector3 &d = ray.direction();
 
       // initial intersection with z=0 plane
-      {
-        double  s = ray.direction().z();
-
-        if (s == 0)
-          return false;
-
-        double  a = -ray.origin().z() / s;
+      if (d.z() == 0)
+        return false;
 
-        if (a < 0)
-          return false;
+      double t = -o.z() / d.z();
 
-        p.origin() = ray.origin() + ray.direction() * a;
-      }
+      if (t < 0)
+        return false;
 
-      unsigned int n = 32;      // avoid infinite loop
+      double t_last = t;
+      double f_last = std::numeric_limits<double>::infinity();
+      double step = 0;
+      bool found = false;
 
-      while (n--)
+      for (unsigned int n = 32; n--; )    // avoid infinite loop
         {
-          double new_sag = sagitta(p.origin().project_xy());
-          double old_sag = p.origin().z();
-
-          // project previous intersection point on curve
-          p.origin().z() = new_sag;
+          math::Vector2 xy(o.x() + d.x() * t, o.y() + d.y() * t);
+          math::Vector2 g;
+          double s = sagitta_gradient(xy, g);
+          // distance along z between ray point and curve
+          double f = o.z() + d.z() * t - s;
+
+          iterations++;
+
+          // step went too far, retry with half step
+          if (!std::isfinite(f) || !std::isfinite(g.x()) || !std::isfinite(g.y()) ||
+              fabs(f) > fabs(f_last))
+            {
+              step /= 2.0;
+              t = t_last + step;
+              continue;
+            }
+
+          // project ray point on curve
+          point = math::Vector3(xy, s);
+          found = true;
 
           // stop if close enough
-          if (fabs(old_sag - new_sag) < 1e-10)
+          if (fabs(f) < 1e-10)
             break;
 
-          // get curve tangeante plane at intersection point
-          normal(p.normal(), p.origin());
+          // derivative of f along ray
+          double df = d.z() - g.x() * d.x() - g.y() * d.y();
 
-          // intersect again with new tangeante plane
-          double a = p.pl_ln_intersect_scale(ray);
+          if (df == 0)
+            break;
 
-          if (a < 0)
-            return false;
+          step = -f / df;
+          t_last = t;
+          f_last = f;
+          t += step;
 
-          p.origin() = ray.origin() + ray.direction() * a;
+          if (t < 0)
+            return false;
         }
 
-      point = p.origin();
+      return found;
+    }
 
-      return true;
+    bool Base::intersect(math::Vector3 &point, const math::VectorPair3 &ray) const
+    {
+      unsigned int iterations = 0;
+
+      return intersect_newton(point, ray, iterations);
+    }
+
+    double Base::sagitta_gradient(const math::Vector2 & xy, math::Vector2 & dxdy) const
+    {
+      derivative(xy, dxdy);
+
+      return sagitta(xy);
     }
 
     // Default curve derivative use gsl numerical differentiation
@@ -135,6 +168,71 @@ namespace _goptical {
       normal.normalize();
     }
 
+    void Base::intersect_batch(trace::RayBatch &batch) const
+    {
+      unsigned int iterations = 0;
+
+      for (unsigned int i = 0; i < batch.size(); i++)
+        {
+          if (!batch.is_active(i))
+            continue;
+
+          math::Vector3 point;
+
+          if (intersect_newton(point, batch.get_ray(i), iterations))
+            batch.set_point(i, point);
+          else
+            batch.set_active(i, false);
+        }
+
+      batch.add_iterations(iterations);
+    }
+
+    void Base::intersect_batch_each(trace::RayBatch &batch) const
+    {
+      for (unsigned int i = 0; i < batch.size(); i++)
+        {
+          if (!batch.is_active(i))
+            continue;
+
+          math::Vector3 point;
+
+          if (intersect(point, batch.get_ray(i)))
+            batch.set_point(i, point);
+          else
+            batch.set_active(i, false);
+        }
+    }
+
+    void Base::normal_batch(trace::RayBatch &batch) const
+    {
+      for (unsigned int i = 0; i < batch.size(); i++)
+        {
+          if (!batch.is_active(i))
+            continue;
+
+          math::Vector3 n;
+
+          normal(n, batch.get_point(i));
+          batch.set_normal(i, n);
+        }
+    }
+
+    bool Base::is_tabulation_useful() const
+    {
+      return true;
+    }
+
+    bool Base::get_sagitta_range(double, math::range_t &) const
+    {
+      return false;
+    }
+
+    unsigned int Base::get_version() const
+    {
+      return _version;
+    }
+
   }
 
 }
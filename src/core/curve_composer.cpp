@@ -39,8 +39,10 @@ namespace _goptical {
       attr._z_offset = 0.;
       attr._transform.reset();
       attr._inv_transform.reset();
+      attr._version = 0;
 
       _list.push_back(attr);
+      update_version();
 
       return _list.back();
     }
@@ -50,6 +52,17 @@ namespace _goptical {
     {
     }
 
+    unsigned int Composer::get_version() const
+    {
+      // all versions only increase, so does the sum
+      unsigned int v = Base::get_version();
+
+      for (auto& c : _list)
+        v += c._version + c._curve->get_version();
+
+      return v;
+    }
+
     double Composer::sagitta(const math::Vector2 & xy) const
     {
       double z = 0;
@@ -70,10 +83,28 @@ namespace _goptical {
 
           c._curve->derivative(c._inv_transform.transform(xy), dtmp);
 
-          dxdy += c._transform.transform_linear(dtmp) * c._z_scale;
+          // gradient is transformed by transposed inverse linear transform
+          dxdy += c._inv_transform.get_linear().transpose() * dtmp * c._z_scale;
         }
     }
 
+    double Composer::sagitta_gradient(const math::Vector2 & xy, math::Vector2 & dxdy) const
+    {
+      double z = 0;
+
+      dxdy.set(0.0);
+
+      for (auto&c : _list)
+        {
+          math::Vector2 dtmp;
+
+          z += c._curve->sagitta_gradient(c._inv_transform.transform(xy), dtmp) * c._z_scale + c._z_offset;
+          dxdy += c._inv_transform.get_linear().transpose() * dtmp * c._z_scale;
+        }
+
+      return z;
+    }
+
   }
 }
 
@@ -31,6 +31,8 @@
 #include <goptical/core/math/VectorPair>
 #include <goptical/core/math/VectorPair>
 
+#include "math_simd_.hxx"
+
 namespace _goptical {
 
   namespace curve {
@@ -105,6 +107,128 @@ namespace _goptical {
       return true;
     }
 
+    struct conic_batch_s : public math::simd::BatchArrays
+    {
+      conic_batch_s(trace::RayBatch &batch, double roc, double sh)
+        : BatchArrays(batch), roc(roc), sh(sh)
+      {
+      }
+
+      double roc;
+      double sh;
+    };
+
+    /* same as Conic::intersect for S::width rays */
+    template <class S>
+    struct conic_intersect_k
+    {
+      static inline void process(conic_batch_s &p, size_t i)
+      {
+        typedef typename S::vec vec;
+        typedef typename S::mask mask;
+
+        unsigned int act = math::simd::active_bits<S>(p.active + i);
+
+        if (!act)
+          return;
+
+        const vec zero = S::set(0.0);
+        const vec two = S::set(2.0);
+        const vec roc = S::set(p.roc);
+        const vec sh = S::set(p.sh);
+
+        const vec ax = S::load(p.origin[0] + i);
+        const vec ay = S::load(p.origin[1] + i);
+        const vec az = S::load(p.origin[2] + i);
+        const vec bx = S::load(p.direction[0] + i);
+        const vec by = S::load(p.direction[1] + i);
+        const vec bz = S::load(p.direction[2] + i);
+
+        const vec a = (sh * (bz * bz) + by * by + bx * bx);
+        const vec b = ((sh * bz * az + by * ay + bx * ax) / roc - bz) * two;
+        const vec c = (sh * (az * az) + ay * ay + ax * ax) / roc - two * az;
+
+        // linear case, a == 0
+        const mask linear = S::eq(a, zero);
+        const vec tl = S::neg(c) / b;
+
+        const vec d = b * b - S::set(4.0) * a * c / roc;
+        vec s = S::sqrt(d);
+
+        s = S::select(S::lt(a * bz, zero), S::neg(s), s);
+
+        if (p.sh < 0)
+          s = S::neg(s);
+
+        const vec t = S::select(linear, tl, (two * c) / (s - b));
+
+        mask hit = S::mask_or(linear, S::nlt(d, zero));
+        hit = S::mask_and(hit, S::nle(t, zero));
+
+        unsigned int h = act & S::bits(hit);
+
+        math::simd::store_masked<S>(p.point[0] + i, ax + bx * t, h);
+        math::simd::store_masked<S>(p.point[1] + i, ay + by * t, h);
+        math::simd::store_masked<S>(p.point[2] + i, az + bz * t, h);
+        math::simd::disable<S>(p.active + i, act & ~h);
+      }
+    };
+
+    /* same as Rotational::normal with Conic::derivative for S::width rays */
+    template <class S>
+    struct conic_normal_k
+    {
+      static inline void process(conic_batch_s &p, size_t i)
+      {
+        typedef typename S::vec vec;
+        typedef typename S::mask mask;
+
+        unsigned int act = math::simd::active_bits<S>(p.active + i);
+
+        if (!act)
+          return;
+
+        const vec zero = S::set(0.0);
+        const vec one = S::set(1.0);
+        const vec roc = S::set(p.roc);
+        const vec roc2 = roc * roc;
+
+        const vec x = S::load(p.point[0] + i);
+        const vec y = S::load(p.point[1] + i);
+        const vec r = S::sqrt(x * x + y * y);
+
+        const vec s2 = S::set(p.sh) * (r * r);
+        const vec s3 = S::sqrt(one - s2 / roc2);
+        const vec s3_1 = s3 + one;
+        const vec s4 = S::set(2.0) / (roc * s3_1) + s2 / (roc2 * roc * s3 * (s3_1 * s3_1));
+        const vec q = r * s4;
+
+        const vec nx = x * q / r;
+        const vec ny = y * q / r;
+        const vec len = S::sqrt(nx * nx + ny * ny + one);
+
+        const mask axis = S::eq(r, zero);
+
+        math::simd::store_masked<S>(p.normal[0] + i, S::select(axis, zero, nx / len), act);
+        math::simd::store_masked<S>(p.normal[1] + i, S::select(axis, zero, ny / len), act);
+        math::simd::store_masked<S>(p.normal[2] + i, S::select(axis, S::neg(one), S::neg(one) / len), act);
+      }
+    };
+
+    void Conic::intersect_batch(trace::RayBatch &batch) const
+    {
+      conic_batch_s p(batch, _roc, _sh);
+
+      math::simd::process<conic_intersect_k>(p, batch.size());
+    }
+
+    void Conic::normal_batch(trace::RayBatch &batch) const
+    {
+      conic_batch_s p(batch, _roc, _sh);
+
+      math::simd::process<conic_normal_k>(p, batch.size());
+    }
+
     /*
       ellipse and hyperbola equation standard forms:
 
@@ -184,6 +308,7 @@ namespace _goptical {
 
       _sh = -c1;
       _roc = c0 / 2.0;
+      update_version();
 
       return sqrt(chisq / count); // FIXME bad rms error
     }
@@ -23,6 +23,7 @@
 */
 
 #include <cassert>
+#include <cmath>
 
 #include <gsl/gsl_fit.h>
 
@@ -133,9 +134,28 @@ namespace _goptical {
           _roc = 2.0 * c1;
         }
 
+      update_version();
+
       return sqrt(chisq / count); // FIXME bad rms error
     }
 
+    bool ConicBase::is_tabulation_useful() const
+    {
+      return false;
+    }
+
+    bool ConicBase::get_sagitta_range(double radius, math::range_t &range) const
+    {
+      // conic sagitta is monotonic along radius
+      double s = sagitta(radius);
+
+      if (!std::isfinite(s))
+        return false;
+
+      range = s < 0 ? math::range_t(s, 0.) : math::range_t(0., s);
+      return true;
+    }
+
   }
 
 }
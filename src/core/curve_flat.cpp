@@ -80,6 +80,11 @@ namespace _goptical {
       return true;
     }
 
+    void Flat::intersect_batch(trace::RayBatch &batch) const
+    {
+      intersect_batch_each(batch);
+    }
+
     void Flat::normal(math::Vector3 &normal, const math::Vector3 &point) const
     {
       normal = math::Vector3(0, 0, -1);
@@ -87,6 +92,17 @@ namespace _goptical {
 
     Flat flat;
 
+    bool Flat::is_tabulation_useful() const
+    {
+      return false;
+    }
+
+    bool Flat::get_sagitta_range(double, math::range_t &range) const
+    {
+      range = math::range_t(0., 0.);
+      return true;
+    }
+
   }
 
 }
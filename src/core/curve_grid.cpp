@@ -52,6 +52,8 @@ namespace _goptical {
             if (_data.get_interpolation() == data::BicubicDeriv)
               c.derivative(v, _data.get_d_value(x, y));
           }
+
+      update_version();
     }
 
     double Grid::sagitta(const math::Vector2 & xy) const
@@ -64,5 +66,17 @@ namespace _goptical {
       dxdy = _data.interpolate_deriv(xy);
     }
 
+    double Grid::sagitta_gradient(const math::Vector2 & xy, math::Vector2 & dxdy) const
+    {
+      dxdy = _data.interpolate_deriv(xy);
+
+      return _data.interpolate(xy);
+    }
+
+    bool Grid::is_tabulation_useful() const
+    {
+      return false;
+    }
+
   }
 }
@@ -93,6 +93,11 @@ namespace _goptical {
       return true;
     }
 
+    void Parabola::intersect_batch(trace::RayBatch &batch) const
+    {
+      intersect_batch_each(batch);
+    }
+
   }
 
 }
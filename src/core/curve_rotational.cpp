@@ -66,6 +66,27 @@ namespace _goptical {
       dxdy = xy * (p / r);
     }
 
+    double Rotational::sagitta_gradient(double r, double &dzdr) const
+    {
+      dzdr = derivative(r);
+
+      return sagitta(r);
+    }
+
+    double Rotational::sagitta_gradient(const math::Vector2 & xy, math::Vector2 & dxdy) const
+    {
+      const double r = xy.len();
+      double p;
+      double z = sagitta_gradient(r, p);
+
+      if (r == 0)
+        dxdy.x() = dxdy.y() = 0.0;
+      else
+        dxdy = xy * (p / r);
+
+      return z;
+    }
+
     double Rotational::gsl_func_sagitta(double x, void *params)
     {
       Rotational *c = static_cast<Rotational *>(params);
@@ -28,6 +28,8 @@
 #include <goptical/core/math/VectorPair>
 #include <goptical/core/math/VectorPair>
 
+#include "math_simd_.hxx"
+
 namespace _goptical {
 
   namespace curve {
@@ -124,6 +126,117 @@ namespace _goptical {
         normal = -normal;
     }
 
+    struct sphere_batch_s : public math::simd::BatchArrays
+    {
+      sphere_batch_s(trace::RayBatch &batch, double roc)
+        : BatchArrays(batch), roc(roc)
+      {
+      }
+
+      double roc;
+    };
+
+    /* same as Sphere::intersect for S::width rays */
+    template <class S>
+    struct sphere_intersect_k
+    {
+      static inline void process(sphere_batch_s &a, size_t i)
+      {
+        typedef typename S::vec vec;
+        typedef typename S::mask mask;
+
+        unsigned int act = math::simd::active_bits<S>(a.active + i);
+
+        if (!act)
+          return;
+
+        const vec zero = S::set(0.0);
+        const vec two = S::set(2.0);
+        const vec roc = S::set(a.roc);
+
+        const vec ax = S::load(a.origin[0] + i);
+        const vec ay = S::load(a.origin[1] + i);
+        const vec az = S::load(a.origin[2] + i);
+        const vec bx = S::load(a.direction[0] + i);
+        const vec by = S::load(a.direction[1] + i);
+        const vec bz = S::load(a.direction[2] + i);
+
+        const vec d = az - roc;
+        const vec ay_by = ay * by;
+        const vec ax_bx = ax * bx;
+        const vec ay_bx = ay * bx;
+        const vec ax_by = ax * by;
+
+        vec s =
+          + roc * roc
+          + two * (ax_bx + ay_by) * bz * d
+          + two * ax_bx * ay_by
+          - ay_bx * ay_bx
+          - ax_by * ax_by
+          - (bx * bx + by * by) * (d * d)
+          - (ax * ax + ay * ay) * (bz * bz)
+          ;
+
+        mask hit = S::nlt(s, zero);
+
+        s = S::sqrt(s);
+        s = S::select(S::gt(roc * bz, zero), S::neg(s), s);
+
+        const vec t = (s - (bz * d + ax_bx + ay_by));
+
+        hit = S::mask_and(hit, S::nle(t, zero));
+
+        unsigned int h = act & S::bits(hit);
+
+        math::simd::store_masked<S>(a.point[0] + i, ax + bx * t, h);
+        math::simd::store_masked<S>(a.point[1] + i, ay + by * t, h);
+        math::simd::store_masked<S>(a.point[2] + i, az + bz * t, h);
+        math::simd::disable<S>(a.active + i, act & ~h);
+      }
+    };
+
+    /* same as Sphere::normal for S::width rays */
+    template <class S>
+    struct sphere_normal_k
+    {
+      static inline void process(sphere_batch_s &a, size_t i)
+      {
+        typedef typename S::vec vec;
+
+        unsigned int act = math::simd::active_bits<S>(a.active + i);
+
+        if (!act)
+          return;
+
+        const vec x = S::load(a.point[0] + i);
+        const vec y = S::load(a.point[1] + i);
+        const vec z = S::load(a.point[2] + i) - S::set(a.roc);
+
+        vec len = S::sqrt(x * x + y * y + z * z);
+
+        if (a.roc < 0)
+          len = S::neg(len);
+
+        math::simd::store_masked<S>(a.normal[0] + i, x / len, act);
+        math::simd::store_masked<S>(a.normal[1] + i, y / len, act);
+        math::simd::store_masked<S>(a.normal[2] + i, z / len, act);
+      }
+    };
+
+    void Sphere::intersect_batch(trace::RayBatch &batch) const
+    {
+      sphere_batch_s a(batch, _roc);
+
+      math::simd::process<sphere_intersect_k>(a, batch.size());
+    }
+
+    void Sphere::normal_batch(trace::RayBatch &batch) const
+    {
+      sphere_batch_s a(batch, _roc);
+
+      math::simd::process<sphere_normal_k>(a, batch.size());
+    }
+
   }
 
 }
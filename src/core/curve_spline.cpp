@@ -45,6 +45,13 @@ namespace _goptical {
 
       for (double x = 0; x < radius + step / 2; x += step)
         _data.add_data(x, c.sagitta(x));
+
+      update_version();
+    }
+
+    bool Spline::is_tabulation_useful() const
+    {
+      return false;
     }
 
   }
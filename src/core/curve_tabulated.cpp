@@ -0,0 +1,220 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include <goptical/core/curve/Tabulated>
+#include <goptical/core/data/Grid>
+#include <goptical/core/Error>
+
+#include "thread_ranges_.hxx"
+
+namespace _goptical {
+
+  namespace curve {
+
+    Tabulated::Tabulated(const const_ref<Base> &curve, double radius, double tolerance,
+                         unsigned int threads, unsigned int max_n)
+      : _curve(curve),
+        _grid(),
+        _radius(radius),
+        _tolerance(tolerance),
+        _n(0),
+        _step(0),
+        _exact(),
+        _exact_count(0)
+    {
+      double last_mean = std::numeric_limits<double>::infinity();
+      double ratio = 1.0;
+      std::vector<double> err;
+
+      // update lazily computed curve data before concurrent use
+      _curve->sagitta(math::vector2_0);
+
+      for (unsigned int n = 17; n <= max_n; n = n * 2 - 1)
+        {
+          _grid = ref<Grid>::create(n, radius);
+          _grid->get_data().set_interpolation(data::BicubicDeriv);
+          _n = n - 1;
+          _step = 2.0 * radius / (double)_n;
+
+          sample(err, threads);
+
+          unsigned int count = 0, failed = 0;
+          double sum = 0;
+
+          // cells outside circle are not checked
+          _exact.resize(_n * _n);
+          for (unsigned int i = 0; i < err.size(); i++)
+            _exact[i] = err[i] < 0;
+
+          for (unsigned int j = 0; j < _n; j++)
+            for (unsigned int i = 0; i < _n; i++)
+              {
+                double e = err[i + j * _n];
+
+                if (e < 0)
+                  continue;
+
+                count++;
+
+                if (e < std::numeric_limits<double>::infinity())
+                  sum += e;
+
+                if (e <= tolerance)
+                  continue;
+
+                failed++;
+
+                // interpolation of neighbor cells uses cross
+                // derivatives estimated from this cell nodes
+                for (unsigned int y = std::max(j, 1u) - 1; y <= std::min(j + 1, _n - 1); y++)
+                  for (unsigned int x = std::max(i, 1u) - 1; x <= std::min(i + 1, _n - 1); x++)
+                    _exact[x + y * _n] = true;
+              }
+
+          _exact_count = std::count(_exact.begin(), _exact.end(), true);
+          ratio = (double)failed / (double)count;
+
+          // bicubic interpolation error decreases with step size
+          // unless the curve is not smooth, in which case the
+          // original curve is used on failed cells
+          double mean = sum / (double)count;
+
+          if (!failed || ratio < 0.02 || !(mean < last_mean / 1.5))
+            break;
+
+          last_mean = mean;
+        }
+
+      if (!(ratio <= 0.5))
+        throw Error("curve can not be tabulated with requested tolerance");
+    }
+
+    Tabulated::~Tabulated()
+    {
+    }
+
+    void Tabulated::sample(std::vector<double> &err, unsigned int threads)
+    {
+      data::Grid &data = _grid->get_data();
+      const unsigned int n = _n + 1;
+
+      // curve is sampled in temporary arrays, data set
+      // is not safe for concurrent update
+      std::vector<double> y(n * n);
+      std::vector<math::Vector2> d(n * n);
+
+      run_ranges(n, threads, [&](unsigned int, unsigned int first, unsigned int last)
+        {
+          for (unsigned int j = first; j < last; j++)
+            for (unsigned int i = 0; i < n; i++)
+              y[i + j * n] = _curve->sagitta_gradient(data.get_x_value_i(i, j), d[i + j * n]);
+        });
+
+      for (unsigned int j = 0; j < n; j++)
+        for (unsigned int i = 0; i < n; i++)
+          {
+            data.get_y_value(i, j) = y[i + j * n];
+            data.get_d_value(i, j) = d[i + j * n];
+          }
+
+      // update interpolation data before concurrent use
+      _grid->sagitta(math::vector2_0);
+
+      // interpolation error of cells which intersect the circle is
+      // measured at cell center and edges middle points
+      const double h = _step / 2.0;
+      const double r = _radius + h * M_SQRT2;
+
+      err.assign(_n * _n, -1.0);
+
+      run_ranges(_n, threads, [&](unsigned int, unsigned int first, unsigned int last)
+        {
+          for (unsigned int j = first; j < last; j++)
+            for (unsigned int i = 0; i < _n; i++)
+              {
+                const math::Vector2 p = data.get_x_value_i(i, j);
+                const math::Vector2 s[5] = {
+                  math::Vector2(p.x() + h, p.y() + h),
+                  math::Vector2(p.x() + h, p.y()),
+                  math::Vector2(p.x(), p.y() + h),
+                  math::Vector2(p.x() + h, p.y() + _step),
+                  math::Vector2(p.x() + _step, p.y() + h),
+                };
+
+                if (s[0].len() > r)
+                  continue;
+
+                double e = 0;
+
+                for (auto &v : s)
+                  {
+                    double de = fabs(_grid->sagitta(v) - _curve->sagitta(v));
+
+                    if (!(de <= e))
+                      e = std::isnan(de) ? std::numeric_limits<double>::infinity() : de;
+                  }
+
+                err[i + j * _n] = e;
+              }
+        });
+    }
+
+    double Tabulated::sagitta(const math::Vector2 & xy) const
+    {
+      if (use_curve(xy))
+        return _curve->sagitta(xy);
+
+      return _grid->sagitta(xy);
+    }
+
+    void Tabulated::derivative(const math::Vector2 & xy, math::Vector2 & dxdy) const
+    {
+      if (use_curve(xy))
+        _curve->derivative(xy, dxdy);
+      else
+        _grid->derivative(xy, dxdy);
+    }
+
+    double Tabulated::sagitta_gradient(const math::Vector2 & xy, math::Vector2 & dxdy) const
+    {
+      if (use_curve(xy))
+        return _curve->sagitta_gradient(xy, dxdy);
+
+      return _grid->sagitta_gradient(xy, dxdy);
+    }
+
+    bool Tabulated::is_tabulation_useful() const
+    {
+      return false;
+    }
+
+  }
+
+}
+
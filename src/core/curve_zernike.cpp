@@ -22,12 +22,20 @@
 
 */
 
-#include <gsl/gsl_multifit.h>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <algorithm>
 
 #include <goptical/core/math/Vector>
 #include <goptical/core/curve/Zernike>
 #include <goptical/core/trace/Distribution>
 #include <goptical/core/shape/Disk>
+#include <goptical/core/trace/RayBatch>
+#include <goptical/core/data/Grid>
+#include <goptical/core/Error>
+
+#include "thread_ranges_.hxx"
 
 namespace _goptical {
 
@@ -35,772 +43,916 @@ namespace _goptical {
 
     const trace::Distribution Zernike::default_dist(trace::HexaPolarDist, 10);
 
-    struct zp_precalc_s
-    {
-      double x, x2;
-      double y, y2;
-      double r;
-
-      inline zp_precalc_s(double x_, double y_)
-        : x(x_),
-          x2(x_ * x_),
-          y(y_),
-          y2(y_ * y_),
-          r(x2 + y2)
-      {
-      }
-    };
-
-    typedef double (zp_t)(const struct zp_precalc_s &p);
-    typedef void (zp_d_t)(const struct zp_precalc_s &p, math::Vector2 & dxdy);
-
-    // Zernike polynomial 0
+    // Kintner recurrence on radial polynomials of azimuthal
+    // frequency m, written for Q = R / rho^m and t = rho^2:
+    //   Q[k] = (a * t + b) * Q[k-1] + c * Q[k-2]
+    // with n = m + 2k. Q[0] = 1 and Q[1] = (m + 2) * t - (m + 1).
 
-    static double zp_0(const struct zp_precalc_s &p)
+    static void radial_rec(unsigned int m, unsigned int k, double r[3])
     {
-      return 1;
-    }
+      if (k == 1)
+        {
+          r[0] = m + 2;
+          r[1] = -(double)(m + 1);
+          r[2] = 0;
+          return;
+        }
 
-    // Zernike polynomial 1
+      double n = m + 2 * k;
+      double k1 = (n + m) * (n - m) * (n - 2) / 2;
+      double k2 = 2 * n * (n - 1) * (n - 2);
+      double k3 = -(double)m * m * (n - 1) - n * (n - 1) * (n - 2);
+      double k4 = -n * (n + m - 2) * (n - m - 2) / 2;
 
-    static double zp_1(const struct zp_precalc_s &p)
-    {
-      return p.x;
+      r[0] = k2 / k1;
+      r[1] = k3 / k1;
+      r[2] = k4 / k1;
     }
 
-    static void zp_1_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
+    // enumerate terms radial order and signed azimuthal frequency
+    template <typename F>
+    static void enum_terms(Zernike::Ordering o, unsigned int max_order, const F &f)
     {
-      dxdy.x() = 1.0;
-      dxdy.y() = 0.0;
-    }
+      switch (o)
+        {
+        case Zernike::Fringe:
+          for (unsigned int g = 0; 2 * g <= max_order; g++)
+            for (int m = g; m >= 0; m--)
+              {
+                f(2 * g - m, m);
+                if (m)
+                  f(2 * g - m, -m);
+              }
+          break;
 
-    // Zernike polynomial 2
+        case Zernike::Noll:
+          for (unsigned int n = 0; n <= max_order; n++)
+            {
+              unsigned int j = n * (n + 1) / 2 + 1;
+
+              for (unsigned int m = n % 2; m <= n; m += 2)
+                {
+                  if (!m)
+                    {
+                      f(n, 0);
+                      j++;
+                      continue;
+                    }
+
+                  // cosine terms have even index
+                  f(n, j % 2 ? -(int)m : m);
+                  f(n, j % 2 ? m : -(int)m);
+                  j += 2;
+                }
+            }
+          break;
 
-    static double zp_2(const struct zp_precalc_s &p)
-    {
-      return p.y;
+        case Zernike::Ansi:
+          for (unsigned int n = 0; n <= max_order; n++)
+            for (int m = -(int)n; m <= (int)n; m += 2)
+              f(n, m);
+          break;
+        }
     }
 
-    static void zp_2_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
+    // radial polynomial and derivative with respect to rho^2
+    static double radial_poly(unsigned int n, unsigned int m, double t, double &dq)
     {
-      dxdy.x() = 0.0;
-      dxdy.y() = 1.0;
-    }
+      double q = 1, qm = 0, d = 0, dm = 0;
 
-    // Zernike polynomial 3
+      for (unsigned int k = 1; k <= (n - m) / 2; k++)
+        {
+          double r[3];
 
-    static double zp_3(const struct zp_precalc_s &p)
-    {
-      return -1.0 + 2.0 * p.r;
-    }
+          radial_rec(m, k, r);
 
-    static void zp_3_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
-    {
-      dxdy.x() = 4.0 * p.x;
-      dxdy.y() = 4.0 * p.y;
-    }
+          double a = r[0] * t + r[1];
+          double qn = a * q + r[2] * qm;
+          double dn = r[0] * q + a * d + r[2] * dm;
 
-    // Zernike polynomial 4
+          qm = q;
+          q = qn;
+          dm = d;
+          d = dn;
+        }
 
-    static double zp_4(const struct zp_precalc_s &p)
-    {
-      return p.x2 - p.y2;
+      dq = d;
+      return q;
     }
 
-    static void zp_4_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
+    // evaluate term with radial order n and signed azimuthal frequency m
+    static double term_poly(unsigned int n, int m, const math::Vector2 & xy,
+                            math::Vector2 *dxdy)
     {
-      dxdy.x() = 2.0 * p.x;
-      dxdy.y() = -2.0 * p.y;
-    }
+      unsigned int am = abs(m);
+      double x = xy.x(), y = xy.y();
+      double wr = 1, wi = 0, pr = 0, pi = 0;
 
-    // Zernike polynomial 5
+      // w = (x + iy)^m and p = (x + iy)^(m-1)
+      for (unsigned int i = 0; i < am; i++)
+        {
+          pr = wr;
+          pi = wi;
+          wr = pr * x - pi * y;
+          wi = pr * y + pi * x;
+        }
 
-    static double zp_5(const struct zp_precalc_s &p)
-    {
-      return 2.0 * p.x * p.y;
-    }
+      double dq;
+      double q = radial_poly(n, am, x * x + y * y, dq);
 
-    static void zp_5_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
-    {
-      dxdy.x() = 2.0 * p.y;
-      dxdy.y() = 2.0 * p.x;
+      if (m < 0)
+        {
+          if (dxdy)
+            *dxdy = math::Vector2(2 * x * dq * wi + am * q * pi,
+                                  2 * y * dq * wi + am * q * pr);
+          return q * wi;
+        }
+      else
+        {
+          if (dxdy)
+            *dxdy = math::Vector2(2 * x * dq * wr + am * q * pr,
+                                  2 * y * dq * wr - am * q * pi);
+          return q * wr;
+        }
     }
 
-    // Zernike polynomial 6
-
-    static double zp_6(const struct zp_precalc_s &p)
+    static double term_norm(Zernike::Ordering o, unsigned int n, int m)
     {
-      return p.x * (-2.0 + 3.0 * p.r);
-    }
+      if (o == Zernike::Fringe)
+        return 1.0;
 
-    static void zp_6_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
-    {
-      dxdy.x() = 3.0 * p.r + 6.0 * p.x2 - 2.0;
-      dxdy.y() = 6.0 * p.x * p.y;
+      return sqrt(m ? 2.0 * (n + 1) : n + 1);
     }
 
-    // Zernike polynomial 7
-
-    static double zp_7(const struct zp_precalc_s &p)
+    Zernike::Zernike(double radius, double unit_scale)
+      : _ordering(Fringe),
+        _scale(unit_scale),
+        _threshold(1e-10),
+        _radius(radius)
     {
-      return p.y * (-2.0 + 3.0 * p.r);
+      init_terms(10);
     }
 
-    static void zp_7_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
+    Zernike::Zernike(double radius, double coefs[],
+                     unsigned int coefs_count, double unit_scale)
+      : _ordering(Fringe),
+        _scale(unit_scale),
+        _threshold(1e-10),
+        _radius(radius)
     {
-      dxdy.x() = 6.0 * p.x * p.y;
-      dxdy.y() = 3.0 * p.r + 6.0 * p.y2 - 2.0;
-    }
+      init_terms(10);
 
-    // Zernike polynomial 8
+      for (unsigned int i = 0; i < coefs_count && i < _coeff.size(); i++)
+        _coeff[i] = coefs[i];
 
-    static double zp_8(const struct zp_precalc_s &p)
-    {
-      return 1.0 + 6.0 * p.r * (- 1.0 + p.r);
+      update_threshold_state();
     }
 
-    static void zp_8_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
+    Zernike::Zernike(double radius, Ordering ordering, unsigned int max_order,
+                     double unit_scale)
+      : _ordering(ordering),
+        _scale(unit_scale),
+        _threshold(1e-10),
+        _radius(radius)
     {
-      double a = 12.0 * (2 * p.r - 1.0);
-
-      dxdy.x() = p.x * a;
-      dxdy.y() = p.y * a;
+      init_terms(max_order);
     }
 
-    // Zernike polynomial 9
-
-    static double zp_9(const struct zp_precalc_s &p)
+    void Zernike::init_terms(unsigned int max_order)
     {
-      return p.x * (p.x2 - 3.0 * p.y2);
-    }
+      _max_order = max_order;
 
-    static void zp_9_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
-    {
-      dxdy.x() = 3.0 * (p.x2 - p.y2);
-      dxdy.y() = -6.0 * p.x * p.y;
-    }
+      enum_terms(_ordering, max_order, [&](unsigned int n, int m)
+        {
+          struct term_s t = { n, m };
+          _terms.push_back(t);
+        });
 
-    // Zernike polynomial 10
+      _coeff.assign(_terms.size(), 0.0);
+      _enabled.assign(_terms.size(), false);
 
-    static double zp_10(const struct zp_precalc_s &p)
-    {
-      return -p.y * (p.y2 - 3.0 * p.x2);
-    }
+      _offset.resize(max_order + 1);
+      _kmax.resize(max_order + 1);
 
-    static void zp_10_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
-    {
-      dxdy.x() = 6.0 * p.x * p.y;
-      dxdy.y() = 3.0 * (p.x2 - p.y2);
-    }
+      unsigned int size = 0;
 
-    // Zernike polynomial 11
+      for (unsigned int m = 0; m <= max_order; m++)
+        {
+          _offset[m] = size;
+          size += (max_order - m) / 2 + 1;
+        }
 
-    static double zp_11(const struct zp_precalc_s &p)
-    {
-      return (p.y2 - p.x2) * (3.0 + (-4.0 * p.r));
-    }
+      for (auto &r : _rec)
+        r.resize(size);
 
-    static void zp_11_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
-    {
-      dxdy.x() = p.x * (16.0 * p.x2 - 6.0);
-      dxdy.y() = p.y * (-16.0 * p.y2 + 6.0);
-    }
+      for (unsigned int m = 0; m <= max_order; m++)
+        for (unsigned int k = 1; m + 2 * k <= max_order; k++)
+          {
+            double r[3];
 
-    // Zernike polynomial 12
+            radial_rec(m, k, r);
 
-    static double zp_12(const struct zp_precalc_s &p)
-    {
-      return p.x * p.y * (-6.0 + 8.0 * p.r);
-    }
+            for (unsigned int i = 0; i < 3; i++)
+              _rec[i][_offset[m] + k] = r[i];
+          }
 
-    static void zp_12_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
-    {
-      dxdy.x() = p.y * (8.0 * p.y2 + 24.0 * p.x2 - 6.0);
-      dxdy.y() = p.x * (8.0 * p.x2 + 24.0 * p.y2 - 6.0);
-    }
+      _icos.assign(size, -1);
+      _isin.assign(size, -1);
 
-    // Zernike polynomial 13
+      for (unsigned int i = 0; i < _terms.size(); i++)
+        {
+          const term_s &t = _terms[i];
+          unsigned int j = _offset[abs(t._m)] + (t._n - abs(t._m)) / 2;
 
-    static double zp_13(const struct zp_precalc_s &p)
-    {
-      return p.x * (3.0 - p.r * (12.0 - 10.0 * p.r));
+          if (t._m < 0)
+            _isin[j] = i;
+          else
+            _icos[j] = i;
+        }
+
+      update_tables();
     }
 
-    static void zp_13_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
+    void Zernike::update_tables()
     {
-      double a = (12.0 - 10.0 * p.r);
-
-      dxdy.x() = p.x2 * (20.0 * p.r - 2.0 * a) - a * p.r + 3.0;
-      dxdy.y() = 8.0 * p.x * p.y * (5.0 * p.r - 3.0); 
-    }
+      _ccos.assign(_icos.size(), 0.0);
+      _csin.assign(_isin.size(), 0.0);
 
-    // Zernike polynomial 14
+      for (unsigned int m = 0; m <= _max_order; m++)
+        {
+          _kmax[m] = -1;
 
-    static double zp_14(const struct zp_precalc_s &p)
-    {
-      return p.y * (3.0 - p.r * (12.0 - 10.0 * p.r));
+          for (unsigned int k = 0; m + 2 * k <= _max_order; k++)
+            {
+              unsigned int j = _offset[m] + k;
+              int ic = _icos[j], is = _isin[j];
+
+              if (ic >= 0 && _enabled[ic])
+                {
+                  _ccos[j] = _coeff[ic] * term_norm(_ordering, m + 2 * k, m);
+                  _kmax[m] = k;
+                }
+
+              if (is >= 0 && _enabled[is])
+                {
+                  _csin[j] = _coeff[is] * term_norm(_ordering, m + 2 * k, -(int)m);
+                  _kmax[m] = k;
+                }
+            }
+        }
+      update_version();
     }
 
-    static void zp_14_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
+    void Zernike::get_term_order(unsigned int n, unsigned int &radial, int &azimuthal) const
     {
-      double a = (12.0 - 10.0 * p.r);
-
-      dxdy.x() = 8.0 * p.x * p.y * (5.0 * p.r - 3.0); 
-      dxdy.y() = p.y2 * (20.0 * p.r - 2.0 * a) - a * p.r + 3.0;
-    }
+      n -= get_first_term();
 
-    // Zernike polynomial 15
+      if (n >= _terms.size())
+        throw Error("zernike term index out of range");
 
-    static double zp_15(const struct zp_precalc_s &p)
-    {
-      return -1.0 + p.r * (12 - p.r * (30.0 - 20.0 * p.r));
+      radial = _terms[n]._n;
+      azimuthal = _terms[n]._m;
     }
 
-    static void zp_15_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
+    unsigned int Zernike::get_term_index(unsigned int radial, int azimuthal) const
     {
-      double a = 24.0 * (5.0 * p.r * (p.r - 1.0) + 1.0);
+      for (unsigned int i = 0; i < _terms.size(); i++)
+        if (_terms[i]._n == radial && _terms[i]._m == azimuthal)
+          return i + get_first_term();
 
-      dxdy.x() = a * p.x;
-      dxdy.y() = a * p.y;
+      throw Error("no such zernike term");
     }
 
-    // Zernike polynomial 16
-
-    static double zp_16(const struct zp_precalc_s &p)
+    void Zernike::eval_block(unsigned int count, const double x[], const double y[],
+                             double z[], double dzdx[], double dzdy[]) const
     {
-      return p.x2*p.x2 + p.y2 * (p.y2 - 6.0 * p.x2);
-    }    
+      // w = (x + iy)^m, p = (x + iy)^(m-1)
+      double wr[block_size], wi[block_size], pr[block_size], pi[block_size];
+      // radial polynomials Q[k], Q[k-1] and derivatives
+      double q[block_size], qm[block_size], d[block_size], dm[block_size];
+      // cosine and sine terms sums and derivatives
+      double a[block_size], b[block_size], da[block_size], db[block_size];
+      double t[block_size];
 
-    static void zp_16_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
-    {
-      dxdy.x() = -4.0 * p.x * (3.0 * p.y2 - p.x2);
-      dxdy.y() = 4.0 * p.y * (p.y2 - 3.0 * p.x2);
-    }
+      assert(count <= block_size);
 
-    // Zernike polynomial 17
+      for (unsigned int i = 0; i < count; i++)
+        {
+          t[i] = x[i] * x[i] + y[i] * y[i];
+          wr[i] = 1;
+          wi[i] = 0;
+          pr[i] = pi[i] = 0;
+          z[i] = dzdx[i] = dzdy[i] = 0;
+        }
 
-    static double zp_17(const struct zp_precalc_s &p)
-    {
-      return 4.0 * p.x * p.y * (p.x2 - p.y2);
-    }
+      for (unsigned int m = 0; m <= _max_order; m++)
+        {
+          if (m)
+            for (unsigned int i = 0; i < count; i++)
+              {
+                pr[i] = wr[i];
+                pi[i] = wi[i];
+                wr[i] = pr[i] * x[i] - pi[i] * y[i];
+                wi[i] = pr[i] * y[i] + pi[i] * x[i];
+              }
 
-    static void zp_17_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
-    {
-      dxdy.x() = -4.0 * p.y * (p.y2 - 3.0 * p.x2);
-      dxdy.y() = -4.0 * p.x * (3.0 * p.y2 - p.x2);
-    }
+          int kmax = _kmax[m];
 
-    // Zernike polynomial 18
+          if (kmax < 0)
+            continue;
 
-    static double zp_18(const struct zp_precalc_s &p)
-    {
-      return p.x * (- 4.0 + 5.0 * p.r) * (p.x2 - 3.0 * p.y2);
-    }
+          const unsigned int o = _offset[m];
 
-    static void zp_18_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
-    {
-      double a = (5.0 * p.r - 4.0);
-      double b = (p.x2 - 3.0 * p.y2);
+          for (unsigned int i = 0; i < count; i++)
+            {
+              q[i] = 1;
+              qm[i] = d[i] = dm[i] = 0;
+              a[i] = _ccos[o];
+              b[i] = _csin[o];
+              da[i] = db[i] = 0;
+            }
 
-      dxdy.x() = b * (10.0 * p.x2 + a) + 2.0 * a * p.x2;
-      dxdy.y() = p.x * p.y * (10.0 * b - 6.0 * a);
-    }
+          for (int k = 1; k <= kmax; k++)
+            {
+              const double r0 = _rec[0][o + k];
+              const double r1 = _rec[1][o + k];
+              const double r2 = _rec[2][o + k];
+              const double cc = _ccos[o + k];
+              const double cs = _csin[o + k];
+
+              for (unsigned int i = 0; i < count; i++)
+                {
+                  double e = r0 * t[i] + r1;
+                  double qn = e * q[i] + r2 * qm[i];
+                  double dn = r0 * q[i] + e * d[i] + r2 * dm[i];
+
+                  qm[i] = q[i];
+                  q[i] = qn;
+                  dm[i] = d[i];
+                  d[i] = dn;
+
+                  a[i] += cc * qn;
+                  b[i] += cs * qn;
+                  da[i] += cc * dn;
+                  db[i] += cs * dn;
+                }
+            }
 
-    // Zernike polynomial 19
+          for (unsigned int i = 0; i < count; i++)
+            {
+              double r = 2 * (da[i] * wr[i] + db[i] * wi[i]);
 
-    static double zp_19(const struct zp_precalc_s &p)
-    {
-      return p.y * (- 4.0 + 5.0 * p.r) * (3.0 * p.x2 - p.y2);
+              z[i] += a[i] * wr[i] + b[i] * wi[i];
+              dzdx[i] += x[i] * r + m * (a[i] * pr[i] + b[i] * pi[i]);
+              dzdy[i] += y[i] * r + m * (b[i] * pr[i] - a[i] * pi[i]);
+            }
+        }
     }
 
-    static void zp_19_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
+    void Zernike::sagitta_gradient_batch(unsigned int count, const double x[], const double y[],
+                                         double z[], double dzdx[], double dzdy[]) const
     {
-      double a = (3.0 * p.x2 - p.y2);
-      double b = (5.0 * p.r - 4.0);
+      double nx[block_size], ny[block_size];
 
-      dxdy.x() = p.x * p.y * (10.0 * a + 6.0 * b);
-      dxdy.y() = p.y2 * (-2.0 * b + 10.0 * a) + a * b;
-    }
+      for (unsigned int j = 0; j < count; j += block_size)
+        {
+          unsigned int c = std::min(count - j, block_size);
+
+          for (unsigned int i = 0; i < c; i++)
+            {
+              nx[i] = x[j + i] / _radius;
+              ny[i] = y[j + i] / _radius;
+            }
 
-    // Zernike polynomial 20
+          eval_block(c, nx, ny, z + j, dzdx + j, dzdy + j);
 
-    static double zp_20(const struct zp_precalc_s &p)
-    {
-      return (p.x2 - p.y2) * (6.0 - p.r * (20.0 - 15.0 * p.r));
+          for (unsigned int i = 0; i < c; i++)
+            {
+              // curve is flat outside zernike circle
+              if (nx[i] * nx[i] + ny[i] * ny[i] > 1.0)
+                {
+                  z[j + i] = dzdx[j + i] = dzdy[j + i] = 0;
+                  continue;
+                }
+
+              z[j + i] *= _scale;
+              dzdx[j + i] *= _scale / _radius;
+              dzdy[j + i] *= _scale / _radius;
+            }
+        }
     }
 
-    static void zp_20_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
+    double Zernike::sagitta(const math::Vector2 & xy) const
     {
-      double a = 20.0 - 15.0 * p.r;
-      double b = (30.0 * p.r - 2.0 * a) * (p.x2 - p.y2);
-      double c = 2.0 * (6.0 - a * p.r);
+      math::Vector2 d;
 
-      dxdy.x() = p.x * (b + c);
-      dxdy.y() = p.y * (b - c);
+      return sagitta_gradient(xy, d);
     }
 
-    // Zernike polynomial 21
-
-    static double zp_21(const struct zp_precalc_s &p)
+    void Zernike::derivative(const math::Vector2 & xy, math::Vector2 & dxdy) const
     {
-      return p.x * p.y * (12.0 - p.r * (40.0 - 30.0 * p.r));
+      sagitta_gradient(xy, dxdy);
     }
 
-    static void zp_21_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
+    double Zernike::sagitta_gradient(const math::Vector2 & xy, math::Vector2 & dxdy) const
     {
-      double a = (40.0 - 30.0 * p.r);
-      double b = (60.0 * p.r - 2.0 * a);
-      double c = (12.0 - a * p.r);
+      double x = xy.x(), y = xy.y(), z;
 
-      dxdy.x() = p.y * (p.x2 * b + c);
-      dxdy.y() = p.x * (p.y2 * b + c);
-    }
-
-    // Zernike polynomial 22
+      sagitta_gradient_batch(1, &x, &y, &z, &dxdy.x(), &dxdy.y());
 
-    static double zp_22(const struct zp_precalc_s &p)
-    {
-      return p.x * (-4.0 + p.r * (30.0 - p.r * (60.0 - 35.0 * p.r)));
+      return z;
     }
 
-    static void zp_22_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
+    void Zernike::intersect_batch(trace::RayBatch &batch) const
     {
-      double a = 60.0 - 35.0 * p.r;
-      double b = 30.0 - a * p.r;
-      double c = (70.0 * p.r - 2.0 * a);
-      double e = (p.r * c + 2.0 * b);
+      // same iterations as Base::intersect_newton, performed for
+      // blocks of rays so that the curve is evaluated in batch
+      unsigned int idx[block_size];
+      double x[block_size], y[block_size], z[block_size], gx[block_size], gy[block_size];
+      double t[block_size], t_last[block_size], f_last[block_size], step[block_size];
+      bool found[block_size];
+      unsigned int iterations = 0;
+      unsigned int i = 0;
 
-      dxdy.x() = p.x2      * e + b * p.r - 4.0;
-      dxdy.y() = p.x * p.y * e;
-    }
+      const double *o[3], *d[3];
 
-    // Zernike polynomial 23
+      for (unsigned int j = 0; j < 3; j++)
+        {
+          o[j] = batch.get_origin_array(j);
+          d[j] = batch.get_direction_array(j);
+        }
 
-    static double zp_23(const struct zp_precalc_s &p)
-    {
-      return p.y * (-4.0 + p.r * (30.0 - p.r * (60.0 - 35.0 * p.r)));
-    }
+      while (i < batch.size())
+        {
+          unsigned int count = 0;
 
-    static void zp_23_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
-    {
-      double a = 60.0 - 35.0 * p.r;
-      double b = 30.0 - a * p.r;
-      double c = (70.0 * p.r - 2.0 * a);
-      double e = (p.r * c + 2.0 * b);
+          // load a block of active rays
+          for (; i < batch.size() && count < block_size; i++)
+            {
+              if (!batch.is_active(i))
+                continue;
+
+              if (d[2][i] == 0 || (t[count] = -o[2][i] / d[2][i]) < 0)
+                {
+                  batch.set_active(i, false);
+                  continue;
+                }
+
+              t_last[count] = t[count];
+              f_last[count] = std::numeric_limits<double>::infinity();
+              step[count] = 0;
+              found[count] = false;
+              idx[count++] = i;
+            }
 
-      dxdy.x() = p.x * p.y * e;
-      dxdy.y() = p.y2      * e + b * p.r - 4.0;
-    }
+          // pending rays are moved to front of block
+          unsigned int pending = count;
+          unsigned int slot[block_size];
 
-    // Zernike polynomial 24
+          for (unsigned int j = 0; j < count; j++)
+            slot[j] = j;
 
-    static double zp_24(const struct zp_precalc_s &p)
-    {
-      return 1.0 - p.r * (20.0 + p.r * (-90.0 - p.r * (-140.0 + 70.0 * p.r)));
-    }
+          for (unsigned int n = 32; n-- && pending; )
+            {
+              for (unsigned int j = 0; j < pending; j++)
+                {
+                  unsigned int s = slot[j], r = idx[s];
+
+                  x[j] = o[0][r] + d[0][r] * t[s];
+                  y[j] = o[1][r] + d[1][r] * t[s];
+                }
+
+              sagitta_gradient_batch(pending, x, y, z, gx, gy);
+              iterations += pending;
+
+              unsigned int next = 0;
+
+              for (unsigned int j = 0; j < pending; j++)
+                {
+                  unsigned int s = slot[j], r = idx[s];
+                  double f = o[2][r] + d[2][r] * t[s] - z[j];
+
+                  // step went too far, retry with half step
+                  if (!std::isfinite(f) || !std::isfinite(gx[j]) || !std::isfinite(gy[j]) ||
+                      fabs(f) > fabs(f_last[s]))
+                    {
+                      step[s] /= 2.0;
+                      t[s] = t_last[s] + step[s];
+                      slot[next++] = s;
+                      continue;
+                    }
+
+                  // project ray point on curve
+                  batch.set_point(r, math::Vector3(x[j], y[j], z[j]));
+                  found[s] = true;
+
+                  // stop if close enough
+                  if (fabs(f) < 1e-10)
+                    continue;
+
+                  double df = d[2][r] - gx[j] * d[0][r] - gy[j] * d[1][r];
+
+                  if (df == 0)
+                    continue;
+
+                  step[s] = -f / df;
+                  t_last[s] = t[s];
+                  f_last[s] = f;
+                  t[s] += step[s];
+
+                  if (t[s] < 0)
+                    {
+                      found[s] = false;
+                      continue;
+                    }
+
+                  slot[next++] = s;
+                }
+
+              pending = next;
+            }
 
-    static void zp_24_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
-    {
-      double a = 70.0 * p.r - 140.0;
-      double b = (p.r * ((140.0 * p.r + 6.0 * a) * p.r + 360.0) - 40.f); 
+          for (unsigned int j = 0; j < count; j++)
+            if (!found[j])
+              batch.set_active(idx[j], false);
+        }
 
-      dxdy.x() = p.x * b;
-      dxdy.y() = p.y * b;
+      batch.add_iterations(iterations);
     }
 
-    // Zernike polynomial 25
-
-    static double zp_25(const struct zp_precalc_s &p)
+    void Zernike::normal_batch(trace::RayBatch &batch) const
     {
-      return p.x * (p.x2 * (p.x2 - 10.0 * p.y2) + 5.0 * p.y2*p.y2);
-    }
+      unsigned int idx[block_size];
+      double x[block_size], y[block_size], z[block_size], gx[block_size], gy[block_size];
+      unsigned int i = 0;
 
-    static void zp_25_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
-    {
-      dxdy.x() = 5.0 * math::square(p.y2) + 2.0 * math::square(p.x2) + 3.0 * (p.x2 - 10.0 * p.y2) * p.x2;
-      dxdy.y() = 20.0 * p.x * p.y * (p.y2 - p.x2);
-    }
+      while (i < batch.size())
+        {
+          unsigned int count = 0;
 
-    // Zernike polynomial 26
+          for (; i < batch.size() && count < block_size; i++)
+            {
+              if (!batch.is_active(i))
+                continue;
 
-    static double zp_26(const struct zp_precalc_s &p)
-    {
-      return p.y * (p.y2 * (p.y2 - 10.0 * p.x2) + 5.0 * p.x2*p.x2);
-    }
+              math::Vector3 p = batch.get_point(i);
 
-    static void zp_26_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
-    {
-      dxdy.x() = 20.0 * p.x * p.y * (p.x2 - p.y2);
-      dxdy.y() = 5.0 * math::square(p.x2) + 2.0 * math::square(p.y2) + 3.0 * (p.y2 - 10.0 * p.x2) * p.y2;
-    }
+              x[count] = p.x();
+              y[count] = p.y();
+              idx[count++] = i;
+            }
 
-    // Zernike polynomial 27
+          sagitta_gradient_batch(count, x, y, z, gx, gy);
 
-    static double zp_27(const struct zp_precalc_s &p)
-    {
-      return (-math::square(p.x2) + p.y2 * (-p.y2 + p.x2 * 6.0)) * (5.0 - 6.0 * p.r);
-    }
+          for (unsigned int j = 0; j < count; j++)
+            {
+              math::Vector3 n(gx[j], gy[j], -1.0);
 
-    static void zp_27_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
-    {
-      dxdy.x() = p.x * (p.y2 * (-60.0 * p.y2 - 120.0 * p.x2 + 60.0) + p.x2 * (36.0 * p.x2 - 20.0));
-      dxdy.y() = p.y * (p.x2 * (-60.0 * p.x2 - 120.0 * p.y2 + 60.0) + p.y2 * (36.0 * p.y2 - 20.0));
+              n.normalize();
+              batch.set_normal(idx[j], n);
+            }
+        }
     }
 
-    // Zernike polynomial 28
-
-    static double zp_28(const struct zp_precalc_s &p)
+    void Zernike::zernike_polys(const math::Vector2 & xy, double values[]) const
     {
-      return p.x * p.y * (p.x2 - p.y2) * (-20.0 + 24.0 * p.r);
-    }
+      const double x = xy.x(), y = xy.y(), t = x * x + y * y;
+      double wr = 1, wi = 0;
 
-    static void zp_28_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
-    {
-      dxdy.x() =  p.y * (p.y2 * (-24.0 * p.y2 + 20.0) + p.x2 * (120.0 * p.x2 - 60.f));
-      dxdy.y() = -p.x * (p.x2 * (-24.0 * p.x2 + 20.0) + p.y2 * (120.0 * p.y2 - 60.f));
-    }
+      for (unsigned int m = 0; m <= _max_order; m++)
+        {
+          if (m)
+            {
+              double r = wr * x - wi * y;
 
-    // Zernike polynomial 29
+              wi = wr * y + wi * x;
+              wr = r;
+            }
 
-    static double zp_29(const struct zp_precalc_s &p)
-    {
-      return p.x * (10.0 - p.r * (30.0 - 21.0 * p.r)) * (p.x2 + p.y2 * -3.0);
-    }
+          const unsigned int o = _offset[m];
+          double q = 1, qm = 0;
 
-    static void zp_29_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
-    {
-      double a = 30.0 - 21.0 * p.r;
-      double b = 10.0 - a * p.r;
-      double c = (p.x2 - 3.0 * p.y2);
-      double e = (42.0 * p.r - 2.0 * a);
+          for (unsigned int k = 0; m + 2 * k <= _max_order; k++)
+            {
+              if (k)
+                {
+                  double qn = (_rec[0][o + k] * t + _rec[1][o + k]) * q + _rec[2][o + k] * qm;
 
-      dxdy.x() = c * (p.x2 * e + b) + 2 * b * p.x2;
-      dxdy.y() = p.x * p.y * (e * c - 6.0 * b);
-    }
+                  qm = q;
+                  q = qn;
+                }
 
-    // Zernike polynomial 30
+              double nrm = term_norm(_ordering, m + 2 * k, m);
 
-    static double zp_30(const struct zp_precalc_s &p)
-    {
-      return -p.y * (10.0 - p.r * (30.0 - 21.0 * p.r)) * (p.y2 + p.x2 * -3.0);
+              if (_icos[o + k] >= 0)
+                values[_icos[o + k]] = q * wr * nrm;
+              if (_isin[o + k] >= 0)
+                values[_isin[o + k]] = q * wi * nrm;
+            }
+        }
     }
 
-    static void zp_30_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
+    // in place Cholesky factorization of the upper triangle of a
+    // symmetric positive definite matrix, a = u^T u
+    static bool cholesky(unsigned int n, double a[])
     {
-      double a = 30.0 - 21.0 * p.r;
-      double b = 10.0 - a * p.r;
-      double c = (p.y2 - 3.0 * p.x2);
-      double e = (42.0 * p.r - 2.0 * a);
+      for (unsigned int j = 0; j < n; j++)
+        {
+          double d = a[j * n + j];
+          const double dmin = d * 1e-12;
 
-      dxdy.x() = p.x * p.y * (6.0 * b - e * c);
-      dxdy.y() = -c * (p.y2 * e + b) - 2.0 * b * p.y2;
-    }
+          for (unsigned int k = 0; k < j; k++)
+            d -= a[k * n + j] * a[k * n + j];
 
-    // Zernike polynomial 31
+          if (!(d > dmin))
+            return false;
 
-    static double zp_31(const struct zp_precalc_s &p)
-    {
-      return (p.x2 - p.y2) * (-10.0 + p.r * (60.0 - p.r * (105.0 - 56.0 * p.r)));
-    }
+          d = sqrt(d);
+          a[j * n + j] = d;
 
-    static void zp_31_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
-    {
-      double a = 105.0 - 56.0 * p.r;
-      double b = 60.0 - a * p.r;
-      double c = 2.0 * (p.r * (56.0 * p.r - a) + b) * (p.x2 - p.y2);
-      double e = 2.0 * (b * p.r - 10.0);
+          for (unsigned int i = j + 1; i < n; i++)
+            {
+              double s = a[j * n + i];
 
-      dxdy.x() = p.x * (c + e);
-      dxdy.y() = p.y * (c - e);
-    }
+              for (unsigned int k = 0; k < j; k++)
+                s -= a[k * n + j] * a[k * n + i];
 
-    // Zernike polynomial 32
+              a[j * n + i] = s / d;
+            }
+        }
 
-    static double zp_32(const struct zp_precalc_s &p)
-    {
-      return p.x * p.y * (-20.0 + p.r * (120.0 - p.r * (210.0 - (112.0 * p.r))));
+      return true;
     }
 
-    static void zp_32_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
+    // solve u^T u x = b in place
+    static void cholesky_solve(unsigned int n, const double u[], double b[])
     {
-      double a = 210.0 - 112.0 * p.r;
-      double b = 120.0 - a * p.r;
-      double c = 2.0 * (p.r * (112.0 * p.r - a) + b);
-      double e = (b * p.r - 20.0);
+      for (unsigned int i = 0; i < n; i++)
+        {
+          double s = b[i];
 
-      dxdy.x() = p.y * (p.x2 * c + e);
-      dxdy.y() = p.x * (p.y2 * c + e);
-    }
+          for (unsigned int k = 0; k < i; k++)
+            s -= u[k * n + i] * b[k];
 
-    // Zernike polynomial 33
+          b[i] = s / u[i * n + i];
+        }
 
-    static double zp_33(const struct zp_precalc_s &p)
-    {
-      return p.x * (5.0 + p.r * (-60.0 + p.r * (210.0 - p.r * (280.0 - 126.0 * p.r))));
-    }
+      for (unsigned int i = n; i-- > 0; )
+        {
+          double s = b[i];
 
-    static void zp_33_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
-    {
-      double a = 280.0 - 126.0 * p.r;
-      double b = 210.0 - a * p.r;
-      double c = b * p.r - 60.0;
-      double e = 2.0 * (p.r * (p.r * (126.0 * p.r - a) + b) + c);
+          for (unsigned int k = i + 1; k < n; k++)
+            s -= u[i * n + k] * b[k];
 
-      dxdy.x() = p.x2 * e + c * p.r + 5.0;
-      dxdy.y() = p.x * p.y * e;
+          b[i] = s / u[i * n + i];
+        }
     }
 
-    // Zernike polynomial 34
-
-    static double zp_34(const struct zp_precalc_s &p)
+    double Zernike::fit(const Base &curve, const trace::Distribution & d,
+                        unsigned int threads)
     {
-      return p.y * (5.0 + p.r * (-60.0 + p.r * (210.0 - p.r * (280.0 - 126.0 * p.r))));
-    }
+      // get distributed sample points on surface
+      std::vector<double> x, y;
+      shape::Disk shape(1.0);
 
-    static void zp_34_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
-    {
-      double a = 280.0 - 126.0 * p.r;
-      double b = 210.0 - a * p.r;
-      double c = b * p.r - 60.0;
-      double e = 2.0 * (p.r * (p.r * (126.0 * p.r - a) + b) + c);
+      shape.get_pattern([&](const math::Vector2& p)
+        {
+          x.push_back(p.x() * _radius);
+          y.push_back(p.y() * _radius);
+        }, d, false);
 
-      dxdy.x() = p.y * p.x * e;
-      dxdy.y() = p.y2 * e + c * p.r + 5.0;
-    }
+      std::vector<double> z(x.size());
 
-    // Zernike polynomial 35
+      run_ranges(x.size(), threads, [&](unsigned int, unsigned int first, unsigned int last)
+        {
+          for (unsigned int i = first; i < last; i++)
+            z[i] = curve.sagitta(math::Vector2(x[i], y[i]));
+        });
 
-    static double zp_35(const struct zp_precalc_s &p)
-    {
-      return -1.0 + p.r * (30.0 + p.r * (-210.0 + p.r * (560.0 - p.r * (630.0 - 252.0 * p.r))));
+      return fit(x.size(), &x[0], &y[0], &z[0], threads);
     }
 
-    static void zp_35_d(const struct zp_precalc_s &p, math::Vector2 & dxdy)
+    double Zernike::fit(const data::Grid &g, unsigned int threads)
     {
-      double a = 630.0 - 252.0 * p.r;
-      double b = 560.0 - a * p.r;
-      double c = b * p.r - 210.0;
-      double e = 2.0 * (p.r * (p.r * (p.r * (252.0 * p.r - a) + b) + c) + (c * p.r + 30.0));
+      const unsigned int n0 = g.get_count(0), n1 = g.get_count(1);
+      std::vector<double> x, y, z;
 
-      dxdy.x() = p.x * e;
-      dxdy.y() = p.y * e;
-    }
+      x.reserve(n0 * n1);
+      y.reserve(n0 * n1);
+      z.reserve(n0 * n1);
 
-    ////////////////////////////////////////////////////
+      for (unsigned int i = 0; i < n0; i++)
+        for (unsigned int j = 0; j < n1; j++)
+          {
+            math::Vector2 p = g.get_x_value_i(i, j);
 
-    zp_t * const zp[Zernike::term_count] =
-    {
-      &zp_0,
-      &zp_1, &zp_2, &zp_3,
-      &zp_4, &zp_5, &zp_6, &zp_7, &zp_8,
-      &zp_9, &zp_10, &zp_11, &zp_12, &zp_13, &zp_14, &zp_15,
-      &zp_16, &zp_17, &zp_18, &zp_19, &zp_20, &zp_21, &zp_22, &zp_23, &zp_24,
-      &zp_25, &zp_26, &zp_27, &zp_28, &zp_29, &zp_30, &zp_31, &zp_32, &zp_33, &zp_34, &zp_35
-    };
+            x.push_back(p.x());
+            y.push_back(p.y());
+            z.push_back(g.get_y_value(i, j));
+          }
 
-    zp_d_t * const zp_d[Zernike::term_count] =
-    {
-      0,
-      &zp_1_d, &zp_2_d, &zp_3_d,
-      &zp_4_d, &zp_5_d, &zp_6_d, &zp_7_d, &zp_8_d,
-      &zp_9_d, &zp_10_d, &zp_11_d, &zp_12_d, &zp_13_d, &zp_14_d, &zp_15_d,
-      &zp_16_d, &zp_17_d, &zp_18_d, &zp_19_d, &zp_20_d, &zp_21_d, &zp_22_d, &zp_23_d, &zp_24_d,
-      &zp_25_d, &zp_26_d, &zp_27_d, &zp_28_d, &zp_29_d, &zp_30_d, &zp_31_d, &zp_32_d, &zp_33_d, &zp_34_d, &zp_35_d
-    };
-
-    Zernike::Zernike(double radius, double unit_scale)
-      : _scale(unit_scale),
-        _threshold(1e-10),
-        _radius(radius),
-        _enabled_count(0)
-    {
-      for (unsigned int i = 0; i < term_count; i++)
-        _coeff[i] = 0.0;
+      return fit(x.size(), &x[0], &y[0], &z[0], threads);
     }
 
-    Zernike::Zernike(double radius, double coefs[],
-                     unsigned int coefs_count, double unit_scale)
-      : _scale(unit_scale),
-        _threshold(1e-10),
-        _radius(radius),
-        _enabled_count(0)
+    double Zernike::fit(unsigned int count, const double x[], const double y[],
+                        const double z[], unsigned int threads)
     {
-      unsigned int i;
+      fit_cache_s &f = _fit;
+      const unsigned int tcount = _terms.size();
+      std::vector<unsigned int> index;
+      bool hit = !f._chol.empty() && f._x.size() == count;
 
-      for (i = 0; i < coefs_count; i++)
+      index.reserve(count);
+
+      for (unsigned int i = 0; i < count; i++)
         {
-          double c = coefs[i];
+          double nx = x[i] / _radius, ny = y[i] / _radius;
 
-          _coeff[i] = c;
+          hit = hit && f._x[i] == nx && f._y[i] == ny;
 
-          if (c >= _threshold)
-            _enabled_list[_enabled_count++] = i;
+          // allow rounding on circle edge of sampling patterns
+          if (nx * nx + ny * ny <= 1.0 + 1e-9 && std::isfinite(z[i]))
+            index.push_back(i);
         }
 
-      for (; i < term_count; i++)
-        _coeff[i] = 0.0;
-    }
+      if (!hit || index != f._index)
+        {
+          f._x.resize(count);
+          f._y.resize(count);
 
-    double Zernike::sagitta(const math::Vector2 & xy) const
-    {
-      struct zp_precalc_s p(xy.x() / _radius, xy.y() / _radius);
+          for (unsigned int i = 0; i < count; i++)
+            {
+              f._x[i] = x[i] / _radius;
+              f._y[i] = y[i] / _radius;
+            }
 
-      if (p.r > 1.0)
-        return 0;
+          f._index.swap(index);
+          fit_prepare(threads);
+        }
 
-      double sum = 0.0;
+      const unsigned int pcount = f._index.size();
+      const unsigned int parts = std::max(1u, std::min(threads, pcount));
+      std::vector<double> partial(parts * tcount, 0.0);
 
-      for (unsigned int i = 0; i < _enabled_count; i++)
+      // project sagitta values on terms
+      run_ranges(pcount, parts, [&](unsigned int t, unsigned int first, unsigned int last)
         {
-          unsigned int n = _enabled_list[i];
-          sum += zp[n](p) * _coeff[n];
-        }
+          double *r = &partial[t * tcount];
 
-      return sum * _scale;
-    }
+          for (unsigned int p = first; p < last; p++)
+            {
+              const double *b = &f._basis[(size_t)p * tcount];
+              const double v = z[f._index[p]];
 
-    void Zernike::derivative(const math::Vector2 & xy, math::Vector2 & dxdy) const
-    {
-      struct zp_precalc_s p(xy.x() / _radius, xy.y() / _radius);
+              for (unsigned int j = 0; j < tcount; j++)
+                r[j] += b[j] * v;
+            }
+        });
 
-      dxdy.set(0.0);
+      std::vector<double> c(tcount, 0.0);
 
-      if (p.r > 1.0)
-        return;
+      for (unsigned int t = 0; t < parts; t++)
+        for (unsigned int j = 0; j < tcount; j++)
+          c[j] += partial[t * tcount + j];
 
-      for (unsigned int i = 0; i < _enabled_count; i++)
-        {
-          unsigned int n = _enabled_list[i];
+      cholesky_solve(tcount, &f._chol[0], &c[0]);
+
+      // residual
+      std::vector<double> sq(parts, 0.0);
 
-          if (n > 0)
+      run_ranges(pcount, parts, [&](unsigned int t, unsigned int first, unsigned int last)
+        {
+          for (unsigned int p = first; p < last; p++)
             {
-              math::Vector2 dtmp;
+              const double *b = &f._basis[(size_t)p * tcount];
+              double e = z[f._index[p]];
+
+              for (unsigned int j = 0; j < tcount; j++)
+                e -= b[j] * c[j];
 
-              zp_d[n](p, dtmp);
-              dxdy += dtmp * (_coeff[n] / _radius);
+              sq[t] += e * e;
             }
-        }
+        });
 
-      dxdy *= _scale;
-    }
+      double chisq = 0;
 
-    double Zernike::fit(const Base &curve, const trace::Distribution & d)
-    {
+      for (unsigned int t = 0; t < parts; t++)
+        chisq += sq[t];
 
-      // get distributed sample points on surface
-      std::vector<math::Vector2 > pattern;
-      shape::Disk shape(1.0);
-      shape.get_pattern([&](const math::Vector2& item) { pattern.push_back(item); }, d, false);
+      for (unsigned int j = 0; j < tcount; j++)
+        _coeff[j] = c[j] / _scale;
 
-      unsigned int pcount = pattern.size();
+      update_threshold_state();
 
-      gsl_matrix *X = gsl_matrix_alloc(pcount, term_count);
-      gsl_vector *y = gsl_vector_alloc(pcount);
-      gsl_vector *c = gsl_vector_alloc(term_count);
-      gsl_matrix *cov = gsl_matrix_alloc(term_count, term_count);
+      return sqrt(chisq / pcount);
+    }
 
-      unsigned int i = 0;
+    void Zernike::fit_prepare(unsigned int threads)
+    {
+      fit_cache_s &f = _fit;
+      const unsigned int tcount = _terms.size();
+      const unsigned int pcount = f._index.size();
+      const unsigned int parts = std::max(1u, std::min(threads, pcount));
 
-      // setup least square fit matrix from sample points
+      f._chol.clear();
 
-      for (auto&pt : pattern)
-        {
-          struct zp_precalc_s p(pt.x(), pt.y());
+      if (pcount < tcount)
+        throw Error("not enough sample points to fit zernike terms");
 
-          gsl_vector_set(y, i, curve.sagitta(pt * _radius));
-          
-          for (unsigned int j = 0; j < term_count; j++)
-            gsl_matrix_set(X, i, j, zp[j](p) * _scale);
+      f._basis.resize((size_t)pcount * tcount);
 
-          i++;
-        }
+      std::vector<double> partial((size_t)parts * tcount * tcount, 0.0);
 
-      double chisq;
+      // terms values and normal matrix upper triangle
+      run_ranges(pcount, parts, [&](unsigned int t, unsigned int first, unsigned int last)
+        {
+          double *n = &partial[(size_t)t * tcount * tcount];
 
-      // process least square fit
+          for (unsigned int p = first; p < last; p++)
+            {
+              const unsigned int i = f._index[p];
+              double *b = &f._basis[(size_t)p * tcount];
 
-      gsl_multifit_linear_workspace *work = gsl_multifit_linear_alloc(pcount, term_count);
-      gsl_multifit_linear(X, y, c, cov, &chisq, work);
-      gsl_multifit_linear_free(work);
+              zernike_polys(math::Vector2(f._x[i], f._y[i]), b);
 
-      gsl_matrix_free(X);
-      gsl_vector_free(y);
-      gsl_matrix_free(cov);
+              for (unsigned int j = 0; j < tcount; j++)
+                {
+                  const double bj = b[j];
+                  double *r = n + j * tcount;
 
-      for (unsigned int j = 0; j < term_count; j++)
-        _coeff[j] = gsl_vector_get(c, j);
+                  for (unsigned int k = j; k < tcount; k++)
+                    r[k] += bj * b[k];
+                }
+            }
+        });
 
-      gsl_vector_free(c);
+      std::vector<double> chol(tcount * tcount, 0.0);
 
-      update_threshold_state();
+      for (unsigned int t = 0; t < parts; t++)
+        for (unsigned int j = 0; j < tcount * tcount; j++)
+          chol[j] += partial[(size_t)t * tcount * tcount + j];
 
-      return sqrt(chisq / pcount);
+      if (!cholesky(tcount, &chol[0]))
+        throw Error("zernike terms can not be resolved from fit sample points");
 
+      f._chol.swap(chol);
     }
 
-    void Zernike::update_threshold_state()
+    void Zernike::clear_fit_cache()
     {
-      unsigned int n = 0, i = 0;
+      _fit = fit_cache_s();
+    }
 
-      for (; i < term_count; i++)
-        if (fabs(_coeff[i]) >= _threshold)
-          _enabled_list[n++] = i;
+    void Zernike::update_threshold_state()
+    {
+      for (unsigned int i = 0; i < _coeff.size(); i++)
+        _enabled[i] = fabs(_coeff[i]) >= _threshold;
 
-      _enabled_count = n;
+      update_tables();
     }
 
     void Zernike::set_term_state(unsigned int n, bool enabled)
     {
-      unsigned int i;
+      n -= get_first_term();
 
-      assert(n < term_count);
+      assert(n < _enabled.size());
 
-      if (enabled)
-        {
-          for (i = 0; i < _enabled_count; i++)
-            if (_enabled_list[i] == n)
-              return;
-          assert(i < term_count);
-          _enabled_list[i] = n;
-          _enabled_count = i + 1;
-        }
-      else
-        {
-          for (i = 0; i < _enabled_count; i++)
-            if (_enabled_list[i] == n)
-              {
-                _enabled_count--;
-                _enabled_list[i] = _enabled_list[_enabled_count];
-                return;
-              }
-        }
+      _enabled[n] = enabled;
+      update_tables();
     }
 
     bool Zernike::get_term_state(unsigned int n)
     {
-      for (unsigned int i = 0; i < _enabled_count; i++)
-        if (_enabled_list[i] == n)
-          return true;
+      n -= get_first_term();
 
-      return false;
+      assert(n < _enabled.size());
+
+      return _enabled[n];
     }
 
     double Zernike::zernike_poly(unsigned int n, const math::Vector2 & xy)
     {
-      struct zp_precalc_s p(xy.x(), xy.y());
+      unsigned int i = 0;
+      double r = 0;
 
-      assert(n < term_count);
+      enum_terms(Fringe, 2 * (unsigned int)sqrt((double)n) + 2, [&](unsigned int tn, int tm)
+        {
+          if (i++ == n)
+            r = term_poly(tn, tm, xy, 0);
+        });
 
-      return zp[n](p);
+      return r;
     }
 
     void Zernike::zernike_poly_d(unsigned int n, const math::Vector2 & xy, math::Vector2 & dxdy)
     {
-      struct zp_precalc_s p(xy.x(), xy.y());
-
-      assert(n < term_count);
+      unsigned int i = 0;
 
-      zp_d[n](p, dxdy);
+      enum_terms(Fringe, 2 * (unsigned int)sqrt((double)n) + 2, [&](unsigned int tn, int tm)
+        {
+          if (i++ == n)
+            term_poly(tn, tm, xy, &dxdy);
+        });
     }
 
   }
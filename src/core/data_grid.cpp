@@ -391,8 +391,8 @@ namespace _goptical {
       const unsigned int s0 = _size[0] - 1;
       this_->_poly.resize(s0 * (_size[1] - 1));
 
-      double cd[_size[0] * _size[1]];
-      get_cross_deriv_diff(cd);
+      std::vector<double> cd(_size[0] * _size[1]);
+      get_cross_deriv_diff(&cd[0]);
 
       const unsigned int w = _size[0];
       unsigned int x0, x1;
@@ -450,8 +450,8 @@ namespace _goptical {
       const unsigned int s0 = _size[0] - 1;
       this_->_poly.resize(s0 * (_size[1] - 1));
 
-      double cd[_size[0] * _size[1]];
-      get_cross_deriv_diff(cd);
+      std::vector<double> cd(_size[0] * _size[1]);
+      get_cross_deriv_diff(&cd[0]);
 
       DPP_VLARRAY(math::Vector2, _size[0] * _size[1], d);
       get_deriv_diff(&d[0]);
@@ -503,8 +503,8 @@ namespace _goptical {
       const unsigned int s0 = _size[0] - 1;
       this_->_poly.resize(s0 * (_size[1] - 1));
 
-      double cd[_size[0] * _size[1]];
-      get_cross_deriv_diff(cd);
+      std::vector<double> cd(_size[0] * _size[1]);
+      get_cross_deriv_diff(&cd[0]);
 
       const unsigned int w = _size[0];
 
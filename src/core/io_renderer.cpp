@@ -144,6 +144,9 @@ namespace _goptical {
       if (sl.empty())
         throw Error("No source found in trace result");
 
+      if (!result.get_params().get_ray_history())
+        throw Error("Drawing rays requires ray history, enable it in tracer parameters");
+
       _max_intensity = result.get_max_ray_intensity();
 
       for (auto& s : sl)
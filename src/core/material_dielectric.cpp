@@ -23,6 +23,10 @@
 */
 
 
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
 #include <goptical/core/data/Set>
 #include <goptical/core/material/Dielectric>
 #include <goptical/core/material/Air>
@@ -38,7 +42,7 @@ namespace _goptical {
         _low_wavelen(350.0),
         _high_wavelen(750.0),
         _measurement_medium(std_air),
-        _last_wavelen(0)
+        _index_cache_serial(index_cache_new_serial())
     {
       _transmittance.set_interpolation(data::Cubic);
     }
@@ -88,11 +92,45 @@ namespace _goptical {
                                         + (_temp_e0 + _temp_e1*dt)/(wl*wl - wl_tk*wl_tk));
     }
 
+    /* Material objects are shared between tracer worker threads,
+       each thread keeps its own small table of last computed
+       refractive index values. */
+
+    struct index_cache_entry_s
+    {
+      unsigned long _serial;
+      double        _wavelen;
+      double        _temperature;
+      double        _index;
+    };
+
+    static const unsigned int index_cache_bits = 6;
+    static thread_local index_cache_entry_s index_cache[1 << index_cache_bits];
+
+    unsigned long Dielectric::index_cache_new_serial()
+    {
+      static std::atomic<unsigned long> serial(0);
+
+      return ++serial;
+    }
+
+    static inline index_cache_entry_s & index_cache_entry(unsigned long serial, double wavelen)
+    {
+      uint64_t h;
+
+      memcpy(&h, &wavelen, sizeof(h));
+      h = (h ^ serial) * 0x9e3779b97f4a7c15ULL;
+
+      return index_cache[h >> (64 - index_cache_bits)];
+    }
+
     double Dielectric::get_refractive_index(double wavelen) const
     {
-      if (wavelen == _last_wavelen) {
-          return _last_get_refractive_index;
-      }
+      index_cache_entry_s &c = index_cache_entry(_index_cache_serial, wavelen);
+
+      if (c._serial == _index_cache_serial && c._wavelen == wavelen &&
+          c._temperature == _temperature)
+        return c._index;
 
       double a = _measurement_medium->get_refractive_index(wavelen);
       double m = get_measurement_index(wavelen);
@@ -117,8 +155,10 @@ namespace _goptical {
           ;
         }
 
-      _last_wavelen = wavelen;
-      _last_get_refractive_index = n;
+      c._serial = _index_cache_serial;
+      c._wavelen = wavelen;
+      c._temperature = _temperature;
+      c._index = n;
 
       return n;
     }
@@ -52,6 +52,7 @@ namespace _goptical {
     void Sellmeier::set_terms_count(unsigned int c)
     {
       _coeff.resize(c * 2, 0.0);
+      index_cache_flush();
     }
 
     double Sellmeier::get_measurement_index(double wavelen) const
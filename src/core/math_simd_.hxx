@@ -0,0 +1,273 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+   Batch kernels helpers.
+
+   Kernels are written once as a class template parametrized by one
+   of the instruction set classes below and process S::width rays
+   per call. The Scalar class is used for processors without vector
+   units and for remaining rays at the end of a batch, so all code
+   paths share the same expressions. Operations are performed in the
+   same order as scalar code and fused multiply-add is never enabled,
+   results are identical whatever the instruction set used.
+*/
+
+#include <math.h>
+
+#include <goptical/core/trace/RayBatch>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+# define GOPTICAL_SIMD_X86
+# include <immintrin.h>
+// 256 bits vectors are used in kernels inlined in AVX2 functions only
+# pragma GCC diagnostic ignored "-Wpsabi"
+# define GOPTICAL_SIMD_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace _goptical {
+
+  namespace math {
+
+    namespace simd {
+
+      /** Instruction sets available to batch kernels */
+      enum Level
+        {
+          LevelScalar,
+          LevelSSE2,
+          LevelAVX2,
+        };
+
+      /** Get best instruction set supported by the running processor */
+      inline Level get_level()
+      {
+#ifdef GOPTICAL_SIMD_X86
+        static const Level level =
+          (__builtin_cpu_init(), __builtin_cpu_supports("avx2")) ? LevelAVX2 : LevelSSE2;
+
+        return level;
+#else
+        return LevelScalar;
+#endif
+      }
+
+      /** One lane operations */
+      struct Scalar
+      {
+        typedef double vec;
+        typedef bool mask;
+
+        static const unsigned int width = 1;
+
+        static inline vec load(const double *p) { return *p; }
+        static inline void store(double *p, vec a) { *p = a; }
+        static inline vec set(double a) { return a; }
+        static inline vec sqrt(vec a) { return ::sqrt(a); }
+        static inline vec neg(vec a) { return -a; }
+        static inline vec select(mask m, vec a, vec b) { return m ? a : b; }
+
+        static inline mask lt(vec a, vec b) { return a < b; }
+        static inline mask le(vec a, vec b) { return a <= b; }
+        static inline mask gt(vec a, vec b) { return a > b; }
+        static inline mask ge(vec a, vec b) { return a >= b; }
+        static inline mask eq(vec a, vec b) { return a == b; }
+        static inline mask nlt(vec a, vec b) { return !(a < b); }
+        static inline mask nle(vec a, vec b) { return !(a <= b); }
+        static inline mask mask_and(mask a, mask b) { return a && b; }
+        static inline mask mask_or(mask a, mask b) { return a || b; }
+        static inline unsigned int bits(mask m) { return m; }
+      };
+
+#ifdef GOPTICAL_SIMD_X86
+
+      /** Two lanes SSE2 operations */
+      struct SSE2
+      {
+        typedef __m128d vec;
+        typedef __m128d mask;
+
+        static const unsigned int width = 2;
+
+        static inline vec load(const double *p) { return _mm_loadu_pd(p); }
+        static inline void store(double *p, vec a) { _mm_storeu_pd(p, a); }
+        static inline vec set(double a) { return _mm_set1_pd(a); }
+        static inline vec sqrt(vec a) { return _mm_sqrt_pd(a); }
+        static inline vec neg(vec a) { return _mm_xor_pd(a, _mm_set1_pd(-0.0)); }
+        static inline vec select(mask m, vec a, vec b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+
+        static inline mask lt(vec a, vec b) { return _mm_cmplt_pd(a, b); }
+        static inline mask le(vec a, vec b) { return _mm_cmple_pd(a, b); }
+        static inline mask gt(vec a, vec b) { return _mm_cmpgt_pd(a, b); }
+        static inline mask ge(vec a, vec b) { return _mm_cmpge_pd(a, b); }
+        static inline mask eq(vec a, vec b) { return _mm_cmpeq_pd(a, b); }
+        static inline mask nlt(vec a, vec b) { return _mm_cmpnlt_pd(a, b); }
+        static inline mask nle(vec a, vec b) { return _mm_cmpnle_pd(a, b); }
+        static inline mask mask_and(mask a, mask b) { return _mm_and_pd(a, b); }
+        static inline mask mask_or(mask a, mask b) { return _mm_or_pd(a, b); }
+        static inline unsigned int bits(mask m) { return _mm_movemask_pd(m); }
+      };
+
+      /** Four lanes AVX2 operations */
+      struct AVX2
+      {
+        typedef __m256d vec;
+        typedef __m256d mask;
+
+        static const unsigned int width = 4;
+
+        static inline GOPTICAL_SIMD_AVX2 vec load(const double *p) { return _mm256_loadu_pd(p); }
+        static inline GOPTICAL_SIMD_AVX2 void store(double *p, vec a) { _mm256_storeu_pd(p, a); }
+        static inline GOPTICAL_SIMD_AVX2 vec set(double a) { return _mm256_set1_pd(a); }
+        static inline GOPTICAL_SIMD_AVX2 vec sqrt(vec a) { return _mm256_sqrt_pd(a); }
+        static inline GOPTICAL_SIMD_AVX2 vec neg(vec a) { return _mm256_xor_pd(a, _mm256_set1_pd(-0.0)); }
+        static inline GOPTICAL_SIMD_AVX2 vec select(mask m, vec a, vec b) { return _mm256_blendv_pd(b, a, m); }
+
+        static inline GOPTICAL_SIMD_AVX2 mask lt(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+        static inline GOPTICAL_SIMD_AVX2 mask le(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+        static inline GOPTICAL_SIMD_AVX2 mask gt(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+        static inline GOPTICAL_SIMD_AVX2 mask ge(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+        static inline GOPTICAL_SIMD_AVX2 mask eq(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+        static inline GOPTICAL_SIMD_AVX2 mask nlt(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_NLT_UQ); }
+        static inline GOPTICAL_SIMD_AVX2 mask nle(vec a, vec b) { return _mm256_cmp_pd(a, b, _CMP_NLE_UQ); }
+        static inline GOPTICAL_SIMD_AVX2 mask mask_and(mask a, mask b) { return _mm256_and_pd(a, b); }
+        static inline GOPTICAL_SIMD_AVX2 mask mask_or(mask a, mask b) { return _mm256_or_pd(a, b); }
+        static inline GOPTICAL_SIMD_AVX2 unsigned int bits(mask m) { return _mm256_movemask_pd(m); }
+      };
+
+      template <template <class> class K, class A>
+      __attribute__((flatten))
+      size_t process_sse2(A &args, size_t count)
+      {
+        size_t i;
+
+        for (i = 0; i + SSE2::width <= count; i += SSE2::width)
+          K<SSE2>::process(args, i);
+
+        return i;
+      }
+
+      template <template <class> class K, class A>
+      __attribute__((flatten)) GOPTICAL_SIMD_AVX2
+      size_t process_avx2(A &args, size_t count)
+      {
+        size_t i;
+
+        for (i = 0; i + AVX2::width <= count; i += AVX2::width)
+          K<AVX2>::process(args, i);
+
+        return i;
+      }
+
+#endif
+
+      /** Call K<S>::process(args, index) for all indexes in range
+          [0, count) with index stepping by S::width, using the best
+          instruction set S available. */
+      template <template <class> class K, class A>
+      void process(A &args, size_t count)
+      {
+        size_t i = 0;
+
+#ifdef GOPTICAL_SIMD_X86
+        switch (get_level())
+          {
+          case LevelAVX2:
+            i = process_avx2<K>(args, count);
+            break;
+          case LevelSSE2:
+            i = process_sse2<K>(args, count);
+            break;
+          default:
+            break;
+          }
+#endif
+
+        for (; i < count; i++)
+          K<Scalar>::process(args, i);
+      }
+
+      /** Rays batch arrays passed to kernels */
+      struct BatchArrays
+      {
+        BatchArrays(trace::RayBatch &batch)
+          : active(batch.get_active_array())
+        {
+          for (unsigned int j = 0; j < 3; j++)
+            {
+              origin[j] = batch.get_origin_array(j);
+              direction[j] = batch.get_direction_array(j);
+              point[j] = batch.get_point_array(j);
+              normal[j] = batch.get_normal_array(j);
+            }
+        }
+
+        const double *origin[3];
+        const double *direction[3];
+        double *point[3];
+        double *normal[3];
+        unsigned char *active;
+      };
+
+      /** Store lanes of a vector which have their bit set in mask */
+      template <class S>
+      inline void store_masked(double *p, const typename S::vec &a, unsigned int mask)
+      {
+        if (mask == (1U << S::width) - 1)
+          return S::store(p, a);
+
+        double tmp[S::width];
+        S::store(tmp, a);
+
+        for (unsigned int j = 0; j < S::width; j++)
+          if (mask & (1 << j))
+            p[j] = tmp[j];
+      }
+
+      /** Get bit mask of active lanes from a batch active array */
+      template <class S>
+      inline unsigned int active_bits(const unsigned char *active)
+      {
+        unsigned int mask = 0;
+
+        for (unsigned int j = 0; j < S::width; j++)
+          mask |= (active[j] != 0) << j;
+
+        return mask;
+      }
+
+      /** Disable lanes which have their bit set in mask */
+      template <class S>
+      inline void disable(unsigned char *active, unsigned int mask)
+      {
+        for (unsigned int j = 0; j < S::width; j++)
+          if (mask & (1 << j))
+            active[j] = 0;
+      }
+
+    }
+
+  }
+
+}
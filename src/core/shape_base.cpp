@@ -25,8 +25,10 @@
 #include <cstdlib>
 
 #include <goptical/core/shape/Base>
+#include <goptical/core/math/RandomStream>
 #include <goptical/core/math/Vector>
 #include <goptical/core/trace/Distribution>
+#include <goptical/core/trace/RayBatch>
 
 namespace _goptical {
 
@@ -101,6 +103,7 @@ namespace _goptical {
 
         case trace::RandomDist: {
 
+          math::RandomStream rng(d.get_seed(), d.get_stream());
           double x, y;
 
           for (x = -tr; x < tr; x += step)
@@ -109,14 +112,27 @@ namespace _goptical {
 
               for (y = -ybound; y < ybound; y += step)
               {
-                  ADD_PATTERN_POINT(math::Vector2(x + (drand48() - .5) * step,
-                                                    y + (drand48() - .5) * step));
+                  ADD_PATTERN_POINT(math::Vector2(x + (rng.uniform() - .5) * step,
+                                                    y + (rng.uniform() - .5) * step));
                 }
 
             }
           break;
         }
 
+        case trace::SobolDist:
+        case trace::HaltonDist:
+        case trace::JitteredDist: {
+
+          unsigned int n = d.get_radial_density();
+
+          d.get_disk_samples(round(M_PI * n * n), 0.0, [&](const math::Vector2 &v)
+            {
+              ADD_PATTERN_POINT(v * tr);
+            });
+          break;
+        }
+
         case trace::HexaPolarDist: {
 
           ADD_PATTERN_POINT(math::Vector2(0, 0));
@@ -210,6 +226,22 @@ namespace _goptical {
       return 0.;
     }
 
+    void Base::inside_batch(trace::RayBatch &batch) const
+    {
+      const double *x = batch.get_point_array(0);
+      const double *y = batch.get_point_array(1);
+      unsigned char *active = batch.get_active_array();
+
+      for (unsigned int i = 0; i < batch.size(); i++)
+        if (active[i] && !inside(math::Vector2(x[i], y[i])))
+          active[i] = 0;
+    }
+
+    unsigned int Base::get_version() const
+    {
+      return _version;
+    }
+
   }
 
 }
@@ -47,7 +47,8 @@ namespace _goptical {
     Composer::Attributes::Attributes(const const_ref<Base> &shape)
       : _shape(shape),
         _list(),
-        _exclude(false)
+        _exclude(false),
+        _version(0)
     {
       _transform.reset();
       _inv_transform.reset();
@@ -58,6 +59,7 @@ namespace _goptical {
       _list.push_back(Attributes(shape));
       //_list.back()._exclude = true;
       _update = true;
+      update_version();
       return _list.back();
     }
 
@@ -65,6 +67,7 @@ namespace _goptical {
     {
       Attributes::_list.push_back(Attributes(shape));
       Attributes::_list.back()._exclude = false;
+      _version++;
       return Attributes::_list.back();
     }
 
@@ -72,6 +75,7 @@ namespace _goptical {
     {
       Attributes::_list.push_back(Attributes(shape));
       Attributes::_list.back()._exclude = true;
+      _version++;
       return Attributes::_list.back();
     }
 
@@ -87,6 +91,27 @@ namespace _goptical {
       return res ^ _exclude;
     }
 
+    unsigned int Composer::Attributes::get_version() const
+    {
+      // all versions only increase, so does the sum
+      unsigned int v = _version + _shape->get_version();
+
+      for (auto& s: Attributes::_list)
+        v += s.get_version();
+
+      return v;
+    }
+
+    unsigned int Composer::get_version() const
+    {
+      unsigned int v = Base::get_version();
+
+      for (auto& s : _list)
+        v += s.get_version();
+
+      return v;
+    }
+
     bool Composer::inside(const math::Vector2 &point) const
     {
 
@@ -26,6 +26,7 @@
 #include <goptical/core/math/VectorPair>
 
 #include "shape_round_.hxx"
+#include "math_simd_.hxx"
 
 namespace _goptical {
 
@@ -36,6 +37,46 @@ namespace _goptical {
       return (math::square(point.x()) + math::square(point.y()) <= math::square(_radius));
     }
 
+    struct disk_batch_s
+    {
+      const double *x, *y;
+      unsigned char *active;
+      double r2;
+    };
+
+    template <class S>
+    struct disk_inside_k
+    {
+      static inline void process(disk_batch_s &p, size_t i)
+      {
+        typedef typename S::vec vec;
+
+        unsigned int act = math::simd::active_bits<S>(p.active + i);
+
+        if (!act)
+          return;
+
+        const vec x = S::load(p.x + i);
+        const vec y = S::load(p.y + i);
+
+        unsigned int in = S::bits(S::le(x * x + y * y, S::set(p.r2)));
+
+        math::simd::disable<S>(p.active + i, act & ~in);
+      }
+    };
+
+    void DiskBase::inside_batch(trace::RayBatch &batch) const
+    {
+      disk_batch_s p;
+
+      p.x = batch.get_point_array(0);
+      p.y = batch.get_point_array(1);
+      p.active = batch.get_active_array();
+      p.r2 = math::square(_radius);
+
+      math::simd::process<disk_inside_k>(p, batch.size());
+    }
+
     math::VectorPair2 DiskBase::get_bounding_box() const
     {
       math::Vector2 hs(_radius, _radius);
@@ -90,6 +90,7 @@ namespace _goptical {
       _updated = false;
       assert(id <= _vertices.size());
       _vertices.insert(_vertices.begin() + id, v);
+      update_version();
     }
 
     unsigned int Polygon::add_vertex(const math::Vector2 &v)
@@ -105,6 +106,7 @@ namespace _goptical {
       _updated = false;
       assert(id < _vertices.size());
       _vertices.erase(_vertices.begin() + id);
+      update_version();
     }
 
     bool Polygon::inside(const math::Vector2 &p) const
@@ -24,6 +24,7 @@
 
 #include <cstdlib>
 #include <cassert>
+#include <algorithm>
 
 #include <goptical/core/shape/Rectangle>
 
@@ -121,6 +122,19 @@ namespace _goptical {
           break;
         }
 
+        case trace::SobolDist:
+        case trace::HaltonDist:
+        case trace::JitteredDist: {
+          unsigned int n = d.get_radial_density() / 2;
+
+          d.get_unit_samples(std::max(1U, 4 * n * n), [&](const math::Vector2 &u)
+            {
+              f(math::Vector2((2.0 * u.x() - 1.0) * hs.x(),
+                              (2.0 * u.y() - 1.0) * hs.y()));
+            });
+          break;
+        }
+
         default:
           Base::get_pattern(f, d, unobstructed);
         }
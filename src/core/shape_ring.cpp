@@ -27,6 +27,7 @@
 #include <goptical/core/math/VectorPair>
 
 #include "shape_round_.hxx"
+#include "math_simd_.hxx"
 
 namespace _goptical {
 
@@ -39,6 +40,49 @@ namespace _goptical {
       return d <= math::square(_radius) && d >= math::square(_hole_radius);
     }
 
+    struct ring_batch_s
+    {
+      const double *x, *y;
+      unsigned char *active;
+      double r2, h2;
+    };
+
+    template <class S>
+    struct ring_inside_k
+    {
+      static inline void process(ring_batch_s &p, size_t i)
+      {
+        typedef typename S::vec vec;
+
+        unsigned int act = math::simd::active_bits<S>(p.active + i);
+
+        if (!act)
+          return;
+
+        const vec x = S::load(p.x + i);
+        const vec y = S::load(p.y + i);
+        const vec d = x * x + y * y;
+
+        unsigned int in = S::bits(S::mask_and(S::le(d, S::set(p.r2)),
+                                              S::ge(d, S::set(p.h2))));
+
+        math::simd::disable<S>(p.active + i, act & ~in);
+      }
+    };
+
+    void RingBase::inside_batch(trace::RayBatch &batch) const
+    {
+      ring_batch_s p;
+
+      p.x = batch.get_point_array(0);
+      p.y = batch.get_point_array(1);
+      p.active = batch.get_active_array();
+      p.r2 = math::square(_radius);
+      p.h2 = math::square(_hole_radius);
+
+      math::simd::process<ring_inside_k>(p, batch.size());
+    }
+
     math::VectorPair2 RingBase::get_bounding_box() const
     {
       math::Vector2 hs(_radius, _radius);
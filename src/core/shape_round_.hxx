@@ -25,6 +25,7 @@
 #include <cstdlib>
 
 #include <goptical/core/trace/Distribution>
+#include <goptical/core/math/RandomStream>
 #include <goptical/core/math/Triangle>
 
 namespace _goptical {
@@ -101,6 +102,7 @@ namespace _goptical {
           if (!obstructed)
             f(math::Vector2(0, 0));
 
+          math::RandomStream rng(d.get_seed(), d.get_stream());
           const double bound = obstructed ? hr - epsilon : epsilon;
 
           double tr1 = tr / 20;
@@ -110,8 +112,8 @@ namespace _goptical {
               // angle
               for (double a = 0; a < 2 * M_PI - epsilon; a += astep)
                 {
-                  math::Vector2 v(sin(a) * r       + (drand48() - .5) * step,
-                                    cos(a) * r * xyr + (drand48() - .5) * step);
+                  math::Vector2 v(sin(a) * r       + (rng.uniform() - .5) * step,
+                                    cos(a) * r * xyr + (rng.uniform() - .5) * step);
                   double h = hypot(v.x(), v.y() / xyr);
                   if (h < tr && (h > hr || unobstructed))
                     f(v);
@@ -120,6 +122,21 @@ namespace _goptical {
 
         }  break;
 
+        case trace::SobolDist:
+        case trace::HaltonDist:
+        case trace::JitteredDist: {
+          // keep same rays density as other patterns over the ring area
+          const double n = d.get_radial_density();
+          const double ratio = hr / tr;
+
+          d.get_disk_samples(std::max(1.0, round(M_PI * n * n * (1.0 - ratio * ratio))),
+                             ratio, [&](const math::Vector2 &v)
+            {
+              f(math::Vector2(v.x() * tr, v.y() * tr * xyr));
+            });
+
+        } break;
+
         case trace::DefaultDist:
         case trace::HexaPolarDist: {
 
@@ -60,7 +60,7 @@ namespace _goptical {
       if (e->_container)
         e->_container->remove(*e);
 
-      _list.insert(_list.begin(), e);
+      e->_container_pos = _list.insert(_list.begin(), e);
 
       e->_container = this;
 
@@ -73,13 +73,25 @@ namespace _goptical {
       if (e->_container)
         e->_container->remove(*e);
 
-      _list.push_back(e);
+      e->_container_pos = _list.insert(_list.end(), e);
 
       e->_container = this;
 
       added(*e);
     }
 
+    void Container::add(const std::vector<ref<Element> > &list)
+    {
+      reserve(list.size());
+
+      for (auto&e : list)
+        add(e);
+    }
+
+    void Container::reserve(unsigned int)
+    {
+    }
+
     void Container::remove(Element &e)
     {
       removed(e);
@@ -88,7 +100,7 @@ namespace _goptical {
 
       e._container = 0;
 
-      _list.remove(e);
+      _list.erase(e._container_pos);
     }
 
     math::VectorPair3 Container::get_bounding_box() const
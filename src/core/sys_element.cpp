@@ -43,6 +43,7 @@ namespace _goptical {
     Element::Element(const math::VectorPair3 &plane)
       : _system(0),
         _container(0),
+        _container_pos(),
         _enabled(true),
         _version(0),
         _system_id(0),
@@ -153,30 +154,38 @@ namespace _goptical {
       return math::VectorPair3(math::vector3_0, math::vector3_0);
     }
 
-    const math::Transform<3> & Element::get_transform_to(const Element &e) const
+    math::Transform<3> Element::get_transform_to(const Element &e) const
     {
-      assert(_system);
-      return _system->get_transform(*this, e);
+      const system *s = _system ? _system : e._system;
+
+      assert(s);
+      return s->get_transform(*this, e);
     }
 
-    const math::Transform<3> & Element::get_transform_from(const Element &e) const
+    math::Transform<3> Element::get_transform_from(const Element &e) const
     {
-      assert(_system);
-      return _system->get_transform(e, *this);
+      const system *s = _system ? _system : e._system;
+
+      assert(s);
+      return s->get_transform(e, *this);
     }
 
-    const math::Transform<3> & Element::get_transform_to(const Element *e) const
+    math::Transform<3> Element::get_transform_to(const Element *e) const
     {
+      if (e)
+        return get_transform_to(*e);
+
       assert(_system);
-      return e ? _system->get_transform(*this, *e)
-        : _system->get_global_transform(*this);
+      return _system->get_global_transform(*this);
     }
 
-    const math::Transform<3> & Element::get_transform_from(const Element *e) const
+    math::Transform<3> Element::get_transform_from(const Element *e) const
     {
+      if (e)
+        return get_transform_from(*e);
+
       assert(_system);
-      return e ? _system->get_transform(*e, *this)
-        : _system->get_local_transform(*this);
+      return _system->get_local_transform(*this);
     }
 
     const math::Transform<3> & Element::get_global_transform() const
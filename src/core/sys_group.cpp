@@ -23,6 +23,7 @@
 */
 
 #include <goptical/core/sys/Group>
+#include <goptical/core/sys/System>
 #include <goptical/core/math/VectorPair>
 #include <goptical/core/io/Renderer>
 
@@ -49,6 +50,12 @@ namespace _goptical {
         e.system_unregister();
     }
 
+    void Group::reserve(unsigned int count)
+    {
+      if (_system)
+        _system->reserve(count);
+    }
+
     void Group::system_register(system &s)
     {
       Element::system_register(s);
@@ -26,6 +26,8 @@
 #include <goptical/core/curve/Flat>
 #include <goptical/core/sys/Image>
 #include <goptical/core/trace/Ray>
+#include <goptical/core/trace/Result>
+#include <goptical/core/trace/Detector>
 
 namespace _goptical {
 
@@ -34,28 +36,81 @@ namespace _goptical {
     Image::Image(const math::VectorPair3 &p,
                  const const_ref<curve::Base> &curve,
                  const const_ref<shape::Base> &shape)
-      : Surface(p, curve, shape)
+      : Surface(p, curve, shape),
+        _detector_width(0),
+        _detector_height(0),
+        _detector_per_wavelen(false)
     {
     }
 
     Image::Image(const math::VectorPair3 &p, double radius)
-      : Surface(p, curve::flat, ref<shape::Rectangle>::create(radius * 2.))
+      : Surface(p, curve::flat, ref<shape::Rectangle>::create(radius * 2.)),
+        _detector_width(0),
+        _detector_height(0),
+        _detector_per_wavelen(false)
     {
     }
 
+    void Image::set_detector(unsigned int width, unsigned int height,
+                             bool per_wavelen)
+    {
+      if (!width || !height)
+        throw Error("image detector must have at least one pixel");
+
+      _detector_width = width;
+      _detector_height = height;
+      _detector_per_wavelen = per_wavelen;
+      update_version();
+    }
+
+    void Image::clear_detector()
+    {
+      _detector_width = _detector_height = 0;
+      update_version();
+    }
+
+    ref<trace::Detector> Image::new_detector() const
+    {
+      if (!has_detector())
+        throw Error("image is not in detector mode");
+
+      return GOPTICAL_REFNEW(trace::Detector, get_shape().get_bounding_box(),
+                             _detector_width, _detector_height,
+                             _detector_per_wavelen);
+    }
+
+    bool Image::match_detector(const trace::Detector &d) const
+    {
+      const trace::Irradiance &map = d.get_irradiance();
+      // detector covers the current image shape
+      math::VectorPair2 window = get_shape().get_bounding_box();
+
+      return map.get_width() == _detector_width &&
+        map.get_height() == _detector_height &&
+        d.is_per_wavelen() == _detector_per_wavelen &&
+        (map.get_window()[0] - window[0]).len() == 0 &&
+        (map.get_window()[1] - window[1]).len() == 0;
+    }
+
     void Image::trace_ray_simple(trace::Result &result, trace::Ray &incident,
                                  const math::VectorPair3 &local, const math::VectorPair3 &intersect) const
     {
+      if (has_detector())
+        result.add_detected(*this, incident);
     }
 
     void Image::trace_ray_intensity(trace::Result &result, trace::Ray &incident,
                                     const math::VectorPair3 &local, const math::VectorPair3 &intersect) const
     {
+      if (has_detector())
+        result.add_detected(*this, incident);
     }
 
     void Image::trace_ray_polarized(trace::Result &result, trace::Ray &incident,
                                     const math::VectorPair3 &local, const math::VectorPair3 &intersect) const
     {
+      if (has_detector())
+        result.add_detected(*this, incident);
     }
 
   }
@@ -32,6 +32,8 @@
 #include <goptical/core/trace/Ray>
 #include <goptical/core/trace/Distribution>
 #include <goptical/core/trace/Result>
+#include <goptical/core/trace/RayBatch>
+#include <goptical/core/trace/IndexTable>
 
 #include <goptical/core/io/Rgb>
 #include <goptical/core/io/Renderer>
@@ -40,6 +42,73 @@ namespace _goptical {
 
   namespace sys {
 
+    /* Materials properties on both sides of an optical surface for a
+       ray wavelength. Values are looked up in the table built for
+       the current trace, values which are not in the table are
+       computed by material objects. */
+    struct surface_media_s
+    {
+      inline surface_media_s(const trace::IndexTable &table, const sys::Element &surface,
+                             bool right_to_left, const material::Base *prev,
+                             const material::Base *next, double wl)
+        : _table(table),
+          _prev(prev),
+          _next(next),
+          _wl(wl),
+          _w(table.get_wavelen_slot(wl)),
+          _p(table.get_material_slot(surface, right_to_left)),
+          _n(table.get_material_slot(surface, !right_to_left))
+      {
+        if (_p == trace::IndexTable::none || _n == trace::IndexTable::none)
+          _w = trace::IndexTable::none;
+      }
+
+      /** refractive index ratio */
+      inline double index_ratio() const
+      {
+        if (_w != trace::IndexTable::none)
+          {
+            double r = _table.get_refractive_index(_p, _w) / _table.get_refractive_index(_n, _w);
+
+            if (!std::isnan(r))
+              return r;
+          }
+
+        return _prev->get_refractive_index(_wl) / _next->get_refractive_index(_wl);
+      }
+
+      inline double normal_transmittance() const
+      {
+        if (_w != trace::IndexTable::none)
+          {
+            double t = _table.get_normal_transmittance(_p, _n, _w);
+
+            if (!std::isnan(t))
+              return t;
+          }
+
+        return _next->get_normal_transmittance(_prev, _wl);
+      }
+
+      inline double normal_reflectance() const
+      {
+        if (_w != trace::IndexTable::none)
+          {
+            double r = _table.get_normal_reflectance(_p, _n, _w);
+
+            if (!std::isnan(r))
+              return r;
+          }
+
+        return _next->get_normal_reflectance(_prev, _wl);
+      }
+
+      const trace::IndexTable &_table;
+      const material::Base *_prev, *_next;
+      double _wl;
+      unsigned int _w, _p, _n;
+    };
+
     OpticalSurface::OpticalSurface(const math::VectorPair3 &p,
                                    const const_ref<curve::Base> &curve,
                                    const const_ref<shape::Base> &shape,
@@ -136,7 +205,9 @@ namespace _goptical {
       }
 
       double wl = incident.get_wavelen();
-      double index = prev_mat->get_refractive_index(wl) / next_mat->get_refractive_index(wl);
+      surface_media_s media(result.get_index_table(), *this, right_to_left,
+                            prev_mat, next_mat, wl);
+      double index = media.index_ratio();
 
       if (!refract(local, direction, intersect.normal(), index))
         {
@@ -183,6 +254,97 @@ namespace _goptical {
         }
     }
 
+    void OpticalSurface::refract_batch(const trace::IndexTable &table,
+                                       const trace::RayBatch &batch,
+                                       trace::RayBatch &generated) const
+    {
+      for (unsigned int i = 0; i < batch.size(); i++)
+        {
+          if (!batch.is_active(i))
+            continue;
+
+          const math::VectorPair3 local = batch.get_ray(i);
+          const math::VectorPair3 intersect = batch.get_intersect(i);
+          math::Vector3 direction;
+
+          bool right_to_left = intersect.normal().z() > 0;
+          const material::Base *prev_mat = _mat[right_to_left].ptr();
+          const material::Base *next_mat = _mat[!right_to_left].ptr();
+
+          // check ray didn't "escaped" from its material
+          if (prev_mat != batch.get_material(i))
+            continue;
+
+          double wl = batch.get_wavelen(i);
+          double intensity = batch.get_intensity(i);
+          double index = surface_media_s(table, *this, right_to_left,
+                                         prev_mat, next_mat, wl).index_ratio();
+
+          if (!refract(local, direction, intersect.normal(), index))
+            {
+              // total internal reflection
+              reflect(local, direction, intersect.normal());
+              generated.add(math::VectorPair3(intersect.origin(), direction),
+                            wl, intensity, prev_mat, i);
+              continue;
+            }
+
+          // transmit
+          if (!next_mat->is_opaque())
+            generated.add(math::VectorPair3(intersect.origin(), direction),
+                          wl, intensity, next_mat, i);
+
+          // reflect
+          if (next_mat->is_reflecting())
+            {
+              reflect(local, direction, intersect.normal());
+              generated.add(math::VectorPair3(intersect.origin(), direction),
+                            wl, intensity, prev_mat, i);
+            }
+        }
+    }
+
+    void OpticalSurface::process_rays_simple(trace::Result &result,
+                                             trace::rays_queue_t *input) const
+    {
+      trace::RayBatch &batch = result.get_ray_batch(0);
+      trace::RayBatch &generated = result.get_ray_batch(1);
+
+      intersect_rays(result, *input, batch);
+
+      for (unsigned int i = 0; i < batch.size(); i++)
+        {
+          if (!batch.is_active(i))
+            continue;
+
+          trace::Ray &incident = *(*input)[batch.get_parent(i)];
+          const math::Vector3 point = batch.get_point(i);
+
+          incident.set_len((point - batch.get_ray(i).origin()).len());
+          incident.set_intercept(*this, point);
+          incident.set_intercept_intensity(1.0);
+        }
+
+      generated.clear();
+      generated.reserve(batch.size());
+      refract_batch(result.get_index_table(), batch, generated);
+
+      for (unsigned int i = 0; i < generated.size(); i++)
+        {
+          trace::Ray &incident = *(*input)[batch.get_parent(generated.get_parent(i))];
+          trace::Ray &r = result.new_ray();
+          const math::VectorPair3 ray = generated.get_ray(i);
+
+          r.set_wavelen(generated.get_wavelen(i));
+          r.set_intensity(generated.get_intensity(i));
+          r.set_material(generated.get_material(i));
+          r.origin() = ray.origin();
+          r.direction() = ray.direction();
+          r.set_creator(this);
+          incident.add_generated(&r);
+        }
+    }
+
     void OpticalSurface::trace_ray_intensity(trace::Result &result,
                                              trace::Ray &incident,
                                              const math::VectorPair3 &local,
@@ -200,7 +362,9 @@ namespace _goptical {
         return;
 
       double wl = incident.get_wavelen();
-      double index = prev_mat->get_refractive_index(wl) / next_mat->get_refractive_index(wl);
+      surface_media_s media(result.get_index_table(), *this, right_to_left,
+                            prev_mat, next_mat, wl);
+      double index = media.index_ratio();
       double intensity = incident.get_intercept_intensity();
 
       if (!refract(local, direction, intersect.normal(), index))
@@ -222,7 +386,7 @@ namespace _goptical {
       // transmit
       if (!next_mat->is_opaque())
         {
-          double tintensity = intensity * next_mat->get_normal_transmittance(prev_mat, wl);
+          double tintensity = intensity * media.normal_transmittance();
 
           if (tintensity >= get_discard_intensity())
             {
@@ -240,7 +404,7 @@ namespace _goptical {
 
       // reflect
       {
-        double rintensity = intensity * next_mat->get_normal_reflectance(prev_mat, wl);
+        double rintensity = intensity * media.normal_reflectance();
 
         if (rintensity >= get_discard_intensity())
           {
@@ -266,6 +430,8 @@ namespace _goptical {
         _mat[index] = get_system()->get_environment_proxy();
       else
         _mat[index] = m;
+
+      update_version();
     }
 
     void OpticalSurface::system_register(system &s)
@@ -74,9 +74,11 @@ namespace _goptical {
       double rlen = result.get_params().get_lost_ray_length();
       const trace::Distribution &d = result.get_params().get_distribution(*starget);
 
+      const math::Transform<3> t = starget->get_transform_to(*this);
+
       // i is point on target surface
       auto de = [&]( const math::Vector3 &i ) {
-          math::Vector3 pp = starget->get_transform_to(*this).transform(i);  // pattern point on target surface
+          math::Vector3 pp = t.transform(i);  // pattern point on target surface
 
           if (i[0] < _limit1[0] ||
               i[0] > _limit2[0] ||
@@ -113,7 +115,7 @@ namespace _goptical {
                       r.set_creator(this);
                       r.set_intensity(l.get_intensity()); // FIXME depends on distance from source and pattern density
                       r.set_wavelen(l.get_wavelen());
-                      r.set_material(_mat.valid() ? _mat.ptr() : &get_system()->get_environment_proxy());
+                      r.set_material(_mat.valid() ? _mat.ptr() : &result.get_system().get_environment_proxy());
                   }
 
                   for (double rad_angle_tan = std::tan(_halfsize); std::atan(rad_angle_tan) > epsilon; rad_angle_tan -= step)
@@ -136,7 +138,7 @@ namespace _goptical {
                           r.set_creator(this);
                           r.set_intensity(l.get_intensity()); // FIXME depends on distance from source and pattern density
                           r.set_wavelen(l.get_wavelen());
-                          r.set_material(_mat.valid() ? _mat.ptr() : &get_system()->get_environment_proxy());
+                          r.set_material(_mat.valid() ? _mat.ptr() : &result.get_system().get_environment_proxy());
                       }
                   }
               }
@@ -146,7 +148,12 @@ namespace _goptical {
 
       };
 
-      starget->get_pattern(de, d, result.get_params().get_unobstructed());
+      // pattern is kept by the target surface between traces
+      std::shared_ptr<const std::vector<math::Vector3> > pattern =
+        starget->get_pattern(d, result.get_params().get_unobstructed());
+
+      for (auto &i : *pattern)
+        de(i);
 
     }
 
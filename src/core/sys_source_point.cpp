@@ -61,8 +61,10 @@ namespace _goptical {
       double rlen = result.get_params().get_lost_ray_length();
       const trace::Distribution &d = result.get_params().get_distribution(*starget);
 
+      const math::Transform<3> t = starget->get_transform_to(*this);
+
       auto de = [&]( const math::Vector3 &i ) {
-          math::Vector3 r = starget->get_transform_to(*this).transform(i);  // pattern point on target surface
+          math::Vector3 r = t.transform(i);  // pattern point on target surface
           math::Vector3 direction;
           math::Vector3 position;
 
@@ -91,11 +93,16 @@ namespace _goptical {
               r.set_creator(this);
               r.set_intensity(l.get_intensity()); // FIXME depends on distance from source and pattern density
               r.set_wavelen(l.get_wavelen());
-              r.set_material(_mat.valid() ? _mat.ptr() : &get_system()->get_environment_proxy());
+              r.set_material(_mat.valid() ? _mat.ptr() : &result.get_system().get_environment_proxy());
           }
       };
       
-      starget->get_pattern(de, d, result.get_params().get_unobstructed());
+      // pattern is kept by the target surface between traces
+      std::shared_ptr<const std::vector<math::Vector3> > pattern =
+        starget->get_pattern(d, result.get_params().get_unobstructed());
+
+      for (auto &i : *pattern)
+        de(i);
 
     }
         
@@ -144,7 +144,7 @@ namespace _goptical {
                                           const targets_t &entry) const
     {
       const material::Base *m = _mat.valid()
-        ? _mat.ptr() : &get_system()->get_environment_proxy();
+        ? _mat.ptr() : &result.get_system().get_environment_proxy();
 
       for (auto&w :  _wl_map) {
           if (w.second)
@@ -175,6 +175,19 @@ namespace _goptical {
       r.group_end();
     }
 
+    math::VectorPair3 Stop::get_bounding_box() const
+    {
+      math::Vector3 hs(_external_radius, _external_radius, 0);
+
+      return math::VectorPair3(-hs, hs);
+    }
+
+    bool Stop::get_exact_bounding_box(math::VectorPair3 &box) const
+    {
+      box = get_bounding_box();
+      return true;
+    }
+
     void Stop::draw_2d_e(io::Renderer &r, const Element *ref) const
     {
       math::Vector3 mr(0, _external_radius, 0);
@@ -31,6 +31,7 @@
 #include <goptical/core/shape/Ring>
 
 #include <goptical/core/curve/Base>
+#include <goptical/core/curve/Tabulated>
 
 #include <goptical/core/math/Vector>
 #include <goptical/core/math/Triangle>
@@ -38,8 +39,10 @@
 #include <goptical/core/light/Ray>
 
 #include <goptical/core/trace/Distribution>
+#include <goptical/core/trace/RayBatch>
 #include <goptical/core/trace/Ray>
 #include <goptical/core/trace/Result>
+#include <goptical/core/trace/IndexTable>
 #include <goptical/core/trace/Params>
 
 #include <goptical/core/io/Renderer>
@@ -56,12 +59,27 @@ namespace _goptical {
       : Element(p),
         _discard_intensity(0),
         _curve(curve),
-        _shape(shape)
+        _shape(shape),
+        _table_lock(),
+        _tables(0),
+        _patterns_lock(),
+        _patterns()
     {
     }
 
     Surface::~Surface()
     {
+      free_tables(_tables.load(std::memory_order_relaxed));
+    }
+
+    void Surface::free_tables(const struct table_s *t)
+    {
+      while (t)
+        {
+          const struct table_s *next = t->_next;
+          delete t;
+          t = next;
+        }
     }
 
     void Surface::get_pattern(const math::Vector3::put_delegate_t &f,
@@ -76,6 +94,72 @@ namespace _goptical {
       _shape->get_pattern(de, d, unobstructed);
     }
 
+    std::shared_ptr<const std::vector<math::Vector3> >
+    Surface::get_pattern(const trace::Distribution &d, bool unobstructed) const
+    {
+      unsigned int curve_version = _curve->get_version();
+      unsigned int shape_version = _shape->get_version();
+
+      {
+        std::lock_guard<std::mutex> lock(_patterns_lock);
+
+        for (auto i = _patterns.begin(); i != _patterns.end(); )
+          {
+            // drop patterns of a previous curve or shape
+            if (i->_curve.ptr() != _curve.ptr() || i->_curve_version != curve_version ||
+                i->_shape.ptr() != _shape.ptr() || i->_shape_version != shape_version)
+              {
+                i = _patterns.erase(i);
+                continue;
+              }
+
+            if (i->_dist == d && i->_unobstructed == unobstructed)
+              {
+                // most recently used first
+                _patterns.splice(_patterns.begin(), _patterns, i);
+
+                return _patterns.front()._points;
+              }
+
+            ++i;
+          }
+      }
+
+      // pattern is computed without holding the lock
+      std::vector<math::Vector2> points;
+
+      _shape->get_pattern([&](const math::Vector2 &v2d) {
+          points.push_back(v2d);
+        }, d, unobstructed);
+
+      std::shared_ptr<std::vector<math::Vector3> > p3d =
+        std::make_shared<std::vector<math::Vector3> >();
+
+      p3d->reserve(points.size());
+
+      for (auto &v2d : points)
+        p3d->push_back(math::Vector3(v2d, _curve->sagitta(v2d)));
+
+      pattern_s p;
+
+      p._dist = d;
+      p._unobstructed = unobstructed;
+      p._curve = _curve;
+      p._shape = _shape;
+      p._curve_version = curve_version;
+      p._shape_version = shape_version;
+      p._points = p3d;
+
+      std::lock_guard<std::mutex> lock(_patterns_lock);
+
+      if (_patterns.size() >= pattern_cache_size)
+        _patterns.pop_back();
+
+      _patterns.push_front(std::move(p));
+
+      return p3d;
+    }
+
     void Surface::trace_ray_simple(trace::Result &result, trace::Ray &incident,
                                    const math::VectorPair3 &local, const math::VectorPair3 &intersect) const
     {
@@ -94,22 +178,153 @@ namespace _goptical {
       throw Error("polarized ray trace not handled by this surface class");
     }
 
+    void Surface::update_curve_table(double tolerance, unsigned int threads) const
+    {
+      if (tolerance <= 0)
+        return;
+
+      std::lock_guard<std::mutex> lock(_table_lock);
+
+      unsigned int version = get_version();
+      unsigned int curve_version = _curve->get_version();
+      unsigned int shape_version = _shape->get_version();
+      const struct table_s *tables = _tables.load(std::memory_order_relaxed);
+
+      // all tables are built for the same surface, curve and shape
+      // versions, tables of previous versions can not be in use by a
+      // running tracer
+      if (tables && (tables->_version != version ||
+                     tables->_curve_version != curve_version ||
+                     tables->_shape_version != shape_version))
+        {
+          _tables.store(0, std::memory_order_relaxed);
+          free_tables(tables);
+          tables = 0;
+        }
+
+      for (const struct table_s *t = tables; t; t = t->_next)
+        if (t->_tolerance == tolerance)
+          return;
+
+      struct table_s *t = new table_s;
+
+      t->_tolerance = tolerance;
+      t->_version = version;
+      t->_curve_version = curve_version;
+      t->_shape_version = shape_version;
+      t->_next = tables;
+
+      if (_curve->is_tabulation_useful())
+        {
+          try {
+            t->_curve = ref<curve::Tabulated>::create(_curve, _shape->max_radius(),
+                                                      tolerance, threads);
+          } catch (...) {
+            // surface curve is used if it can not be sampled
+          }
+        }
+
+      // tables are never modified once published
+      _tables.store(t, std::memory_order_release);
+    }
+
+    const curve::Base & Surface::get_trace_curve(const trace::Params &params) const
+    {
+      double tolerance = params.get_sag_table_tolerance();
+
+      if (tolerance > 0)
+        for (const struct table_s *t = _tables.load(std::memory_order_acquire);
+             t; t = t->_next)
+          if (t->_tolerance == tolerance)
+            {
+              if (t->_curve.valid() && t->_version == get_version() &&
+                  t->_curve_version == _curve->get_version() &&
+                  t->_shape_version == _shape->get_version())
+                return *t->_curve;
+              break;
+            }
+
+      return *_curve;
+    }
+
     bool Surface::intersect(const trace::Params &params, math::VectorPair3 &pt, const math::VectorPair3 &ray) const
     {
-      if (!_curve->intersect(pt.origin(), ray))
+      const curve::Base &curve = get_trace_curve(params);
+
+      if (!curve.intersect(pt.origin(), ray))
         return false;
 
       if (!params.get_unobstructed() &&
           !_shape->inside(pt.origin().project_xy()))
         return false;
 
-      _curve->normal(pt.normal(), pt.origin());
+      curve.normal(pt.normal(), pt.origin());
       if (ray.direction().z() < 0)
         pt.normal() = -pt.normal();
 
       return true;
     }
 
+    void Surface::intersect_batch(const trace::Params &params, trace::RayBatch &batch) const
+    {
+      const curve::Base &curve = get_trace_curve(params);
+
+      curve.intersect_batch(batch);
+
+      if (!params.get_unobstructed())
+        _shape->inside_batch(batch);
+
+      curve.normal_batch(batch);
+
+      const double *dz = batch.get_direction_array(2);
+      const unsigned char *active = batch.get_active_array();
+      double *n[3] = { batch.get_normal_array(0),
+                       batch.get_normal_array(1),
+                       batch.get_normal_array(2) };
+
+      for (unsigned int i = 0; i < batch.size(); i++)
+        {
+          if (active[i] && dz[i] < 0)
+            {
+              n[0][i] = -n[0][i];
+              n[1][i] = -n[1][i];
+              n[2][i] = -n[2][i];
+            }
+        }
+    }
+
+    void Surface::intersect_rays(trace::Result &result, const trace::rays_queue_t &input,
+                                 trace::RayBatch &batch) const
+    {
+      const sys::Element *creator = 0;
+      math::Transform<3> t;
+
+      batch.clear();
+      batch.reserve(input.size());
+
+      for (unsigned int i = 0; i < input.size(); i++)
+        {
+          const trace::Ray &ray = *input[i];
+
+          if (ray.get_creator() != creator)
+            {
+              creator = ray.get_creator();
+              t = creator->get_transform_to(*this);
+            }
+
+          batch.add(t.transform_line(ray), ray.get_wavelen(),
+                    ray.get_intensity(), ray.get_material(), i);
+        }
+
+      intersect_batch(result.get_params(), batch);
+
+      result.add_intersect_iterations(*this, batch.get_iterations());
+
+      for (unsigned int i = 0; i < batch.size(); i++)
+        if (batch.is_active(i))
+          result.add_intercepted(*this, *input[batch.get_parent(i)]);
+    }
+
     template <trace::IntensityMode m>
     void Surface::trace_ray(trace::Result &result, trace::Ray &incident,
                             const math::VectorPair3 &local, const math::VectorPair3 &pt) const
@@ -125,9 +340,16 @@ namespace _goptical {
       else
         {
           // apply absorbtion from current material
-          double i_intensity = incident.get_intensity() *
-            incident.get_material()->get_internal_transmittance(
-                          incident.get_wavelen(), incident.get_len());
+          const trace::IndexTable &table = result.get_index_table();
+          unsigned int mat = table.get_material_slot(incident.get_material());
+          unsigned int wl = table.get_wavelen_slot(incident.get_wavelen());
+          double t = mat != trace::IndexTable::none && wl != trace::IndexTable::none
+            ? table.get_internal_transmittance(mat, wl) : NAN;
+
+          double i_intensity = incident.get_intensity() * (!std::isnan(t)
+            ? pow(t, incident.get_len())
+            : incident.get_material()->get_internal_transmittance(
+                          incident.get_wavelen(), incident.get_len()));
 
           incident.set_intercept_intensity(i_intensity);
 
@@ -154,21 +376,15 @@ namespace _goptical {
     inline void Surface::process_rays_(trace::Result &result,
                                        trace::rays_queue_t *input) const
     {
-      const trace::Params &params = result.get_params();
+      trace::RayBatch &batch = result.get_ray_batch(0);
 
-      for(auto& i : *input)
-        {
-          math::VectorPair3 pt;
-          trace::Ray  &ray = *i;
-
-          const math::Transform<3> &t = ray.get_creator()->get_transform_to(*this);
-          math::VectorPair3 local(t.transform_line(ray));
+      intersect_rays(result, *input, batch);
 
-          if (intersect(params, pt, local))
-            {
-              result.add_intercepted(*this, ray);
-              trace_ray<m>(result, ray, local, pt);
-            }
+      for (unsigned int i = 0; i < batch.size(); i++)
+        {
+          if (batch.is_active(i))
+            trace_ray<m>(result, *(*input)[batch.get_parent(i)],
+                         batch.get_ray(i), batch.get_intersect(i));
         }
     }
 
@@ -195,16 +411,42 @@ namespace _goptical {
       return r.get_style_color(io::StyleSurface);
     }
 
+    bool Surface::get_exact_bounding_box(math::VectorPair3 &box) const
+    {
+      math::range_t sr;
+
+      if (!_curve->get_sagitta_range(_shape->max_radius(), sr))
+        return false;
+
+      math::VectorPair2 sb = _shape->get_bounding_box();
+
+      box = math::VectorPair3(math::Vector3(sb[0].x(), sb[0].y(), sr.first),
+                              math::Vector3(sb[1].x(), sb[1].y(), sr.second));
+      return true;
+    }
+
     math::VectorPair3 Surface::get_bounding_box() const
     {
       math::VectorPair2 sb = _shape->get_bounding_box();
 
-      // FIXME we assume curve is symetric here
+      // sample curve sagitta on a grid which includes shape bounding
+      // box corners and center
+      static const unsigned int n = 8;
       double z = 0;
-      double ms = _curve->sagitta(math::Vector2(_shape->max_radius()));
-
-      if (z > ms)
-        std::swap(z, ms);
+      double ms = 0;
+
+      for (unsigned int i = 0; i <= n; i++)
+        for (unsigned int j = 0; j <= n; j++)
+          {
+            math::Vector2 p(sb[0].x() + (sb[1].x() - sb[0].x()) * i / n,
+                            sb[0].y() + (sb[1].y() - sb[0].y()) * j / n);
+            double s = _curve->sagitta(p);
+
+            if (s < z)
+              z = s;
+            if (s > ms)
+              ms = s;
+          }
 
       return math::VectorPair3(math::Vector3(sb[0].x(), sb[0].y(), z),
                                  math::Vector3(sb[1].x(), sb[1].y(), ms));
@@ -34,6 +34,7 @@
 #include <goptical/core/trace/Params>
 #include <goptical/core/math/Transform>
 #include <goptical/core/trace/Ray>
+#include <goptical/core/trace/CompiledSystem>
 #include <goptical/core/material/Air>
 #include <goptical/core/material/Proxy>
 
@@ -47,7 +48,13 @@ namespace _goptical {
         _tracer_params(),
         _e_count(0),
         _index_map(),
-        _transform_cache()
+        _index_free(),
+        _transform_cache(),
+        _transform_dirty(),
+        _transform_outdated(false),
+        _transform_lock(),
+        _compiled_lock(),
+        _compiled()
     {
       transform_cache_resize(1);
       // index 0 is reserved for global coordinates transformations
@@ -56,7 +63,6 @@ namespace _goptical {
 
     system::~system()
     {
-      transform_cache_flush();
       remove_all();
     }
 
@@ -86,14 +92,31 @@ namespace _goptical {
       _env_proxy.set_material(env);
     }
 
-    const math::Transform<3> & system::transform_l2g_cache_update(const Element &element) const
+    void system::transform_cache_update() const
     {
-      math::Transform<3> * & e = transform_cache_entry(element.id(), 0);
+      std::lock_guard<std::mutex> lock(_transform_lock);
 
-      if (!e)
+      // an other thread may have done the job
+      if (!_transform_outdated.load(std::memory_order_relaxed))
+        return;
+
+      for (unsigned int id : _transform_dirty)
         {
-          math::Transform<3> t(element._transform);
-          const Element *i1 = &element;
+          struct transform_s &ts = _transform_cache[id];
+          const Element *element = _index_map[id];
+
+          if (!ts._dirty)
+            continue;
+
+          ts._dirty = false;
+
+          if (!element)
+            continue;
+
+          math::Transform<3> &t = ts._l2g;
+          const Element *i1 = element;
+
+          t = element->_transform;
 
           while (const Element *i2 = dynamic_cast<Group *>(i1->_container))
             {
@@ -102,139 +125,133 @@ namespace _goptical {
               i1 = i2;
             }
 
-          assert(!e);
-          e = new math::Transform<3>(t);
+          ts._g2l = t.inverse();
         }
 
-      return *e;
+      _transform_dirty.clear();
+      _transform_outdated.store(false, std::memory_order_release);
     }
 
-    const math::Transform<3> & system::transform_g2l_cache_update(const Element &element) const
+    void system::transform_cache_flush(const Element &element)
     {
-      math::Transform<3> * & e = transform_cache_entry(0, element.id());
+      struct transform_s &ts = _transform_cache[element.id()];
 
-      if (!e)
-        e = new math::Transform<3>(transform_l2g_cache_update(element).inverse());
+      if (ts._dirty)
+        return;
 
-      return *e;
+      ts._dirty = true;
+      _transform_dirty.push_back(element.id());
+      _transform_outdated.store(true, std::memory_order_release);
     }
 
-    const math::Transform<3> & system::transform_cache_update(const Element &from, const Element &to) const
+    void system::transform_cache_flush()
     {
-      assert(&from != &to);
+      for (unsigned int id = 1; id < _e_count; id++)
+        if (_index_map[id])
+          transform_cache_flush(*_index_map[id]);
+    }
 
-      math::Transform<3> * & e = transform_cache_entry(from.id(), to.id());
+    void system::transform_cache_resize(unsigned int newsize)
+    {
+      static const struct transform_s ts = { math::Transform<3>(), math::Transform<3>(), false };
 
-      if (!e)
+      if (_transform_cache.empty())
         {
-          const math::Transform<3> &t1 = transform_l2g_cache_update(from);
-          const math::Transform<3> &t2 = transform_l2g_cache_update(to);
-
-          if (!e)
-            {
-              e = new math::Transform<3>(t1);
-              e->compose(t2.inverse());
-            }
+          // global coordinates entry
+          _transform_cache.push_back(ts);
+          _transform_cache[0]._l2g.reset();
+          _transform_cache[0]._g2l.reset();
         }
 
-      return *e;
-    }
+      _index_map.resize(newsize, 0);
+      _transform_cache.resize(newsize, ts);
 
-    void system::transform_cache_flush(const Element &element)
-    {
-      for (unsigned int x = 0; x < _e_count; x++)
+      // drop dirty ids of released entries
+      if (newsize < _e_count)
         {
-          if (math::Transform<3> * & t = transform_cache_entry(element.id(), x))
-            {
-              delete t;
-              t = 0;
-            }
+          unsigned int j = 0;
 
-          if (math::Transform<3> * & t = transform_cache_entry(x, element.id()))
-            {
-              delete t;
-              t = 0;
-            }
+          for (unsigned int id : _transform_dirty)
+            if (id < newsize)
+              _transform_dirty[j++] = id;
+
+          _transform_dirty.resize(j);
         }
+
+      _e_count = newsize;
     }
 
-    void system::transform_cache_flush()
+    void system::reserve(unsigned int count)
     {
-      for (unsigned int x = 0; x < _e_count; x++)
-        for (unsigned int y = 0; y < _e_count; y++)
-          if (math::Transform<3> * & t = transform_cache_entry(x, y))
-            {
-              delete t;
-              t = 0;
-            }
+      _index_map.reserve(_e_count + count);
+      _transform_cache.reserve(_e_count + count);
     }
 
-    void system::transform_cache_resize(unsigned int newsize)
+    unsigned int system::index_get(Element &element)
     {
-      unsigned int oldsize = _e_count;
+      unsigned int index = 0;
 
-      if (oldsize < newsize)
+      // free list may contain identifiers dropped or reallocated
+      // after table downsize
+      while (!_index_free.empty() && !index)
         {
-          _index_map.resize(newsize, 0);
-          _transform_cache.resize(newsize * newsize, 0);
+          index = _index_free.back();
+          _index_free.pop_back();
 
-          for (int y = oldsize - 1; y > 0; y--)
-            {
-              // move data
-              for (int x = oldsize - 1; x >= 0; x--)
-                {
-                  _transform_cache[y * newsize + x] =
-                    _transform_cache[y * oldsize + x];
-
-                  _transform_cache[y * oldsize + x] = 0;
-                }
-            }
-
-          _e_count = newsize;
+          if (index >= _e_count || _index_map[index])
+            index = 0;
         }
-      else
-        {
-          // FIXME handle cache downsize
-        }
-
-    }
 
-    unsigned int system::index_get(Element &element)
-    {
-      std::vector<Element*>::iterator i;
-      unsigned int index;
-
-      i = std::find(_index_map.begin(), _index_map.end(), (Element*)0);
-
-      if (i == _index_map.end())
+      if (!index)
         {
           index = _e_count;
           transform_cache_resize(index + 1);
         }
-      else
+
+      _index_map[index] = &element;
+
+      // transforms are computed on first access
+      if (!_transform_cache[index]._dirty)
         {
-          index = _index_map.begin() - i;
+          _transform_cache[index]._dirty = true;
+          _transform_dirty.push_back(index);
         }
 
-      _index_map[index] = &element;
+      _transform_outdated.store(true, std::memory_order_release);
 
       return index;
     }
 
     void system::index_put(const Element &element)
     {
-      transform_cache_flush(element);
+      unsigned int size = _e_count;
+
       _index_map[element.id()] = 0;
+      _index_free.push_back(element.id());
+
+      // release unused identifiers at end of table
+      while (size > 1 && !_index_map[size - 1])
+        size--;
+
+      if (size < _e_count)
+        transform_cache_resize(size);
+
+      if (size == 1)
+        _index_free.clear();
     }
 
     void system::transform_cache_dump(std::ostream &o) const
     {
-      o << "system transform cache size is " << _e_count << "x" << _e_count << std::endl;
+      o << "system transform cache size is " << _e_count << std::endl;
 
-      for (unsigned int from = 0; from < _e_count; from++)
-        for (unsigned int to = 0; to < _e_count; to++)
-          if (const math::Transform<3> *t = _transform_cache[from * _e_count + to])
-            o << "from " << from << " to " << to << ":" << std::endl << *t << std::endl;
+      for (unsigned int id = 1; id < _e_count; id++)
+        if (_index_map[id])
+          {
+            const struct transform_s &ts = transform_cache_entry(*_index_map[id]);
+
+            o << "local to global " << id << ":" << std::endl << ts._l2g << std::endl;
+            o << "global to local " << id << ":" << std::endl << ts._g2l << std::endl;
+          }
     }
 
     const Surface & system::get_entrance_pupil() const
@@ -255,49 +272,24 @@ namespace _goptical {
       return *res;
     }
 
-    /** FIXME write an optimized version of this function which uses
-        some kind of data structure (bsp tree?) */
-    Surface *system::colide_next(const trace::Params &params,
-                                 math::VectorPair3 &intersect,
-                                 const trace::Ray &ray) const
+    std::shared_ptr<const trace::CompiledSystem> system::get_compiled() const
     {
-      const Element *origin = ray.get_creator();
-
-      // test all elements and keep closest intersection
-
-      Surface *s, *e = 0;
-      math::VectorPair3 inter;
-      double    min_dist = std::numeric_limits<double>::max();
-
-      for (unsigned int i = 1; i <= get_element_count(); i++)
-        {
-          Element *j = &get_element(i);
-
-          if (j == origin || !j->is_enabled())
-            continue;
+      // tracers of the same system may run in different threads,
+      // snapshots are replaced but never modified
+      std::lock_guard<std::mutex> lock(_compiled_lock);
 
-          if ((s = dynamic_cast<Surface*>(j)))
-            {
-              const math::Transform<3> &t = origin->get_transform_to(*s);
-              math::VectorPair3 local(t.transform_line(ray));
-
-              if (s->intersect(params, inter, local))
-                {
-                  double        dist = (inter.origin() - local.origin()).len();
-
-                  if (min_dist > dist)
-                    {
-                      min_dist = dist;
-                      intersect = inter;
-                      e = s;
-                    }
-                }
-            }
-        }
+      if (!_compiled || _compiled->is_outdated())
+        _compiled = std::make_shared<const trace::CompiledSystem>(*this);
 
-      return e;
+      return _compiled;
     }
 
+    Surface *system::colide_next(const trace::Params &params,
+                                 math::VectorPair3 &intersect,
+                                 const trace::Ray &ray) const
+    {
+      return get_compiled()->colide_next(params, intersect, ray);
+    }
 
   }
 
@@ -0,0 +1,87 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+   Split work on index ranges between threads.
+*/
+
+#ifndef GOPTICAL_THREAD_RANGES_HXX_
+#define GOPTICAL_THREAD_RANGES_HXX_
+
+#include <thread>
+#include <vector>
+#include <exception>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+
+namespace _goptical {
+
+  /* process [0, count) as contiguous ranges on multiple threads,
+     range i is processed by thread i. The calling thread processes
+     the first range. Exceptions thrown by work are rethrown once
+     all threads have completed. */
+  static inline void run_ranges(unsigned int count, unsigned int threads,
+                                const std::function<void (unsigned int index, unsigned int first,
+                                                          unsigned int last)> &work)
+  {
+    threads = std::max(1u, std::min(threads, count));
+
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread> t;
+
+    auto run = [&](unsigned int i)
+      {
+        try {
+          // 64 bits products, count * threads may not fit in 32 bits
+          work(i, (uint64_t)count * i / threads,
+               (uint64_t)count * (i + 1) / threads);
+        } catch (...) {
+          errors[i] = std::current_exception();
+        }
+      };
+
+    try {
+      for (unsigned int i = 1; i < threads; i++)
+        t.push_back(std::thread(run, i));
+    } catch (...) {
+      for (auto &i : t)
+        i.join();
+      throw;
+    }
+
+    run(0);
+
+    for (auto &i : t)
+      i.join();
+
+    for (auto &e : errors)
+      if (e)
+        std::rethrow_exception(e);
+  }
+
+}
+
+#endif
+
@@ -0,0 +1,428 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <goptical/core/trace/CompiledSystem>
+#include <goptical/core/trace/Params>
+#include <goptical/core/trace/Ray>
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/Source>
+#include <goptical/core/sys/Surface>
+#include <goptical/core/sys/OpticalSurface>
+#include <goptical/core/material/Proxy>
+#include <goptical/core/math/Transform>
+#include <goptical/core/math/VectorPair>
+
+namespace _goptical {
+
+  namespace trace {
+
+    // maximum size of creators to surfaces transforms table
+    static const size_t max_transforms = 1 << 16;
+
+    CompiledSystem::CompiledSystem(const sys::system &system)
+      : _system(&system),
+        _version(0),
+        _surfaces_version(0),
+        _elements(),
+        _sources(),
+        _surfaces(),
+        _transforms(),
+        _nodes(),
+        _tree_surfaces(),
+        _unbounded(0)
+    {
+      build();
+    }
+
+    unsigned int CompiledSystem::get_surfaces_version() const
+    {
+      // all versions only increase, so does the sum
+      unsigned int v = 0;
+
+      for (auto &s : _surfaces)
+        v += s->get_curve().get_version() + s->get_shape().get_version();
+
+      return v;
+    }
+
+    bool CompiledSystem::is_outdated() const
+    {
+      // bounding boxes depend on curves and shapes
+      return _version != _system->get_version() ||
+        _surfaces_version != get_surfaces_version();
+    }
+
+    static const material::Base * resolve_proxy(const material::Base *m)
+    {
+      while (const material::Proxy *p = dynamic_cast<const material::Proxy *>(m))
+        m = &p->get_material();
+
+      return m;
+    }
+
+    void CompiledSystem::build()
+    {
+      const sys::system &sys = *_system;
+      unsigned int count = sys.get_element_count();
+
+      _elements.resize(count + 1);
+      _sources.clear();
+      _surfaces.clear();
+      _transforms.clear();
+      _nodes.clear();
+      _tree_surfaces.clear();
+      _unbounded = 0;
+
+      std::vector<const sys::Element *> creators;
+
+      // elements types, index 0 is reserved for global coordinates
+      for (unsigned int i = 0; i <= count; i++)
+        {
+          struct element_s &es = _elements[i];
+          const sys::Element *e = i ? sys._index_map[i] : 0;
+
+          es._element = e;
+          es._type = ElementOther;
+          es._creator = none;
+          es._surface = none;
+          es._material[0] = es._material[1] = 0;
+
+          if (!e)
+            continue;
+
+          es._global = e->get_global_transform();
+
+          if (dynamic_cast<const sys::Source *>(e))
+            {
+              es._type = ElementSource;
+
+              if (e->is_enabled())
+                creators.push_back(e);
+            }
+          else if (const sys::Surface *s = dynamic_cast<const sys::Surface *>(e))
+            {
+              es._type = ElementSurface;
+
+              if (const sys::OpticalSurface *os = dynamic_cast<const sys::OpticalSurface *>(s))
+                {
+                  es._type = ElementOpticalSurface;
+                  es._material[0] = resolve_proxy(&os->get_material(0));
+                  es._material[1] = resolve_proxy(&os->get_material(1));
+                }
+
+              if (!e->is_enabled())
+                continue;
+
+              es._surface = _surfaces.size();
+              _surfaces.push_back(s);
+              creators.push_back(e);
+            }
+        }
+
+      sys.get_elements<sys::Source>([&](const sys::Source &s)
+        {
+          if (s.is_enabled())
+            _sources.push_back(&s);
+        });
+
+      // transforms between rays creators and surfaces
+      if (creators.size() * _surfaces.size() <= max_transforms)
+        {
+          _transforms.resize(creators.size() * _surfaces.size());
+
+          for (unsigned int c = 0; c < creators.size(); c++)
+            {
+              _elements[creators[c]->id()]._creator = c;
+
+              for (unsigned int s = 0; s < _surfaces.size(); s++)
+                {
+                  math::Transform<3> &t = _transforms[c * _surfaces.size() + s];
+
+                  if (creators[c] == _surfaces[s])
+                    t.reset();
+                  else
+                    t = creators[c]->get_transform_to(*_surfaces[s]);
+                }
+            }
+        }
+
+      // surfaces bounding volume hierarchy
+      std::vector<struct tree_surface_s> bounded;
+
+      for (unsigned int i = 0; i < _surfaces.size(); i++)
+        {
+          const sys::Surface *s = _surfaces[i];
+
+          struct tree_surface_s ts;
+          ts._surface = i;
+
+          math::VectorPair3 lb;
+          const math::Transform<3> &t = _elements[s->id()]._global;
+
+          // surfaces without exact bounds are always tested
+          bool unbounded = !s->get_exact_bounding_box(lb)
+            || lb[0].x() >= lb[1].x() || lb[0].y() >= lb[1].y();
+
+          // global box enclosing all transformed local box corners
+          for (unsigned int c = 0; !unbounded && c < 8; c++)
+            {
+              math::Vector3 p(t.transform(math::Vector3(lb[c & 1].x(),
+                                                        lb[(c >> 1) & 1].y(),
+                                                        lb[(c >> 2) & 1].z())));
+
+              for (unsigned int j = 0; j < 3; j++)
+                {
+                  if (!std::isfinite(p[j]))
+                    unbounded = true;
+
+                  if (c == 0 || p[j] < ts._box[0][j])
+                    ts._box[0][j] = p[j];
+                  if (c == 0 || p[j] > ts._box[1][j])
+                    ts._box[1][j] = p[j];
+                }
+            }
+
+          if (unbounded)
+            {
+              _tree_surfaces.push_back(ts);
+              _unbounded++;
+              continue;
+            }
+
+          // enlarge box to cope with rounding errors
+          for (unsigned int j = 0; j < 3; j++)
+            {
+              double m = std::max(fabs(ts._box[0][j]), fabs(ts._box[1][j]));
+              double e = 1e-6 * (1.0 + m + ts._box[1][j] - ts._box[0][j]);
+
+              ts._box[0][j] -= e;
+              ts._box[1][j] += e;
+            }
+
+          bounded.push_back(ts);
+        }
+
+      _tree_surfaces.insert(_tree_surfaces.end(), bounded.begin(), bounded.end());
+
+      if (_tree_surfaces.size() > _unbounded)
+        tree_build(_unbounded, _tree_surfaces.size());
+
+      _version = sys.get_version();
+      _surfaces_version = get_surfaces_version();
+    }
+
+    unsigned int CompiledSystem::tree_build(unsigned int first, unsigned int last)
+    {
+      unsigned int n = _nodes.size();
+      _nodes.push_back(node_s());
+
+      math::VectorPair3 box(_tree_surfaces[first]._box);
+      math::VectorPair3 center(math::vector3_0, math::vector3_0);
+
+      for (unsigned int i = first; i < last; i++)
+        {
+          const math::VectorPair3 &b = _tree_surfaces[i]._box;
+
+          for (unsigned int j = 0; j < 3; j++)
+            {
+              double c = (b[0][j] + b[1][j]) / 2.0;
+
+              box[0][j] = std::min(box[0][j], b[0][j]);
+              box[1][j] = std::max(box[1][j], b[1][j]);
+
+              if (i == first || c < center[0][j])
+                center[0][j] = c;
+              if (i == first || c > center[1][j])
+                center[1][j] = c;
+            }
+        }
+
+      _nodes[n]._box = box;
+
+      // split along largest box centers spread axis
+      unsigned int axis = 0;
+      math::Vector3 spread(center[1] - center[0]);
+
+      for (unsigned int j = 1; j < 3; j++)
+        if (spread[j] > spread[axis])
+          axis = j;
+
+      if (last - first <= 4 || spread[axis] <= 0)
+        {
+          _nodes[n]._first = first;
+          _nodes[n]._count = last - first;
+          return n;
+        }
+
+      unsigned int middle = (first + last) / 2;
+
+      std::nth_element(_tree_surfaces.begin() + first,
+                       _tree_surfaces.begin() + middle,
+                       _tree_surfaces.begin() + last,
+                       [=](const struct tree_surface_s &a, const struct tree_surface_s &b)
+                       {
+                         return a._box[0][axis] + a._box[1][axis] <
+                                b._box[0][axis] + b._box[1][axis];
+                       });
+
+      tree_build(first, middle);
+      unsigned int second = tree_build(middle, last);
+
+      _nodes[n]._first = second;
+      _nodes[n]._count = 0;
+
+      return n;
+    }
+
+    /** Test intersection between a ray and a bounding box, only box
+        parts in front of the ray origin are considered. */
+    static inline bool colide_box(const math::VectorPair3 &box,
+                                  const math::VectorPair3 &ray)
+    {
+      double tmin = 0;
+      double tmax = std::numeric_limits<double>::infinity();
+
+      for (unsigned int i = 0; i < 3; i++)
+        {
+          const double o = ray.origin()[i];
+          const double d = ray.direction()[i];
+
+          if (d == 0)
+            {
+              if (o < box[0][i] || o > box[1][i])
+                return false;
+              continue;
+            }
+
+          double t0 = (box[0][i] - o) / d;
+          double t1 = (box[1][i] - o) / d;
+
+          if (t0 > t1)
+            std::swap(t0, t1);
+
+          if (tmin < t0)
+            tmin = t0;
+          if (tmax > t1)
+            tmax = t1;
+
+          if (tmin > tmax)
+            return false;
+        }
+
+      return true;
+    }
+
+    void CompiledSystem::colide_test(const Params &params, unsigned int surface,
+                                     const sys::Element &origin, const math::VectorPair3 &ray,
+                                     math::VectorPair3 &intersect, double &min_dist,
+                                     int &hit) const
+    {
+      const sys::Surface *s = _surfaces[surface];
+
+      if (s == &origin)
+        return;
+
+      math::VectorPair3 local(get_transform(origin, *s).transform_line(ray));
+      math::VectorPair3 inter;
+
+      if (s->intersect(params, inter, local))
+        {
+          double        dist = (inter.origin() - local.origin()).len();
+
+          // keep lowest surface index when distances are equal
+          if (min_dist > dist || (hit >= 0 && min_dist == dist && hit > (int)surface))
+            {
+              min_dist = dist;
+              intersect = inter;
+              hit = surface;
+            }
+        }
+    }
+
+    sys::Surface * CompiledSystem::colide_next(const Params &params,
+                                               math::VectorPair3 &intersect,
+                                               const Ray &ray) const
+    {
+      const sys::Element &origin = *ray.get_creator();
+      double    min_dist = std::numeric_limits<double>::max();
+      int       hit = -1;
+
+      // shapes are ignored, bounding boxes can not be used
+      if (params.get_unobstructed())
+        {
+          for (unsigned int i = 0; i < _surfaces.size(); i++)
+            colide_test(params, i, origin, ray, intersect, min_dist, hit);
+        }
+      else
+        {
+          for (unsigned int i = 0; i < _unbounded; i++)
+            colide_test(params, _tree_surfaces[i]._surface, origin, ray, intersect, min_dist, hit);
+
+          if (!_nodes.empty())
+            {
+              // rays creator may not be part of the system
+              const math::Transform<3> &t = origin.id()
+                ? _elements[origin.id()]._global : origin.get_transform();
+              const math::VectorPair3 global(t.transform_line(ray));
+
+              unsigned int stack[64];
+              unsigned int sp = 0;
+
+              stack[sp++] = 0;
+
+              while (sp)
+                {
+                  unsigned int n = stack[--sp];
+                  const struct node_s &node = _nodes[n];
+
+                  if (!colide_box(node._box, global))
+                    continue;
+
+                  if (node._count)
+                    {
+                      for (unsigned int i = node._first; i < node._first + node._count; i++)
+                        if (colide_box(_tree_surfaces[i]._box, global))
+                          colide_test(params, _tree_surfaces[i]._surface, origin, ray,
+                                      intersect, min_dist, hit);
+                    }
+                  else
+                    {
+                      stack[sp++] = node._first;
+                      stack[sp++] = n + 1;
+                    }
+                }
+            }
+        }
+
+      return hit < 0 ? 0 : const_cast<sys::Surface *>(_surfaces[hit]);
+    }
+
+  }
+
+}
+
@@ -0,0 +1,124 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <goptical/core/trace/Detector>
+#include <goptical/core/trace/Ray>
+#include <goptical/core/Error>
+
+namespace _goptical {
+
+  namespace trace {
+
+    Detector::Detector(const math::VectorPair2 &window,
+                       unsigned int width, unsigned int height,
+                       bool per_wavelen)
+      : _total(GOPTICAL_REFNEW(Irradiance, window, width, height)),
+        _wavelens(),
+        _per_wavelen(per_wavelen),
+        _count(0)
+    {
+    }
+
+    Detector::~Detector()
+    {
+    }
+
+    const Irradiance & Detector::get_irradiance(double wavelen) const
+    {
+      wavelens_t::const_iterator i = _wavelens.find(wavelen);
+
+      if (i == _wavelens.end())
+        throw Error("no detector map for this wavelength");
+
+      return *i->second;
+    }
+
+    std::set<double> Detector::get_wavelen_set() const
+    {
+      std::set<double> res;
+
+      for (auto &i : _wavelens)
+        res.insert(i.first);
+
+      return res;
+    }
+
+    void Detector::clear()
+    {
+      _total->clear();
+      _wavelens.clear();
+      _count = 0;
+    }
+
+    void Detector::intercept(const sys::Surface &, const Ray &ray)
+    {
+      const math::Vector3 &p = ray.get_intercept_point();
+      math::Vector2 v(p.x(), p.y());
+      double intensity = ray.get_intercept_intensity();
+
+      _total->add(v, intensity);
+      _count++;
+
+      if (!_per_wavelen)
+        return;
+
+      ref<Irradiance> &map = _wavelens[ray.get_wavelen()];
+
+      if (!map.valid())
+        map = GOPTICAL_REFNEW(Irradiance, _total->get_window(),
+                              _total->get_width(), _total->get_height());
+
+      map->add(v, intensity);
+    }
+
+    ref<Sink> Detector::new_worker() const
+    {
+      return GOPTICAL_REFNEW(Detector, _total->get_window(), _total->get_width(),
+                             _total->get_height(), _per_wavelen);
+    }
+
+    void Detector::merge_worker(Sink &worker)
+    {
+      Detector &w = static_cast<Detector &>(worker);
+
+      _total->merge_worker(*w._total);
+      _count += w._count;
+
+      for (auto &i : w._wavelens)
+        {
+          ref<Irradiance> &map = _wavelens[i.first];
+
+          // take worker map when this wavelength is new
+          if (!map.valid())
+            map = i.second;
+          else
+            map->merge_worker(*i.second);
+        }
+
+      w._wavelens.clear();
+    }
+
+  }
+}
+
@@ -0,0 +1,180 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include <goptical/core/trace/Distribution>
+#include <goptical/core/math/RandomStream>
+#include <goptical/core/math/Vector>
+
+namespace _goptical {
+
+  namespace trace {
+
+    static inline uint32_t reverse_bits(uint32_t x)
+    {
+      x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+      x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+      x = ((x >> 4) & 0x0f0f0f0f) | ((x & 0x0f0f0f0f) << 4);
+      x = ((x >> 8) & 0x00ff00ff) | ((x & 0x00ff00ff) << 8);
+      return (x >> 16) | (x << 16);
+    }
+
+    /* second dimension of the Sobol sequence, primitive polynomial x + 1 */
+    static inline uint32_t sobol_dim1(uint32_t i)
+    {
+      uint32_t r = 0;
+
+      for (uint32_t v = 1U << 31; i; i >>= 1, v ^= v >> 1)
+        if (i & 1)
+          r ^= v;
+
+      return r;
+    }
+
+    /* nested uniform scrambling of a base 2 fraction, low bits only
+       depend on higher bits so that sequence stratification is kept */
+    static inline uint32_t scramble(uint32_t x, uint32_t seed)
+    {
+      x = reverse_bits(x);
+      x += seed;
+      x ^= x * 0x6c50b47c;
+      x ^= x * 0xb82f1e52;
+      x ^= x * 0xc7afe638;
+      x ^= x * 0x8d22f6e6;
+      return reverse_bits(x);
+    }
+
+    static inline double radical_inverse(unsigned int i, unsigned int base)
+    {
+      const double inv = 1.0 / base;
+      double f = inv, r = 0;
+
+      for (; i; i /= base, f *= inv)
+        r += (i % base) * f;
+
+      return r;
+    }
+
+    static inline double fraction(double x)
+    {
+      return x - floor(x);
+    }
+
+    void Distribution::get_unit_samples(unsigned int count,
+                                        const math::Vector2::put_delegate_t &f) const
+    {
+      static const double to_unit = 1.0 / 4294967296.0;
+      const math::RandomStream rng(_seed, _stream);
+
+      switch (_pattern)
+        {
+        case SobolDist: {
+          const uint32_t s0 = rng.get_bits(0);
+          const uint32_t s1 = rng.get_bits(1);
+
+          for (unsigned int i = 0; i < count; i++)
+            f(math::Vector2(scramble(reverse_bits(i), s0) * to_unit,
+                            scramble(sobol_dim1(i), s1) * to_unit));
+          break;
+        }
+
+        case HaltonDist: {
+          // Cranley-Patterson rotation
+          const double s0 = rng.get_uniform(0);
+          const double s1 = rng.get_uniform(1);
+
+          for (unsigned int i = 0; i < count; i++)
+            f(math::Vector2(fraction(radical_inverse(i, 2) + s0),
+                            fraction(radical_inverse(i, 3) + s1)));
+          break;
+        }
+
+        case JitteredDist: {
+          const unsigned int nx = std::max(1U, (unsigned int)ceil(sqrt((double)count)));
+          const unsigned int ny = (count + nx - 1) / nx;
+          uint64_t k = 0;
+
+          for (unsigned int j = 0; j < ny; j++)
+            for (unsigned int i = 0; i < nx; i++, k += 2)
+              f(math::Vector2((i + rng.get_uniform(k)) / nx,
+                              (j + rng.get_uniform(k + 1)) / ny));
+          break;
+        }
+
+        case RandomDist:
+          for (uint64_t k = 0; k < 2 * (uint64_t)count; k += 2)
+            f(math::Vector2(rng.get_uniform(k), rng.get_uniform(k + 1)));
+          break;
+
+        default:
+          throw Error("distribution pattern is not a sampled pattern");
+        }
+    }
+
+    void Distribution::get_disk_samples(unsigned int count, double hole_radius,
+                                        const math::Vector2::put_delegate_t &f) const
+    {
+      if (hole_radius > 0)
+        {
+          // polar mapping with equal area rings
+          const double h2 = math::square(hole_radius);
+
+          get_unit_samples(count, [&](const math::Vector2 &u)
+            {
+              double r = sqrt(h2 + u.x() * (1.0 - h2));
+              double a = 2.0 * M_PI * u.y();
+
+              f(math::Vector2(cos(a) * r, sin(a) * r));
+            });
+        }
+      else
+        {
+          // concentric mapping of square to disk, keeps adjacent
+          // samples close together
+          get_unit_samples(count, [&](const math::Vector2 &u)
+            {
+              double x = 2.0 * u.x() - 1.0;
+              double y = 2.0 * u.y() - 1.0;
+
+              if (x == 0 && y == 0)
+                f(math::vector2_0);
+              else if (fabs(x) > fabs(y))
+                {
+                  double a = (M_PI / 4) * (y / x);
+                  f(math::Vector2(cos(a) * x, sin(a) * x));
+                }
+              else
+                {
+                  double a = (M_PI / 2) - (M_PI / 4) * (x / y);
+                  f(math::Vector2(cos(a) * y, sin(a) * y));
+                }
+            });
+        }
+    }
+
+  }
+}
+
@@ -0,0 +1,189 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include <goptical/core/trace/IndexTable>
+#include <goptical/core/trace/CompiledSystem>
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/OpticalSurface>
+#include <goptical/core/material/Base>
+#include <goptical/core/material/Proxy>
+
+namespace _goptical {
+
+  namespace trace {
+
+    IndexTable::IndexTable()
+      : _valid(false)
+    {
+    }
+
+    /* value computed by a material function, NaN on error */
+    template <typename F>
+    static double table_value(const F &f)
+    {
+      try {
+        return f();
+      } catch (...) {
+        return std::numeric_limits<double>::quiet_NaN();
+      }
+    }
+
+    void IndexTable::update(const sys::system &system, const std::set<double> &wavelens,
+                            bool intensity)
+    {
+      update(*system.get_compiled(), wavelens, intensity);
+    }
+
+    void IndexTable::update(const CompiledSystem &compiled, const std::set<double> &wavelens,
+                            bool intensity)
+    {
+      if (_valid && _wavelens.size() == wavelens.size() &&
+          std::equal(wavelens.begin(), wavelens.end(), _wavelens.begin()))
+        return;
+
+      const sys::system &system = compiled.get_system();
+
+      _wavelens.assign(wavelens.begin(), wavelens.end());
+      _materials.clear();
+      _keys.clear();
+      _elements.clear();
+
+      auto add_key = [&](const material::Base *m, unsigned int slot)
+        {
+          if (get_material_slot(m) == none)
+            {
+              struct key_s k = { m, slot };
+              _keys.push_back(k);
+            }
+        };
+
+      auto add = [&](const material::Base *m, const material::Base *resolved)
+        {
+          unsigned int slot = get_material_slot(resolved);
+
+          if (slot == none)
+            {
+              slot = _materials.size();
+              _materials.push_back(resolved);
+              add_key(resolved, slot);
+            }
+
+          add_key(m, slot);
+
+          return slot;
+        };
+
+      // environment
+      const material::Base *env = &system.get_environment_proxy();
+      const material::Base *m = env;
+
+      while (const material::Proxy *p = dynamic_cast<const material::Proxy *>(m))
+        m = &p->get_material();
+
+      add(env, m);
+
+      // optical surfaces
+      std::vector<struct element_s> pairs;
+
+      for (auto &s : compiled.get_surfaces())
+        {
+          if (compiled.get_type(*s) != CompiledSystem::ElementOpticalSurface)
+            continue;
+
+          const sys::OpticalSurface &os = static_cast<const sys::OpticalSurface &>(*s);
+          struct element_s e;
+
+          for (unsigned int i = 0; i < 2; i++)
+            e._slot[i] = add(&os.get_material(i), &compiled.get_material(os, i));
+
+          if (_elements.size() <= os.id())
+            {
+              struct element_s n = { { none, none } };
+              _elements.resize(os.id() + 1, n);
+            }
+
+          _elements[os.id()] = e;
+          pairs.push_back(e);
+        }
+
+      const unsigned int mc = _materials.size();
+      const unsigned int wc = _wavelens.size();
+      const double nan = std::numeric_limits<double>::quiet_NaN();
+
+      _index.assign(mc * wc, nan);
+      _transmittance.assign(mc * wc, nan);
+      _normal_reflectance.assign(mc * mc * wc, nan);
+      _normal_transmittance.assign(mc * mc * wc, nan);
+
+      for (unsigned int i = 0; i < mc; i++)
+        for (unsigned int w = 0; w < wc; w++)
+          {
+            const material::Base *mat = _materials[i];
+            double wl = _wavelens[w];
+
+            _index[i * wc + w] = table_value([&]() {
+                return mat->get_refractive_index(wl);
+              });
+
+            if (intensity)
+              _transmittance[i * wc + w] = table_value([&]() {
+                  return mat->get_internal_transmittance(wl, 1.0);
+                });
+          }
+
+      // interfaces between materials of optical surfaces, both ways
+      if (intensity)
+        for (auto &e : pairs)
+          for (unsigned int i = 0; i < 2; i++)
+            {
+              unsigned int from = e._slot[i], to = e._slot[!i];
+              const material::Base *f = _materials[from];
+              const material::Base *t = _materials[to];
+
+              for (unsigned int w = 0; w < wc; w++)
+                {
+                  unsigned int j = (from * mc + to) * wc + w;
+                  double wl = _wavelens[w];
+
+                  _normal_reflectance[j] = table_value([&]() {
+                      return t->get_normal_reflectance(f, wl);
+                    });
+
+                  _normal_transmittance[j] = table_value([&]() {
+                      return t->get_normal_transmittance(f, wl);
+                    });
+                }
+            }
+
+      _valid = true;
+    }
+
+  }
+}
+
@@ -0,0 +1,189 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include <goptical/core/trace/Irradiance>
+#include <goptical/core/trace/Result>
+#include <goptical/core/trace/Ray>
+#include <goptical/core/sys/Surface>
+#include <goptical/core/Error>
+
+#include "thread_ranges_.hxx"
+
+namespace _goptical {
+
+  namespace trace {
+
+    Irradiance::Irradiance(const math::VectorPair2 &window,
+                           unsigned int width, unsigned int height)
+      : _window(window),
+        _width(0),
+        _height(0),
+        _bilinear(false)
+    {
+      set_resolution(width, height);
+    }
+
+    Irradiance::~Irradiance()
+    {
+    }
+
+    void Irradiance::set_window(const math::VectorPair2 &window)
+    {
+      math::Vector2 size = window[1] - window[0];
+
+      if (!(size.x() > 0 && size.y() > 0))
+        throw Error("irradiance map window must have a positive size");
+
+      _window = window;
+      _scale = math::Vector2(_width / size.x(), _height / size.y());
+
+      clear();
+    }
+
+    void Irradiance::set_resolution(unsigned int width, unsigned int height)
+    {
+      if (!width || !height)
+        throw Error("irradiance map must have at least one pixel");
+
+      _width = width;
+      _height = height;
+      _data.resize((size_t)width * height);
+
+      set_window(_window);
+    }
+
+    void Irradiance::clear()
+    {
+      std::fill(_data.begin(), _data.end(), 0.0);
+    }
+
+    void Irradiance::add_bilinear(double *data, double x, double y, double intensity) const
+    {
+      double fx = floor(x);
+      double fy = floor(y);
+      double tx = x - fx;
+      double ty = y - fy;
+
+      // neighbor pixels beyond map edges fold back on edge pixels
+      int x0 = std::max((int)fx, 0);
+      int y0 = std::max((int)fy, 0);
+      int x1 = std::min((int)fx + 1, (int)_width - 1);
+      int y1 = std::min((int)fy + 1, (int)_height - 1);
+
+      double *r0 = data + (size_t)y0 * _width;
+      double *r1 = data + (size_t)y1 * _width;
+
+      r0[x0] += intensity * (1.0 - tx) * (1.0 - ty);
+      r0[x1] += intensity * tx * (1.0 - ty);
+      r1[x0] += intensity * (1.0 - tx) * ty;
+      r1[x1] += intensity * tx * ty;
+    }
+
+    void Irradiance::add_intercepts(const Result &result, const sys::Surface &s,
+                                    unsigned int threads)
+    {
+      const rays_queue_t &intercepts = result.get_intercepted(s);
+
+      if (!threads)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+      // small rays lists are not worth a partial map per thread
+      threads = std::max(1u, std::min<unsigned int>(threads, intercepts.size() / 4096));
+
+      std::vector<std::vector<double> > partial(threads - 1);
+
+      run_ranges(intercepts.size(), threads,
+                 [&](unsigned int t, unsigned int first, unsigned int last)
+        {
+          double *data = &_data[0];
+
+          if (t)
+            {
+              partial[t - 1].resize(_data.size(), 0.0);
+              data = &partial[t - 1][0];
+            }
+
+          for (unsigned int i = first; i < last; i++)
+            {
+              const Ray &r = *intercepts[i];
+              const math::Vector3 &p = r.get_intercept_point();
+
+              add(data, math::Vector2(p.x(), p.y()), r.get_intercept_intensity());
+            }
+        });
+
+      if (partial.empty())
+        return;
+
+      // merge partial maps, split on pixels ranges
+      run_ranges(_data.size(), threads,
+                 [&](unsigned int, unsigned int first, unsigned int last)
+        {
+          for (auto &p : partial)
+            for (unsigned int i = first; i < last; i++)
+              _data[i] += p[i];
+        });
+    }
+
+    double Irradiance::get_total_intensity() const
+    {
+      double sum = 0;
+
+      for (double v : _data)
+        sum += v;
+
+      return sum;
+    }
+
+    void Irradiance::intercept(const sys::Surface &, const Ray &ray)
+    {
+      const math::Vector3 &p = ray.get_intercept_point();
+
+      add(math::Vector2(p.x(), p.y()), ray.get_intercept_intensity());
+    }
+
+    ref<Sink> Irradiance::new_worker() const
+    {
+      ref<Irradiance> w = GOPTICAL_REFNEW(Irradiance, _window, _width, _height);
+
+      w->_bilinear = _bilinear;
+
+      return w;
+    }
+
+    void Irradiance::merge_worker(Sink &worker)
+    {
+      const Irradiance &w = static_cast<const Irradiance &>(worker);
+
+      for (size_t i = 0; i < _data.size(); i++)
+        _data[i] += w._data[i];
+    }
+
+  }
+}
+
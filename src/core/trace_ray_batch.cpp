@@ -0,0 +1,99 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+
+#include <goptical/core/trace/RayBatch>
+
+namespace _goptical {
+
+  namespace trace {
+
+    RayBatch::RayBatch()
+      : _wavelen(),
+        _intensity(),
+        _material(),
+        _parent(),
+        _active(),
+        _materials(),
+        _last_material(0),
+        _iterations(0)
+    {
+    }
+
+    void RayBatch::clear()
+    {
+      for (unsigned int j = 0; j < 3; j++)
+        {
+          _origin[j].clear();
+          _direction[j].clear();
+          _point[j].clear();
+          _normal[j].clear();
+        }
+
+      _wavelen.clear();
+      _intensity.clear();
+      _material.clear();
+      _parent.clear();
+      _active.clear();
+      _materials.clear();
+      _last_material = 0;
+      _iterations = 0;
+    }
+
+    void RayBatch::reserve(size_t count)
+    {
+      for (unsigned int j = 0; j < 3; j++)
+        {
+          _origin[j].reserve(count);
+          _direction[j].reserve(count);
+          _point[j].reserve(count);
+          _normal[j].reserve(count);
+        }
+
+      _wavelen.reserve(count);
+      _intensity.reserve(count);
+      _material.reserve(count);
+      _parent.reserve(count);
+      _active.reserve(count);
+    }
+
+    unsigned int RayBatch::get_material_index(const material::Base *material)
+    {
+      // rays of a batch usually share a few materials
+      if (_last_material < _materials.size() &&
+          _materials[_last_material] == material)
+        return _last_material;
+
+      for (unsigned int i = 0; i < _materials.size(); i++)
+        if (_materials[i] == material)
+          return _last_material = i;
+
+      _materials.push_back(material);
+
+      return _last_material = _materials.size() - 1;
+    }
+
+  }
+}
+
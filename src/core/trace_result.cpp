@@ -23,11 +23,17 @@
 */
 
 
+#include <algorithm>
+
 #include <goptical/core/sys/System>
 #include <goptical/core/sys/Element>
+#include <goptical/core/sys/Image>
 
 #include <goptical/core/trace/Ray>
 #include <goptical/core/trace/Result>
+#include <goptical/core/trace/Sink>
+#include <goptical/core/trace/IndexTable>
+#include <goptical/core/trace/Irradiance>
 
 #include <goptical/core/math/Vector>
 #include <goptical/core/math/VectorPair>
@@ -38,14 +44,24 @@ namespace _goptical {
 
   namespace trace {
 
+    static const IndexTable no_index_table;
+
     Result::Result()
       : _rays(),
+        _free_rays(),
         _elements(),
         _wavelengths(),
+        _source_rays(0),
         _generated_queue(0),
         _sources(),
         _bounce_limit_count(0),
-        _system(0)
+        _system(0),
+        _params(0),
+        _index_table(&no_index_table),
+        _workers(),
+        _workers_used(0),
+        _retain_capacity(false),
+        _alloc_count(0)
     {
     }
 
@@ -67,42 +83,196 @@ namespace _goptical {
     {
       for (auto&i : _elements)
         {
-          if (i._intercepted)
+          i._iterations = 0;
+
+          // rays lists storage is kept for next trace
+          if (_retain_capacity)
             {
-              i._intercepted = nullptr;
-            }
+              if (i._intercepted)
+                i._intercepted->clear();
+
+              if (i._generated)
+                i._generated->clear();
 
-          if (i._generated)
+              if (i._detector.valid())
+                i._detector->clear();
+            }
+          else
             {
+              i._intercepted = nullptr;
               i._generated = nullptr;
+              i._detector.invalidate();
             }
         }
 
       _rays.clear();// = vector_pool<Ray, 256>();
-      _rays.shrink();
+      _free_rays.clear();
+
+      if (_retain_capacity)
+        {
+          for (auto&w : _workers)
+            w->clear();
+        }
+      else
+        {
+          _rays.shrink();
+          std::vector<Ray *>().swap(_free_rays);
+          _workers.clear();
+
+          for (auto&q : _tmp_queues)
+            rays_queue_t().swap(q);
+
+          for (auto&b : _batches)
+            b = RayBatch();
+        }
+
+      _workers_used = 0;
       _sources.clear();
       _wavelengths.clear();
+      _source_rays = 0;
 
       _bounce_limit_count = 0;
     }
 
+    void Result::prepare_queue(std::shared_ptr<rays_queue_t> &queue, bool enabled)
+    {
+      if (!enabled)
+        {
+          queue = nullptr;
+        }
+      else if (!queue)
+        {
+          queue = std::make_shared<rays_queue_t>();
+          _alloc_count++;
+        }
+      else
+        {
+          queue->clear();
+        }
+    }
+
     void Result::prepare()
     {
       clear();
 
       for (auto&i : _elements)
         {
-          if (i._save_intercepted_list)
-            i._intercepted = std::make_shared<rays_queue_t>();
+          prepare_queue(i._intercepted, i._save_intercepted_list);
+          prepare_queue(i._generated, i._save_generated_list);
+        }
+    }
+
+    Result & Result::new_worker()
+    {
+      // worker results are reused when retaining capacity
+      if (_workers_used == _workers.size())
+        {
+          _workers.push_back(std::make_shared<Result>());
+          _alloc_count++;
+        }
+
+      Result &w = *_workers[_workers_used++];
+
+      w._system = _system;
+      w._params = _params;
+      w._index_table = _index_table;
+      w._retain_capacity = _retain_capacity;
+      w._elements.resize(_elements.size());
+
+      for (unsigned int i = 0; i < _elements.size(); i++)
+        {
+          const element_result_s &er = _elements[i];
+          element_result_s &wr = w._elements[i];
+
+          wr._save_intercepted_list = (bool)er._intercepted;
+          wr._save_generated_list = (bool)er._generated;
+
+          wr._sink = er._sink.valid() ? er._sink->new_worker() : ref<Sink>();
+        }
+
+      w.prepare();
+
+      return w;
+    }
+
+    void Result::merge_worker(Result &worker)
+    {
+      auto append = [&](rays_queue_t &queue, const rays_queue_t &rays)
+        {
+          if (queue.size() + rays.size() > queue.capacity())
+            _alloc_count++;
+
+          queue.insert(queue.end(), rays.begin(), rays.end());
+        };
+
+      for (unsigned int i = 0; i < _elements.size(); i++)
+        {
+          element_result_s &er = _elements[i];
+          element_result_s &wr = worker._elements[i];
 
-          if (i._save_generated_list)
-            i._generated = std::make_shared<rays_queue_t>();
+          if (er._intercepted)
+            append(*er._intercepted, *wr._intercepted);
+
+          if (er._generated)
+            append(*er._generated, *wr._generated);
+
+          if (er._sink.valid())
+            er._sink->merge_worker(*wr._sink);
+
+          if (wr._detector.valid())
+            {
+              if (!er._detector.valid())
+                er._detector = wr._detector->new_worker().staticcast<Detector>();
+
+              er._detector->merge_worker(*wr._detector);
+            }
+
+          er._iterations += wr._iterations;
+          wr._iterations = 0;
+
+          // rays are still owned by the worker result
+          if (!_retain_capacity)
+            {
+              wr._intercepted = nullptr;
+              wr._generated = nullptr;
+            }
+
+          wr._sink.invalidate();
+        }
+
+      _wavelengths.insert(worker._wavelengths.begin(), worker._wavelengths.end());
+      _bounce_limit_count += worker._bounce_limit_count;
+      worker._bounce_limit_count = 0;
+      _alloc_count += worker._alloc_count;
+      worker._alloc_count = 0;
+    }
+
+    void Result::release_ray(Ray &ray, bool reuse)
+    {
+      // children keep no reference to a ray which may be recycled
+      for (Ray *r = ray._child; r; )
+        {
+          Ray *next = r->_next;
+
+          r->_parent = 0;
+          r->_next = 0;
+          r = next;
+        }
+
+      ray._child = 0;
+
+      if (reuse)
+        {
+          if (_free_rays.size() == _free_rays.capacity())
+            _alloc_count++;
+
+          _free_rays.push_back(&ray);
         }
     }
 
     void Result::init(const sys::system &system)
     {
-      static const struct element_result_s er = { 0 };
+      const struct element_result_s er = element_result_s();
 
       if (!_system)
         _system = &system;
@@ -110,7 +280,7 @@ namespace _goptical {
       if(_system != &system)
         throw Error("trace::Result used with multiple sys::system objects");
 
-      _elements.resize(system.get_element_count(), er);
+      _elements.resize(system.get_element_count() + 1, er);
     }
 
     void Result::init(const sys::Element &element)
@@ -134,6 +304,36 @@ namespace _goptical {
       get_element_result(e)._save_generated_list = enabled;
     }
 
+    void Result::set_intercepted_sink(const sys::Surface &s, const ref<Sink> &sink)
+    {
+      init(s);
+      get_element_result(s)._sink = sink;
+    }
+
+    void Result::add_detected(const sys::Image &image, const Ray &ray)
+    {
+      element_result_s &er = get_element_result(image);
+
+      // detector settings may have changed since a retained detector was created
+      if (!er._detector.valid() || !image.match_detector(*er._detector))
+        {
+          er._detector = image.new_detector();
+          _alloc_count++;
+        }
+
+      er._detector->intercept(image, ray);
+    }
+
+    const Detector & Result::get_detector(const sys::Image &image) const
+    {
+      const element_result_s &er = get_element_result(image);
+
+      if (!er._detector.valid())
+        throw Error("no detector data for this image in ray trace result");
+
+      return *er._detector;
+    }
+
     bool Result::get_intercepted_save_state(const sys::Element &e)
     {
       return get_element_result(e)._save_intercepted_list;
@@ -185,41 +385,21 @@ namespace _goptical {
       if (intercepts.empty())
         throw Error("no ray intercepts found on the surface");
 
-//      math::VectorPair3 window = get_intercepted_window(s);
-      const auto& shape = s.get_shape();
-      const auto& window = s.get_bounding_box();
+      const math::VectorPair3 &window = s.get_bounding_box();
+      Irradiance map(math::VectorPair2(math::Vector2(window[0], 0, 1),
+                                       math::Vector2(window[1], 0, 1)), 1024, 1024);
+
+      map.add_intercepts(*this, s);
 
       auto result = std::vector< std::vector<double> >(1024, std::vector<double>(1024, 0) );
 
-      for (auto&i : intercepts)
-        {
-          const math::Vector3 &ip = i->get_intercept_point();
-          math::Vector3 d = (ip - window[0]) / (window[1] - window[0]) * 1024.0;
-
-          if (d[0] < 0) {
-              d[0] = 0;
-          }
-          if (d[0] > 1023) {
-              d[0] = 1023;
-          }
-          if (d[1] < 0) {
-              d[1] = 0;
-          }
-          if (d[1] > 1023) {
-              d[1] = 1023;
-          }
-
-          const double intensity = i->get_intercept_intensity();
-
-          result[d[0]][d[1]] += intensity;
-          
-          
-        }
+      for (unsigned int x = 0; x < 1024; x++)
+        for (unsigned int y = 0; y < 1024; y++)
+          result[x][y] = map.get_value(x, y);
 
       return result;
     }
 
-
     math::Vector3 Result::get_intercepted_center(const sys::Surface &s) const
     {
       math::VectorPair3 win = get_intercepted_window(s);
@@ -251,14 +431,24 @@ namespace _goptical {
     {
       double res = 0;
 
+      // released rays slots hold stale rays waiting to be reused
+      std::vector<const Ray *> released(_free_rays.begin(), _free_rays.end());
+      std::sort(released.begin(), released.end());
+
       for (auto&r : _rays)
         {
+          if (std::binary_search(released.begin(), released.end(), &r))
+            continue;
+
           double i = r.get_intensity();
 
           if (i > res)
             res = i;
         }
 
+      for (auto&w : _workers)
+        res = std::max(res, w->get_max_ray_intensity());
+
       return res;
     }
 
@@ -23,16 +23,29 @@
 */
 
 
+#include <cmath>
 #include <deque>
+#include <set>
+#include <functional>
+#include <thread>
+#include <exception>
+#include <algorithm>
 
 #include <goptical/core/trace/Tracer>
+#include <goptical/core/trace/CompiledSystem>
 #include <goptical/core/trace/Result>
+#include <goptical/core/trace/IndexTable>
 #include <goptical/core/trace/Ray>
 #include <goptical/core/trace/Ray>
 #include <goptical/core/sys/System>
 #include <goptical/core/sys/Source>
+#include <goptical/core/sys/Image>
 #include <goptical/core/Error>
 #include <goptical/core/sys/Surface>
+#include <goptical/core/sys/OpticalSurface>
+#include <goptical/core/curve/Base>
+#include <goptical/core/shape/Base>
+#include <goptical/core/material/Base>
 #include <goptical/core/math/VectorPair>
 #include <goptical/core/trace/Distribution>
 #include <goptical/core/trace/Sequence>
@@ -41,11 +54,24 @@ namespace _goptical {
 
   namespace trace {
 
+    // maximum number of source rays propagated at once through
+    // sequence elements when ray history is disabled
+    static const size_t seq_batch_size = 4096;
+
     tracer::tracer(const const_ref<sys::system> &system)
       : _system(system),
+        _source(),
         _params(system->get_tracer_params()),
         _result(),
-        _result_ptr(&_result)
+        _result_ptr(&_result),
+        _compiled(),
+        _index_table(),
+        _params_version(0),
+        _seq_cache(),
+        _cache_hits(0),
+        _cache_misses(0),
+        _cache_skipped(0),
+        _restart(0)
     {
     }
 
@@ -59,61 +85,375 @@ namespace _goptical {
 
       result.init(*_system);
 
-      // stack of rays to propagate
-      rays_queue_t tmp[2];
-
-      unsigned int swaped = 0;
-      rays_queue_t *generated;
-      rays_queue_t *source_rays = &tmp[1];
+      rays_queue_t &tmp = result._tmp_queues[0];
+      rays_queue_t *source_rays = &tmp;
       const std::vector<const_ref<sys::Element> > &seq = _params._sequence->_list;
       const sys::Element *entrance = 0;
+      unsigned int threads = get_thread_count();
 
-      // find entry element (first non source)
       for (unsigned int i = 0; i < seq.size(); i++)
         {
-          if (!dynamic_cast<const sys::Source *>(seq[i].ptr()))
+          const sys::Element *element = seq[i].ptr();
+
+          if (_system != element->get_system())
+            throw Error("Sequence contains element which is not part of the system");
+
+          // find entry element (first non source)
+          if (!entrance && _compiled->get_type(*element) != CompiledSystem::ElementSource)
+            entrance = element;
+        }
+
+      unsigned int i = 0;
+      seq_cache_s &cache = _seq_cache;
+      std::vector<seq_rays_t> *inputs = 0;
+
+      // incremental trace data only covers sequence sources
+      if (_params._incremental && !_source.valid())
+        {
+          i = seq_restart(result);
+          inputs = &cache._inputs;
+
+          if (i)
+            _cache_hits++, _cache_skipped += i;
+          else
+            _cache_misses++;
+
+          // cache is only valid once trace has completed
+          cache._sequence = 0;
+          cache._elements.resize(seq.size());
+          cache._versions.resize(seq.size());
+          cache._inputs.resize(seq.size());
+          cache._wavelengths.resize(seq.size());
+          cache._source_rays.resize(seq.size());
+
+          // restore sources and wavelengths of skipped elements
+          for (unsigned int j = 0; j < i; j++)
             {
-              entrance = seq[i].ptr();
-              break;
+              const sys::Element *element = seq[j].ptr();
+
+              if (_compiled->get_type(*element) != CompiledSystem::ElementSource)
+                continue;
+
+              if (!element->is_enabled())
+                continue;
+
+              result._sources.push_back(static_cast<const sys::Source *>(element));
+              result._wavelengths = cache._wavelengths[j];
+              result._source_rays = cache._source_rays[j];
             }
+
+          // restore rays entering restart element
+          if (i && i < seq.size() &&
+              _compiled->get_type(*seq[i]) != CompiledSystem::ElementSource)
+            {
+              tmp.clear();
+              result._generated_queue = &tmp;
+
+              for (auto &r : cache._inputs[i])
+                {
+                  Ray &ray = result.new_ray(r._ray);
+
+                  ray.set_creator(r._creator);
+                  ray.set_material(r._material);
+                  ray.set_source_index(r._source_index);
+                  ray.set_optical_len(r._optical_len);
+                }
+
+              result._generated_queue = 0;
+            }
+
+          for (unsigned int j = i; j < seq.size(); j++)
+            cache._inputs[j].clear();
         }
 
-      for (unsigned int i = 0; i < seq.size(); i++)
+      _restart = i;
+
+      auto generate = [&](const sys::Source &source)
+        {
+          Result::element_result_s &er = result.get_element_result(source);
+
+          source_rays = er._generated ? er._generated.get() : &tmp;
+          result._generated_queue = source_rays;
+          source_rays->clear();
+
+          result._sources.push_back(&source);
+          sys::Source::targets_t elist;
+          if (entrance)
+            elist.push_back(entrance);
+          source.generate_rays<m>(result, elist);
+          number_source_rays(result, *source_rays);
+
+          GOPTICAL_DEBUG(" " << source_rays->size() << " rays generated by " << source);
+        };
+
+      // tracer source replaces sources of the sequence
+      if (_source.valid() && _source->is_enabled())
+        generate(*_source);
+
+      while (i < seq.size())
         {
           const sys::Element *element = seq[i].ptr();
 
-          if (_system != element->get_system())
-            throw Error("Sequence contains element which is not part of the system");
+          if (_compiled->get_type(*element) == CompiledSystem::ElementSource)
+            {
+              const sys::Source *source = static_cast<const sys::Source *>(element);
+              i++;
 
-          if (!element->is_enabled())
-            continue;
+              if (!source->is_enabled() || _source.valid())
+                continue;
+
+              generate(*source);
 
-          Result::element_result_s &er = result.get_element_result(*element);
+              if (inputs)
+                {
+                  cache._wavelengths[i - 1] = result._wavelengths;
+                  cache._source_rays[i - 1] = result._source_rays;
+                }
+
+              continue;
+            }
+
+          // propagate rays through elements up to next source
+          unsigned int end = i + 1;
+
+          _index_table.update(*_compiled, result._wavelengths, m != Simpletrace);
+
+          while (end < seq.size() &&
+                 _compiled->get_type(*seq[end]) != CompiledSystem::ElementSource)
+            end++;
 
-          generated = er._generated ? er._generated.get() : &tmp[swaped];
-          result._generated_queue = generated;
-          generated->clear();
+          unsigned int count = std::min<size_t>(threads, source_rays->size());
 
-          if (const sys::Source *source = dynamic_cast<const sys::Source *>(element))
+          if (count > 1)
             {
-              result._sources.push_back(source);
-              sys::Source::targets_t elist;
-              if (entrance)
-                elist.push_back(entrance);
-              source->generate_rays<m>(result, elist);
+              const rays_queue_t &rays = *source_rays;
+
+              // rays captured by each worker for incremental trace
+              std::vector<std::vector<seq_rays_t> > winputs(inputs ? count : 0);
+
+              for (auto &w : winputs)
+                w.resize(seq.size());
+
+              prepare_parallel_trace(result, rays);
+              run_workers(result, count, [&](Result &worker, unsigned int j)
+                {
+                  trace_seq_rays_template<m>(worker, rays,
+                                             rays.size() * j / count,
+                                             rays.size() * (j + 1) / count, i, end,
+                                             inputs ? &winputs[j] : 0);
+                });
+
+              for (auto &w : winputs)
+                for (unsigned int k = i; k < end; k++)
+                  (*inputs)[k].insert((*inputs)[k].end(), w[k].begin(), w[k].end());
             }
           else
             {
-              element->process_rays<m>(result, source_rays);
-              // swap ray buffers
+              trace_seq_rays_template<m>(result, *source_rays,
+                                         0, source_rays->size(), i, end, inputs);
             }
 
-          GOPTICAL_DEBUG(" " << generated->size() << " rays generated by " << *element);
-          source_rays = generated;
-          swaped ^= 1;
+          i = end;
         }
 
-      
+      result._generated_queue = 0;
+
+      if (inputs)
+        {
+          for (unsigned int j = 0; j < seq.size(); j++)
+            {
+              cache._elements[j] = seq[j].ptr();
+              cache._versions[j] = seq[j]->get_version();
+            }
+
+          cache._params_version = _params_version;
+          cache._environment = &_system->get_environment();
+          cache._sequence = _params._sequence.ptr();
+        }
+    }
+
+    unsigned int tracer::seq_restart(const Result &result) const
+    {
+      const seq_cache_s &cache = _seq_cache;
+      const std::vector<const_ref<sys::Element> > &seq = _params._sequence->_list;
+
+      if (cache._sequence != _params._sequence.ptr() ||
+          cache._params_version != _params_version ||
+          cache._environment != &_system->get_environment() ||
+          cache._elements.size() != seq.size())
+        return 0;
+
+      unsigned int i;
+      bool changed = false;
+
+      for (i = 0; i < seq.size(); i++)
+        {
+          const sys::Element *element = seq[i].ptr();
+          const Result::element_result_s &er = result.get_element_result(*element);
+
+          changed = cache._elements[i] != element ||
+            cache._versions[i] != element->get_version();
+
+          if (changed)
+            break;
+
+          // rays saved for this element must be traced again
+          if (er._intercepted || er._generated || er._sink.valid() ||
+              er._detector.valid())
+            break;
+
+          // detector data is dropped on result clear, image must be traced again
+          const sys::Image *image = dynamic_cast<const sys::Image *>(element);
+
+          if (image && image->has_detector())
+            break;
+        }
+
+      if (i == seq.size() ||
+          _compiled->get_type(*seq[i]) == CompiledSystem::ElementSource)
+        return i;
+
+      // rays generated by sources depend on the entrance element,
+      // restart from the source which generated the cached rays
+      bool entrance = true;
+
+      for (unsigned int j = 0; j < i; j++)
+        if (_compiled->get_type(*seq[j]) != CompiledSystem::ElementSource)
+          entrance = false;
+
+      if (entrance && changed)
+        while (i > 0 && _compiled->get_type(*seq[i]) != CompiledSystem::ElementSource)
+          i--;
+
+      return i;
+    }
+
+    void tracer::seq_capture(seq_rays_t &cache, const rays_queue_t &rays)
+    {
+      for (auto &r : rays)
+        {
+          struct seq_ray_s c = { *r, r->get_creator(), r->get_material(),
+                                 r->get_source_index(), r->get_optical_len() };
+
+          cache.push_back(c);
+        }
+    }
+
+    void tracer::number_source_rays(Result &result, const rays_queue_t &rays)
+    {
+      for (auto &r : rays)
+        r->set_source_index(result._source_rays++);
+    }
+
+    void tracer::propagate_optical_len(const Result &result, Ray &ray)
+    {
+      Ray *child = ray.get_first_child();
+
+      if (!child)
+        return;
+
+      const IndexTable &table = result.get_index_table();
+      const material::Base *material = ray.get_material();
+      double wl = ray.get_wavelen();
+      unsigned int w = table.get_wavelen_slot(wl);
+      unsigned int s = table.get_material_slot(material);
+      double index = w != IndexTable::none && s != IndexTable::none
+        ? table.get_refractive_index(s, w) : NAN;
+
+      if (std::isnan(index))
+        index = material->get_refractive_index(wl);
+
+      double len = ray.get_optical_len() + ray.get_len() * index;
+
+      for (; child; child = child->get_next_child())
+        child->set_optical_len(len);
+    }
+
+    template <IntensityMode m>
+    void tracer::trace_seq_rays_template(Result &result, const rays_queue_t &rays,
+                                         size_t first, size_t last,
+                                         unsigned int begin, unsigned int end,
+                                         std::vector<seq_rays_t> *inputs) const
+    {
+      // stack of rays to propagate
+      rays_queue_t *tmp = result._tmp_queues + 1;
+      const std::vector<const_ref<sys::Element> > &seq = _params._sequence->_list;
+
+      // without history, rays are propagated by batches so that the
+      // set of rays in flight does not grow with the source rays count
+      size_t size = _params._ray_history ? last - first : seq_batch_size;
+
+      for (size_t b = first; b < last; b += size)
+        {
+          size_t b_last = std::min(last, b + size);
+          unsigned int swaped = 0;
+          rays_queue_t *generated;
+          rays_queue_t *source_rays = &tmp[1];
+
+          if (b_last - b > source_rays->capacity())
+            result._alloc_count++;
+
+          source_rays->assign(rays.begin() + b, rays.begin() + b_last);
+
+          // are input rays saved in a generated rays list
+          bool saved = (bool)result.get_element_result(*rays[b]->get_creator())._generated;
+
+          for (unsigned int i = begin; i < end; i++)
+            {
+              const sys::Element *element = seq[i].ptr();
+
+              if (inputs)
+                seq_capture((*inputs)[i], *source_rays);
+
+              if (!element->is_enabled())
+                continue;
+
+              Result::element_result_s &er = result.get_element_result(*element);
+
+              generated = &tmp[swaped];
+              result._generated_queue = generated;
+              generated->clear();
+
+              element->process_rays<m>(result, source_rays);
+
+              GOPTICAL_DEBUG(" " << generated->size() << " rays generated by " << *element);
+
+              // generated rays list gets rays of all batches
+              if (er._generated)
+                {
+                  if (b == first)
+                    er._generated->clear();
+
+                  er._generated->insert(er._generated->end(),
+                                        generated->begin(), generated->end());
+                }
+
+              if (_params._optical_path)
+                for (auto &r : *source_rays)
+                  propagate_optical_len(result, *r);
+
+              // sinks are only registered for surfaces
+              if (er._sink.valid())
+                for (auto &r : *source_rays)
+                  if (!r->is_lost())
+                    result.sink_intercepted(static_cast<const sys::Surface &>(*element), *r);
+
+              // input rays are not needed anymore without history
+              if (!_params._ray_history)
+                {
+                  bool reuse = !saved && !er._intercepted;
+
+                  for (auto &r : *source_rays)
+                    result.release_ray(*r, reuse);
+                }
+
+              saved = (bool)er._generated;
+
+              // swap ray buffers
+              source_rays = generated;
+              swaped ^= 1;
+            }
+        }
 
       result._generated_queue = 0;
     }
@@ -129,24 +469,27 @@ namespace _goptical {
 
       // stack of rays to propagate
 
-      rays_queue_t source_rays;
+      rays_queue_t &source_rays = result._tmp_queues[0];
 
       sys::Source::targets_t entry;
       entry.push_back(&_system->get_entrance_pupil());
 
-      // FIXME avoid container use here
-      std::vector<const sys::Source *> slist;
-      _system->get_elements<sys::Source>([&](const sys::Source& elem) { slist.push_back(&elem); });
+      unsigned int threads = get_thread_count();
 
-      for (auto &s : slist)
-        {
-          const sys::Source &source = *s;
+      // tracer source replaces system sources
+      const std::vector<const sys::Source *> *sources = &_compiled->get_sources();
+      std::vector<const sys::Source *> external;
 
-          if (_system != source.get_system())
-            throw Error("can not trace with Source which is not part of the system");
+      if (_source.valid())
+        {
+          if (_source->is_enabled())
+            external.push_back(_source.ptr());
+          sources = &external;
+        }
 
-          if (!source.is_enabled())
-            continue;
+      for (auto &s : *sources)
+        {
+          const sys::Source &source = *s;
 
           result._sources.push_back(&source);
 
@@ -154,65 +497,246 @@ namespace _goptical {
           source_rays.clear();
           result._generated_queue = &source_rays;
           source.generate_rays<m>(result, entry);
+          number_source_rays(result, source_rays);
 
           // copy to source generated rays
           {
             Result::element_result_s &source_er = result.get_element_result(source);
 
             if (source_er._generated)
-              *source_er._generated = source_rays;
+              {
+                if (source_rays.size() > source_er._generated->capacity())
+                  result._alloc_count++;
+
+                *source_er._generated = source_rays;
+              }
           }
 
           GOPTICAL_DEBUG("NSeq Ray trace: " << source_rays.size() << " Rays");
 
+          _index_table.update(*_compiled, result._wavelengths, m != Simpletrace);
+
           // trace each ray generated by source through the system
 
-          rays_queue_t gqueue;
-          result._generated_queue = &gqueue;
+          unsigned int count = std::min<size_t>(threads, source_rays.size());
+
+          if (count > 1)
+            {
+              prepare_parallel_trace(result, source_rays);
+              run_workers(result, count, [&](Result &worker, unsigned int i)
+                {
+                  trace_rays_template<m>(worker, source_rays,
+                                         source_rays.size() * i / count,
+                                         source_rays.size() * (i + 1) / count);
+                });
+            }
+          else
+            {
+              trace_rays_template<m>(result, source_rays, 0, source_rays.size());
+            }
+        }
+
+      result._generated_queue = 0;
+    }
 
-          for (auto&r : source_rays)
+    template <IntensityMode m>
+    void tracer::trace_rays_template(Result &result, const rays_queue_t &rays,
+                                     size_t first, size_t last) const
+    {
+      rays_queue_t &gqueue = result._tmp_queues[1];
+      size_t gnext = 0;
+
+      gqueue.clear();
+      result._generated_queue = &gqueue;
+
+      for (size_t i = first; i < last; i++)
+        {
+          Ray *ray = rays[i];
+          unsigned int bounce = _params._max_bounce;
+
+          // trace relfected/refracted ray further
+          while (1)
             {
-              Ray *ray = r;
-              unsigned int bounce = _params._max_bounce;
+              // is ray saved in a generated or intercepted rays list
+              bool saved = (bool)result.get_element_result(*ray->get_creator())._generated;
 
-              // trace relfected/refracted ray further
-              while (1)
+              // check bounce limit
+              if (!bounce--)
+                result._bounce_limit_count++;
+              else
                 {
-                  // check bounce limit
-                  if (!bounce--)
-                    result._bounce_limit_count++;
-                  else
+                  math::VectorPair3 intersect; // intersection point and normal (intersect surface local)
+
+                  // find ray / surface interction
+                  if (sys::Surface *s = _compiled->colide_next(_params, intersect, *ray))
                     {
-                      math::VectorPair3 intersect; // intersection point and normal (intersect surface local)
+                      result.add_intercepted(*s, *ray);
+
+                      // transform incident ray to surface local
+                      const math::Transform<3> &t = _compiled->get_transform(*ray->get_creator(), *s);
+                      math::VectorPair3 local(t.transform_line(*ray));
 
-                      // find ray / surface interction
-                      if (sys::Surface *s = _system->colide_next(_params, intersect, *ray))
-                        {
-                          result.add_intercepted(*s, *ray);
+                      s->trace_ray<m>(result, *ray, local, intersect);
 
-                          // transform incident ray to surface local
-                          const math::Transform<3> &t = ray->get_creator()->get_transform_to(*s);
-                          math::VectorPair3 local(t.transform_line(*ray));
+                      if (_params._optical_path)
+                        propagate_optical_len(result, *ray);
 
-                          s->trace_ray<m>(result, *ray, local, intersect);
-                        }
+                      result.sink_intercepted(*s, *ray);
+
+                      saved |= (bool)result.get_element_result(*s)._intercepted;
                     }
+                }
 
-                  // pick next ray to trace further through the system
-                  if (gqueue.empty())
-                    break;
-                  
-                  ray = gqueue.front();
-                  gqueue.pop_front();
+              // ray is not needed anymore once its children have been generated
+              if (!_params._ray_history)
+                result.release_ray(*ray, !saved);
 
-                  result.add_generated(*ray->get_creator(), *ray);
+              // pick next ray to trace further through the system
+              if (gnext == gqueue.size())
+                {
+                  gqueue.clear();
+                  gnext = 0;
+                  break;
                 }
+
+              ray = gqueue[gnext++];
+
+              result.add_generated(*ray->get_creator(), *ray);
             }
         }
 
       result._generated_queue = 0;
     }
 
+    void tracer::run_workers(Result &result, unsigned int count,
+                             const std::function<void (Result &worker, unsigned int index)> &work) const
+    {
+      // Each worker allocates its own rays. Worker results are
+      // merged in index order, producing the same result as a
+      // single threaded trace when workers process contiguous
+      // ranges of rays.
+
+      std::vector<Result *> workers;
+      std::vector<std::exception_ptr> errors(count);
+      std::vector<std::thread> threads;
+
+      for (unsigned int i = 0; i < count; i++)
+        workers.push_back(&result.new_worker());
+
+      auto run = [&](unsigned int i)
+        {
+          try {
+            work(*workers[i], i);
+          } catch (...) {
+            errors[i] = std::current_exception();
+          }
+        };
+
+      try {
+        for (unsigned int i = 1; i < count; i++)
+          threads.push_back(std::thread(run, i));
+      } catch (...) {
+        for (auto &t : threads)
+          t.join();
+        throw;
+      }
+
+      run(0);
+
+      for (auto &t : threads)
+        t.join();
+
+      for (auto &e : errors)
+        if (e)
+          std::rethrow_exception(e);
+
+      for (auto &w : workers)
+        result.merge_worker(*w);
+    }
+
+    unsigned int tracer::get_thread_count() const
+    {
+      unsigned int threads = _params._thread_count;
+
+      if (!threads)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+      return threads;
+    }
+
+    /* evaluate lazily computed data. The trace may not need a value
+       which can not be computed, errors are left to the evaluation
+       done by the worker threads. */
+    template <typename F>
+    static void warm_up(const F &f)
+    {
+      try {
+        f();
+      } catch (...) {
+      }
+    }
+
+    void tracer::prepare_parallel_trace(const Result &result, const rays_queue_t &rays) const
+    {
+      const std::vector<const sys::Surface *> &surfaces = _compiled->get_surfaces();
+      std::vector<const sys::Element *> creators(surfaces.begin(), surfaces.end());
+      std::set<const material::Base *> materials;
+
+      for (auto &s : _compiled->get_sources())
+        creators.push_back(s);
+
+      for (auto &s : surfaces)
+        if (_compiled->get_type(*s) == CompiledSystem::ElementOpticalSurface)
+          {
+            materials.insert(&_compiled->get_material(*s, 0));
+            materials.insert(&_compiled->get_material(*s, 1));
+          }
+
+      // update transforms table used by sequential surfaces processing
+      for (auto &c : creators)
+        c->get_global_transform();
+
+      // curves and shapes data
+      for (auto &s : surfaces)
+        {
+          const curve::Base &curve = s->get_trace_curve(_params);
+          const shape::Base &shape = s->get_shape();
+
+          math::Vector3 n;
+
+          warm_up([&]() { curve.sagitta(math::vector2_0); });
+          warm_up([&]() { curve.normal(n, math::vector3_0); });
+
+          warm_up([&]() { shape.max_radius(); });
+          warm_up([&]() { shape.min_radius(); });
+          warm_up([&]() { shape.get_bounding_box(); });
+          warm_up([&]() { shape.inside(math::vector2_0); });
+        }
+
+      // materials data
+      if (result.get_ray_wavelen_set().empty())
+        return;
+
+      double wl = *result.get_ray_wavelen_set().begin();
+      const material::Base *env = &_system->get_environment_proxy();
+
+      materials.insert(env);
+      for (auto &r : rays)
+        materials.insert(r->get_material());
+
+      for (auto &m : materials)
+        {
+          warm_up([&]() { m->get_refractive_index(wl); });
+
+          if (_params._intensity_mode == Simpletrace)
+            continue;
+
+          warm_up([&]() { m->get_internal_transmittance(wl, 1.0); });
+          warm_up([&]() { m->get_normal_transmittance(env, wl); });
+          warm_up([&]() { m->get_normal_reflectance(env, wl); });
+        }
+    }
+
     void tracer::trace()
     {
       Result    &result = *_result_ptr;
@@ -222,6 +746,20 @@ namespace _goptical {
 
       result._params = &_params;
 
+      if (_source.valid() && _source->get_system())
+        throw Error("tracer source must not be part of a system");
+
+      _compiled = _system->get_compiled();
+
+      // materials properties may have changed since last trace
+      _index_table.invalidate();
+      result._index_table = &_index_table;
+
+      // tabulated curves are built before rays are traced
+      if (_params._sag_table_tolerance > 0)
+        for (auto &s : _compiled->get_surfaces())
+          s->update_curve_table(_params._sag_table_tolerance, get_thread_count());
+
       switch (_params._intensity_mode)
         {
         case Simpletrace:
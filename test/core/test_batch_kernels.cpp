@@ -0,0 +1,335 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+   Check batch intersection kernels against scalar code and compare
+   their speed. Check rays traced with batch processing in
+   sequential mode against per ray tracing in non sequential mode.
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <cmath>
+#include <map>
+#include <tuple>
+
+#include <goptical/core/math/Vector>
+#include <goptical/core/math/VectorPair>
+
+#include <goptical/core/curve/Base>
+#include <goptical/core/curve/Sphere>
+#include <goptical/core/curve/Conic>
+#include <goptical/core/shape/Base>
+#include <goptical/core/shape/Disk>
+#include <goptical/core/shape/Ring>
+
+#include <goptical/core/material/Abbe>
+
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/Surface>
+#include <goptical/core/sys/Lens>
+#include <goptical/core/sys/Image>
+#include <goptical/core/sys/SourcePoint>
+
+#include <goptical/core/trace/RayBatch>
+#include <goptical/core/trace/Ray>
+#include <goptical/core/trace/Result>
+#include <goptical/core/trace/Tracer>
+#include <goptical/core/trace/Params>
+#include <goptical/core/trace/Sequence>
+#include <goptical/core/trace/Distribution>
+
+#include <goptical/core/light/SpectralLine>
+
+#include "test_common.hpp"
+
+using namespace goptical;
+
+static const unsigned int batch_size = 1021;
+static const unsigned int loops = 2000;
+
+static void fill_batch(trace::RayBatch &batch, double radius)
+{
+  batch.clear();
+
+  for (unsigned int i = 0; i < batch_size; i++)
+    {
+      math::Vector3 o((drand48() - .5) * radius, (drand48() - .5) * radius, -radius);
+      math::Vector3 d((drand48() - .5) * .3, (drand48() - .5) * .3, 1.);
+
+      // some axial rays and rays going backward
+      if (i % 37 == 0)
+        o.x() = o.y() = d.x() = d.y() = 0.;
+      if (i % 53 == 0)
+        d.z() = -d.z();
+
+      batch.add(math::VectorPair3(o, d.normalized()), 0.5, 1.0, 0, i);
+
+      if (i % 11 == 0)
+        batch.set_active(i, false);
+    }
+}
+
+static bool same(double a, double b)
+{
+  return !memcmp(&a, &b, sizeof(double));
+}
+
+static void compare(const char *name, const trace::RayBatch &a, const trace::RayBatch &b)
+{
+  for (unsigned int i = 0; i < a.size(); i++)
+    {
+      if (a.is_active(i) != b.is_active(i))
+        FAIL(name << ": ray " << i << " active state mismatch");
+
+      if (!a.is_active(i))
+        continue;
+
+      for (unsigned int j = 0; j < 3; j++)
+        if (!same(a.get_point_array(j)[i], b.get_point_array(j)[i]) ||
+            !same(a.get_normal_array(j)[i], b.get_normal_array(j)[i]))
+          FAIL(name << ": ray " << i << " intersection mismatch");
+    }
+}
+
+static double elapsed(clock_t start)
+{
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/* scalar reference, intersect each ray with closed form curve intersection */
+static void intersect_each(const curve::Base &c, trace::RayBatch &batch)
+{
+  for (unsigned int i = 0; i < batch.size(); i++)
+    {
+      if (!batch.is_active(i))
+        continue;
+
+      math::Vector3 point;
+
+      if (c.intersect(point, batch.get_ray(i)))
+        batch.set_point(i, point);
+      else
+        batch.set_active(i, false);
+    }
+}
+
+static void test_curve(const char *name, const curve::Base &c, double radius)
+{
+  trace::RayBatch rays, vbatch, sbatch;
+
+  fill_batch(rays, radius);
+
+  vbatch = rays;
+  c.intersect_batch(vbatch);
+  c.normal_batch(vbatch);
+
+  sbatch = rays;
+  intersect_each(c, sbatch);
+  c.Base::normal_batch(sbatch);
+
+  compare(name, vbatch, sbatch);
+
+  clock_t start = clock();
+  for (unsigned int l = 0; l < loops; l++)
+    {
+      vbatch = rays;
+      c.intersect_batch(vbatch);
+      c.normal_batch(vbatch);
+    }
+  double vt = elapsed(start);
+
+  start = clock();
+  for (unsigned int l = 0; l < loops; l++)
+    {
+      sbatch = rays;
+      intersect_each(c, sbatch);
+      c.Base::normal_batch(sbatch);
+    }
+  double st = elapsed(start);
+
+  std::cout << name << ": vector " << vt << "s, scalar " << st << "s" << std::endl;
+}
+
+static void test_shape(const char *name, const shape::Base &s, double radius)
+{
+  trace::RayBatch rays, vbatch, sbatch;
+
+  fill_batch(rays, radius);
+
+  // use ray origins as intersection points
+  for (unsigned int i = 0; i < batch_size; i++)
+    rays.set_point(i, rays.get_ray(i).origin());
+
+  vbatch = rays;
+  s.inside_batch(vbatch);
+
+  sbatch = rays;
+  s.Base::inside_batch(sbatch);
+
+  compare(name, vbatch, sbatch);
+
+  clock_t start = clock();
+  for (unsigned int l = 0; l < loops; l++)
+    {
+      vbatch = rays;
+      s.inside_batch(vbatch);
+    }
+  double vt = elapsed(start);
+
+  start = clock();
+  for (unsigned int l = 0; l < loops; l++)
+    {
+      sbatch = rays;
+      s.Base::inside_batch(sbatch);
+    }
+  double st = elapsed(start);
+
+  std::cout << name << ": vector " << vt << "s, scalar " << st << "s" << std::endl;
+}
+
+typedef std::tuple<double, double, double, double> ray_key_t;
+typedef std::map<ray_key_t, const trace::Ray *> rays_map_t;
+
+/* index intercepts by wavelength and origin of the source ray */
+static rays_map_t get_intercepts(const trace::Result &result, const sys::Surface &s)
+{
+  rays_map_t map;
+
+  for (auto &r : result.get_intercepted(s))
+    {
+      const trace::Ray *root = r;
+
+      while (root->get_parent())
+        root = root->get_parent();
+
+      const math::Vector3 &o = root->origin();
+
+      map[ray_key_t(r->get_wavelen(), o.x(), o.y(), o.z())] = r;
+    }
+
+  return map;
+}
+
+static void test_trace()
+{
+  sys::system   sys;
+
+  // no stop and large surfaces, rays follow the same path in both modes
+  sys::Lens     lens(math::Vector3(0, 0, 0));
+
+  lens.add_surface(1/0.02,  20., 8.,
+                   ref<material::AbbeVd>::create(1.5168, 64.17));
+  lens.add_surface(1/-0.01, 20., 3.);
+  lens.add_surface(1/-0.015, 20., 4.,
+                   ref<material::AbbeVd>::create(1.6200, 36.37));
+  lens.add_surface(0,       20., 50.);
+
+  sys.add(lens);
+
+  sys::Image      image(math::Vector3(0, 0, 65.), 50.);
+  sys.add(image);
+
+  sys::SourcePoint source(sys::SourceAtInfinity, math::Vector3(0, .05, 1));
+  sys.add(source);
+
+  source.clear_spectrum();
+  source.add_spectral_line(light::SpectralLine::C);
+  source.add_spectral_line(light::SpectralLine::e);
+  source.add_spectral_line(light::SpectralLine::F);
+
+  sys.get_tracer_params().set_default_distribution(
+    trace::Distribution(trace::HexaPolarDist, 15));
+
+  trace::Sequence seq(sys);
+
+  const sys::Surface *surfaces[5] = {
+    &lens.get_surface(0), &lens.get_surface(1),
+    &lens.get_surface(2), &lens.get_surface(3), &image
+  };
+
+  // per ray trace_ray_simple calls
+  trace::tracer ptracer(sys);
+  trace::Result &presult = ptracer.get_trace_result();
+  for (auto s : surfaces)
+    presult.set_intercepted_save_state(*s);
+  ptracer.trace();
+
+  // batched process_rays_simple calls
+  trace::tracer btracer(sys);
+  trace::Result &bresult = btracer.get_trace_result();
+  btracer.get_params().set_sequential_mode(seq);
+  for (auto s : surfaces)
+    bresult.set_intercepted_save_state(*s);
+  btracer.trace();
+
+  for (unsigned int i = 0; i < 5; i++)
+    {
+      const sys::Surface &s = *surfaces[i];
+
+      rays_map_t pmap = get_intercepts(presult, s);
+      rays_map_t bmap = get_intercepts(bresult, s);
+
+      if (pmap.size() < 1000 || pmap.size() != bmap.size())
+        FAIL("surface " << i << ": intercepted rays count mismatch "
+             << pmap.size() << " " << bmap.size());
+
+      for (auto &p : pmap)
+        {
+          auto b = bmap.find(p.first);
+
+          if (b == bmap.end())
+            FAIL("surface " << i << ": ray not intercepted by batch trace");
+
+          const trace::Ray &pr = *p.second;
+          const trace::Ray &br = *b->second;
+
+          if ((pr.get_intercept_point() - br.get_intercept_point()).len() > 1e-10 ||
+              (pr.get_direction() - br.get_direction()).len() > 1e-12 ||
+              fabs(pr.get_len() - br.get_len()) > 1e-10)
+            FAIL("surface " << i << ": batch trace differs from per ray trace");
+        }
+    }
+}
+
+int main()
+{
+  srand48(1);
+
+  test_curve("sphere", curve::Sphere(40.), 30.);
+  test_curve("sphere neg", curve::Sphere(-40.), 30.);
+  test_curve("conic ellipse", curve::Conic(40., -.5), 30.);
+  test_curve("conic parabola", curve::Conic(40., -1.), 30.);
+  test_curve("conic hyperbola", curve::Conic(-40., -2.), 30.);
+  test_curve("conic oblate", curve::Conic(40., .7), 30.);
+
+  test_shape("disk", shape::Disk(10.), 30.);
+  test_shape("ring", shape::Ring(10., 4.), 30.);
+
+  test_trace();
+
+  return 0;
+}
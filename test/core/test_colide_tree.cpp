@@ -0,0 +1,206 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+   Check surfaces lookup of non sequential ray tracing against a test
+   of all system surfaces.
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include <goptical/core/math/Vector>
+#include <goptical/core/math/VectorPair>
+#include <goptical/core/math/Transform>
+
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/Element>
+#include <goptical/core/sys/Surface>
+#include <goptical/core/sys/Mirror>
+#include <goptical/core/sys/Stop>
+#include <goptical/core/sys/Image>
+
+#include <goptical/core/curve/Zernike>
+#include <goptical/core/curve/Polynomial>
+
+#include <goptical/core/trace/Ray>
+#include <goptical/core/trace/Params>
+#include <goptical/core/trace/CompiledSystem>
+
+#include <goptical/core/light/Ray>
+
+#include "test_common.hpp"
+
+using namespace goptical;
+
+static sys::Surface * colide_all(const sys::system &sys, const trace::Params &params,
+                                 math::VectorPair3 &intersect, const trace::Ray &ray)
+{
+  const sys::Element *origin = ray.get_creator();
+  sys::Surface *e = 0;
+  math::VectorPair3 inter;
+  double min_dist = std::numeric_limits<double>::max();
+
+  for (unsigned int i = 1; i <= sys.get_element_count(); i++)
+    {
+      sys::Surface *s = dynamic_cast<sys::Surface *>(&sys.get_element(i));
+
+      if (!s || s == origin || !s->is_enabled())
+        continue;
+
+      math::VectorPair3 local(origin->get_transform_to(*s).transform_line(ray));
+
+      if (s->intersect(params, inter, local))
+        {
+          double dist = (inter.origin() - local.origin()).len();
+
+          if (min_dist > dist)
+            {
+              min_dist = dist;
+              intersect = inter;
+              e = s;
+            }
+        }
+    }
+
+  return e;
+}
+
+static void compare(const sys::system &sys, const trace::Params &params,
+                    const sys::Element &origin, const char *name)
+{
+  unsigned int hits = 0;
+
+  for (unsigned int i = 0; i < 20000; i++)
+    {
+      math::Vector3 o((drand48() - .5) * 400, (drand48() - .5) * 400, (drand48() - .5) * 400);
+      math::Vector3 d(drand48() - .5, drand48() - .5, drand48() - .5);
+
+      if (i % 3 == 0)
+        d = math::Vector3((drand48() - .5) * .1, (drand48() - .5) * .1, 1.);
+
+      trace::Ray ray(light::Ray(math::VectorPair3(o, d.normalized())));
+      ray.set_creator(&origin);
+
+      math::VectorPair3 i1, i2;
+      sys::Surface *s1 = sys.colide_next(params, i1, ray);
+      sys::Surface *s2 = colide_all(sys, params, i2, ray);
+
+      if (s1 != s2)
+        FAIL(name << ": ray " << i << " hit surface mismatch");
+
+      if (s1 && memcmp(&i1, &i2, sizeof(i1)))
+        FAIL(name << ": ray " << i << " intersection mismatch");
+
+      hits += !!s1;
+    }
+
+  std::cout << name << ": " << hits << " hits" << std::endl;
+}
+
+int main()
+{
+  srand48(1);
+
+  sys::system sys;
+  std::vector<ref<sys::Mirror> > mirrors;
+
+  // tilted mirror segments
+  for (int x = -6; x <= 6; x++)
+    for (int y = -6; y <= 6; y++)
+      {
+        ref<sys::Mirror> m = ref<sys::Mirror>::create(math::Vector3(x * 30, y * 30, x * y),
+                                                      -800 + drand48() * 100, -1., 14.);
+        m->rotate(drand48() * 40 - 20, drand48() * 40 - 20, 0);
+        sys.add(*m);
+        mirrors.push_back(m);
+      }
+
+  mirrors[17]->set_enable_state(false);
+
+  sys::Stop stop(math::Vector3(0, 0, -100), 50);
+  sys.add(stop);
+
+  sys::Image image(math::Vector3(0, 0, 150), 60);
+  sys.add(image);
+
+  trace::Params params;
+
+  compare(sys, params, stop, "segments");
+  compare(sys, params, image, "from image");
+
+  // change system, lookup tree must be rebuilt
+  mirrors[17]->set_enable_state(true);
+  mirrors[42]->rotate(0, 30, 0);
+  image.set_local_position(math::Vector3(0, 0, 120));
+
+  compare(sys, params, stop, "moved");
+
+  params.set_unobstructed(true);
+  compare(sys, params, stop, "unobstructed");
+  params.set_unobstructed(false);
+
+  // curves without exact sagitta bounds, high order terms have
+  // extrema which do not lie on any regular sampling grid
+  ref<curve::Zernike> zc = ref<curve::Zernike>::create(40.);
+
+  for (unsigned int i = 0; i < 36; i++)
+    zc->set_coefficient(i, (drand48() - .5) * 8.);
+
+  sys::Mirror zernike(math::Vector3(0, 0, 60), zc, 40.);
+  sys.add(zernike);
+
+  ref<curve::Polynomial> pc = ref<curve::Polynomial>::create();
+
+  pc->set_even(2, 8, 2e-2, -6e-5, 6e-8, -2e-11);
+
+  sys::Mirror asphere(math::Vector3(0, 0, 30), pc, 60.);
+  sys.add(asphere);
+
+  compare(sys, params, stop, "zernike");
+  compare(sys, params, image, "zernike from image");
+
+  // snapshots are never modified, changes publish a new snapshot
+  std::shared_ptr<const trace::CompiledSystem> snapshot = sys.get_compiled();
+  unsigned int version = snapshot->get_version();
+
+  if (sys.get_compiled() != snapshot)
+    FAIL("snapshot rebuilt without change");
+
+  zc->set_coefficient(4, 1.);
+
+  if (sys.get_compiled() == snapshot)
+    FAIL("snapshot not rebuilt on curve change");
+
+  image.set_local_position(math::Vector3(0, 0, 130));
+
+  if (sys.get_compiled() == snapshot || snapshot->get_version() != version)
+    FAIL("snapshot modified");
+
+  compare(sys, params, stop, "zernike changed");
+
+  return 0;
+}
@@ -0,0 +1,104 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+   Helpers shared by core library tests.
+*/
+
+#ifndef GOPTICAL_TEST_COMMON_HH_
+#define GOPTICAL_TEST_COMMON_HH_
+
+#include <iostream>
+#include <cstdlib>
+
+#include <goptical/core/math/Vector>
+
+#include <goptical/core/material/Abbe>
+
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/Lens>
+#include <goptical/core/sys/Image>
+#include <goptical/core/sys/SourcePoint>
+
+#include <goptical/core/trace/Distribution>
+#include <goptical/core/trace/Params>
+
+#include <goptical/core/light/SpectralLine>
+
+/* report test failure and exit */
+#define FAIL(x)                                 \
+{                                               \
+  std::cerr << x << std::endl;                  \
+  std::exit(1);                                 \
+}
+
+namespace test {
+
+  using namespace goptical;
+
+  /* Tessar lens with an image plane and an off axis point source
+     emitting C, e and F lines. Rays are distributed on the
+     entrance pupil with an hexapolar pattern. */
+  struct Tessar
+  {
+    Tessar(unsigned int rings = 20)
+      : _lens(math::Vector3(0, 0, 0)),
+        _image(math::Vector3(0, 0, 125.596), 5),
+        _source(sys::SourceAtFiniteDistance, math::Vector3(0, 27.5, -1000))
+    {
+      _lens.add_surface(1/0.031186861,  14.934638, 4.627804137,
+                        ref<material::AbbeVd>::create(1.607170, 59.5002));
+      _lens.add_surface(0,              14.934638, 5.417429465);
+      _lens.add_surface(1/-0.014065441, 12.766446, 3.728230979,
+                        ref<material::AbbeVd>::create(1.575960, 41.2999));
+      _lens.add_surface(1/0.034678487,  11.918098, 4.417903733);
+      _lens.add_stop   (                12.066273, 2.288913925);
+      _lens.add_surface(0,              12.372318, 1.499288597,
+                        ref<material::AbbeVd>::create(1.526480, 51.4000));
+      _lens.add_surface(1/0.035104369,  14.642815, 7.996205852,
+                        ref<material::AbbeVd>::create(1.623770, 56.8998));
+      _lens.add_surface(1/-0.021187519, 14.642815, 85.243965130);
+
+      _system.add(_lens);
+      _system.add(_image);
+      _system.add(_source);
+
+      _source.clear_spectrum();
+      _source.add_spectral_line(light::SpectralLine::C);
+      _source.add_spectral_line(light::SpectralLine::e);
+      _source.add_spectral_line(light::SpectralLine::F);
+
+      _system.get_tracer_params().set_default_distribution(
+        trace::Distribution(trace::HexaPolarDist, rings));
+    }
+
+    sys::system         _system;
+    sys::Lens           _lens;
+    sys::Image          _image;
+    sys::SourcePoint    _source;
+  };
+
+}
+
+#endif
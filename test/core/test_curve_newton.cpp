@@ -0,0 +1,262 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+   Check curves analytic gradients against numerical differentiation
+   and Newton intersection against closed form intersection and
+   bisection along the ray.
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+
+#include <goptical/core/math/Vector>
+#include <goptical/core/math/VectorPair>
+
+#include <goptical/core/curve/Base>
+#include <goptical/core/curve/Conic>
+#include <goptical/core/curve/Sphere>
+#include <goptical/core/curve/Polynomial>
+#include <goptical/core/curve/Zernike>
+#include <goptical/core/curve/Composer>
+#include <goptical/core/curve/Array>
+#include <goptical/core/curve/Grid>
+#include <goptical/core/curve/Spline>
+
+#include <goptical/core/shape/Disk>
+
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/Lens>
+#include <goptical/core/sys/Image>
+#include <goptical/core/sys/SourcePoint>
+#include <goptical/core/sys/OpticalSurface>
+
+#include <goptical/core/material/Abbe>
+
+#include <goptical/core/trace/Tracer>
+#include <goptical/core/trace/Result>
+#include <goptical/core/trace/Params>
+#include <goptical/core/trace/Sequence>
+#include <goptical/core/trace/RayBatch>
+
+#include "test_common.hpp"
+
+using namespace goptical;
+
+static void test_gradient(const char *name, const curve::Base &c, double radius)
+{
+  for (unsigned int i = 0; i < 1000; i++)
+    {
+      math::Vector2 xy((drand48() - .5) * radius, (drand48() - .5) * radius);
+      math::Vector2 g, d;
+
+      double z = c.sagitta_gradient(xy, g);
+
+      if (fabs(z - c.sagitta(xy)) > 1e-12)
+        FAIL(name << ": sagitta mismatch at " << xy);
+
+      c.Base::derivative(xy, d);
+
+      if ((g - d).len() > 1e-5 * (1.0 + d.len()))
+        FAIL(name << ": gradient mismatch at " << xy << ": " << g << " " << d);
+    }
+}
+
+/* bisection along ray between z=0 plane and a far point */
+static bool bisect(const curve::Base &c, const math::VectorPair3 &ray, math::Vector3 &point)
+{
+  double t0 = -ray.origin().z() / ray.direction().z();
+  double t1 = t0;
+  double step = 1e-3;
+
+  auto f = [&](double t) {
+    math::Vector3 p(ray.origin() + ray.direction() * t);
+    return p.z() - c.sagitta(p.project_xy());
+  };
+
+  double f0 = f(t0);
+
+  // find bracket nearest to z=0 plane
+  for (;;)
+    {
+      if (f(t0 + step) * f0 <= 0)
+        { t1 = t0 + step; break; }
+      if (t0 - step > 0 && f(t0 - step) * f0 <= 0)
+        { t1 = t0 - step; break; }
+      step *= 2;
+      if (step > 100)
+        return false;
+    }
+
+  for (unsigned int i = 0; i < 200; i++)
+    {
+      double tm = (t0 + t1) / 2;
+
+      if (f(tm) * f0 > 0)
+        t0 = tm;
+      else
+        t1 = tm;
+    }
+
+  point = ray.origin() + ray.direction() * t0;
+  return true;
+}
+
+class NewtonCurve : public curve::Base
+{
+public:
+  NewtonCurve(const curve::Base &c) : _c(c) {}
+
+  double sagitta(const math::Vector2 & xy) const { return _c.sagitta(xy); }
+  void derivative(const math::Vector2 & xy, math::Vector2 & dxdy) const { _c.derivative(xy, dxdy); }
+  double sagitta_gradient(const math::Vector2 & xy, math::Vector2 & dxdy) const { return _c.sagitta_gradient(xy, dxdy); }
+
+  const curve::Base &_c;
+};
+
+static void test_intersect(const char *name, const curve::Base &c, double radius, bool closed)
+{
+  unsigned int count = 0;
+  trace::RayBatch batch;
+
+  for (unsigned int i = 0; i < 1000; i++)
+    {
+      math::Vector3 o((drand48() - .5) * radius, (drand48() - .5) * radius, -radius);
+      math::Vector3 d((drand48() - .5) * .2, (drand48() - .5) * .2, 1.);
+      math::VectorPair3 ray(o, d.normalized());
+      math::Vector3 p1, p2;
+
+      // default Base implementation uses Newton iterations
+      if (!c.Base::intersect(p1, ray))
+        FAIL(name << ": ray " << i << " no intersection");
+
+      if (closed)
+        {
+          if (!c.intersect(p2, ray))
+            FAIL(name << ": ray " << i << " no closed form intersection");
+        }
+      else if (!bisect(c, ray, p2))
+        FAIL(name << ": ray " << i << " bisection failed");
+
+      if ((p1 - p2).len() > 1e-8)
+        FAIL(name << ": ray " << i << " intersection mismatch " << p1 << " " << p2);
+
+      batch.add(ray, 0.5, 1.0, 0, i);
+      count++;
+    }
+
+  NewtonCurve(c).intersect_batch(batch);
+
+  for (unsigned int i = 0; i < batch.size(); i++)
+    if (!batch.is_active(i))
+      FAIL(name << ": ray " << i << " batch intersection failed");
+
+  std::cout << name << ": " << (double)batch.get_iterations() / count
+            << " iterations per ray" << std::endl;
+
+  if (batch.get_iterations() > count * 8)
+    FAIL(name << ": too many iterations");
+}
+
+int main()
+{
+  srand48(1);
+
+  curve::Conic conic(60., -1.5);
+  curve::Sphere sphere(-80.);
+
+  test_intersect("conic", conic, 20., true);
+  test_intersect("sphere", sphere, 20., true);
+
+  curve::Polynomial poly;
+  poly.set_even(2, 8, 1. / 120., 1e-6, -2e-9, 1e-12);
+  test_gradient("polynomial", poly, 20.);
+  test_intersect("polynomial", poly, 20., false);
+
+  curve::Zernike zernike(20.);
+  zernike.set_coefficient(3, .01);
+  zernike.set_coefficient(4, .004);
+  zernike.set_coefficient(7, -.002);
+  zernike.set_coefficient(8, .003);
+  zernike.set_coefficient(12, .001);
+  test_gradient("zernike", zernike, 28.);
+  test_intersect("zernike", zernike, 28., false);
+
+  curve::Composer composer;
+  composer.add_curve(conic);
+  composer.add_curve(zernike).xy_scale(math::Vector2(1.2, .8)).rotate(10.);
+  test_gradient("composer", composer, 20.);
+  test_intersect("composer", composer, 20., false);
+
+  curve::Array array(ref<curve::Sphere>::create(15.), 6., curve::Array::Hexagonal);
+  test_gradient("array", array, 2.);
+
+  curve::Grid grid(64, 25.);
+  grid.fit(conic);
+  test_gradient("grid", grid, 30.);
+  test_intersect("grid", grid, 30., false);
+
+  _goptical::curve::Spline spline;
+  spline.fit(conic, 30., 100);
+  test_intersect("spline", spline, 30., false);
+
+  // iterations are reported by sequential ray tracing result
+  sys::system sys;
+  sys::Lens lens(math::Vector3(0, 0, 0));
+
+  lens.add_surface(ref<curve::Polynomial>::create(poly),
+                   ref<shape::Disk>::create(15.), 5.,
+                   ref<material::AbbeVd>::create(1.5168, 64.17));
+  lens.add_surface(-80., 15., 90.);
+  sys.add(lens);
+
+  sys::Image image(math::Vector3(0, 0, 120), 20);
+  sys.add(image);
+
+  sys::SourcePoint source(sys::SourceAtInfinity, math::Vector3(0, 0, 1));
+  sys.add(source);
+
+  trace::Sequence seq(sys);
+  sys.get_tracer_params().set_sequential_mode(seq);
+
+  trace::tracer tracer(sys);
+  trace::Result &result = tracer.get_trace_result();
+  result.set_intercepted_save_state(image);
+  tracer.trace();
+
+  if (result.get_intercepted(image).empty())
+    FAIL("no ray intercepted by image");
+
+  if (!result.get_intersect_iterations(lens.get_surface(0)))
+    FAIL("no iterations reported for polynomial surface");
+
+  if (result.get_intersect_iterations(lens.get_surface(1)))
+    FAIL("iterations reported for spherical surface");
+
+  std::cout << "trace: " << result.get_intersect_iterations(lens.get_surface(0))
+            << " iterations" << std::endl;
+
+  return 0;
+}
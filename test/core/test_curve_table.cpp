@@ -0,0 +1,265 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+   Check tabulated curves used in place of expensive surface curves
+   when tracing with a sagitta table tolerance.
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <thread>
+
+#include <goptical/core/math/Vector>
+#include <goptical/core/Error>
+
+#include <goptical/core/curve/Base>
+#include <goptical/core/curve/Sphere>
+#include <goptical/core/curve/Zernike>
+#include <goptical/core/curve/Composer>
+#include <goptical/core/curve/Tabulated>
+
+#include <goptical/core/shape/Disk>
+
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/Surface>
+#include <goptical/core/sys/Lens>
+#include <goptical/core/sys/Image>
+#include <goptical/core/sys/SourcePoint>
+#include <goptical/core/sys/OpticalSurface>
+
+#include <goptical/core/material/Abbe>
+
+#include <goptical/core/trace/Tracer>
+#include <goptical/core/trace/Result>
+#include <goptical/core/trace/Params>
+#include <goptical/core/trace/Sequence>
+#include <goptical/core/trace/Distribution>
+
+#include "test_common.hpp"
+
+using namespace goptical;
+
+static std::vector<math::Vector3> get_points(sys::system &sys, sys::Image &image)
+{
+  trace::tracer tracer(sys);
+  trace::Result &result = tracer.get_trace_result();
+  std::vector<math::Vector3> points;
+
+  result.set_intercepted_save_state(image);
+  tracer.trace();
+
+  for (auto &r : result.get_intercepted(image))
+    points.push_back(r->get_intercept_point());
+
+  return points;
+}
+
+static std::vector<math::Vector3> get_points(sys::system &sys, sys::Image &image,
+                                             double tolerance)
+{
+  trace::tracer tracer(sys);
+  trace::Result &result = tracer.get_trace_result();
+  std::vector<math::Vector3> points;
+
+  tracer.get_params().set_sag_table_tolerance(tolerance);
+  result.set_intercepted_save_state(image);
+  tracer.trace();
+
+  for (auto &r : result.get_intercepted(image))
+    points.push_back(r->get_intercept_point());
+
+  return points;
+}
+
+static double max_distance(const std::vector<math::Vector3> &a,
+                           const std::vector<math::Vector3> &b)
+{
+  double d = 0;
+
+  if (a.size() != b.size())
+    FAIL("intercepted rays count mismatch " << a.size() << " " << b.size());
+
+  for (unsigned int i = 0; i < a.size(); i++)
+    d = std::max(d, (a[i] - b[i]).len());
+
+  return d;
+}
+
+int main()
+{
+  const double radius = 15.;
+  const double tolerance = 1e-8;
+
+  ref<curve::Zernike> zernike = ref<curve::Zernike>::create(radius);
+  zernike->set_coefficient(4, .002);
+  zernike->set_coefficient(8, -.001);
+  zernike->set_coefficient(12, .0005);
+
+  ref<curve::Composer> composer = ref<curve::Composer>::create();
+  composer->add_curve(ref<curve::Sphere>::create(60.));
+  composer->add_curve(zernike);
+
+  // error bound, zernike curve is not smooth on its radius
+  curve::Tabulated table(composer, radius, tolerance, 4);
+
+  std::cout << "grid size " << table.get_grid().get_data().get_count(0)
+            << ", " << table.get_exact_cell_count() << " exact cells" << std::endl;
+
+  if (!table.get_exact_cell_count())
+    FAIL("no exact cells on zernike radius");
+
+  for (unsigned int i = 0; i < 100000; i++)
+    {
+      math::Vector2 v((drand48() - .5) * 2.2 * radius, (drand48() - .5) * 2.2 * radius);
+      math::Vector2 g1, g2;
+
+      double e = fabs(table.sagitta_gradient(v, g1) - composer->sagitta_gradient(v, g2));
+
+      if (e > tolerance * 2)
+        FAIL("tabulation error above tolerance at " << v << ": " << e);
+    }
+
+  try {
+    curve::Tabulated(composer, radius, 1e-30, 4, 65);
+    FAIL("tabulation with unreachable tolerance");
+  } catch (const Error &e) {
+  }
+
+  if (curve::Sphere(60.).is_tabulation_useful() || table.is_tabulation_useful())
+    FAIL("cheap curve reported as expensive");
+
+  // traced system
+  sys::system sys;
+  sys::Lens lens(math::Vector3(0, 0, 0));
+
+  lens.add_surface(composer, ref<shape::Disk>::create(radius), 5.,
+                   ref<material::AbbeVd>::create(1.5168, 64.17));
+  lens.add_surface(-80., radius, 90.);
+  sys.add(lens);
+
+  sys::Image image(math::Vector3(0, 0, 120), 20);
+  sys.add(image);
+
+  sys::SourcePoint source(sys::SourceAtInfinity, math::Vector3(0, 0.05, 1));
+  sys.add(source);
+
+  sys.get_tracer_params().set_default_distribution(
+    trace::Distribution(trace::HexaPolarDist, 20));
+
+  trace::Sequence seq(sys);
+  sys.get_tracer_params().set_sequential_mode(seq);
+
+  const sys::Surface &surface = lens.get_surface(0);
+
+  std::vector<math::Vector3> ref_points = get_points(sys, image);
+
+  if (&surface.get_trace_curve(sys.get_tracer_params()) != composer.ptr())
+    FAIL("table used with zero tolerance");
+
+  sys.get_tracer_params().set_sag_table_tolerance(tolerance);
+
+  std::vector<math::Vector3> points = get_points(sys, image);
+
+  const curve::Base *trace_curve = &surface.get_trace_curve(sys.get_tracer_params());
+
+  if (trace_curve == composer.ptr())
+    FAIL("table not used");
+
+  double d = max_distance(ref_points, points);
+  std::cout << "max distance " << d << std::endl;
+
+  if (d > 1e-5)
+    FAIL("tabulated curve trace mismatch");
+
+  // table is kept between traces
+  get_points(sys, image);
+
+  if (&surface.get_trace_curve(sys.get_tracer_params()) != trace_curve)
+    FAIL("table rebuilt");
+
+  // table is rebuilt when the surface curve is modified
+  zernike->set_coefficient(4, .003);
+  lens.get_surface(0).update_version();
+
+  sys.get_tracer_params().set_sag_table_tolerance(0);
+  ref_points = get_points(sys, image);
+
+  sys.get_tracer_params().set_sag_table_tolerance(tolerance);
+  points = get_points(sys, image);
+
+  d = max_distance(ref_points, points);
+  std::cout << "max distance " << d << std::endl;
+
+  if (d > 1e-5)
+    FAIL("tabulated curve not updated");
+
+  // table is rebuilt when only the curve is modified
+  zernike->set_coefficient(8, -.002);
+
+  sys.get_tracer_params().set_sag_table_tolerance(0);
+  ref_points = get_points(sys, image);
+
+  sys.get_tracer_params().set_sag_table_tolerance(tolerance);
+  points = get_points(sys, image);
+
+  d = max_distance(ref_points, points);
+  std::cout << "max distance " << d << std::endl;
+
+  if (d > 1e-5)
+    FAIL("tabulated curve not updated on curve change");
+
+  // tracers with different tolerances used from different threads
+  zernike->set_coefficient(4, .002);
+  lens.get_surface(0).update_version();
+
+  std::vector<math::Vector3> ref_tol[2] = {
+    get_points(sys, image, tolerance),
+    get_points(sys, image, tolerance * 10)
+  };
+
+  for (int pass = 0; pass < 4; pass++)
+    {
+      lens.get_surface(0).update_version();
+
+      std::vector<math::Vector3> res[4];
+      std::vector<std::thread> threads;
+
+      for (unsigned int i = 0; i < 4; i++)
+        threads.push_back(std::thread([&, i]() {
+              res[i] = get_points(sys, image, i % 2 ? tolerance * 10 : tolerance);
+            }));
+
+      for (auto &t : threads)
+        t.join();
+
+      for (unsigned int i = 0; i < 4; i++)
+        if (max_distance(res[i], ref_tol[i % 2]) != 0)
+          FAIL("concurrent tracers use wrong curve table");
+    }
+
+  return 0;
+}
@@ -0,0 +1,217 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+   Check rays binned by images in detector mode while tracing.
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <set>
+#include <vector>
+
+#include <goptical/core/math/Vector>
+#include <goptical/core/math/VectorPair>
+
+#include <goptical/core/shape/Rectangle>
+
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/Lens>
+#include <goptical/core/sys/Image>
+#include <goptical/core/sys/SourcePoint>
+
+#include <goptical/core/trace/Tracer>
+#include <goptical/core/trace/Result>
+#include <goptical/core/trace/Ray>
+#include <goptical/core/trace/Distribution>
+#include <goptical/core/trace/Params>
+#include <goptical/core/trace/Sequence>
+#include <goptical/core/trace/Irradiance>
+#include <goptical/core/trace/Detector>
+
+#include <goptical/core/light/SpectralLine>
+
+#include <goptical/core/Error>
+
+#include "test_common.hpp"
+
+using namespace goptical;
+
+static bool close(double a, double b)
+{
+  return fabs(a - b) <= 1e-9 * std::max(1.0, fabs(b));
+}
+
+static bool same_map(const trace::Irradiance &a, const trace::Irradiance &b)
+{
+  if (a.get_data().size() != b.get_data().size())
+    return false;
+
+  for (size_t i = 0; i < a.get_data().size(); i++)
+    if (!close(a.get_data()[i], b.get_data()[i]))
+      return false;
+
+  return true;
+}
+
+int main()
+{
+  test::Tessar  tessar(30);
+  sys::system   &sys = tessar._system;
+  sys::Image    &image = tessar._image;
+
+  trace::Sequence seq(sys);
+
+  for (int mode = 0; mode < 2; mode++)
+    {
+      if (mode)
+        sys.get_tracer_params().set_sequential_mode(seq);
+
+      // reference maps built from saved intercepts
+
+      image.clear_detector();
+
+      trace::tracer tracer(sys);
+
+      tracer.get_trace_result().set_intercepted_save_state(image);
+      tracer.trace();
+
+      const trace::Result &result = tracer.get_trace_result();
+      const std::vector<trace::Ray *> &intercepts = result.get_intercepted(image);
+      math::VectorPair2 window = image.get_shape().get_bounding_box();
+      std::set<double> wavelens = result.get_ray_wavelen_set();
+
+      trace::Irradiance ref_all(window, 50, 40);
+      ref_all.add_intercepts(result, image);
+
+      std::vector<trace::Irradiance> ref_wl;
+
+      for (double w : wavelens)
+        {
+          ref_wl.push_back(trace::Irradiance(window, 50, 40));
+
+          for (auto &r : intercepts)
+            if (r->get_wavelen() == w)
+              {
+                const math::Vector3 &p = r->get_intercept_point();
+                ref_wl.back().add(math::Vector2(p.x(), p.y()), r->get_intercept_intensity());
+              }
+        }
+
+      image.set_detector(50, 40, true);
+
+      for (unsigned int threads = 1; threads <= 3; threads++)
+        {
+          trace::tracer t(sys);
+
+          t.get_params().set_thread_count(threads);
+          t.get_params().set_ray_history(false);
+          t.get_trace_result().set_retain_capacity(true);
+
+          for (int pass = 0; pass < 3; pass++)
+            {
+              t.trace();
+
+              const trace::Result &res = t.get_trace_result();
+              const trace::Detector &d = res.get_detector(image);
+
+              try {
+                res.get_intercepted(image);
+                FAIL("intercepted rays saved in detector mode");
+              } catch (const Error &e) {
+              }
+
+              if (d.get_ray_count() != intercepts.size())
+                FAIL("bad detector ray count " << d.get_ray_count() << " " << intercepts.size());
+
+              if (!same_map(d.get_irradiance(), ref_all))
+                FAIL(threads << " threads detector map differs, mode " << mode);
+
+              if (d.get_wavelen_set() != wavelens)
+                FAIL("bad detector wavelengths");
+
+              unsigned int i = 0;
+              for (double w : wavelens)
+                if (!same_map(d.get_irradiance(w), ref_wl[i++]))
+                  FAIL(threads << " threads detector wavelength map differs, mode " << mode);
+            }
+        }
+
+      // detector settings change
+
+      {
+        trace::tracer t(sys);
+
+        t.get_trace_result().set_retain_capacity(true);
+        t.trace();
+
+        image.set_detector(20, 10);
+        t.trace();
+
+        const trace::Detector &d = t.get_trace_result().get_detector(image);
+
+        if (d.get_irradiance().get_width() != 20 || d.is_per_wavelen() ||
+            !d.get_wavelen_set().empty())
+          FAIL("detector not updated");
+
+        if (!close(d.get_irradiance().get_total_intensity(), ref_all.get_total_intensity()))
+          FAIL("detector intensity differs");
+      }
+
+      // detector follows image shape
+
+      {
+        trace::tracer t(sys);
+
+        t.get_trace_result().set_retain_capacity(true);
+        t.trace();
+
+        unsigned int version = image.get_version();
+
+        image.set_shape(ref<shape::Rectangle>::create(9.));
+        t.trace();
+
+        const math::VectorPair2 &w = t.get_trace_result().get_detector(image)
+          .get_irradiance().get_window();
+
+        if (w[0].x() != -4.5 || w[1].y() != 4.5)
+          FAIL("detector window not updated with image shape");
+
+        image.set_shape(ref<shape::Rectangle>::create(10.));
+
+        if (image.get_version() == version)
+          FAIL("image version not updated");
+
+        version = image.get_version();
+        image.clear_detector();
+
+        if (image.get_version() == version)
+          FAIL("image version not updated by detector mode change");
+      }
+    }
+
+  return 0;
+}
+
@@ -0,0 +1,164 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+   Build a large segmented system and check elements registration
+   and identifiers reuse. Building times are reported for benchmarking.
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+
+#include <goptical/core/math/Vector>
+#include <goptical/core/math/VectorPair>
+#include <goptical/core/math/Transform>
+
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/Element>
+#include <goptical/core/sys/Group>
+#include <goptical/core/sys/Mirror>
+
+#include "test_common.hpp"
+
+using namespace goptical;
+
+static const unsigned int groups = 50;
+static const unsigned int segments = 99;
+
+static double elapsed(const std::chrono::steady_clock::time_point &start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void check_ids(const sys::system &sys)
+{
+  std::vector<bool> used(sys.get_element_count() + 1, false);
+
+  sys.get_elements<sys::Element>([&](const sys::Element &e)
+    {
+      if (e.get_system() != &sys)
+        FAIL("element not registered in system");
+
+      if (e.id() == 0 || e.id() > sys.get_element_count())
+        FAIL("bad element id " << e.id());
+
+      if (used[e.id()])
+        FAIL("element id " << e.id() << " used twice");
+
+      if (&sys.get_element(e.id()) != &e)
+        FAIL("element id " << e.id() << " lookup mismatch");
+
+      used[e.id()] = true;
+    });
+}
+
+int main()
+{
+  sys::system sys;
+  std::vector<ref<sys::Group> > arrays;
+  std::vector<ref<sys::Mirror> > mirrors;
+
+  // 50 lenslet groups with 99 segments each, 5000 elements
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<ref<sys::Element> > list;
+
+  for (unsigned int g = 0; g < groups; g++)
+    {
+      ref<sys::Group> grp = ref<sys::Group>::create(math::VectorPair3(math::Vector3(g * 100., 0., 0.), math::vector3_001));
+      std::vector<ref<sys::Element> > glist;
+
+      for (unsigned int i = 0; i < segments; i++)
+        {
+          ref<sys::Mirror> m = ref<sys::Mirror>::create(math::Vector3(0, i * 3., 0),
+                                                        -500., -1., 1.4);
+          glist.push_back(m);
+          mirrors.push_back(m);
+        }
+
+      grp->add(glist);
+      list.push_back(grp);
+      arrays.push_back(grp);
+    }
+
+  sys.add(list);
+
+  double t_build = elapsed(start);
+
+  if (sys.get_element_count() != groups * (segments + 1))
+    FAIL("bad element count " << sys.get_element_count());
+
+  check_ids(sys);
+
+  // global position through group transform
+  math::Vector3 p = mirrors[3 * segments + 5]->get_position();
+  if ((p - math::Vector3(300., 15., 0.)).len() > 1e-12)
+    FAIL("bad segment position " << p);
+
+  // remove and add back segments, identifiers must be reused
+  start = std::chrono::steady_clock::now();
+
+  unsigned int count = sys.get_element_count();
+
+  for (unsigned int i = 0; i < mirrors.size(); i += 2)
+    mirrors[i]->get_parent()->remove(*mirrors[i]);
+
+  if (sys.get_element_count() != count)
+    FAIL("element table shrunk while last element still registered");
+
+  for (unsigned int i = 0; i < mirrors.size(); i += 2)
+    arrays[i / segments]->add(mirrors[i]);
+
+  double t_reuse = elapsed(start);
+
+  if (sys.get_element_count() != count)
+    FAIL("identifiers not reused, element count " << sys.get_element_count());
+
+  check_ids(sys);
+
+  // moving a group updates segments transforms
+  arrays[3]->set_local_position(math::Vector3(0., 0., 10.));
+  p = mirrors[3 * segments + 5]->get_position();
+  if ((p - math::Vector3(0., 15., 10.)).len() > 1e-12)
+    FAIL("bad moved segment position " << p);
+
+  // remove whole system content, table shrinks
+  start = std::chrono::steady_clock::now();
+
+  for (auto &g : arrays)
+    sys.remove(*g);
+
+  double t_remove = elapsed(start);
+
+  if (sys.get_element_count() != 0)
+    FAIL("element table not released, count " << sys.get_element_count());
+
+  std::cout << count << " elements: build " << t_build
+            << " s, remove/add " << t_reuse
+            << " s, remove " << t_remove << " s" << std::endl;
+
+  return 0;
+}
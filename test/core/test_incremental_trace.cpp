@@ -0,0 +1,196 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <goptical/core/math/Vector>
+
+#include <goptical/core/curve/Sphere>
+
+#include <goptical/core/material/Air>
+
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/Element>
+#include <goptical/core/sys/Lens>
+#include <goptical/core/sys/Image>
+#include <goptical/core/sys/SourcePoint>
+
+#include <goptical/core/trace/Tracer>
+#include <goptical/core/trace/Result>
+#include <goptical/core/trace/Ray>
+#include <goptical/core/trace/Distribution>
+#include <goptical/core/trace/Params>
+#include <goptical/core/trace/Sequence>
+#include <goptical/core/trace/Detector>
+
+#include <goptical/core/light/SpectralLine>
+
+#include "test_common.hpp"
+
+using namespace goptical;
+
+static std::vector<double> get_points(trace::tracer &tracer, sys::Image &image)
+{
+  std::vector<double> res;
+
+  for (auto &r : tracer.get_trace_result().get_intercepted(image))
+    {
+      const math::Vector3 &p = r->get_intercept_point();
+
+      res.push_back(p.x());
+      res.push_back(p.y());
+      res.push_back(r->get_wavelen());
+    }
+
+  return res;
+}
+
+// trace without cache
+static std::vector<double> trace_full(sys::system &sys, sys::Image &image)
+{
+  trace::tracer tracer(sys);
+
+  tracer.get_trace_result().set_intercepted_save_state(image);
+  tracer.trace();
+
+  return get_points(tracer, image);
+}
+
+static void check(trace::tracer &tracer, sys::system &sys, sys::Image &image,
+                  unsigned int restart)
+{
+  tracer.trace();
+
+  if (tracer.get_restart_position() != restart)
+    FAIL("trace restarted from " << tracer.get_restart_position()
+         << " instead of " << restart);
+
+  std::vector<double> ref = trace_full(sys, image);
+
+  if (ref.empty())
+    FAIL("no ray intercepted by image");
+
+  if (get_points(tracer, image) != ref)
+    FAIL("incremental trace result differs, restart " << restart);
+}
+
+int main()
+{
+  test::Tessar  tessar(20);
+  sys::system   &sys = tessar._system;
+  sys::Lens     &lens = tessar._lens;
+  sys::Image    &image = tessar._image;
+  sys::SourcePoint &source = tessar._source;
+
+  trace::Sequence seq(sys);
+
+  sys.get_tracer_params().set_sequential_mode(seq);
+  sys.get_tracer_params().set_incremental(true);
+
+  unsigned int image_pos = 0, surface_pos = 0, entrance_pos = 0;
+
+  for (unsigned int i = 0; i < 10; i++)
+    {
+      const sys::Element *e = &seq.get_element(i);
+
+      if (e == &image)
+        image_pos = i;
+      if (e == &lens.get_surface(5))
+        surface_pos = i;
+      if (e == &lens.get_surface(0))
+        entrance_pos = i;
+    }
+
+  if (!image_pos || !surface_pos || entrance_pos != 1)
+    FAIL("unexpected sequence order");
+
+  for (unsigned int threads = 1; threads <= 3; threads += 2)
+    {
+      sys.get_tracer_params().set_thread_count(threads);
+
+      trace::tracer tracer(sys);
+
+      tracer.get_trace_result().set_intercepted_save_state(image);
+
+      // first trace starts from source
+      check(tracer, sys, image, 0);
+
+      // only elements with saved rays are traced again
+      check(tracer, sys, image, image_pos);
+
+      // restart from changed surface
+      lens.set_curve(ref<curve::Sphere>::create(1/0.036), 5);
+      check(tracer, sys, image, surface_pos);
+
+      // source rays depend on entrance surface
+      lens.set_curve(ref<curve::Sphere>::create(1/0.032), 0);
+      check(tracer, sys, image, 0);
+
+      if (tracer.get_cache_hit_count() != 2 ||
+          tracer.get_cache_miss_count() != 2 ||
+          tracer.get_cache_skipped_count() != image_pos + surface_pos)
+        FAIL("bad cache statistics");
+
+      // parameters change invalidate cache
+      tracer.get_params().set_lost_ray_length(2000);
+      check(tracer, sys, image, 0);
+
+      // environment change invalidate cache
+      sys.set_environment(ref<material::AirKohlrausch68>::create());
+      check(tracer, sys, image, 0);
+
+      // nothing saved, no element is traced again
+      trace::tracer tracer2(sys);
+
+      tracer2.trace();
+      tracer2.trace();
+
+      if (tracer2.get_restart_position() != seq.get_element_count())
+        FAIL("trace without saved rays restarted from "
+             << tracer2.get_restart_position());
+
+      // detector images are traced again
+      image.set_detector(16, 16);
+
+      for (unsigned int j = 0; j < 2; j++)
+        {
+          tracer2.trace();
+
+          if (tracer2.get_restart_position() != image_pos)
+            FAIL("detector trace restarted from "
+                 << tracer2.get_restart_position());
+
+          if (tracer2.get_trace_result().get_detector(image).get_ray_count() * 3 !=
+              trace_full(sys, image).size())
+            FAIL("bad detector ray count");
+        }
+
+      image.clear_detector();
+    }
+
+  return 0;
+}
@@ -0,0 +1,166 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+   Check materials properties table used when tracing rays gives the
+   values computed by materials.
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <set>
+
+#include <goptical/core/math/Vector>
+
+#include <goptical/core/material/Abbe>
+#include <goptical/core/material/Base>
+
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/Lens>
+#include <goptical/core/sys/Image>
+#include <goptical/core/sys/OpticalSurface>
+
+#include <goptical/core/trace/IndexTable>
+
+#include <goptical/core/light/SpectralLine>
+
+#include "test_common.hpp"
+
+using namespace goptical;
+
+/* material value, NaN when the material reports an error */
+template <typename F>
+static double value(const F &f)
+{
+  try {
+    return f();
+  } catch (...) {
+    return NAN;
+  }
+}
+
+static bool same(double a, double b)
+{
+  return a == b || (std::isnan(a) && std::isnan(b));
+}
+
+int main()
+{
+  sys::system   sys;
+
+  sys::Lens     lens(math::Vector3(0, 0, 0));
+
+  lens.add_surface(1/0.031186861,  14.934638, 4.627804137,
+                   ref<material::AbbeVd>::create(1.607170, 59.5002));
+  lens.add_surface(0,              14.934638, 5.417429465);
+  lens.add_surface(1/-0.014065441, 12.766446, 3.728230979,
+                   ref<material::AbbeVd>::create(1.575960, 41.2999));
+  lens.add_surface(1/0.034678487,  11.918098, 4.417903733);
+
+  sys.add(lens);
+
+  sys::Image      image(math::Vector3(0, 0, 50), 5);
+  sys.add(image);
+
+  std::set<double> wavelens;
+
+  wavelens.insert(light::SpectralLine::C);
+  wavelens.insert(light::SpectralLine::e);
+  wavelens.insert(light::SpectralLine::F);
+
+  trace::IndexTable table;
+
+  table.update(sys, wavelens, true);
+
+  if (table.get_wavelen_slot(light::SpectralLine::d) != trace::IndexTable::none)
+    FAIL("wavelength not in table has a slot");
+
+  const material::Base &env = sys.get_environment_proxy();
+  unsigned int env_slot = table.get_material_slot(&env);
+
+  if (env_slot == trace::IndexTable::none)
+    FAIL("no slot for environment material");
+
+  for (unsigned int i = 0; i < 4; i++)
+    {
+      const sys::OpticalSurface &s = lens.get_surface(i);
+
+      for (unsigned int side = 0; side < 2; side++)
+        {
+          const material::Base &m = s.get_material(side);
+          const material::Base &o = s.get_material(!side);
+          unsigned int slot = table.get_material_slot(s, side);
+          unsigned int other = table.get_material_slot(s, !side);
+
+          if (slot == trace::IndexTable::none || slot != table.get_material_slot(&m))
+            FAIL("bad material slot");
+
+          // surface materials set to none use the environment proxy
+          if (&m == &env && slot != env_slot)
+            FAIL("proxy material has its own slot");
+
+          for (auto wl : wavelens)
+            {
+              unsigned int w = table.get_wavelen_slot(wl);
+
+              if (w == trace::IndexTable::none)
+                FAIL("no slot for traced wavelength");
+
+              if (table.get_refractive_index(slot, w) != m.get_refractive_index(wl))
+                FAIL("bad refractive index");
+
+              if (!same(table.get_internal_transmittance(slot, w),
+                        value([&]() { return m.get_internal_transmittance(wl, 1.0); })))
+                FAIL("bad internal transmittance");
+
+              if (!same(table.get_normal_reflectance(other, slot, w),
+                        value([&]() { return m.get_normal_reflectance(&o, wl); })))
+                FAIL("bad normal reflectance");
+
+              if (!same(table.get_normal_transmittance(other, slot, w),
+                        value([&]() { return m.get_normal_transmittance(&o, wl); })))
+                FAIL("bad normal transmittance");
+            }
+        }
+    }
+
+  // table follows system changes
+  lens.get_surface(1).set_material(1, ref<material::AbbeVd>::create(1.5, 60));
+
+  table.invalidate();
+  table.update(sys, wavelens, false);
+
+  unsigned int slot = table.get_material_slot(lens.get_surface(1), 1);
+  unsigned int w = table.get_wavelen_slot(light::SpectralLine::e);
+
+  if (table.get_refractive_index(slot, w) !=
+      lens.get_surface(1).get_material(1).get_refractive_index(light::SpectralLine::e))
+    FAIL("table not updated");
+
+  if (!std::isnan(table.get_internal_transmittance(slot, w)))
+    FAIL("transmittance computed in simple trace mode");
+
+  return 0;
+}
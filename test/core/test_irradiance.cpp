@@ -0,0 +1,214 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+   Check irradiance maps built from saved intercepts and while tracing.
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include <goptical/core/math/Vector>
+#include <goptical/core/math/VectorPair>
+
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/Lens>
+#include <goptical/core/sys/Image>
+#include <goptical/core/sys/SourcePoint>
+
+#include <goptical/core/trace/Tracer>
+#include <goptical/core/trace/Result>
+#include <goptical/core/trace/Ray>
+#include <goptical/core/trace/Distribution>
+#include <goptical/core/trace/Params>
+#include <goptical/core/trace/Irradiance>
+
+#include <goptical/core/light/SpectralLine>
+
+#include <goptical/core/Error>
+
+#include "test_common.hpp"
+
+using namespace goptical;
+
+static bool close(double a, double b)
+{
+  return fabs(a - b) <= 1e-9 * std::max(1.0, fabs(b));
+}
+
+static bool same_map(const trace::Irradiance &a, const trace::Irradiance &b, bool exact)
+{
+  for (size_t i = 0; i < a.get_data().size(); i++)
+    if (exact ? a.get_data()[i] != b.get_data()[i]
+        : !close(a.get_data()[i], b.get_data()[i]))
+      return false;
+
+  return true;
+}
+
+int main()
+{
+  test::Tessar  tessar(60);
+  sys::system   &sys = tessar._system;
+  sys::Image    &image = tessar._image;
+
+  trace::tracer tracer(sys);
+
+  tracer.get_trace_result().set_intercepted_save_state(image);
+  tracer.trace();
+
+  const trace::Result &result = tracer.get_trace_result();
+  const std::vector<trace::Ray *> &intercepts = result.get_intercepted(image);
+
+  if (intercepts.size() < 10000)
+    FAIL("not enough intercepts " << intercepts.size());
+
+  math::Vector3 c = result.get_intercepted_centroid(image);
+  const unsigned int w = 64, h = 48;
+  const double hw = 0.05;
+  math::VectorPair2 window(math::Vector2(c.x() - hw, c.y() - hw),
+                           math::Vector2(c.x() + hw, c.y() + hw * .5));
+
+  // plain binning of intercepts
+
+  std::vector<double> bins(w * h, 0.0);
+  double inside = 0, total = 0;
+
+  for (auto &r : intercepts)
+    {
+      const math::Vector3 &p = r->get_intercept_point();
+      double x = (p.x() - window[0].x()) / (window[1].x() - window[0].x()) * w;
+      double y = (p.y() - window[0].y()) / (window[1].y() - window[0].y()) * h;
+
+      total += r->get_intercept_intensity();
+
+      if (x < 0 || y < 0 || x > w || y > h)
+        continue;
+
+      bins[std::min((unsigned int)y, h - 1) * w +
+           std::min((unsigned int)x, w - 1)] += r->get_intercept_intensity();
+      inside += r->get_intercept_intensity();
+    }
+
+  if (inside >= total || inside < total * .2)
+    FAIL("window should only cover part of the spot");
+
+  trace::Irradiance map(window, w, h);
+
+  map.add_intercepts(result, image);
+
+  for (unsigned int y = 0; y < h; y++)
+    for (unsigned int x = 0; x < w; x++)
+      if (!close(map.get_value(x, y), bins[y * w + x]))
+        FAIL("bad pixel value " << x << " " << y);
+
+  if (!close(map.get_total_intensity(), inside))
+    FAIL("rays outside window not dropped");
+
+  if (!close(map.get_irradiance(3, 4) * map.get_pixel_area(), map.get_value(3, 4)))
+    FAIL("bad irradiance");
+
+  // partial maps
+
+  for (unsigned int threads = 2; threads <= 5; threads++)
+    {
+      trace::Irradiance m(window, w, h);
+
+      m.add_intercepts(result, image, threads);
+
+      if (!same_map(m, map, false))
+        FAIL(threads << " threads map differs");
+    }
+
+  // bilinear splatting keeps intensity inside the window
+
+  trace::Irradiance bmap(window, w, h);
+
+  bmap.set_bilinear(true);
+  bmap.add_intercepts(result, image, 3);
+
+  if (!close(bmap.get_total_intensity(), inside))
+    FAIL("bilinear splatting does not preserve intensity");
+
+  if (same_map(bmap, map, false))
+    FAIL("bilinear splatting not used");
+
+  // splatting of a point on a pixel center
+
+  {
+    trace::Irradiance m(math::VectorPair2(math::Vector2(0, 0), math::Vector2(4, 4)), 4, 4);
+
+    m.set_bilinear(true);
+    m.add(math::Vector2(1.5, 2.5), 1.0);
+    m.add(math::Vector2(2.0, 2.0), 4.0);
+
+    if (m.get_value(1, 2) != 2.0 || m.get_value(2, 2) != 1.0 ||
+        m.get_value(1, 1) != 1.0 || m.get_value(2, 1) != 1.0)
+      FAIL("bad bilinear weights");
+  }
+
+  // rays on window edges are kept
+
+  for (int bilinear = 0; bilinear < 2; bilinear++)
+    {
+      trace::Irradiance m(math::VectorPair2(math::Vector2(0, 0), math::Vector2(4, 4)), 4, 4);
+
+      m.set_bilinear(bilinear);
+      m.add(math::Vector2(0, 0), 1.0);
+      m.add(math::Vector2(4, 4), 2.0);
+      m.add(math::Vector2(4, 0), 4.0);
+      m.add(math::Vector2(4.001, 2), 8.0);
+
+      if (m.get_value(0, 0) != 1.0 || m.get_value(3, 3) != 2.0 ||
+          m.get_value(3, 0) != 4.0 || m.get_total_intensity() != 7.0)
+        FAIL("bad window edges handling");
+    }
+
+  // map used as sink while tracing
+
+  for (unsigned int threads = 1; threads <= 3; threads++)
+    {
+      trace::tracer t(sys);
+      ref<trace::Irradiance> sink = ref<trace::Irradiance>::create(window, w, h);
+
+      t.get_params().set_thread_count(threads);
+      t.get_trace_result().set_intercepted_sink(image, sink);
+      t.trace();
+
+      if (!same_map(*sink, map, threads == 1))
+        FAIL(threads << " threads sink map differs");
+    }
+
+  try {
+    trace::Irradiance m(math::VectorPair2(math::Vector2(0, 0), math::Vector2(0, 1)), 4, 4);
+    FAIL("empty window not rejected");
+  } catch (const Error &e) {
+  }
+
+  return 0;
+}
+
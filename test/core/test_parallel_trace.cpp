@@ -0,0 +1,173 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <thread>
+
+#include <goptical/core/math/Vector>
+
+#include <goptical/core/Error>
+
+#include <goptical/core/curve/Sphere>
+#include <goptical/core/shape/Ring>
+#include <goptical/core/material/Abbe>
+
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/Lens>
+#include <goptical/core/sys/Image>
+#include <goptical/core/sys/SourcePoint>
+
+#include <goptical/core/trace/Tracer>
+#include <goptical/core/trace/Result>
+#include <goptical/core/trace/Ray>
+#include <goptical/core/trace/Distribution>
+#include <goptical/core/trace/Params>
+#include <goptical/core/trace/Sequence>
+
+#include <goptical/core/light/SpectralLine>
+
+#include "test_common.hpp"
+
+using namespace goptical;
+
+// sagitta is not defined on axis, rays do not reach the ring hole
+class AxisSphere : public curve::Sphere
+{
+public:
+  AxisSphere(double roc)
+    : curve::Sphere(roc)
+  {
+  }
+
+  double sagitta(double r) const
+  {
+    if (r == 0.)
+      throw Error("sagitta not defined on axis");
+
+    return curve::Sphere::sagitta(r);
+  }
+};
+
+static std::vector<double> trace_image(sys::system &sys, sys::Image &image,
+                                       unsigned int threads)
+{
+  trace::tracer tracer(sys);
+  std::vector<double> res;
+
+  tracer.get_params().set_thread_count(threads);
+  tracer.get_trace_result().set_intercepted_save_state(image);
+  tracer.trace();
+
+  for (auto &r : tracer.get_trace_result().get_intercepted(image))
+    {
+      const math::Vector3 &p = r->get_intercept_point();
+
+      res.push_back(p.x());
+      res.push_back(p.y());
+      res.push_back(r->get_wavelen());
+    }
+
+  return res;
+}
+
+int main()
+{
+  test::Tessar  tessar(20);
+  sys::system   &sys = tessar._system;
+  sys::Image    &image = tessar._image;
+
+  trace::Sequence seq(sys);
+
+  for (int mode = 0; mode < 2; mode++)
+    {
+      if (mode)
+        sys.get_tracer_params().set_sequential_mode(seq);
+
+      // multithreaded trace must give the same result
+      std::vector<double> ref = trace_image(sys, image, 1);
+
+      if (ref.empty())
+        FAIL("no ray intercepted by image");
+
+      for (unsigned int threads = 2; threads <= 5; threads++)
+        {
+          std::vector<double> res = trace_image(sys, image, threads);
+
+          if (res.size() != ref.size() ||
+              std::memcmp(&res[0], &ref[0], ref.size() * sizeof(double)))
+            FAIL(threads << " threads trace result differs from single thread trace");
+        }
+    }
+
+  // values which can not be computed are not needed by the trace
+  {
+    sys::system   s2;
+    sys::Lens     lens(math::Vector3(0, 0, 0));
+
+    lens.add_surface(ref<AxisSphere>::create(50.), ref<shape::Ring>::create(15., 3.),
+                     5., ref<material::AbbeVd>::create(1.5168, 64.17));
+    lens.add_surface(-50., 15., 50.);
+    s2.add(lens);
+
+    sys::Image    image2(math::Vector3(0, 0, 55), 20);
+    s2.add(image2);
+
+    sys::SourcePoint source2(sys::SourceAtInfinity, math::Vector3(0, .05, 1));
+    s2.add(source2);
+
+    std::vector<double> ref = trace_image(s2, image2, 1);
+
+    if (ref.empty() || trace_image(s2, image2, 3) != ref)
+      FAIL("multithreaded trace differs with partially defined curve");
+  }
+
+  // tracers of the same system used from different threads
+  std::vector<double> ref = trace_image(sys, image, 1);
+
+  for (int pass = 0; pass < 4; pass++)
+    {
+      // compiled system has to be updated by one of the tracers
+      image.set_local_position(image.get_local_position());
+
+      std::vector<std::vector<double> > res(4);
+      std::vector<std::thread> threads;
+
+      for (unsigned int i = 0; i < res.size(); i++)
+        threads.push_back(std::thread([&, i]() {
+              res[i] = trace_image(sys, image, 1);
+            }));
+
+      for (auto &t : threads)
+        t.join();
+
+      for (auto &r : res)
+        if (r != ref)
+          FAIL("concurrent tracers result differs from single tracer result");
+    }
+
+  return 0;
+}
@@ -0,0 +1,165 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+   Check distribution patterns kept by surfaces.
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <memory>
+#include <thread>
+
+#include <goptical/core/math/Vector>
+
+#include <goptical/core/curve/Sphere>
+#include <goptical/core/shape/Disk>
+
+#include <goptical/core/material/Base>
+
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/Surface>
+#include <goptical/core/sys/OpticalSurface>
+
+#include <goptical/core/trace/Distribution>
+
+#include "test_common.hpp"
+
+using namespace goptical;
+
+static std::vector<math::Vector3> pattern(const sys::Surface &s, const trace::Distribution &d)
+{
+  std::vector<math::Vector3> res;
+
+  s.get_pattern([&](const math::Vector3 &v) { res.push_back(v); }, d);
+
+  return res;
+}
+
+static bool same(const std::vector<math::Vector3> &a, const std::vector<math::Vector3> &b)
+{
+  if (a.size() != b.size())
+    return false;
+
+  for (unsigned int i = 0; i < a.size(); i++)
+    if ((a[i] - b[i]).len() != 0)
+      return false;
+
+  return true;
+}
+
+typedef std::shared_ptr<const std::vector<math::Vector3> > pattern_t;
+
+int main()
+{
+  sys::system sys;
+  sys::OpticalSurface s(math::Vector3(0, 0, 0), 50., 10., material::none, material::none);
+
+  sys.add(s);
+
+  trace::Distribution d1(trace::HexaPolarDist, 10);
+  trace::Distribution d2(trace::CrossDist, 8);
+
+  pattern_t p1 = s.get_pattern(d1);
+
+  if (p1->empty() || !same(*p1, pattern(s, d1)))
+    FAIL("cached pattern differs");
+
+  pattern_t p2 = s.get_pattern(d2);
+
+  if (!same(*p2, pattern(s, d2)))
+    FAIL("cached pattern differs");
+
+  // kept buffers are returned again
+  if (s.get_pattern(d1) != p1 || s.get_pattern(d2) != p2)
+    FAIL("pattern not kept");
+
+  if (s.get_pattern(d1, true) == p1)
+    FAIL("unobstructed pattern must be kept separately");
+
+  // surface change drops patterns
+  std::vector<math::Vector3> old = *p1;
+  ref<curve::Sphere> sphere = ref<curve::Sphere>::create(-30.);
+  s.set_curve(sphere);
+
+  std::vector<math::Vector3> expected = pattern(s, d1);
+
+  if (!same(*s.get_pattern(d1), expected))
+    FAIL("pattern not updated");
+
+  // dropped buffers stay valid while in use
+  if (!same(*p1, old))
+    FAIL("dropped pattern released");
+
+  // curve and shape changes drop patterns too
+  sphere->set_roc(-40.);
+
+  if (!same(*s.get_pattern(d1), pattern(s, d1)))
+    FAIL("pattern not updated on curve change");
+
+  ref<shape::Disk> disk = ref<shape::Disk>::create(10.);
+  s.set_shape(disk);
+  s.get_pattern(d1);
+  disk->set_radius(12.);
+
+  expected = pattern(s, d1);
+
+  if (!same(*s.get_pattern(d1), expected))
+    FAIL("pattern not updated on shape change");
+
+  // least recently used patterns are dropped
+  for (unsigned int i = 0; i < 10; i++)
+    if (!same(*s.get_pattern(trace::Distribution(trace::HexaPolarDist, i + 1)),
+              pattern(s, trace::Distribution(trace::HexaPolarDist, i + 1))))
+      FAIL("bad pattern");
+
+  if (!same(*s.get_pattern(d1), expected))
+    FAIL("bad pattern");
+
+  // patterns requested from different threads
+  std::vector<std::thread> threads;
+  bool ok[4];
+
+  for (unsigned int i = 0; i < 4; i++)
+    threads.push_back(std::thread([&, i]() {
+          ok[i] = true;
+
+          for (unsigned int j = 0; j < 200; j++)
+            {
+              trace::Distribution d(trace::HexaPolarDist, (i + j) % 6 + 1);
+
+              ok[i] &= same(*s.get_pattern(d), pattern(s, d));
+            }
+        }));
+
+  for (auto &t : threads)
+    t.join();
+
+  for (unsigned int i = 0; i < 4; i++)
+    if (!ok[i])
+      FAIL("bad pattern from thread " << i);
+
+  return 0;
+}
@@ -0,0 +1,232 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+   Check ray fan plots built from the intercepts index against values
+   computed by walking the rays tree for each plotted ray, with and
+   without ray history in the ray fan tracer, on multiple threads.
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+
+#include <goptical/core/math/Vector>
+
+#include <goptical/core/Error>
+
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/Surface>
+#include <goptical/core/sys/Lens>
+#include <goptical/core/sys/Image>
+#include <goptical/core/sys/SourcePoint>
+
+#include <goptical/core/trace/Tracer>
+#include <goptical/core/trace/Result>
+#include <goptical/core/trace/Ray>
+#include <goptical/core/trace/Distribution>
+#include <goptical/core/trace/Params>
+
+#include <goptical/core/analysis/RayFan>
+
+#include <goptical/core/data/Plot>
+#include <goptical/core/data/PlotData>
+#include <goptical/core/data/DiscreteSet>
+
+#include <goptical/core/light/SpectralLine>
+
+#include "test_common.hpp"
+
+using namespace goptical;
+
+typedef analysis::RayFan::rayfan_plot_type_e plot_type_t;
+
+/* ray fan values computed from the rays tree */
+struct Reference
+{
+  Reference(const sys::system &sys, analysis::RayFan::rayfan_plane_e plane)
+    : _tracer(sys),
+      _entrance(&sys.get_entrance_pupil()),
+      _image(sys.find<const sys::Image>()),
+      _plane(plane)
+  {
+    trace::Distribution dist(plane == analysis::RayFan::SagittalAberration
+                             ? trace::SagittalDist : trace::TangentialDist, 15);
+
+    _tracer.get_params().set_distribution(*_entrance, dist);
+    _tracer.get_params().set_unobstructed(true);
+    _tracer.get_params().set_ray_history(true);
+    _tracer.get_trace_result().set_intercepted_save_state(*_image);
+    _tracer.trace();
+  }
+
+  const trace::Ray * entrance_ray(const trace::Ray &r) const
+  {
+    const trace::Ray *ray = &r;
+
+    while (ray && ray->get_creator() != _entrance)
+      ray = ray->get_parent();
+
+    if (!ray)
+      throw Error();
+
+    return ray;
+  }
+
+  double value(plot_type_t t, const trace::Ray &r, const trace::Ray &chief) const
+  {
+    switch (t)
+      {
+      case analysis::RayFan::EntranceHeight:
+        return entrance_ray(r)->origin()[_plane] / _entrance->get_shape()
+          .get_outter_radius(math::Vector2(1 - _plane, _plane));
+
+      case analysis::RayFan::EntranceAngle: {
+        const trace::Ray *ray = entrance_ray(r)->get_parent();
+
+        if (!ray)
+          throw Error();
+
+        // degrees
+        return atan(ray->direction()[_plane] / ray->direction().z()) * 180 / M_PI;
+      }
+
+      case analysis::RayFan::TransverseDistance:
+        return r.get_intercept_point()[_plane] - chief.get_intercept_point()[_plane];
+
+      case analysis::RayFan::OpticalPathDiff: {
+        const double wl = r.get_wavelen();
+        double dist = 0.0;
+
+        for (const trace::Ray *ray = &r; ray; ray = ray->get_parent())
+          dist += ray->get_len() * ray->get_material()->get_refractive_index(wl);
+
+        return dist / (wl * 1e-6);
+      }
+
+      default:
+        FAIL("unexpected plot type");
+      }
+  }
+
+  const trace::Ray & chief_ray(double wavelen) const
+  {
+    for (auto &r : _tracer.get_trace_result().get_intercepted(*_image))
+      if (r->get_wavelen() == wavelen &&
+          fabs(value(analysis::RayFan::EntranceHeight, *r, *r)) < 1e-8)
+        return *r;
+
+    FAIL("no chief ray for wavelen " << wavelen);
+  }
+
+  trace::tracer         _tracer;
+  const sys::Surface    *_entrance;
+  const sys::Image      *_image;
+  analysis::RayFan::rayfan_plane_e _plane;
+};
+
+static void check_plot(analysis::RayFan &fan, const Reference &reference,
+                       plot_type_t x, plot_type_t y)
+{
+  ref<data::Plot> plot = fan.get_plot(x, y);
+  const trace::Result &result = reference._tracer.get_trace_result();
+  const std::set<double> &wavelens = result.get_ray_wavelen_set();
+  bool single_y_ref = y != analysis::RayFan::OpticalPathDiff;
+  double x_ref = 0, y_ref = 0;
+  unsigned int j = 0;
+
+  if (wavelens.size() != 3 || plot->get_plot_count() != wavelens.size())
+    FAIL("bad plot count " << plot->get_plot_count());
+
+  for (double w : wavelens)
+    {
+      const trace::Ray &chief = reference.chief_ray(w);
+
+      if (!j)
+        x_ref = reference.value(x, chief, chief);
+
+      if (!j || !single_y_ref)
+        y_ref = reference.value(y, chief, chief);
+
+      data::DiscreteSet s;
+
+      for (auto &r : result.get_intercepted(*reference._image))
+        if (r->get_wavelen() == w)
+          {
+            double xv, yv;
+
+            try {
+              xv = reference.value(x, *r, chief) - x_ref;
+              yv = reference.value(y, *r, chief) - y_ref;
+            } catch (...) {
+              continue;
+            }
+
+            s.add_data(xv, yv);
+          }
+
+      const data::DiscreteSet &p = static_cast<const data::DiscreteSet &>
+        (plot->get_plot_data(j++).get_set());
+
+      if (s.get_count() < 10 || p.get_count() != s.get_count())
+        FAIL("bad plot points count " << p.get_count() << " " << s.get_count());
+
+      // optical path is accumulated from source while tracing
+      double tolerance = y == analysis::RayFan::OpticalPathDiff ? 1e-6 : 0.0;
+
+      for (unsigned int i = 0; i < s.get_count(); i++)
+        if (p.get_x_value(i) != s.get_x_value(i) ||
+            fabs(p.get_y_value(i) - s.get_y_value(i)) > tolerance)
+          FAIL("plot " << x << "/" << y << " differs at wavelen " << w
+               << " point " << i);
+    }
+}
+
+int main()
+{
+  test::Tessar  tessar(20);
+  sys::system   &sys = tessar._system;
+
+  for (int i = 0; i < 4; i++)
+    {
+      analysis::RayFan::rayfan_plane_e p = (analysis::RayFan::rayfan_plane_e)(i & 1);
+
+      sys.get_tracer_params().set_ray_history(i < 2);
+      sys.get_tracer_params().set_thread_count(i == 3 ? 4 : 1);
+
+      analysis::RayFan fan(sys, p);
+      Reference reference(sys, p);
+
+      check_plot(fan, reference, analysis::RayFan::EntranceHeight,
+                 analysis::RayFan::TransverseDistance);
+      check_plot(fan, reference, analysis::RayFan::EntranceAngle,
+                 analysis::RayFan::TransverseDistance);
+      check_plot(fan, reference, analysis::RayFan::EntranceHeight,
+                 analysis::RayFan::OpticalPathDiff);
+      check_plot(fan, reference, analysis::RayFan::EntranceAngle,
+                 analysis::RayFan::EntranceHeight);
+    }
+
+  return 0;
+}
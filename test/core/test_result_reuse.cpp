@@ -0,0 +1,187 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include <goptical/core/math/Vector>
+
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/Lens>
+#include <goptical/core/sys/Image>
+#include <goptical/core/sys/SourcePoint>
+
+#include <goptical/core/trace/Tracer>
+#include <goptical/core/trace/Result>
+#include <goptical/core/trace/Ray>
+#include <goptical/core/trace/Distribution>
+#include <goptical/core/trace/Params>
+#include <goptical/core/trace/Sequence>
+
+#include <goptical/core/light/SpectralLine>
+
+#include "test_common.hpp"
+
+using namespace goptical;
+
+static std::vector<double> get_points(trace::Result &result, sys::Image &image)
+{
+  std::vector<double> res;
+
+  for (auto &r : result.get_intercepted(image))
+    {
+      const math::Vector3 &p = r->get_intercept_point();
+
+      res.push_back(p.x());
+      res.push_back(p.y());
+      res.push_back(r->get_wavelen());
+    }
+
+  return res;
+}
+
+static std::vector<double> sorted_points(trace::Result &result, sys::Image &image)
+{
+  std::vector<double> p = get_points(result, image);
+  std::vector<std::vector<double> > t;
+
+  for (size_t i = 0; i < p.size(); i += 3)
+    t.push_back(std::vector<double>(p.begin() + i, p.begin() + i + 3));
+
+  std::sort(t.begin(), t.end());
+
+  std::vector<double> res;
+  for (auto &v : t)
+    res.insert(res.end(), v.begin(), v.end());
+
+  return res;
+}
+
+/* sequential trace without history propagates source rays by batches */
+static void test_seq_batches()
+{
+  test::Tessar  tessar(40);
+  sys::system   &sys = tessar._system;
+  sys::Image    &image = tessar._image;
+
+  trace::Sequence seq(sys);
+  sys.get_tracer_params().set_sequential_mode(seq);
+
+  std::vector<double> ref;
+  double ref_max = 0;
+
+  for (int history = 1; history >= 0; history--)
+    {
+      trace::tracer tracer(sys);
+      trace::Result &result = tracer.get_trace_result();
+
+      tracer.get_params().set_ray_history(history);
+      result.set_intercepted_save_state(image);
+
+      tracer.trace();
+
+      if (result.get_ray_wavelen_set().size() != 3)
+        FAIL("wrong wavelength count");
+
+      std::vector<double> points = sorted_points(result, image);
+      double max = result.get_max_ray_intensity();
+
+      if (history)
+        {
+          if (points.size() / 3 <= 4096)
+            FAIL("not enough rays to span several batches");
+
+          ref = points;
+          ref_max = max;
+        }
+      else
+        {
+          if (points != ref)
+            FAIL("batched trace differs from trace with history");
+
+          // released ray slots must not be accounted
+          if (max != ref_max)
+            FAIL("max ray intensity " << max << " expected " << ref_max);
+        }
+    }
+}
+
+int main()
+{
+  test::Tessar  tessar(20);
+  sys::system   &sys = tessar._system;
+  sys::Image    &image = tessar._image;
+  sys::SourcePoint &source = tessar._source;
+
+  trace::Sequence seq(sys);
+
+  for (int mode = 0; mode < 2; mode++)
+    {
+      if (mode)
+        sys.get_tracer_params().set_sequential_mode(seq);
+
+      for (unsigned int threads = 1; threads <= 3; threads += 2)
+        for (int history = 0; history < 2; history++)
+          {
+            trace::tracer tracer(sys);
+            trace::Result &result = tracer.get_trace_result();
+
+            tracer.get_params().set_thread_count(threads);
+            tracer.get_params().set_ray_history(history);
+            result.set_intercepted_save_state(image);
+            result.set_generated_save_state(source);
+
+            tracer.trace();
+            std::vector<double> ref = get_points(result, image);
+
+            if (ref.empty())
+              FAIL("no ray intercepted by image");
+
+            result.set_retain_capacity(true);
+
+            for (int i = 0; i < 4; i++)
+              {
+                unsigned int count = result.get_alloc_count();
+
+                tracer.trace();
+
+                if (get_points(result, image) != ref)
+                  FAIL("trace result differs when retaining capacity");
+
+                // no allocation once storage has been retained
+                if (i > 0 && result.get_alloc_count() != count)
+                  FAIL((result.get_alloc_count() - count)
+                       << " allocations in steady state, "
+                       << threads << " threads, history " << history);
+              }
+          }
+    }
+
+  test_seq_batches();
+
+  return 0;
+}
@@ -0,0 +1,188 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+   Check random and low discrepancy distribution patterns.
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+#include <goptical/core/math/Vector>
+#include <goptical/core/math/RandomStream>
+
+#include <goptical/core/shape/Base>
+#include <goptical/core/shape/Disk>
+#include <goptical/core/shape/Ring>
+#include <goptical/core/shape/Rectangle>
+
+#include <goptical/core/trace/Distribution>
+
+#include "test_common.hpp"
+
+using namespace goptical;
+
+static std::vector<math::Vector2> pattern(const shape::Base &s, const trace::Distribution &d)
+{
+  std::vector<math::Vector2> res;
+
+  s.get_pattern([&](const math::Vector2 &v) { res.push_back(v); }, d);
+
+  return res;
+}
+
+static bool same(const std::vector<math::Vector2> &a, const std::vector<math::Vector2> &b)
+{
+  if (a.size() != b.size())
+    return false;
+
+  for (unsigned int i = 0; i < a.size(); i++)
+    if ((a[i] - b[i]).len() != 0)
+      return false;
+
+  return true;
+}
+
+/* rms error of the disk average of r^2 over several seeds */
+static double integration_error(trace::Pattern p, unsigned int count)
+{
+  double err = 0;
+
+  for (unsigned int seed = 0; seed < 32; seed++)
+    {
+      trace::Distribution d(p);
+      double sum = 0;
+      unsigned int n = 0;
+
+      d.set_seed(seed);
+      d.get_disk_samples(count, 0.0, [&](const math::Vector2 &v)
+        {
+          sum += v.x() * v.x() + v.y() * v.y();
+          n++;
+        });
+
+      err += (sum / n - 0.5) * (sum / n - 0.5);
+    }
+
+  return sqrt(err / 32);
+}
+
+int main()
+{
+  // counter based streams
+  {
+    math::RandomStream a(1, 0), b(1, 0), c(1, 1), e(2, 0);
+    double mean = 0;
+    unsigned int same_c = 0, same_e = 0;
+
+    for (unsigned int i = 0; i < 10000; i++)
+      {
+        double u = a.uniform();
+
+        if (u < 0 || u >= 1)
+          FAIL("random value out of range " << u);
+
+        if (u != b.get_uniform(i))
+          FAIL("random stream not reproducible at " << i);
+
+        same_c += u == c.get_uniform(i);
+        same_e += u == e.get_uniform(i);
+        mean += u;
+      }
+
+    if (same_c || same_e)
+      FAIL("random streams not independent");
+
+    if (fabs(mean / 10000 - 0.5) > 0.01)
+      FAIL("random stream not uniform " << mean / 10000);
+
+    if (a.get_position() != 10000)
+      FAIL("bad random stream position");
+  }
+
+  static const trace::Pattern patterns[] = {
+    trace::RandomDist, trace::SobolDist, trace::HaltonDist, trace::JitteredDist
+  };
+
+  shape::Disk disk(10);
+  shape::Ring ring(10, 4);
+  shape::Rectangle rect(20, 10);
+  const shape::Base *shapes[] = { &disk, &ring, &rect };
+
+  for (unsigned int i = 0; i < 4; i++)
+    for (unsigned int j = 0; j < 3; j++)
+      {
+        const shape::Base &s = *shapes[j];
+
+        // round shapes random pattern only covers the center
+        if (patterns[i] == trace::RandomDist && &s == &ring)
+          continue;
+
+        trace::Distribution d(patterns[i], 20, 1.0);
+
+        d.set_seed(42);
+        std::vector<math::Vector2> p1 = pattern(s, d);
+        std::vector<math::Vector2> p2 = pattern(s, d);
+
+        if (p1.size() < (i ? 100 : 1))
+          FAIL("pattern " << patterns[i] << " shape " << j << ": too few points " << p1.size());
+
+        if (!same(p1, p2))
+          FAIL("pattern " << patterns[i] << " shape " << j << ": not reproducible");
+
+        for (auto &v : p1)
+          if (!s.inside(v))
+            FAIL("pattern " << patterns[i] << " shape " << j << ": point outside " << v);
+
+        d.set_seed(43);
+        if (same(p1, pattern(s, d)))
+          FAIL("pattern " << patterns[i] << " shape " << j << ": seed ignored");
+
+        d.set_seed(42);
+        d.set_stream(1);
+        if (same(p1, pattern(s, d)))
+          FAIL("pattern " << patterns[i] << " shape " << j << ": stream ignored");
+      }
+
+  // low discrepancy and stratified patterns converge faster
+  {
+    double random = integration_error(trace::RandomDist, 1024);
+
+    for (unsigned int i = 1; i < 4; i++)
+      {
+        double e = integration_error(patterns[i], 1024);
+
+        std::cout << "pattern " << patterns[i] << " error " << e
+                  << " random error " << random << std::endl;
+
+        if (e * 5 > random)
+          FAIL("pattern " << patterns[i] << " does not improve on random sampling");
+      }
+  }
+
+  return 0;
+}
+
@@ -0,0 +1,167 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+   Check spot statistics and sorted encircled intensity queries
+   against a plain scan of the intercepts.
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+#include <goptical/core/math/Vector>
+
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/Lens>
+#include <goptical/core/sys/Image>
+#include <goptical/core/sys/SourcePoint>
+
+#include <goptical/core/trace/Tracer>
+#include <goptical/core/trace/Result>
+#include <goptical/core/trace/Ray>
+#include <goptical/core/trace/Distribution>
+#include <goptical/core/trace/Params>
+
+#include <goptical/core/data/Plot>
+#include <goptical/core/data/PlotData>
+#include <goptical/core/data/Set>
+
+#include <goptical/core/analysis/Spot>
+
+#include <goptical/core/light/SpectralLine>
+
+#include "test_common.hpp"
+
+using namespace goptical;
+
+static bool close(double a, double b)
+{
+  return fabs(a - b) <= 1e-9 * std::max(1.0, fabs(b));
+}
+
+int main()
+{
+  test::Tessar  tessar(60);
+  sys::system   &sys = tessar._system;
+  sys::Image    &image = tessar._image;
+
+  analysis::Spot spot(sys);
+  analysis::Spot spot_mt(sys);
+
+  spot_mt.get_tracer().get_params().set_thread_count(4);
+
+  double max = spot.get_max_radius();
+
+  // non const tracer access would invalidate the analysis
+  const trace::tracer &tracer = static_cast<const analysis::Spot &>(spot).get_tracer();
+  const auto &intercepts = tracer.get_trace_result().get_intercepted(image);
+
+  if (intercepts.size() < 10000)
+    FAIL("not enough intercepts " << intercepts.size());
+
+  // plain scan of intercepts
+
+  const math::Vector3 &c = spot.get_centroid();
+  double rms = 0, total = 0;
+
+  for (auto &i : intercepts)
+    {
+      rms += (i->get_intercept_point() - c).len() * (i->get_intercept_point() - c).len();
+      total += i->get_intensity();
+    }
+
+  rms = sqrt(rms / intercepts.size());
+
+  if (!close(spot.get_rms_radius(), rms) || !close(spot.get_total_intensity(), total))
+    FAIL("bad spot statistics");
+
+  // threaded statistics
+
+  if ((spot_mt.get_centroid() - c).len() > 1e-12 ||
+      !close(spot_mt.get_rms_radius(), spot.get_rms_radius()) ||
+      !close(spot_mt.get_max_radius(), max) ||
+      !close(spot_mt.get_total_intensity(), spot.get_total_intensity()))
+    FAIL("threaded spot statistics differ");
+
+  const std::set<double> &wavelens = tracer.get_trace_result().get_ray_wavelen_set();
+
+  for (unsigned int k = 0; k <= 20; k++)
+    {
+      double r = max * k / 16;
+      double e = 0, s = 0, w0 = 0;
+
+      for (auto &i : intercepts)
+        {
+          math::Vector3 d = i->get_intercept_point() - c;
+
+          if (d.len() <= r)
+            {
+              e += i->get_intensity();
+              if (i->get_wavelen() == *wavelens.begin())
+                w0 += i->get_intensity();
+            }
+
+          if (std::max(fabs(d.x()), fabs(d.y())) <= r)
+            s += i->get_intensity();
+        }
+
+      if (!close(spot.get_encircled_intensity(r), e))
+        FAIL("bad encircled intensity at " << r << ": "
+             << spot.get_encircled_intensity(r) << " " << e);
+
+      if (!close(spot.get_encircled_intensity(r, *wavelens.begin()), w0))
+        FAIL("bad wavelen encircled intensity at " << r);
+
+      if (!close(spot.get_ensquared_intensity(r), s))
+        FAIL("bad ensquared intensity at " << r);
+    }
+
+  if (spot.get_encircled_intensity(max) != spot.get_total_intensity())
+    FAIL("spot max radius does not enclose all intensity");
+
+  // plot
+
+  ref<data::Plot> plot = spot.get_encircled_intensity_plot(50);
+
+  if (plot->get_plot_count() != wavelens.size())
+    FAIL("bad encircled intensity plot count");
+
+  double sum = 0;
+
+  for (unsigned int i = 0; i < plot->get_plot_count(); i++)
+    {
+      const data::Set &set = plot->get_plot_data(i).get_set();
+      unsigned int last = set.get_count() - 1;
+
+      sum += set.get_y_value(&last);
+    }
+
+  if (!close(sum, spot.get_total_intensity()))
+    FAIL("encircled intensity plot does not reach total intensity");
+
+  return 0;
+}
+
@@ -0,0 +1,173 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+   Check field and wavelength spot matrix against single spot analysis.
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+
+#include <goptical/core/Error>
+
+#include <goptical/core/math/Vector>
+
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/Lens>
+#include <goptical/core/sys/Image>
+#include <goptical/core/sys/SourcePoint>
+
+#include <goptical/core/trace/Tracer>
+#include <goptical/core/trace/Distribution>
+#include <goptical/core/trace/Params>
+#include <goptical/core/trace/Sequence>
+
+#include <goptical/core/analysis/Spot>
+#include <goptical/core/analysis/SpotMatrix>
+
+#include <goptical/core/light/SpectralLine>
+
+#include "test_common.hpp"
+
+using namespace goptical;
+
+static const double fields[] = { 0.0, 15.0, 27.5 };
+static const double wavelens[] = { light::SpectralLine::C,
+                                   light::SpectralLine::e,
+                                   light::SpectralLine::F };
+
+static bool same(double a, double b)
+{
+  return fabs(a - b) <= 1e-9 * std::max(1.0, fabs(b));
+}
+
+int main()
+{
+  test::Tessar  tessar(20);
+  sys::system   &sys = tessar._system;
+  sys::Image    &image = tessar._image;
+  sys::SourcePoint &source = tessar._source;
+
+  trace::Sequence seq(sys);
+
+  for (int mode = 0; mode < 2; mode++)
+    {
+      if (mode)
+        sys.get_tracer_params().set_sequential_mode(seq);
+
+      unsigned int count = sys.get_element_count();
+      unsigned int version = sys.get_version();
+
+      analysis::SpotMatrix matrix(sys);
+
+      matrix.get_tracer().get_params().set_thread_count(3);
+
+      for (double y : fields)
+        matrix.add_field(math::Vector3(0, y, -1000), sys::SourceAtFiniteDistance);
+
+      for (double w : wavelens)
+        matrix.add_spectral_line(light::SpectralLine(w));
+
+      if (matrix.get_field_count() != 3 || matrix.get_spectral_line_count() != 3)
+        FAIL("bad matrix size");
+
+      // system is left unchanged by the analysis
+      matrix.get_rms_radius(0, 0);
+
+      if (sys.get_element_count() != count || sys.get_version() != version ||
+          !source.is_enabled())
+        FAIL("system modified");
+
+      if (matrix.get_field_source(1).get_system())
+        FAIL("field source left in system");
+
+      for (unsigned int f = 0; f < 3; f++)
+        for (unsigned int l = 0; l < 3; l++)
+          {
+            source.set_local_position(math::Vector3(0, fields[f], -1000));
+            source.single_spectral_line(light::SpectralLine(wavelens[l]));
+
+            analysis::Spot spot(sys);
+
+            if (matrix.get_ray_count(f, l) == 0)
+              FAIL("empty cell " << f << " " << l);
+
+            if (!same(matrix.get_rms_radius(f, l), spot.get_rms_radius()))
+              FAIL("rms radius differs for cell " << f << " " << l << ": "
+                   << matrix.get_rms_radius(f, l) << " " << spot.get_rms_radius());
+
+            if (!same(matrix.get_max_radius(f, l), spot.get_max_radius()))
+              FAIL("max radius differs for cell " << f << " " << l);
+
+            if ((matrix.get_centroid(f, l) - spot.get_centroid()).len() > 1e-9)
+              FAIL("centroid differs for cell " << f << " " << l);
+
+            if (!same(matrix.get_total_intensity(f, l), spot.get_total_intensity()))
+              FAIL("total intensity differs for cell " << f << " " << l);
+
+            for (double r = 0.005; r < 0.1; r += 0.005)
+              if (!same(matrix.get_encircled_intensity(f, l, r),
+                         spot.get_encircled_intensity(r)))
+                FAIL("encircled intensity differs for cell " << f << " " << l
+                     << " at radius " << r);
+          }
+
+      source.clear_spectrum();
+      source.add_spectral_line(light::SpectralLine::e);
+    }
+
+  // duplicate wavelen and out of range cells are rejected
+
+  analysis::SpotMatrix matrix(sys);
+
+  matrix.add_field(math::Vector3(0, 0, -1000), sys::SourceAtFiniteDistance);
+  matrix.add_spectral_line(light::SpectralLine::e);
+
+  try {
+    matrix.add_spectral_line(light::SpectralLine::e);
+    FAIL("duplicate wavelen accepted");
+  } catch (const Error &) {
+  }
+
+  try {
+    matrix.get_rms_radius(1, 0);
+    FAIL("out of range cell accepted");
+  } catch (const Error &) {
+  }
+
+  // tracer source can not be part of a system
+
+  trace::tracer tracer(sys);
+
+  tracer.set_source(source);
+
+  try {
+    tracer.trace();
+    FAIL("tracer source in system accepted");
+  } catch (const Error &) {
+  }
+
+  return 0;
+}
@@ -0,0 +1,86 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+   Check work ranges split between threads for large counts.
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+
+#include "test_common.hpp"
+
+#include "../../src/core/thread_ranges_.hxx"
+
+static void check(unsigned int count, unsigned int threads)
+{
+  std::vector<std::pair<unsigned int, unsigned int> > ranges(threads);
+  std::mutex lock;
+  unsigned int calls = 0;
+
+  _goptical::run_ranges(count, threads,
+                        [&](unsigned int i, unsigned int first, unsigned int last)
+    {
+      std::lock_guard<std::mutex> l(lock);
+
+      ranges[i] = std::make_pair(first, last);
+      calls++;
+    });
+
+  if (calls != std::max(1u, std::min(count, threads)))
+    FAIL("bad ranges count " << calls);
+
+  unsigned int next = 0;
+
+  for (unsigned int i = 0; i < calls; i++)
+    {
+      if (ranges[i].first != next || ranges[i].second < ranges[i].first)
+        FAIL(count << " / " << threads << ": range " << i << " is not contiguous");
+
+      if (ranges[i].second - ranges[i].first > count / calls + 1)
+        FAIL(count << " / " << threads << ": range " << i << " is too large");
+
+      next = ranges[i].second;
+    }
+
+  if (next != count)
+    FAIL(count << " / " << threads << ": ranges do not cover count");
+}
+
+int main()
+{
+  check(0, 4);
+  check(7, 16);
+  check(1000, 3);
+
+  // count * threads does not fit in 32 bits
+  check(300000000, 16);
+  check(4000000000u, 64);
+  check(0xffffffffu, 256);
+
+  return 0;
+}
@@ -0,0 +1,121 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+   Check through focus analysis against spots traced on shifted images.
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+#include <goptical/core/math/Vector>
+
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/Lens>
+#include <goptical/core/sys/Image>
+#include <goptical/core/sys/SourcePoint>
+
+#include <goptical/core/trace/Tracer>
+#include <goptical/core/trace/Distribution>
+#include <goptical/core/trace/Params>
+
+#include <goptical/core/data/Plot>
+
+#include <goptical/core/analysis/Spot>
+#include <goptical/core/analysis/ThroughFocus>
+
+#include <goptical/core/light/SpectralLine>
+
+#include "test_common.hpp"
+
+using namespace goptical;
+
+int main()
+{
+  test::Tessar  tessar(30);
+  sys::system   &sys = tessar._system;
+  sys::Image    &image = tessar._image;
+
+  const double z0 = image.get_local_position().z();
+
+  analysis::ThroughFocus tf(sys);
+
+  tf.get_tracer().get_params().set_thread_count(3);
+  tf.set_defocus_range(-1.0, 1.0, 9);
+
+  std::vector<double> ee = tf.get_encircled_intensity(0.05);
+
+  if (ee.size() != 9 || tf.get_plane_count() != 9)
+    FAIL("bad plane count");
+
+  for (unsigned int i = 0; i < tf.get_plane_count(); i++)
+    {
+      double dz = tf.get_defocus(i);
+
+      image.set_local_position(math::Vector3(0, 0, z0 + dz));
+
+      analysis::Spot spot(sys);
+      double rms = spot.get_rms_radius();
+
+      if (fabs(tf.get_rms_radius(i) - rms) > 1e-9 * rms)
+        FAIL("rms radius differs at defocus " << dz << ": "
+             << tf.get_rms_radius(i) << " " << rms);
+
+      math::Vector2 c(spot.get_centroid(), 0, 1);
+
+      if ((tf.get_centroid(i) - c).len() > 1e-9)
+        FAIL("centroid differs at defocus " << dz);
+
+      double e = spot.get_encircled_intensity(0.05);
+
+      if (fabs(ee[i] - e) > 1e-3 * spot.get_total_intensity())
+        FAIL("encircled intensity differs at defocus " << dz << ": " << ee[i] << " " << e);
+    }
+
+  image.set_local_position(math::Vector3(0, 0, z0));
+
+  // best focus
+
+  double best = tf.get_best_defocus();
+
+  tf.set_defocus_range(best, best, 1);
+  double best_rms = tf.get_rms_radius(0);
+
+  tf.set_defocus_range(best - 0.1, best + 0.1, 21);
+
+  for (unsigned int i = 0; i < tf.get_plane_count(); i++)
+    if (tf.get_rms_radius(i) < best_rms - 1e-12)
+      FAIL("best defocus does not minimize rms radius");
+
+  ref<data::Plot> p1 = tf.get_rms_radius_plot();
+  ref<data::Plot> p2 = tf.get_encircled_intensity_plot(0.02);
+
+  if (p1->get_plot_count() != 1 || p2->get_plot_count() != 1)
+    FAIL("bad plots");
+
+  return 0;
+}
+
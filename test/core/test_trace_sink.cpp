@@ -0,0 +1,146 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <goptical/core/math/Vector>
+
+#include <goptical/core/sys/System>
+#include <goptical/core/sys/Lens>
+#include <goptical/core/sys/Image>
+#include <goptical/core/sys/Surface>
+#include <goptical/core/sys/SourcePoint>
+
+#include <goptical/core/trace/Tracer>
+#include <goptical/core/trace/Result>
+#include <goptical/core/trace/Ray>
+#include <goptical/core/trace/Distribution>
+#include <goptical/core/trace/Params>
+#include <goptical/core/trace/Sequence>
+#include <goptical/core/trace/Sink>
+
+#include <goptical/core/light/SpectralLine>
+
+#include "test_common.hpp"
+
+using namespace goptical;
+
+// store intercept points as they are reported by the tracer
+class PointSink : public trace::Sink
+{
+public:
+  void intercept(const sys::Surface &, const trace::Ray &r)
+  {
+    const math::Vector3 &p = r.get_intercept_point();
+
+    _points.push_back(p.x());
+    _points.push_back(p.y());
+    _points.push_back(r.get_wavelen());
+  }
+
+  ref<trace::Sink> new_worker() const
+  {
+    return ref<PointSink>::create();
+  }
+
+  void merge_worker(trace::Sink &worker)
+  {
+    const PointSink &w = static_cast<const PointSink &>(worker);
+
+    _points.insert(_points.end(), w._points.begin(), w._points.end());
+  }
+
+  std::vector<double> _points;
+};
+
+static std::vector<double> trace_list(sys::system &sys, sys::Image &image)
+{
+  trace::tracer tracer(sys);
+  std::vector<double> res;
+
+  tracer.get_trace_result().set_intercepted_save_state(image);
+  tracer.trace();
+
+  for (auto &r : tracer.get_trace_result().get_intercepted(image))
+    {
+      const math::Vector3 &p = r->get_intercept_point();
+
+      res.push_back(p.x());
+      res.push_back(p.y());
+      res.push_back(r->get_wavelen());
+    }
+
+  return res;
+}
+
+static std::vector<double> trace_sink(sys::system &sys, sys::Image &image,
+                                      unsigned int threads, bool history)
+{
+  trace::tracer tracer(sys);
+  ref<PointSink> sink = ref<PointSink>::create();
+
+  tracer.get_params().set_thread_count(threads);
+  tracer.get_params().set_ray_history(history);
+  tracer.get_trace_result().set_intercepted_sink(image, sink);
+  tracer.trace();
+
+  return sink->_points;
+}
+
+int main()
+{
+  test::Tessar  tessar(20);
+  sys::system   &sys = tessar._system;
+  sys::Image    &image = tessar._image;
+
+  trace::Sequence seq(sys);
+
+  for (int mode = 0; mode < 2; mode++)
+    {
+      if (mode)
+        sys.get_tracer_params().set_sequential_mode(seq);
+
+      // sink must see the same rays as the intercepted rays list
+      std::vector<double> ref = trace_list(sys, image);
+
+      if (ref.empty())
+        FAIL("no ray intercepted by image");
+
+      for (unsigned int threads = 1; threads <= 3; threads++)
+        for (int history = 0; history < 2; history++)
+          {
+            std::vector<double> res = trace_sink(sys, image, threads, history);
+
+            if (res.size() != ref.size() ||
+                std::memcmp(&res[0], &ref[0], ref.size() * sizeof(double)))
+              FAIL("sink data differs from intercepted rays list, "
+                   << threads << " threads, history " << history);
+          }
+    }
+
+  return 0;
+}
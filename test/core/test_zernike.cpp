@@ -0,0 +1,307 @@
+/*
+
+      This file is part of the <goptical/core Core library.
+  
+      The <goptical/core library is free software; you can redistribute it
+      and/or modify it under the terms of the GNU General Public
+      License as published by the Free Software Foundation; either
+      version 3 of the License, or (at your option) any later version.
+  
+      The <goptical/core library is distributed in the hope that it will be
+      useful, but WITHOUT ANY WARRANTY; without even the implied
+      warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+      See the GNU General Public License for more details.
+  
+      You should have received a copy of the GNU General Public
+      License along with the <goptical/core library; if not, write to the
+      Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+      Boston, MA 02111-1307 USA
+  
+      Copyright (C) 2010-2011 Free Software Foundation, Inc
+      Author: Alexandre Becoulet
+
+*/
+
+/*
+   Check Zernike terms orderings, normalization and high order terms
+   orthogonality, batch evaluation and intersection.
+*/
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+#include <goptical/core/math/Vector>
+#include <goptical/core/math/VectorPair>
+
+#include <goptical/core/curve/Zernike>
+#include <goptical/core/data/Grid>
+
+#include <goptical/core/trace/RayBatch>
+#include <goptical/core/trace/Distribution>
+
+#include "test_common.hpp"
+
+using namespace goptical;
+
+/* Gauss-Legendre nodes and weights on [0, 1] */
+static void gauss_legendre(unsigned int n, std::vector<double> &x, std::vector<double> &w)
+{
+  x.resize(n);
+  w.resize(n);
+
+  for (unsigned int i = 0; i < n; i++)
+    {
+      double z = cos(M_PI * (i + .75) / (n + .5));
+      double dp;
+
+      for (unsigned int j = 0; j < 100; j++)
+        {
+          double p0 = 1, p1 = 0;
+
+          for (unsigned int k = 1; k <= n; k++)
+            {
+              double p2 = p1;
+              p1 = p0;
+              p0 = ((2 * k - 1) * z * p1 - (k - 1) * p2) / k;
+            }
+
+          dp = n * (z * p0 - p1) / (z * z - 1);
+          z -= p0 / dp;
+        }
+
+      x[i] = (1 - z) / 2;
+      w[i] = 1 / ((1 - z * z) * dp * dp);
+    }
+}
+
+/* check terms of normalized orderings are orthonormal over the unit disk */
+static void test_orthonormal(curve::Zernike::Ordering o, unsigned int order)
+{
+  curve::Zernike z(1., o, order);
+  unsigned int tc = z.get_term_count();
+
+  if (tc != (order + 1) * (order + 2) / 2)
+    FAIL("bad term count " << tc);
+
+  std::vector<double> r, rw;
+  gauss_legendre(order + 2, r, rw);
+
+  const unsigned int na = 2 * order + 2;
+  std::vector<double> v(tc), m(tc * tc, 0.);
+
+  for (unsigned int i = 0; i < r.size(); i++)
+    for (unsigned int j = 0; j < na; j++)
+      {
+        double a = 2 * M_PI * j / na;
+        double w = rw[i] * r[i] * 2 / na;
+
+        z.zernike_polys(math::Vector2(r[i] * cos(a), r[i] * sin(a)), &v[0]);
+
+        for (unsigned int k = 0; k < tc; k++)
+          for (unsigned int l = 0; l < tc; l++)
+            m[k * tc + l] += v[k] * v[l] * w;
+      }
+
+  for (unsigned int k = 0; k < tc; k++)
+    for (unsigned int l = 0; l < tc; l++)
+      if (fabs(m[k * tc + l] - (k == l)) > 1e-9)
+        FAIL("terms " << k << " " << l << " not orthonormal: " << m[k * tc + l]);
+}
+
+int main()
+{
+  // Fringe terms
+  {
+    curve::Zernike z(1.);
+    unsigned int n;
+    int m;
+
+    if (z.get_term_count() != curve::Zernike::term_count)
+      FAIL("bad default term count");
+
+    z.get_term_order(8, n, m);
+    if (n != 4 || m != 0)
+      FAIL("bad fringe spherical term");
+
+    z.get_term_order(12, n, m);
+    if (n != 4 || m != -2)
+      FAIL("bad fringe term 12");
+
+    if (fabs(curve::Zernike::zernike_poly(8, math::Vector2(.5, .3)) -
+             (1 + 6 * .34 * (.34 - 1))) > 1e-14)
+      FAIL("bad fringe spherical value");
+  }
+
+  // Noll terms
+  {
+    curve::Zernike z(1., curve::Zernike::Noll, 6);
+    std::vector<double> v(z.get_term_count());
+    math::Vector2 p(.3, -.4);
+    double r2 = .25, a = atan2(-.4, .3);
+
+    z.zernike_polys(p, &v[0]);
+
+    if (z.get_first_term() != 1 || z.get_term_index(2, 0) != 4 ||
+        z.get_term_index(1, 1) != 2 || z.get_term_index(1, -1) != 3 ||
+        z.get_term_index(2, -2) != 5 || z.get_term_index(3, -1) != 7 ||
+        z.get_term_index(4, 0) != 11 || z.get_term_index(4, 2) != 12)
+      FAIL("bad noll index");
+
+    if (fabs(v[4 - 1] - sqrt(3.) * (2 * r2 - 1)) > 1e-14 ||
+        fabs(v[11 - 1] - sqrt(5.) * (6 * r2 * r2 - 6 * r2 + 1)) > 1e-14 ||
+        fabs(v[9 - 1] - sqrt(8.) * pow(r2, 1.5) * sin(3 * a)) > 1e-14)
+      FAIL("bad noll value");
+  }
+
+  // ANSI terms
+  {
+    curve::Zernike z(1., curve::Zernike::Ansi, 8);
+
+    for (unsigned int n = 0; n <= 8; n++)
+      for (int m = -(int)n; m <= (int)n; m += 2)
+        if (z.get_term_index(n, m) != (n * (n + 2) + m) / 2)
+          FAIL("bad ansi index");
+  }
+
+  test_orthonormal(curve::Zernike::Noll, 20);
+  test_orthonormal(curve::Zernike::Ansi, 20);
+
+  // high order curve, batch evaluation and intersection
+  curve::Zernike z(10., curve::Zernike::Ansi, 20, 1e-3);
+
+  srand48(1);
+  for (unsigned int i = 0; i < z.get_term_count(); i++)
+    z.set_coefficient(i, (drand48() - .5) * .1);
+
+  const unsigned int count = 200;
+  std::vector<double> x(count), y(count), s(count), dx(count), dy(count);
+
+  for (unsigned int i = 0; i < count; i++)
+    {
+      x[i] = (drand48() - .5) * 20;
+      y[i] = (drand48() - .5) * 20;
+    }
+
+  z.sagitta_gradient_batch(count, &x[0], &y[0], &s[0], &dx[0], &dy[0]);
+
+  for (unsigned int i = 0; i < count; i++)
+    {
+      math::Vector2 p(x[i], y[i]), d;
+
+      if (s[i] != z.sagitta(p))
+        FAIL("batch sagitta mismatch");
+
+      z.derivative(p, d);
+
+      if (d.x() != dx[i] || d.y() != dy[i])
+        FAIL("batch gradient mismatch");
+
+      z.Base::derivative(p, d);
+
+      if (p.len() < 9.99 && (fabs(d.x() - dx[i]) > 1e-6 || fabs(d.y() - dy[i]) > 1e-6))
+        FAIL("gradient mismatch at " << p << ": " << d << " " << dx[i] << " " << dy[i]);
+    }
+
+  trace::RayBatch batch;
+
+  for (unsigned int i = 0; i < count; i++)
+    {
+      math::Vector3 o((drand48() - .5) * 18, (drand48() - .5) * 18, -10);
+      math::Vector3 d((drand48() - .5) * .1, (drand48() - .5) * .1, 1);
+
+      batch.add(math::VectorPair3(o, d.normalized()), .5, 1., 0, i);
+    }
+
+  z.intersect_batch(batch);
+  z.normal_batch(batch);
+
+  for (unsigned int i = 0; i < count; i++)
+    {
+      math::Vector3 p, n;
+      bool hit = z.Base::intersect(p, batch.get_ray(i));
+
+      if (hit != batch.is_active(i))
+        FAIL("batch intersection state mismatch");
+
+      if (!hit)
+        continue;
+
+      if ((p - batch.get_point(i)).len() != 0)
+        FAIL("batch intersection mismatch");
+
+      z.normal(n, p);
+
+      if ((n - batch.get_normal(i)).len() > 1e-15)
+        FAIL("batch normal mismatch");
+    }
+
+  std::cout << (double)batch.get_iterations() / count << " iterations per ray" << std::endl;
+
+  // fit, same terms in different ordering
+  curve::Zernike a(10., curve::Zernike::Ansi, 8, 1e-3);
+
+  for (unsigned int i = 0; i < a.get_term_count(); i++)
+    a.set_coefficient(i, z.get_coefficient(i));
+
+  curve::Zernike f(10., curve::Zernike::Noll, 8, 1e-3);
+
+  f.fit(a, trace::Distribution(trace::HexaPolarDist, 30));
+
+  curve::Zernike l(10., curve::Zernike::Noll, 8, 1e-3);
+
+  for (unsigned int n = 0; n <= 8; n++)
+    for (int m = -(int)n; m <= (int)n; m += 2)
+      l.set_coefficient(l.get_term_index(n, m), a.get_coefficient(a.get_term_index(n, m)));
+
+  for (unsigned int i = 1; i <= f.get_term_count(); i++)
+    if (fabs(f.get_coefficient(i) - l.get_coefficient(i)) > 1e-9)
+      FAIL("bad fit coefficient " << i << " " << f.get_coefficient(i) << " " << l.get_coefficient(i));
+
+  // grid fit with masked points, on multiple threads
+  {
+    data::Grid g(81, 81, math::Vector2(-10, -10), math::Vector2(.25, .25));
+
+    for (unsigned int i = 0; i < 81; i++)
+      for (unsigned int j = 0; j < 81; j++)
+        g.get_y_value(i, j) = (i - 40) * (i - 40) + (j - 20) * (j - 20) < 25
+          ? NAN : a.sagitta(g.get_x_value_i(i, j));
+
+    curve::Zernike m(10., curve::Zernike::Ansi, 8, 1e-3);
+
+    double rms = m.fit(g, 4);
+
+    if (rms > 1e-12)
+      FAIL("bad grid fit residual " << rms);
+
+    for (unsigned int i = 0; i < m.get_term_count(); i++)
+      if (fabs(m.get_coefficient(i) - a.get_coefficient(i)) > 1e-9)
+        FAIL("bad grid fit coefficient " << i);
+
+    // fit on same points reuses basis
+    for (unsigned int i = 0; i < 81; i++)
+      for (unsigned int j = 0; j < 81; j++)
+        g.get_y_value(i, j) *= 2;
+
+    m.fit(g, 3);
+
+    for (unsigned int i = 0; i < m.get_term_count(); i++)
+      if (fabs(m.get_coefficient(i) - 2 * a.get_coefficient(i)) > 1e-9)
+        FAIL("bad grid fit coefficient " << i);
+
+    double x[3] = { 0, 1, 2 }, y[3] = { 0, 1, 2 }, s[3] = { 0, 0, 0 };
+    bool err = false;
+
+    try {
+      m.fit(3, x, y, s);
+    } catch (...) {
+      err = true;
+    }
+
+    if (!err)
+      FAIL("fit with too few points must fail");
+  }
+
+  return 0;
+}